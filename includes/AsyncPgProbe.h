@@ -0,0 +1,75 @@
+#ifndef ASYNC_PG_PROBE_H
+#define ASYNC_PG_PROBE_H
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include <libpq-fe.h>  // PostgreSQL
+#include <seastar/core/future.hh>
+#include <seastar/core/internal/pollable_fd.hh>
+#include <seastar/core/semaphore.hh>
+
+// Everything one probe round trip returns
+struct PgProbeSnapshot {
+    std::chrono::steady_clock::time_point takenAt;
+    double latencySeconds = 0.0;     // Send to first result, i.e. one network round trip
+    double transactions = 0.0;       // xact_commit + xact_rollback of the current database
+    double cacheHitRatio = 0.0;      // blks_hit / (blks_hit + blks_read) over all databases
+    double poolUtilization = 0.0;    // Mean backends per database
+    double buffersCheckpoint = 0.0;  // pg_stat_bgwriter
+    double buffersClean = 0.0;
+    double buffersBackend = 0.0;
+};
+
+// PostgreSQL probes that run on the Seastar reactor instead of blocking it. The
+// connection is non-blocking and a dup of its socket is registered with the reactor,
+// so waiting on the server yields the shard. All probe queries go out together in
+// pipeline mode (or as one multi-statement query on libpq < 14) and come back in a
+// single round trip. One instance per shard and URI; use forShard().
+class AsyncPgProbe {
+public:
+    explicit AsyncPgProbe(std::string uri);
+    ~AsyncPgProbe();
+
+    AsyncPgProbe(const AsyncPgProbe&) = delete;
+    AsyncPgProbe& operator=(const AsyncPgProbe&) = delete;
+
+    // The calling shard's probe for uri
+    static AsyncPgProbe& forShard(const std::string& uri);
+
+    // Connects on first use and reconnects after a failure
+    seastar::future<PgProbeSnapshot> probe();
+
+    seastar::future<double> queryLatency();
+    seastar::future<double> cacheHitRatio();
+    seastar::future<double> poolUtilization();
+    // Per second since the previous probe; the first call waits one second for a baseline
+    seastar::future<double> transactionRate();
+
+    // Seconds the last connection took to establish
+    std::optional<double> connectLatency() const { return connectSeconds; }
+    // Result of the most recent successful probe
+    const std::optional<PgProbeSnapshot>& lastSnapshot() const { return last; }
+
+private:
+    // These run inside seastar::async and wait on the socket with .get()
+    void connect();
+    void flush();
+    PGresult* nextResult();
+    PgProbeSnapshot roundTrip();
+
+    void watchSocket();
+    void disconnect();
+
+    std::string uri;
+    PGconn* conn = nullptr;
+    std::unique_ptr<seastar::pollable_fd> socket;
+    int watchedSocket = -1;
+    seastar::semaphore inFlight{1}; // One pipeline at a time per connection
+    std::optional<double> connectSeconds;
+    std::optional<PgProbeSnapshot> last;
+};
+
+#endif // ASYNC_PG_PROBE_H
@@ -0,0 +1,92 @@
+#ifndef CGROUP_METRICS_H
+#define CGROUP_METRICS_H
+
+#include "PressureStall.h"
+#include "ProcReader.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+
+struct CgroupCpuStat {
+    uint64_t usageUsec = 0;
+    uint64_t userUsec = 0;
+    uint64_t systemUsec = 0;
+    uint64_t nrPeriods = 0;
+    uint64_t nrThrottled = 0;
+    uint64_t throttledUsec = 0;
+};
+
+struct CgroupMemoryEvents {
+    uint64_t low = 0;
+    uint64_t high = 0;
+    uint64_t max = 0;
+    uint64_t oom = 0;
+    uint64_t oomKill = 0;
+};
+
+// io.stat summed over all devices
+struct CgroupIoStat {
+    uint64_t rbytes = 0;
+    uint64_t wbytes = 0;
+    uint64_t rios = 0;
+    uint64_t wios = 0;
+};
+
+// Reads a cgroup v2 group's own accounting files, so a workload's utilization is
+// measured against its own limits rather than host-wide counters that include
+// noisy neighbours. Files stay open between reads; one instance per thread.
+class CgroupMetrics {
+public:
+    explicit CgroupMetrics(std::string cgroupPath);
+
+    // Resolves the cgroup of pid from /proc/<pid>/cgroup (the "0::" v2 entry) to an
+    // absolute path under the cgroup2 mount. Throws std::runtime_error if the process
+    // is gone or the host has no unified hierarchy.
+    static std::string resolveCgroup(pid_t pid);
+    static CgroupMetrics forProcess(pid_t pid);
+
+    // First pid whose /proc/<pid>/comm equals processName, or -1.
+    static pid_t findProcess(const std::string& processName);
+
+    const std::string& path() const { return cgroupPath; }
+
+    CgroupCpuStat cpuStat();
+    uint64_t memoryCurrent();
+    uint64_t memoryMax(); // UINT64_MAX when unlimited
+    CgroupMemoryEvents memoryEvents();
+    CgroupIoStat ioStat();
+    PressureStats cpuPressure();
+    PressureStats memoryPressure();
+    PressureStats ioPressure();
+
+    // Percent of the group's CPU allowance (cpu.max quota, or all online CPUs when
+    // unlimited) used since the previous call on this object. The first call takes the
+    // baseline and returns 0.
+    double cpuUtilization();
+    // Percent of memory.max, or of host RAM when unlimited.
+    double memoryUtilization();
+    // Read plus write KB/s since the previous call on this object; 0 on the first call.
+    double ioThroughput();
+
+private:
+    double allowedCpus();
+
+    std::string cgroupPath;
+    ProcReader cpuStatFile;
+    ProcReader cpuMaxFile;
+    ProcReader memoryCurrentFile;
+    ProcReader memoryMaxFile;
+    ProcReader memoryEventsFile;
+    ProcReader ioStatFile;
+    ProcReader cpuPressureFile;
+    ProcReader memoryPressureFile;
+    ProcReader ioPressureFile;
+
+    std::chrono::steady_clock::time_point lastCpuSampleAt;
+    uint64_t lastCpuUsageUsec = 0;
+    std::chrono::steady_clock::time_point lastIoSampleAt;
+    uint64_t lastIoBytes = 0;
+};
+
+#endif // CGROUP_METRICS_H
@@ -0,0 +1,65 @@
+#ifndef DB_PROBE_POOL_H
+#define DB_PROBE_POOL_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <mongoc/mongoc.h>  // MongoDB
+#include <aerospike/aerospike.h>  // AerospikeDB
+
+class ScyllaDBClient;
+
+// Keeps one warm connection per database URI for the SystemMetrics probes, so a probe
+// measures the query rather than the TCP/TLS handshake and the database does not see
+// a connection per call. Connections are opened lazily, timed separately, and dropped
+// when a probe reports that the connection itself failed, so the next call reconnects;
+// a query that fails on a healthy connection keeps it. Probes against the same URI are
+// serialized; different URIs run concurrently. PostgreSQL is not pooled here: it is
+// probed without blocking by AsyncPgProbe.
+class DbProbePool {
+public:
+    // Thrown by a probe when the transport failed rather than the query
+    struct ConnectionError : std::runtime_error {
+        using std::runtime_error::runtime_error;
+    };
+
+    // Whether a driver error means the connection is gone: a stream or server selection
+    // failure for MongoDB, a connection, TLS, node or cluster failure for Aerospike
+    static bool isConnectionError(const bson_error_t& error);
+    static bool isConnectionError(as_status status);
+
+    static DbProbePool& instance();
+
+    ~DbProbePool();
+    DbProbePool(const DbProbePool&) = delete;
+    DbProbePool& operator=(const DbProbePool&) = delete;
+
+    // Run probe against the warm connection for uri. Throws std::runtime_error if no
+    // connection can be made. Exceptions from probe propagate; a ConnectionError also
+    // discards that client, and only that one.
+    void withMongo(const std::string& uri, const std::function<void(mongoc_client_t*)>& probe);
+    void withAerospike(const std::string& uri, const std::function<void(aerospike*)>& probe);
+    void withScylla(const std::string& uri, const std::function<void(ScyllaDBClient&)>& probe);
+
+    // Seconds it took to establish the current connection to uri, or nullopt if none is open
+    std::optional<double> connectLatency(const std::string& uri);
+
+    // Per-second rate of a monotonically increasing server counter since the previous
+    // sample under the same name, or nullopt for the first sample (or after a reset)
+    std::optional<double> counterRate(const std::string& uri, const std::string& counter, double value);
+
+private:
+    struct Entry;
+
+    DbProbePool();
+    Entry& entry(const std::string& uri);
+
+    std::mutex mutex;
+    std::map<std::string, std::unique_ptr<Entry>> entries;
+};
+
+#endif // DB_PROBE_POOL_H
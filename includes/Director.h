@@ -4,8 +4,14 @@
 #include "NodeManager.h"
 #include "GANCodirector.h"
 #include "MPIController.h"
+#include "MetricsExporter.h"
 #include "SystemResources.h"
+#include "PressureStall.h"
 #include <seastar/core/future.hh>
+#include <seastar/core/abort_source.hh>
+#include <seastar/core/condition-variable.hh>
+#include <seastar/core/reactor.hh>
+#include <optional>
 #include <string>
 #include <zookeeper/zookeeper.h>
 
@@ -14,6 +20,8 @@ public:
     Director();
     seastar::future<> nodeController();
     seastar::future<> initialize();
+    // Stops the stall watch, the metrics endpoint and answering other ranks' queries
+    seastar::future<> stop();
 
 private:
     NodeManager nodeManager;
@@ -28,7 +36,28 @@ private:
     // Zookeeper handle
     zhandle_t* zkHandle;
 
+    // MPI rank of the leader, as read from /director/leader; -1 while this rank leads or
+    // it is unknown
+    int leaderRank;
+
+    // PSI triggers on every host wake the leader's monitor loop before its next tick: the
+    // lowest rank of each host watches it and reports stalls to the leader
+    PressureMonitor pressureMonitor;
+    seastar::readable_eventfd stallEvents;
+    seastar::condition_variable stallWakeup;
+    std::optional<seastar::future<>> stallWatch;
+    seastar::abort_source stallWatchAbort;
+
+    // /metrics for Prometheus, from every shard's latest node frames
+    MetricsExporter metricsExporter;
+
     seastar::future<> monitorNodes();
+    void startStallWatch();
+    seastar::future<> onStall();
+    void startMetricsExporter();
+    // Opens the shared archive writer; on failure the director runs without an archive
+    void startArchive();
+    seastar::future<> waitForNextTick();
     void onZookeeperWatch(int type, int state, const char* path);
     void checkLeadership();
     static void watcher(zhandle_t* zh, int type, int state, const char* path, void* watcherCtx);
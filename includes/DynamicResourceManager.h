@@ -5,14 +5,10 @@
 #include <string>
 #include <map>
 #include <tuple>
-#include <nvml.h>
 #include <stdexcept>
 
 class DynamicResourceManager {
 public:
-    DynamicResourceManager();
-    ~DynamicResourceManager();
-
     double gpuUsage();
     double gpuTemperature(int instanceId);
     double cpuUsage(int instanceId);
@@ -33,8 +29,6 @@ private:
     std::map<int, double> memoryUsageMap;
     std::map<int, double> driveUsageMap;
     std::map<int, std::string> taskStatusMap;
-    void initNVML();
-    void shutdownNVML();
 };
 
 #endif // DYNAMIC_RESOURCE_MANAGER_H
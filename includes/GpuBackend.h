@@ -0,0 +1,141 @@
+#ifndef GPU_BACKEND_H
+#define GPU_BACKEND_H
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Values mirror the NVML enums they stand in for, so the NVML backend can pass them through
+enum class GpuClock { GRAPHICS = 0, SM = 1, MEMORY = 2 };
+enum class GpuPcieCounter { TX_BYTES = 0, RX_BYTES = 1 };
+enum class GpuComputeMode { DEFAULT = 0, EXCLUSIVE_THREAD = 1, PROHIBITED = 2, EXCLUSIVE_PROCESS = 3 };
+// Gauges the driver samples on its own and buffers (nvmlSamplingType_t)
+enum class GpuSampleType { POWER = 0, GPU_UTILIZATION = 1, MEMORY_UTILIZATION = 2 };
+
+struct GpuUtilization {
+    unsigned int gpu = 0;    // % of the sample period a kernel was running
+    unsigned int memory = 0; // % of the sample period device memory was read or written
+};
+
+struct GpuMemoryInfo {
+    uint64_t total = 0; // Bytes
+    uint64_t used = 0;
+};
+
+// One buffered driver reading: mW for POWER, % for the utilizations
+struct GpuTimedValue {
+    uint64_t timestampMicros = 0; // CPU time of the reading, microseconds since the epoch
+    uint64_t value = 0;
+};
+
+// One process's use of one device. Utilizations are averaged over the driver's samples
+// since the time the caller asked about; 0 when the process was not sampled.
+struct GpuProcessUsage {
+    uint32_t pid = 0;                // As the driver sees it, i.e. in the host pid namespace
+    unsigned int device = 0;
+    uint64_t memoryUsed = 0;         // Bytes of device memory the process holds
+    double smUtilization = 0.0;      // % of the device's SM time
+    double memoryUtilization = 0.0;  // % of memory controller time
+    double encoderUtilization = 0.0; // %
+    double decoderUtilization = 0.0; // %
+    uint64_t lastSampleMicros = 0;   // Newest utilization sample behind the averages
+};
+
+// Every per-device gauge from one pass over the device. Plain fixed-layout data, so it
+// can be copied into MPI buffers and archives as is.
+struct GpuSample {
+    enum Field : uint32_t {
+        TEMPERATURE = 1u << 0,
+        UTILIZATION = 1u << 1,
+        MEMORY = 1u << 2,
+        POWER = 1u << 3,
+        FAN = 1u << 4,
+        CLOCKS = 1u << 5,
+        ENERGY = 1u << 6,
+    };
+
+    uint32_t valid = 0;             // Field bits that were read; the rest stay 0
+    uint32_t temperatureC = 0;
+    uint32_t gpuUtilization = 0;    // %
+    uint32_t memoryUtilization = 0; // %, memory controller busy
+    uint64_t memoryTotal = 0;       // Bytes
+    uint64_t memoryUsed = 0;
+    uint32_t powerMilliwatts = 0;
+    uint32_t fanPercent = 0;
+    uint32_t smClockMHz = 0;
+    uint32_t memoryClockMHz = 0;
+    uint64_t energyMillijoules = 0; // Since the driver loaded
+
+    bool has(Field field) const { return (valid & field) != 0; }
+    double memoryUsedPercent() const;
+};
+
+// One sample of every device on the node, with aggregates over the devices that
+// reported each field (a device missing a field is left out of that aggregate). An
+// aggregate no device reported a field for is empty, so a GPU-less node reports none.
+struct GpuSweep {
+    std::vector<GpuSample> devices; // By device index; a device that could not be read has valid == 0
+    std::optional<uint32_t> maxTemperatureC;
+    std::optional<double> meanUtilization; // %
+    std::optional<double> minUtilization;  // %
+    std::optional<double> memoryPressure;  // Used over total memory of all devices, %
+};
+
+// Source of GPU telemetry. Readers go through instance(), which picks NVML when the
+// driver library is present and a mock otherwise, so nothing links against NVML and a
+// GPU-less node starts without probing for one. Device indices follow NVML. Every
+// reading throws std::runtime_error when the device or the field is unavailable.
+class GpuBackend {
+public:
+    // Path of a mock script (see MockGpuBackend.h); when set, the mock is used even if NVML is present
+    static constexpr const char* MOCK_ENV = "DIRECTOR_GPU_MOCK";
+
+    GpuBackend();
+    virtual ~GpuBackend();
+
+    // Chosen and initialized on first use, then shared for the life of the process
+    static GpuBackend& instance();
+
+    virtual std::string name() const = 0;
+    virtual unsigned int deviceCount() = 0;
+
+    virtual unsigned int temperature(unsigned int index) = 0;     // Celsius
+    virtual GpuUtilization utilization(unsigned int index) = 0;
+    virtual GpuMemoryInfo memory(unsigned int index) = 0;
+    virtual unsigned int powerUsage(unsigned int index) = 0;      // Milliwatts
+    virtual unsigned int fanSpeed(unsigned int index) = 0;        // % of maximum
+    virtual unsigned int clock(unsigned int index, GpuClock clock) = 0; // MHz
+    virtual GpuComputeMode computeMode(unsigned int index) = 0;
+    virtual unsigned int pcieThroughput(unsigned int index, GpuPcieCounter counter) = 0; // KB/s
+
+    // All gauges of one device. Fields the device does not support are left out of
+    // GpuSample::valid instead of throwing; a missing device still throws. The default
+    // calls each getter in turn; backends override it with fewer driver round trips.
+    virtual GpuSample sample(unsigned int index);
+
+    // sample() of every device, spread over worker threads kept between sweeps when
+    // concurrentReads(), so a slow device does not hold up the rest. Never throws; a
+    // GPU-less node gets an empty sweep.
+    GpuSweep sweep();
+
+    // Readings of type the driver buffered after sinceMicros (the timestamp of the last
+    // reading already seen, or 0 for everything still buffered), oldest first. Empty
+    // when nothing newer has been sampled.
+    virtual std::vector<GpuTimedValue> bufferedSamples(unsigned int index, GpuSampleType type,
+                                                       uint64_t sinceMicros) = 0;
+
+    // Every process holding memory on, or sampled on, device index, with utilizations
+    // averaged over the samples taken after sinceMicros (see bufferedSamples())
+    virtual std::vector<GpuProcessUsage> processUsage(unsigned int index, uint64_t sinceMicros) = 0;
+
+    // Whether reads of different devices can overlap; NVML's are independent driver calls
+    virtual bool concurrentReads() const { return true; }
+
+private:
+    class SweepWorkers;
+    std::unique_ptr<SweepWorkers> sweepWorkers; // Starts its threads on the first concurrent sweep
+};
+
+#endif // GPU_BACKEND_H
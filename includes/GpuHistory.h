@@ -0,0 +1,66 @@
+#ifndef GPU_HISTORY_H
+#define GPU_HISTORY_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "GpuBackend.h"
+#include "LatencyHistogram.h"
+
+// Distributions of the gauges the GPU driver samples by itself. NVML records
+// utilization and power several times a second into per-device ring buffers; draining
+// those with the timestamp of the last reading seen gets every reading, at the driver's
+// rate, while this process only wakes up once per monitoring tick. A burst between two
+// ticks therefore shows up in the percentiles instead of being hit or missed by a single
+// instantaneous read. Thread-safe.
+class GpuHistory {
+public:
+    // One tick's readings, kept per device so a busy GPU is not averaged away by idle
+    // ones; merge them only for node-level figures
+    struct Interval {
+        struct Device {
+            LatencyHistogram utilization; // Percent
+            LatencyHistogram power;       // Milliwatts
+        };
+        std::vector<Device> devices; // By device index; empty histograms for a device without buffers
+
+        // Every device's readings together
+        LatencyHistogram utilization() const;
+        LatencyHistogram power() const;
+    };
+
+    explicit GpuHistory(GpuBackend& backend);
+
+    // Shared history over GpuBackend::instance()
+    static GpuHistory& instance();
+
+    // Moves every reading newer than the last one seen into the current interval. Drain
+    // more often than the driver's buffer wraps (NVML keeps a few tens of seconds).
+    // Devices or gauges the driver does not buffer are skipped.
+    void collect();
+
+    // Collects, then closes the current interval and starts the next. An interval
+    // younger than maxAge is returned again instead, so every frame built in one tick
+    // reports the same readings rather than draining them from each other. Shared
+    // rather than copied: each device carries two histograms. Empty histograms when the
+    // driver keeps no sample buffers.
+    std::shared_ptr<const Interval> latest(std::chrono::milliseconds maxAge = std::chrono::milliseconds(1000));
+
+private:
+    struct Track {
+        uint64_t lastSeenMicros = 0;
+        LatencyHistogram interval;
+    };
+
+    GpuBackend& backend;
+    std::mutex mutex;
+    std::map<std::pair<unsigned int, GpuSampleType>, Track> tracks;
+    std::shared_ptr<const Interval> closed;
+    std::chrono::steady_clock::time_point closedAt;
+};
+
+#endif // GPU_HISTORY_H
@@ -1,24 +1,18 @@
 #ifndef GPU_METRICS_H
 #define GPU_METRICS_H
 
-#include <nvml.h>
+#include "GpuBackend.h"
 #include <iostream>
 #include <stdexcept>
 
 class GpuMetrics {
 public:
-    GpuMetrics();
-    ~GpuMetrics();
     double getTemperature(int deviceIndex);
     double getGpuUtilization(int deviceIndex);
     double getMemoryUtilization(int deviceIndex);
     double getPowerUsage(int deviceIndex);
     double getFanSpeed(int deviceIndex);
-    double getClockSpeed(int deviceIndex, nvmlClockType_t clockType);
-
-private:
-    void initNVML();
-    void shutdownNVML();
+    double getClockSpeed(int deviceIndex, GpuClock clockType);
 };
 
 #endif // GPU_METRICS_H
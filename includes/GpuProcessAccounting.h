@@ -0,0 +1,61 @@
+#ifndef GPU_PROCESS_ACCOUNTING_H
+#define GPU_PROCESS_ACCOUNTING_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "GpuBackend.h"
+
+// One process's footprint across the GPUs of this node
+struct GpuProcessShare {
+    pid_t pid = 0;
+    std::string cgroup;                   // cgroup v2 path; empty once the process has exited
+    std::vector<GpuProcessUsage> devices; // One entry per device it holds memory on or was sampled on
+
+    uint64_t memoryUsed() const;          // Bytes, over all devices
+    double peakSmUtilization() const;     // % on its busiest device
+};
+
+// A workload's (cgroup's) GPU use. Utilizations add up the group's processes on each
+// device and report the busiest device, so a group that pegs one GPU of eight reads as
+// saturated rather than as 12% of the node.
+struct GpuWorkloadUsage {
+    unsigned int processes = 0;
+    uint64_t memoryUsed = 0;         // Bytes, over all devices
+    double smUtilization = 0.0;      // %
+    double memoryUtilization = 0.0;  // %
+    double encoderUtilization = 0.0; // %
+    double decoderUtilization = 0.0; // %
+};
+
+// Maps GPU use to processes and their cgroups: device memory from the driver's
+// running-process lists, SM, memory, encoder and decoder utilization from its
+// per-process samples since the previous collection. Pids are the driver's, so this
+// must run in the host pid namespace. Thread-safe.
+class GpuProcessAccounting {
+public:
+    explicit GpuProcessAccounting(GpuBackend& backend);
+
+    // Shared accounting over GpuBackend::instance()
+    static GpuProcessAccounting& instance();
+
+    // Every process on any GPU, utilization averaged since the previous collection.
+    // Results younger than maxAge are returned again instead of collecting, so several
+    // readers in one tick see the same window rather than splitting it.
+    std::vector<GpuProcessShare> collect(std::chrono::milliseconds maxAge = std::chrono::milliseconds(1000));
+
+    // Totals for the processes of shares that live in cgroup
+    static GpuWorkloadUsage forCgroup(const std::vector<GpuProcessShare>& shares, const std::string& cgroup);
+
+private:
+    GpuBackend& backend;
+    std::mutex mutex;
+    std::vector<uint64_t> lastSampleMicros; // Per device
+    std::vector<GpuProcessShare> last;
+    std::chrono::steady_clock::time_point collectedAt;
+};
+
+#endif // GPU_PROCESS_ACCOUNTING_H
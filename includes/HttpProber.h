@@ -0,0 +1,58 @@
+#ifndef HTTP_PROBER_H
+#define HTTP_PROBER_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <curl/curl.h>
+#include "LatencyHistogram.h"
+
+// What one probe window measured across all of its endpoints
+struct HttpProbeResult {
+    LatencyHistogram latencyMicros;  // Every completed response, whatever its status
+    uint64_t requests = 0;           // Transfers attempted
+    uint64_t errors = 0;             // Transport failures and HTTP 5xx
+    uint64_t bytes = 0;              // Response bodies received
+    double seconds = 0.0;            // Wall-clock length of the window
+
+    double errorRate() const;
+    double requestsPerSecond() const;  // Completed responses
+    double bytesPerSecond() const;
+    double latencySeconds(double percentile) const;
+};
+
+// Load-probes HTTP endpoints through one shared curl multi handle. Requests run
+// concurrently up to a parallelism limit until a fixed budget is spent, and easy handles
+// and their connections are kept between windows, so a probe measures the application
+// rather than TCP/TLS setup. Probes from different threads are serialized.
+class HttpProber {
+public:
+    struct Options {
+        size_t parallel = 8;
+        size_t requestBudget = 100;
+        std::chrono::milliseconds timeout{10000}; // Per request
+    };
+
+    static HttpProber& instance();
+
+    ~HttpProber();
+    HttpProber(const HttpProber&) = delete;
+    HttpProber& operator=(const HttpProber&) = delete;
+
+    // Spreads the budget round-robin over endpoints. Throws std::runtime_error if curl
+    // itself fails; failed requests are only counted.
+    HttpProbeResult probe(const std::vector<std::string>& endpoints, const Options& options);
+    HttpProbeResult probe(const std::string& endpoint);
+
+private:
+    HttpProber();
+    CURL* acquire(const std::string& url, long timeoutMs);
+
+    std::mutex mutex;
+    CURLM* multi = nullptr;
+    std::vector<CURL*> idle; // Reused so each keeps its connection cache entry warm
+};
+
+#endif // HTTP_PROBER_H
@@ -0,0 +1,42 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Log-linear histogram in the style of HdrHistogram: values below 2^SUB_BUCKET_BITS are
+// counted exactly, larger ones in buckets no wider than 1/64 of their value, so any
+// percentile is within about 1.6% of the true sample across the full uint64_t range.
+// Recording is a shift and an increment; the memory cost is fixed at ~30KB.
+class LatencyHistogram {
+public:
+    static constexpr unsigned SUB_BUCKET_BITS = 7;
+
+    LatencyHistogram();
+
+    void record(uint64_t value, uint64_t times = 1);
+    void merge(const LatencyHistogram& other);
+    void reset();
+
+    uint64_t count() const { return total; }
+    uint64_t min() const { return total ? lowest : 0; }
+    uint64_t max() const { return highest; }
+    double mean() const;
+
+    // Smallest recorded value such that percentile% of samples are at or below it
+    // (reported as the middle of its bucket), or 0 when empty. percentile is in [0, 100].
+    uint64_t percentile(double percentile) const;
+
+private:
+    static size_t indexOf(uint64_t value);
+    static uint64_t midpointOf(size_t index);
+
+    std::vector<uint64_t> counts;
+    uint64_t total = 0;
+    uint64_t lowest = UINT64_MAX;
+    uint64_t highest = 0;
+    double sum = 0.0;
+};
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,47 @@
+#ifndef LOG_SCANNER_H
+#define LOG_SCANNER_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Counts, in one pass, the lines that match each of a set of patterns. A pattern is a
+// literal, or literals joined by '*' that must appear in that order on the same line
+// ("sudo:*authentication failure"). Candidate positions come from a SIMD compare of
+// every byte pair against the patterns' first two bytes (and every byte against '\n'),
+// so text that cannot start a match is skipped 16 or 32 bytes at a time.
+class LogScanner {
+public:
+    static constexpr size_t MAX_PREFIXES = 8;
+
+    // Returns the counter slot of the pattern. Throws std::invalid_argument when the
+    // leading literal is shorter than two bytes, the pattern contains '\n', or the
+    // patterns use more than MAX_PREFIXES distinct two-byte prefixes.
+    size_t addPattern(std::string_view pattern);
+    size_t patternCount() const { return patterns.size(); }
+
+    // Adds the number of matching lines per pattern to counts[0..patternCount()).
+    // A line counts at most once per pattern.
+    void scan(std::string_view text, uint64_t* counts) const;
+
+    // Maps the file and scans it whole. Throws std::runtime_error if it cannot be opened.
+    std::vector<uint64_t> scanFile(const std::string& path) const;
+
+private:
+    struct Pattern {
+        std::string head;               // Literal before the first '*'
+        std::vector<std::string> tail;  // Remaining literals, searched in order on the same line
+    };
+
+    bool matchesAt(const Pattern& pattern, const char* at, const char* end) const;
+
+    std::vector<Pattern> patterns;
+    std::vector<std::pair<char, char>> prefixes;
+    // Patterns indexed by first byte, so a candidate only checks the ones that can match
+    std::array<std::vector<size_t>, 256> patternsByFirstByte;
+};
+
+#endif // LOG_SCANNER_H
@@ -0,0 +1,79 @@
+#ifndef LOG_TAILER_H
+#define LOG_TAILER_H
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+
+// Running aggregates a tailer folds log lines into. Handlers decide what each slot
+// means (e.g. slot 0 for ScaleUp events, slot 1 for ScaleDown).
+struct LogCounters {
+    static constexpr size_t SLOTS = 4;
+    std::array<uint64_t, SLOTS> count{};
+    std::array<double, SLOTS> sum{};
+};
+
+// Calls f for every line of a block of complete lines, without the newline
+template<typename F>
+void forEachLine(std::string_view block, F f) {
+    while (!block.empty()) {
+        size_t newline = block.find('\n');
+        f(block.substr(0, newline));
+        if (newline == std::string_view::npos) {
+            break;
+        }
+        block.remove_prefix(newline + 1);
+    }
+}
+
+// Follows a log file from a persistent byte offset, so each poll() costs O(bytes
+// appended since the previous one) instead of a rescan. inotify tells it when there
+// is nothing new; rotation is detected by inode and truncation by size. When a
+// checkpoint path is given the offset and counters survive restarts.
+// Not thread-safe.
+class LogTailer {
+public:
+    // Receives a block of complete lines (each ending in '\n'); a partial last line is
+    // held back until the writer finishes it.
+    using BlockHandler = std::function<void(std::string_view lines, LogCounters& counters)>;
+
+    // Throws std::runtime_error if the file cannot be opened.
+    LogTailer(std::string path, BlockHandler handler, std::string checkpointPath = "");
+    ~LogTailer();
+
+    LogTailer(const LogTailer&) = delete;
+    LogTailer& operator=(const LogTailer&) = delete;
+
+    // Folds newly appended lines into the counters and returns them.
+    const LogCounters& poll();
+
+    const std::string& path() const { return filePath; }
+    uint64_t offset() const { return committedOffset; }
+
+private:
+    bool openFile();
+    void closeFile();
+    void drain();
+    bool drainEvents();
+    void loadCheckpoint();
+    void saveCheckpoint() const;
+
+    std::string filePath;
+    std::string checkpointPath;
+    BlockHandler handler;
+    LogCounters counters;
+
+    int fd = -1;
+    ino_t inode = 0;
+    uint64_t committedOffset = 0; // End of the last complete line handed to the handler
+    std::string pending;          // Bytes read past committedOffset, up to the last partial line
+
+    int inotifyFd = -1;
+    int watch = -1;
+    bool rotationPending = false; // The file was moved or deleted; keep checking for its successor
+};
+
+#endif // LOG_TAILER_H
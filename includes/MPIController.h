@@ -8,68 +8,207 @@
 #include <unistd.h>
 #include <arpa/inet.h>
 #include "SystemMetrics.h" // Ensure this is the correct path to your SystemMetrics header
+#include "MetricSchema.h"
+#include <array>
+#include <cstdint>
+#include <functional>
 #include <unordered_map>
 #include <seastar/core/future.hh>
 
-class SystemMetricsMPI {
+// One node's metrics in a collection round: every metric of the node in one fixed-size
+// frame, so a node answers with a single message. Shipped as one MPI derived datatype.
+struct NodeFrame {
+    static constexpr size_t NODE_BYTES = 64;
+    char node[NODE_BYTES] = {}; // NUL-terminated IP address of the node
+    MetricFrame frame;
+};
+
+// Where a rank runs, as gathered into the rank directory
+struct RankAddress {
+    std::string ip;
+    std::string hostname;
+};
+
+// A reading one rank takes for another in a targeted query
+enum class NodeQuery : int32_t {
+    GPU_TEMPERATURE,
+    GPU_USAGE,
+    GPU_MEMORY_USAGE,
+    GPU_POWER_USAGE,
+    GPU_FAN_SPEED,
+    GPU_CORE_CLOCK,
+    GPU_MEMORY_CLOCK,
+    AVAILABLE_MEMORY,
+    CPU_TEMPERATURE,
+    SWAP_USAGE,
+    MEMORY_PAGE_FAULTS,
+    DISK_LATENCY,
+    DISK_SPACE_UTILIZATION,
+    NETWORK_BANDWIDTH_UTILIZATION,
+    NETWORK_LATENCY,
+    NETWORK_ERRORS,
+    PACKET_LOSS,
+    ACTIVE_CONNECTIONS,
+    APPLICATION_RESPONSE_TIME,
+    APPLICATION_ERROR_RATE,
+    REQUEST_RATE,
+    THROUGHPUT,
+    QUERY_PERFORMANCE,
+    CONNECTION_POOL_UTILIZATION,
+    CACHE_HIT_MISS_RATE,
+    TRANSACTION_RATE,
+    FAILED_LOGIN_ATTEMPTS,
+    INTRUSION_DETECTION_ALERTS,
+    FIREWALL_LOG_ENTRIES,
+    VULNERABILITY_SCANS,
+    INSTANCE_TYPE_UTILIZATION,
+    AUTO_SCALING_METRICS,
+    RESOURCE_RESERVATIONS,
+    POWER_USAGE,
+    ENERGY_EFFICIENCY,
+    SHOULD_SCALE,
+    WORKLOAD_CPU,         // Argument 0 is the process name
+    WORKLOAD_MEMORY,
+    WORKLOAD_IO_PRESSURE,
+    WORKLOAD_PERF_COUNTERS, // Counts in PerfSample field order, then 1 when they include hardware events
+    WORKLOAD_GPU_USAGE,     // GpuWorkloadUsage fields in order
+    STALL_REPORT,           // A PSI trigger fired on the node in argument 0; answered at once
+    GPU_FRAME,  // Answered with a NodeFrame holding the GPU part of the schema
+    NODE_FRAME, // Answered with a NodeFrame of everything the node reports
+};
+
+// What a targeted query returns; scalar queries use the first value only
+using NodeQueryValues = std::array<double, 8>;
+
+class MPIController {
 public: 
-	// Function declaration for distributing and gathering memory usage
-	void distributeAndGatherMemoryUsage(const std::vector<pid_t>& pids, int target_rank);
+	// Every MPI call of this process is made on this shard, one at a time, so MPI only has to
+	// provide MPI_THREAD_SERIALIZED. Callers on other shards are forwarded with submit_to.
+	static constexpr unsigned int MPI_SHARD = 0;
+
+	// Starts MPI with MPI_Init_thread, or checks the level it was started with. Throws
+	// std::runtime_error when MPI cannot serialize calls from different threads.
+	static void initialize();
+	// This rank in MPI_COMM_WORLD, as of initialize()
+	static int localRank();
+
+	// Rank <-> node directory, gathered with one MPI_Iallgather along with a communicator of
+	// its own for targeted queries. Collective: the Director builds it at startup so every
+	// rank does so in step. The accessors throw until it is built.
+	static seastar::future<> buildDirectory();
+	static const std::vector<RankAddress>& rankAddresses();
+	// Lowest rank on the node with this IP address or hostname; -1 when no rank runs there
+	static int rankOf(const std::string& node);
+	static const std::string& localIp();
+
+	// Answers other ranks' targeted queries on MPI_SHARD until stopServing(). Resolves once
+	// serving has started; every rank runs it once.
+	static seastar::future<> serveQueries();
+	// Stops taking queries and resolves once the answers already taken have been sent
+	static seastar::future<> stopServing();
+
+	// Called with the reporting node's IP when another node reports a stall. Set and called
+	// on MPI_SHARD; an empty handler drops the reports.
+	using StallHandler = std::function<void(const std::string& node)>;
+	static void onStallReport(StallHandler handler);
+	// Tells the Director on leaderRank that a PSI trigger fired on this node; resolves once
+	// it has been told
+	static seastar::future<> reportStall(int leaderRank);
+
+	// One collection round: the lowest rank of every host is asked at once for a NodeFrame
+	// of everything its node reports (GPUs, CPU temperature, memory, page faults, network,
+	// disks, its PostgreSQL database). Point to point, so only the caller takes part; a host whose read fails is
+	// left out of the round. Frames come in rank order.
+	static seastar::future<std::vector<NodeFrame>> collectNodeFrames();
+
+	// Per-workload cgroup metrics for processName summed over all hosts, so the result does
+	// not depend on which host the process landed on. Each host's lowest rank is asked once,
+	// so a host running several ranks is counted once. Point to point: only the caller takes
+	// part. CPU reads 0 on a host's first ask, which only takes the baseline sample.
+	static seastar::future<double> getCpuUsageMPI(const std::string& processName);
+	static seastar::future<double> getMemoryUsageMPI(const std::string& processName);
+	static seastar::future<double> getIoUsageMPI(const std::string& processName);
+	// Perf counts for processName summed over hosts, asked the same way; zero counts from a
+	// host on its first ask, which only opens the counters
+	static seastar::future<PerfSample> getPerfCountersMPI(const std::string& processName);
+	// Processes and memory summed over hosts, asked the same way; utilizations are those of
+	// the busiest GPU on any host
+	static seastar::future<GpuWorkloadUsage> getGpuUsageMPI(const std::string& processName);
 
 	// MPI wrapper GPU function declarations 
-	float mpiGetGpuTemperature(const std::string& target_ip, unsigned int gpuIndex);
-	float mpiGetGpuUsage(const std::string& target_ip, unsigned int gpuIndex);
-	float mpiGetGpuMemoryUsage(const std::string& target_ip, unsigned int gpuIndex);
-	float mpiGetGpuPowerUsage(const std::string& target_ip, unsigned int gpuIndex);
-	float mpiGetGpuFanSpeed(const std::string& target_ip, unsigned int gpuIndex);
-	float mpiGetGpuCoreClock(const std::string& target_ip, unsigned int gpuIndex);
-	float mpiGetGpuMemoryClock(const std::string& target_ip, unsigned int gpuIndex);
-	static seastar::future<std::unordered_map<std::string, float>> gpuMetrics(const std::string& target_ip, unsigned int gpuIndex);
-
-	static double getAvailableMemoryMPI(const std::string& ipAddress, const std::string& processName);
-	static double getCpuTemperatureMPI(const std::string& ipAddress, const std::string& processName);
-    static double getSwapUsageMPI(const std::string& ipAddress, const std::string& processName);
-    static double getMemoryPageFaultsMPI(const std::string& ipAddress, const std::string& processName);
-    static double getDiskLatencyMPI(const std::string& ipAddress, const std::string& processName, const std::string& disk);
-    static double getDiskSpaceUtilizationMPI(const std::string& ipAddress, const std::string& processName, const std::string& path);
-    static double getNetworkBandwidthUtilizationMPI(const std::string& ipAddress, const std::string& processName, const std::string& interface);
+	seastar::future<float> mpiGetGpuTemperature(const std::string& target_ip, unsigned int gpuIndex);
+	seastar::future<float> mpiGetGpuUsage(const std::string& target_ip, unsigned int gpuIndex);
+	seastar::future<float> mpiGetGpuMemoryUsage(const std::string& target_ip, unsigned int gpuIndex);
+	seastar::future<float> mpiGetGpuPowerUsage(const std::string& target_ip, unsigned int gpuIndex);
+	seastar::future<float> mpiGetGpuFanSpeed(const std::string& target_ip, unsigned int gpuIndex);
+	seastar::future<float> mpiGetGpuCoreClock(const std::string& target_ip, unsigned int gpuIndex);
+	seastar::future<float> mpiGetGpuMemoryClock(const std::string& target_ip, unsigned int gpuIndex);
+	// Every GPU of the node at target_ip from one sweep: the GPU_* node aggregates and
+	// per-GPU gauges of the metric schema. GPU_USAGE_P* and GPU_POWER_P90 cover every
+	// reading the drivers buffered since the previous call. One query to that node's rank;
+	// empty when no rank runs there.
+	static seastar::future<MetricFrame> gpuMetrics(const std::string& target_ip);
+	// PostgreSQL probes for db from one pipelined round trip, without blocking the calling shard
+	static seastar::future<MetricFrame> postgresMetrics(const std::string& db);
+	// The node's own PostgreSQL database; when set, its postgresMetrics are part of the
+	// node's NodeFrame in every collection round
+	static constexpr const char* POSTGRES_URI_ENV = "DIRECTOR_POSTGRES_URI";
+
+	static seastar::future<double> getAvailableMemoryMPI(const std::string& ipAddress, const std::string& processName);
+	static seastar::future<double> getCpuTemperatureMPI(const std::string& ipAddress, const std::string& processName);
+    static seastar::future<double> getSwapUsageMPI(const std::string& ipAddress, const std::string& processName);
+    static seastar::future<double> getMemoryPageFaultsMPI(const std::string& ipAddress, const std::string& processName);
+    static seastar::future<double> getDiskLatencyMPI(const std::string& ipAddress, const std::string& processName, const std::string& disk);
+    static seastar::future<double> getDiskSpaceUtilizationMPI(const std::string& ipAddress, const std::string& processName, const std::string& path);
+    // An empty interface reads the node's primary one (SystemMetrics::getPrimaryInterface)
+    static seastar::future<double> getNetworkBandwidthUtilizationMPI(const std::string& ipAddress, const std::string& processName, const std::string& interface);
 
     // New MPI wrapper functions
-    static double getNetworkLatencyMPI(const std::string& ipAddress, const std::string& processName, const std::string& interface);
-    static double getNetworkErrorsMPI(const std::string& ipAddress, const std::string& processName, const std::string& interface);
-    static double getPacketLossMPI(const std::string& ipAddress, const std::string& processName, const std::string& interface);
-    static int getActiveConnectionsMPI(const std::string& ipAddress, const std::string& processName, const std::string& interface);
-    static double getApplicationResponseTimeMPI(const std::string& ipAddress, const std::string& processName, const std::string& app);
-    static double getApplicationErrorRateMPI(const std::string& ipAddress, const std::string& processName, const std::string& app);
-    static double getRequestRateMPI(const std::string& ipAddress, const std::string& processName, const std::string& app);
-    static double getThroughputMPI(const std::string& ipAddress, const std::string& processName, const std::string& app);
-    static double getQueryPerformanceMPI(const std::string& ipAddress, const std::string& processName, const std::string& db);
-    static double getConnectionPoolUtilizationMPI(const std::string& ipAddress, const std::string& processName, const std::string& db);
-    static double getCacheHitMissRateMPI(const std::string& ipAddress, const std::string& processName, const std::string& db);
-    static double getTransactionRateMPI(const std::string& ipAddress, const std::string& processName, const std::string& db);
-    static int getFailedLoginAttemptsMPI(const std::string& ipAddress, const std::string& processName);
-    static int getIntrusionDetectionAlertsMPI(const std::string& ipAddress, const std::string& processName);
-    static int getFirewallLogEntriesMPI(const std::string& ipAddress, const std::string& processName);
-    static int getVulnerabilityScansMPI(const std::string& ipAddress, const std::string& processName);
-    static double getInstanceTypeUtilizationMPI(const std::string& ipAddress, const std::string& processName);
-    static double getInstanceTypeUtilizationMPI(const std::string& ipAddress, const std::string& processName);
-    static double getAutoScalingMetricsMPI(const std::string& ipAddress, const std::string& processName);
-    static double getResourceReservationsMPI(const std::string& ipAddress, const std::string& processName);
-    static double getPowerUsageMPI(const std::string& ipAddress, const std::string& processName);
-    static double getEnergyEfficiencyMPI(const std::string& ipAddress, const std::string& processName);
-
-    static bool shouldScaleMPI(const std::string& ipAddress, const std::string& instance, const std::string& app, const std::string& disk, const std::string& interface);
+    static seastar::future<double> getNetworkLatencyMPI(const std::string& ipAddress, const std::string& processName, const std::string& interface);
+    static seastar::future<double> getNetworkErrorsMPI(const std::string& ipAddress, const std::string& processName, const std::string& interface);
+    static seastar::future<double> getPacketLossMPI(const std::string& ipAddress, const std::string& processName, const std::string& interface);
+    static seastar::future<int> getActiveConnectionsMPI(const std::string& ipAddress, const std::string& processName, const std::string& interface);
+    static seastar::future<double> getApplicationResponseTimeMPI(const std::string& ipAddress, const std::string& processName, const std::string& app);
+    static seastar::future<double> getApplicationErrorRateMPI(const std::string& ipAddress, const std::string& processName, const std::string& app);
+    static seastar::future<double> getRequestRateMPI(const std::string& ipAddress, const std::string& processName, const std::string& app);
+    static seastar::future<double> getThroughputMPI(const std::string& ipAddress, const std::string& processName, const std::string& app);
+    static seastar::future<double> getQueryPerformanceMPI(const std::string& ipAddress, const std::string& processName, const std::string& db);
+    static seastar::future<double> getConnectionPoolUtilizationMPI(const std::string& ipAddress, const std::string& processName, const std::string& db);
+    static seastar::future<double> getCacheHitMissRateMPI(const std::string& ipAddress, const std::string& processName, const std::string& db);
+    static seastar::future<double> getTransactionRateMPI(const std::string& ipAddress, const std::string& processName, const std::string& db);
+    static seastar::future<int> getFailedLoginAttemptsMPI(const std::string& ipAddress, const std::string& processName);
+    static seastar::future<int> getIntrusionDetectionAlertsMPI(const std::string& ipAddress, const std::string& processName);
+    static seastar::future<int> getFirewallLogEntriesMPI(const std::string& ipAddress, const std::string& processName);
+    static seastar::future<int> getVulnerabilityScansMPI(const std::string& ipAddress, const std::string& processName);
+    static seastar::future<double> getInstanceTypeUtilizationMPI(const std::string& ipAddress, const std::string& processName);
+    static seastar::future<double> getAutoScalingMetricsMPI(const std::string& ipAddress, const std::string& processName);
+    static seastar::future<double> getResourceReservationsMPI(const std::string& ipAddress, const std::string& processName);
+    static seastar::future<double> getPowerUsageMPI(const std::string& ipAddress, const std::string& processName);
+    static seastar::future<double> getEnergyEfficiencyMPI(const std::string& ipAddress, const std::string& processName);
+
+    static seastar::future<bool> shouldScaleMPI(const std::string& ipAddress, const std::string& instance, const std::string& app, const std::string& disk, const std::string& interface);
 
     static double readStatFile();
     static double readProcFile(const std::string& path);
     static std::map<std::string, double> readNetDevFile();
 
 	//MPI wrapper to get ram
-	double mpiGetAvailableMemory();
+	static seastar::future<double> mpiGetAvailableMemory(const std::string& target_ip);
 private:
-    static float mpiWrapperFunction(const std::string& target_ip, std::function<float(unsigned int)> func, unsigned int gpuIndex);
-    static double mpiWrapperFunction(const std::string& target_ip, std::function<double()> func); // New wrapper for double functions
+
+    // Reads query on rank: a request and a response between this rank and that one on the
+    // query communicator, with no other rank involved, or a local read when rank is this
+    // one. Fails with std::runtime_error when the read fails on the target.
+    static seastar::future<NodeQueryValues> queryRank(int rank, NodeQuery query, unsigned int gpuIndex = 0,
+                                                      std::vector<std::string> arguments = {});
+    // queryRank for the queries answered with a whole NodeFrame
+    static seastar::future<NodeFrame> queryFrame(int rank, NodeQuery query);
+    // queryRank on the node at target_ip; 0 when no rank runs there
+    static seastar::future<double> queryNode(const std::string& target_ip, NodeQuery query, unsigned int gpuIndex = 0,
+                                             std::vector<std::string> arguments = {});
+    // query for processName read on every host at once and summed; hosts that fail add 0
+    static seastar::future<double> sumOverHosts(NodeQuery query, const std::string& processName);
 
 };
 
-#endif // SYSTEM_METRICS_MPI_H
\ No newline at end of file
+#endif // MPICONTROLLER_H
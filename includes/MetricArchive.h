@@ -0,0 +1,213 @@
+#ifndef METRIC_ARCHIVE_H
+#define METRIC_ARCHIVE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "MetricSchema.h"
+#include "TimeSeriesStore.h"
+
+// On-disk layout of the metric archive. A directory holds one append-only file per UTC
+// day, named YYYYMMDD.metrics. A file is a FileHeader and its metric table padded to
+// ALIGNMENT, followed by segments, each also padded to ALIGNMENT. The metric table lists
+// the writer's schema in slot order (per metric: uint16 slots, uint16 name length, then
+// the name), so a reader built with another schema can still find a metric's slots. A
+// segment is one flush's rows for that day, sorted by timestamp and stored by column:
+//
+//   SegmentHeader | ColumnHeader[columns] | node names | timestamps (uint64 µs) |
+//   node indices (uint32) | per column: values (float) [+ presence bitmap] | padding
+//
+// Only slots present in some row get a column. The header min/max bounds let a query
+// skip a segment by time or node, and a column by value, without touching its data.
+// Offsets are relative to the start of the segment; all fields are little-endian. A file
+// the writer cannot append to (another schema or format) is renamed to
+// YYYYMMDD.metrics.<mtime>.old and stays readable.
+namespace metric_archive {
+    inline constexpr size_t ALIGNMENT = 4096;
+    inline constexpr uint64_t PARTITION_MICROS = 86400ull * 1000000;
+    inline constexpr char FILE_MAGIC[8] = {'D', 'I', 'R', 'A', 'R', 'C', 'H', '1'};
+    inline constexpr uint32_t SEGMENT_MAGIC = 0x4d474553; // "SEGM"
+    inline constexpr uint32_t FORMAT_VERSION = 2;
+
+    struct FileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t schemaVersion;
+        uint64_t partitionStartMicros;
+        uint32_t metrics;           // Entries in the metric table that follows
+        uint32_t metricTableBytes;
+    };
+
+    // magic is written last, in a second write of the segment's first page, so a reader
+    // or a restarted writer never takes a half-written segment for a whole one
+    struct SegmentHeader {
+        uint32_t magic;
+        uint32_t rows;
+        uint32_t columns;
+        uint32_t nodes;
+        uint64_t length;            // Including padding; the next segment starts here
+        uint64_t minTimestampMicros;
+        uint64_t maxTimestampMicros;
+        uint64_t nodeTableOffset;   // Per node: uint16 length, then the name
+        uint64_t timestampOffset;
+        uint64_t nodeColumnOffset;
+    };
+
+    struct ColumnHeader {
+        static constexpr uint16_t SPARSE = 1; // A presence bitmap follows the values
+
+        uint16_t slot;
+        uint16_t flags;
+        uint32_t present;           // Rows with a value
+        float min;                  // Over present rows
+        float max;
+        uint64_t offset;
+    };
+
+    static_assert(sizeof(FileHeader) == 32, "Archive headers are written as raw bytes");
+    static_assert(sizeof(SegmentHeader) == 64, "Archive headers are written as raw bytes");
+    static_assert(sizeof(ColumnHeader) == 24, "Archive headers are written as raw bytes");
+
+    // YYYYMMDD.metrics for the day starting at partitionStartMicros
+    std::string partitionFileName(uint64_t partitionStartMicros);
+}
+
+// Appends node frames to the archive. append() only copies the frame into a pending
+// batch; a flusher thread turns the batch into segments and writes each with one large
+// aligned write (O_DIRECT where the filesystem allows it), so the caller never waits on
+// the disk. If the flusher falls behind by maxPendingRows, new rows are dropped and
+// counted rather than queued without bound.
+class MetricArchiveWriter {
+public:
+    static constexpr const char* DIRECTORY_ENV = "DIRECTOR_ARCHIVE_DIR";
+    static constexpr const char* DEFAULT_DIRECTORY = "/var/lib/director/archive";
+    static constexpr size_t SEGMENT_ROWS = 65536;
+
+    // Creates the directory if needed; throws std::runtime_error if it cannot.
+    explicit MetricArchiveWriter(std::string directory,
+                                 std::chrono::milliseconds flushInterval = std::chrono::milliseconds(10000),
+                                 size_t maxPendingRows = 1 << 18);
+    ~MetricArchiveWriter();
+
+    MetricArchiveWriter(const MetricArchiveWriter&) = delete;
+    MetricArchiveWriter& operator=(const MetricArchiveWriter&) = delete;
+
+    // Creates and starts the process-wide writer for DIRECTOR_ARCHIVE_DIR, or
+    // DEFAULT_DIRECTORY when it is unset. Called once at startup; throws
+    // std::runtime_error if the directory cannot be created, and archiving stays off.
+    static void openShared();
+    // Appends to the process-wide writer; does nothing unless openShared() succeeded
+    static void appendShared(const std::string& node, const MetricFrame& frame);
+
+    void start();
+    // Stops the flusher and writes what is still pending
+    void stop();
+
+    void append(const std::string& node, const MetricFrame& frame);
+    // Writes everything pending on the caller's thread
+    void flush();
+
+    uint64_t rowsWritten() const;
+    uint64_t rowsDropped() const;
+    uint64_t bytesWritten() const;
+
+private:
+    struct Row {
+        std::string node;
+        MetricFrame frame;
+    };
+
+    struct Partition {
+        int fd = -1;
+        uint64_t end = 0; // Where the next segment goes
+        bool direct = false;
+    };
+
+    void run();
+    Partition& partition(uint64_t startMicros);
+    void writeSegment(uint64_t partitionStartMicros, const Row* rows, size_t count);
+    void writeAt(Partition& file, const uint8_t* data, size_t length, uint64_t offset);
+
+    std::string directory;
+    std::chrono::milliseconds flushInterval;
+    size_t maxPendingRows;
+
+    mutable std::mutex mutex;
+    std::condition_variable wakeup;
+    std::vector<Row> pending;
+    std::thread worker;
+    bool running = false;
+    uint64_t dropped = 0;
+
+    // Held for a whole flush, so the flusher and a direct flush() do not interleave
+    mutable std::mutex writeMutex;
+    std::map<uint64_t, Partition> partitions;
+    std::unique_ptr<uint8_t, void (*)(void*)> buffer;
+    size_t bufferCapacity = 0;
+    uint64_t written = 0;
+    uint64_t writtenBytes = 0;
+};
+
+// One column of one segment, as a query sees it: pointers straight into the mapping
+struct ArchiveChunk {
+    const std::vector<std::string_view>* nodeNames; // Indexed by nodes[row]
+    const uint64_t* timestamps;
+    const uint32_t* nodes;
+    const float* values;
+    const uint64_t* present;  // nullptr when every row has a value
+    size_t begin;             // Rows inside the query's time range
+    size_t end;
+    int64_t node;             // The node index the query asked for, -1 for any
+};
+
+struct ArchiveScanStats {
+    uint64_t files = 0;
+    uint64_t filesSkipped = 0;    // Written with a schema that lacks the queried slot
+    uint64_t segments = 0;        // Segments in the files that were opened
+    uint64_t segmentsSkipped = 0; // By time, node or a missing column
+    uint64_t chunksSkipped = 0;   // By the column's min/max
+    uint64_t chunksRead = 0;
+    uint64_t rowsScanned = 0;
+};
+
+// Reads the archive by mapping its files. Files outside the query's days are not
+// opened, and segments and columns the headers rule out are not touched.
+class MetricArchiveReader {
+public:
+    struct Query {
+        MetricId id = MetricId::CPU_USAGE;
+        unsigned int gpu = 0;
+        uint64_t fromMicros = 0;
+        uint64_t toMicros = std::numeric_limits<uint64_t>::max();
+        std::string node;                                          // Empty for every node
+        float minValue = -std::numeric_limits<float>::infinity(); // Values outside are skipped
+        float maxValue = std::numeric_limits<float>::infinity();
+    };
+
+    explicit MetricArchiveReader(std::string directory);
+
+    // Calls f for every column chunk that may hold matching rows, oldest day first.
+    // Files written with another metric schema are read through their metric table; one
+    // that has no such metric or GPU, or predates the table, is skipped and counted.
+    ArchiveScanStats scan(const Query& query, const std::function<void(const ArchiveChunk&)>& f) const;
+
+    TimeSeriesSummary summarize(const Query& query, ArchiveScanStats* stats = nullptr) const;
+    // Calls f(node, timestampMicros, value) for every matching row
+    ArchiveScanStats forEach(const Query& query,
+                             const std::function<void(std::string_view, uint64_t, float)>& f) const;
+
+private:
+    std::string directory;
+};
+
+#endif // METRIC_ARCHIVE_H
@@ -0,0 +1,84 @@
+#ifndef METRIC_QUERY_H
+#define METRIC_QUERY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+#include "MetricSchema.h"
+#include "TimeSeriesStore.h"
+
+enum class QueryAggregate { COUNT, SUM, MEAN, MIN, MAX, LAST, P50, P90, P95, P99 };
+
+// Keeps samples on one side of a threshold
+struct QueryPredicate {
+    enum Comparison : uint8_t { ABOVE, BELOW };
+    Comparison comparison = ABOVE;
+    float threshold = 0.0f;
+};
+
+// One group of a group-by-node query
+struct NodeAggregate {
+    std::string node;
+    double value = 0.0;
+    uint64_t samples = 0;       // That passed the filter
+    uint64_t firstMicros = 0;   // Of the node's samples in the window, filtered or not
+    uint64_t lastMicros = 0;
+};
+
+struct NodeWindows {
+    std::string node;
+    std::vector<uint64_t> bucketStartMicros; // Buckets without samples are left out
+    std::vector<double> values;
+};
+
+// Ad-hoc aggregates over the history in a TimeSeriesStore, e.g. "p95 GPU usage per node
+// over the last hour" or "nodes where CPU usage stayed above 80 for 5 minutes". Each
+// node's series is decoded into a ColumnBatch and the operators (filter, window
+// aggregate, group by node) run over its columns with SIMD kernels picked for the CPU
+// at startup, as LogScanner does. Percentiles are exact (nearest rank). Unfiltered
+// COUNT, SUM, MEAN, MIN, MAX and LAST go through TimeSeriesStore::aggregate() instead,
+// which takes the blocks the window covers whole from their summaries.
+// Not thread-safe; queries read the store without holding up its appends.
+class MetricQuery {
+public:
+    struct Selection {
+        MetricId id = MetricId::CPU_USAGE;
+        unsigned int gpu = 0;
+        uint64_t fromMicros = 0;
+        uint64_t toMicros = std::numeric_limits<uint64_t>::max();
+        std::vector<std::string> nodes; // Empty for every node in the store
+    };
+
+    explicit MetricQuery(const TimeSeriesStore& store = TimeSeriesStore::forShard());
+
+    // Selection covering the last `seconds` up to now
+    static Selection lastSeconds(MetricId id, unsigned int gpu, uint64_t seconds);
+
+    // One row per node with samples in the window; with a filter, only the samples
+    // that pass it are aggregated and a node none pass is left out
+    std::vector<NodeAggregate> aggregate(const Selection& selection, QueryAggregate aggregate,
+                                         const QueryPredicate* filter = nullptr);
+
+    // Per node, aggregate over consecutive buckets of bucketMicros starting at fromMicros
+    std::vector<NodeWindows> windowAggregate(const Selection& selection, QueryAggregate aggregate,
+                                             uint64_t bucketMicros);
+
+    // Nodes where predicate held for every sample of some span lasting at least
+    // durationMicros; value is the longest such span in seconds
+    std::vector<NodeAggregate> sustained(const Selection& selection, const QueryPredicate& predicate,
+                                         uint64_t durationMicros);
+
+private:
+    const std::vector<std::string>& nodesOf(const Selection& selection);
+    double reduce(const float* values, size_t count, QueryAggregate aggregate);
+
+    const TimeSeriesStore& store;
+    ColumnBatch batch;             // Reused for every node
+    std::vector<float> scratch;    // Filtered values and percentile selection
+    std::vector<uint64_t> mask;    // Filter results, one bit per sample
+    std::vector<std::string> allNodes;
+};
+
+#endif // METRIC_QUERY_H
@@ -0,0 +1,319 @@
+#ifndef METRIC_SCHEMA_H
+#define METRIC_SCHEMA_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Every metric the director moves between collectors, ranks and scaling rules, known at
+// compile time. A metric is an index into a MetricFrame rather than a string key, so a
+// tick costs no hashing, allocation or key copies; names, units and rules live once, in
+// METRIC_SCHEMA, and printing, serialization and threshold checks are driven from it.
+//
+// Adding a metric: append an id before COUNT and a row at the same position in
+// METRIC_SCHEMA. Appending keeps the layout of existing slots, but peers and archives
+// written with another schema are still told apart by METRIC_SCHEMA_VERSION.
+enum class MetricId : uint16_t {
+    // Node
+    CPU_USAGE,
+    TOTAL_MEMORY,
+    FREE_MEMORY,
+    USED_MEMORY,
+    HDD_USAGE,
+    TRAFFIC_IN,
+    TRAFFIC_OUT,
+
+    // GPUs of the node, aggregated
+    GPU_COUNT,
+    GPU_MAX_TEMPERATURE,
+    GPU_MEAN_USAGE,
+    GPU_MIN_USAGE,
+    GPU_MEMORY_PRESSURE,
+    GPU_USAGE_P50,
+    GPU_USAGE_P90,
+    GPU_USAGE_P99,
+    GPU_POWER_P90,
+
+    // One slot per GPU
+    GPU_TEMPERATURE,
+    GPU_USAGE,
+    GPU_MEMORY_USAGE,
+    GPU_POWER_USAGE,
+    GPU_FAN_SPEED,
+    GPU_CORE_CLOCK,
+    GPU_MEMORY_CLOCK,
+
+    // PostgreSQL probe
+    POSTGRES_TRANSACTION_RATE,
+    POSTGRES_QUERY_LATENCY,
+    POSTGRES_CACHE_HIT_RATIO,
+    POSTGRES_POOL_UTILIZATION,
+    POSTGRES_BUFFERS_CHECKPOINT,
+    POSTGRES_BUFFERS_CLEAN,
+    POSTGRES_BUFFERS_BACKEND,
+    POSTGRES_CONNECT_LATENCY,
+
+    // Node, read by the rank on the node in a collection round
+    CPU_TEMPERATURE,
+    MEMORY_PAGE_FAULTS,
+    NETWORK_BANDWIDTH,
+    DISK_LATENCY,
+
+    // Auth log of the node, running totals
+    AUTH_FAILED_PASSWORDS,
+    AUTH_INVALID_USERS,
+    AUTH_SUDO_FAILURES,
+
+    // One slot per GPU, over the readings its driver buffered in the tick
+    GPU_DEVICE_USAGE_P90,
+    GPU_DEVICE_POWER_P90,
+
+    COUNT
+};
+
+enum class MetricType : uint8_t {
+    GAUGE,   // A level; only the latest value means anything
+    COUNTER, // Monotonic total; rates come from differences
+};
+
+enum class MetricUnit : uint8_t {
+    NONE,
+    PERCENT,
+    RATIO,
+    BYTES,
+    CELSIUS,
+    WATTS,
+    MEGAHERTZ,
+    SECONDS,
+    PER_SECOND,
+    MEGABITS_PER_SECOND,
+    KILOBYTES_PER_SECOND,
+};
+
+// How values of the same metric from several sources (ranks, nodes, devices) combine
+enum class MetricAggregation : uint8_t { SUM, MAX, MIN, MEAN, LAST };
+
+// Scaling rule attached to a metric: breached when the value is on the wrong side of limit
+struct MetricThreshold {
+    enum Direction : uint8_t { NONE, ABOVE, BELOW };
+    Direction direction = NONE;
+    float limit = 0.0f;
+};
+
+struct MetricTraits {
+    MetricId id;
+    const char* name;
+    MetricType type;
+    MetricUnit unit;
+    MetricAggregation aggregation;
+    bool perGpu;               // One slot per GPU instead of one per frame
+    MetricThreshold threshold;
+};
+
+// GPUs a frame has room for; per-GPU metrics of higher indices are dropped
+inline constexpr size_t MAX_GPUS = 16;
+
+namespace metric_schema_detail {
+    constexpr MetricThreshold none() { return MetricThreshold{}; }
+    constexpr MetricThreshold above(float limit) { return MetricThreshold{MetricThreshold::ABOVE, limit}; }
+}
+
+inline constexpr MetricTraits METRIC_SCHEMA[] = {
+    {MetricId::CPU_USAGE, "CpuUsage", MetricType::GAUGE, MetricUnit::PERCENT, MetricAggregation::MEAN, false, metric_schema_detail::none()},
+    {MetricId::TOTAL_MEMORY, "TotalMemory", MetricType::GAUGE, MetricUnit::BYTES, MetricAggregation::SUM, false, metric_schema_detail::none()},
+    {MetricId::FREE_MEMORY, "FreeMemory", MetricType::GAUGE, MetricUnit::BYTES, MetricAggregation::SUM, false, metric_schema_detail::none()},
+    {MetricId::USED_MEMORY, "UsedMemory", MetricType::GAUGE, MetricUnit::BYTES, MetricAggregation::SUM, false, metric_schema_detail::none()},
+    {MetricId::HDD_USAGE, "HddUsage", MetricType::GAUGE, MetricUnit::PERCENT, MetricAggregation::MAX, false, metric_schema_detail::none()},
+    {MetricId::TRAFFIC_IN, "TrafficIn", MetricType::GAUGE, MetricUnit::MEGABITS_PER_SECOND, MetricAggregation::SUM, false, metric_schema_detail::none()},
+    {MetricId::TRAFFIC_OUT, "TrafficOut", MetricType::GAUGE, MetricUnit::MEGABITS_PER_SECOND, MetricAggregation::SUM, false, metric_schema_detail::none()},
+
+    {MetricId::GPU_COUNT, "GpuCount", MetricType::GAUGE, MetricUnit::NONE, MetricAggregation::SUM, false, metric_schema_detail::none()},
+    {MetricId::GPU_MAX_TEMPERATURE, "GpuMaxTemperature", MetricType::GAUGE, MetricUnit::CELSIUS, MetricAggregation::MAX, false, metric_schema_detail::above(85.0f)},
+    {MetricId::GPU_MEAN_USAGE, "GpuMeanUsage", MetricType::GAUGE, MetricUnit::PERCENT, MetricAggregation::MEAN, false, metric_schema_detail::none()},
+    {MetricId::GPU_MIN_USAGE, "GpuMinUsage", MetricType::GAUGE, MetricUnit::PERCENT, MetricAggregation::MIN, false, metric_schema_detail::none()},
+    {MetricId::GPU_MEMORY_PRESSURE, "GpuMemoryPressure", MetricType::GAUGE, MetricUnit::PERCENT, MetricAggregation::MAX, false, metric_schema_detail::above(80.0f)},
+    // The median over the driver's buffered samples is not fooled by a burst or a lull
+    // that happens to coincide with the tick, so it carries the utilization rule
+    {MetricId::GPU_USAGE_P50, "GpuUsageP50", MetricType::GAUGE, MetricUnit::PERCENT, MetricAggregation::MAX, false, metric_schema_detail::above(80.0f)},
+    {MetricId::GPU_USAGE_P90, "GpuUsageP90", MetricType::GAUGE, MetricUnit::PERCENT, MetricAggregation::MAX, false, metric_schema_detail::none()},
+    {MetricId::GPU_USAGE_P99, "GpuUsageP99", MetricType::GAUGE, MetricUnit::PERCENT, MetricAggregation::MAX, false, metric_schema_detail::none()},
+    {MetricId::GPU_POWER_P90, "GpuPowerP90", MetricType::GAUGE, MetricUnit::WATTS, MetricAggregation::MAX, false, metric_schema_detail::none()},
+
+    {MetricId::GPU_TEMPERATURE, "GpuTemperature", MetricType::GAUGE, MetricUnit::CELSIUS, MetricAggregation::MAX, true, metric_schema_detail::none()},
+    {MetricId::GPU_USAGE, "GpuUsage", MetricType::GAUGE, MetricUnit::PERCENT, MetricAggregation::MEAN, true, metric_schema_detail::none()},
+    {MetricId::GPU_MEMORY_USAGE, "GpuMemoryUsage", MetricType::GAUGE, MetricUnit::PERCENT, MetricAggregation::MAX, true, metric_schema_detail::none()},
+    {MetricId::GPU_POWER_USAGE, "GpuPowerUsage", MetricType::GAUGE, MetricUnit::WATTS, MetricAggregation::SUM, true, metric_schema_detail::none()},
+    {MetricId::GPU_FAN_SPEED, "GpuFanSpeed", MetricType::GAUGE, MetricUnit::PERCENT, MetricAggregation::MAX, true, metric_schema_detail::none()},
+    {MetricId::GPU_CORE_CLOCK, "GpuCoreClock", MetricType::GAUGE, MetricUnit::MEGAHERTZ, MetricAggregation::MEAN, true, metric_schema_detail::none()},
+    {MetricId::GPU_MEMORY_CLOCK, "GpuMemoryClock", MetricType::GAUGE, MetricUnit::MEGAHERTZ, MetricAggregation::MEAN, true, metric_schema_detail::none()},
+
+    {MetricId::POSTGRES_TRANSACTION_RATE, "PostgresTransactionRate", MetricType::GAUGE, MetricUnit::PER_SECOND, MetricAggregation::SUM, false, metric_schema_detail::none()},
+    {MetricId::POSTGRES_QUERY_LATENCY, "PostgresQueryLatency", MetricType::GAUGE, MetricUnit::SECONDS, MetricAggregation::MAX, false, metric_schema_detail::none()},
+    {MetricId::POSTGRES_CACHE_HIT_RATIO, "PostgresCacheHitRatio", MetricType::GAUGE, MetricUnit::RATIO, MetricAggregation::MIN, false, metric_schema_detail::none()},
+    {MetricId::POSTGRES_POOL_UTILIZATION, "PostgresPoolUtilization", MetricType::GAUGE, MetricUnit::NONE, MetricAggregation::MAX, false, metric_schema_detail::none()},
+    {MetricId::POSTGRES_BUFFERS_CHECKPOINT, "PostgresBuffersCheckpoint", MetricType::COUNTER, MetricUnit::NONE, MetricAggregation::SUM, false, metric_schema_detail::none()},
+    {MetricId::POSTGRES_BUFFERS_CLEAN, "PostgresBuffersClean", MetricType::COUNTER, MetricUnit::NONE, MetricAggregation::SUM, false, metric_schema_detail::none()},
+    {MetricId::POSTGRES_BUFFERS_BACKEND, "PostgresBuffersBackend", MetricType::COUNTER, MetricUnit::NONE, MetricAggregation::SUM, false, metric_schema_detail::none()},
+    {MetricId::POSTGRES_CONNECT_LATENCY, "PostgresConnectLatency", MetricType::GAUGE, MetricUnit::SECONDS, MetricAggregation::MAX, false, metric_schema_detail::none()},
+
+    {MetricId::CPU_TEMPERATURE, "CpuTemperature", MetricType::GAUGE, MetricUnit::CELSIUS, MetricAggregation::MAX, false, metric_schema_detail::none()},
+    {MetricId::MEMORY_PAGE_FAULTS, "MemoryPageFaults", MetricType::COUNTER, MetricUnit::NONE, MetricAggregation::SUM, false, metric_schema_detail::none()},
+    {MetricId::NETWORK_BANDWIDTH, "NetworkBandwidth", MetricType::GAUGE, MetricUnit::KILOBYTES_PER_SECOND, MetricAggregation::SUM, false, metric_schema_detail::none()},
+    {MetricId::DISK_LATENCY, "DiskLatency", MetricType::GAUGE, MetricUnit::SECONDS, MetricAggregation::MAX, false, metric_schema_detail::none()},
+
+    {MetricId::AUTH_FAILED_PASSWORDS, "AuthFailedPasswords", MetricType::COUNTER, MetricUnit::NONE, MetricAggregation::SUM, false, metric_schema_detail::none()},
+    {MetricId::AUTH_INVALID_USERS, "AuthInvalidUsers", MetricType::COUNTER, MetricUnit::NONE, MetricAggregation::SUM, false, metric_schema_detail::none()},
+    {MetricId::AUTH_SUDO_FAILURES, "AuthSudoFailures", MetricType::COUNTER, MetricUnit::NONE, MetricAggregation::SUM, false, metric_schema_detail::none()},
+
+    {MetricId::GPU_DEVICE_USAGE_P90, "GpuDeviceUsageP90", MetricType::GAUGE, MetricUnit::PERCENT, MetricAggregation::MAX, true, metric_schema_detail::none()},
+    {MetricId::GPU_DEVICE_POWER_P90, "GpuDevicePowerP90", MetricType::GAUGE, MetricUnit::WATTS, MetricAggregation::MAX, true, metric_schema_detail::none()},
+};
+
+inline constexpr size_t METRIC_COUNT = static_cast<size_t>(MetricId::COUNT);
+
+namespace metric_schema_detail {
+    constexpr bool rowsMatchIds() {
+        for (size_t i = 0; i < METRIC_COUNT; ++i) {
+            if (static_cast<size_t>(METRIC_SCHEMA[i].id) != i) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr std::array<uint16_t, METRIC_COUNT + 1> slotOffsets() {
+        std::array<uint16_t, METRIC_COUNT + 1> offsets{};
+        for (size_t i = 0; i < METRIC_COUNT; ++i) {
+            offsets[i + 1] = static_cast<uint16_t>(offsets[i] + (METRIC_SCHEMA[i].perGpu ? MAX_GPUS : 1));
+        }
+        return offsets;
+    }
+
+    // FNV-1a over every name and slot count, so any change to the schema changes it
+    constexpr uint32_t schemaHash() {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < METRIC_COUNT; ++i) {
+            for (const char* c = METRIC_SCHEMA[i].name; *c; ++c) {
+                hash = (hash ^ static_cast<uint8_t>(*c)) * 16777619u;
+            }
+            hash = (hash ^ (METRIC_SCHEMA[i].perGpu ? MAX_GPUS : 1u)) * 16777619u;
+        }
+        return hash;
+    }
+}
+
+static_assert(sizeof(METRIC_SCHEMA) / sizeof(METRIC_SCHEMA[0]) == METRIC_COUNT, "One schema row per MetricId");
+static_assert(metric_schema_detail::rowsMatchIds(), "Schema rows must be in MetricId order");
+
+// Start of each metric's slots in MetricFrame::values; the last entry is the slot count
+inline constexpr std::array<uint16_t, METRIC_COUNT + 1> METRIC_OFFSETS = metric_schema_detail::slotOffsets();
+inline constexpr size_t METRIC_SLOTS = METRIC_OFFSETS[METRIC_COUNT];
+inline constexpr uint32_t METRIC_SCHEMA_VERSION = metric_schema_detail::schemaHash();
+
+constexpr const MetricTraits& metricTraits(MetricId id) {
+    return METRIC_SCHEMA[static_cast<size_t>(id)];
+}
+
+constexpr size_t metricSlot(MetricId id, unsigned int gpu = 0) {
+    return METRIC_OFFSETS[static_cast<size_t>(id)] + (metricTraits(id).perGpu ? gpu : 0);
+}
+
+const char* metricUnitName(MetricUnit unit);
+
+// One tick of metrics from one source. Fixed layout and trivially copyable: it is its
+// own MPI buffer and its own serialized form. A slot that was never set is absent, which
+// is not the same as 0.
+struct MetricFrame {
+    static constexpr size_t PRESENT_WORDS = (METRIC_SLOTS + 63) / 64;
+
+    uint32_t schemaVersion = METRIC_SCHEMA_VERSION;
+    uint32_t reserved = 0;
+    uint64_t timestampMicros = 0; // Wall clock when the frame was filled
+    std::array<float, METRIC_SLOTS> values{};
+    std::array<uint64_t, PRESENT_WORDS> present{};
+
+    void set(MetricId id, double value) { setSlot(metricSlot(id), value); }
+    void set(MetricId id, unsigned int gpu, double value) {
+        if (gpu < MAX_GPUS) {
+            setSlot(metricSlot(id, gpu), value);
+        }
+    }
+
+    bool has(MetricId id, unsigned int gpu = 0) const {
+        return gpu < MAX_GPUS && hasSlot(metricSlot(id, gpu));
+    }
+    // 0 when absent
+    float get(MetricId id, unsigned int gpu = 0) const {
+        return has(id, gpu) ? values[metricSlot(id, gpu)] : 0.0f;
+    }
+
+    // No slot present, e.g. a node that reported nothing this tick
+    bool empty() const {
+        for (uint64_t word : present) {
+            if (word) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void clear();
+
+    // One frame from many (ranks, nodes): each slot combines the frames it is present in
+    // by its metric's aggregation; LAST takes the newest frame. The timestamp is the newest.
+    static MetricFrame aggregate(const MetricFrame* frames, size_t count);
+
+    // Calls f(traits, gpu, value) for every present slot in schema order; gpu is 0 for
+    // metrics that are not per-GPU
+    template<typename F>
+    void forEach(F&& f) const {
+        for (size_t i = 0; i < METRIC_COUNT; ++i) {
+            const MetricTraits& traits = METRIC_SCHEMA[i];
+            unsigned int slots = traits.perGpu ? static_cast<unsigned int>(MAX_GPUS) : 1u;
+            for (unsigned int gpu = 0; gpu < slots; ++gpu) {
+                size_t slot = METRIC_OFFSETS[i] + gpu;
+                if (hasSlot(slot)) {
+                    f(traits, gpu, values[slot]);
+                }
+            }
+        }
+    }
+
+    // Present metrics whose schema threshold is breached, in schema order; calls
+    // f(traits, gpu, value) for each and returns how many there were
+    template<typename F>
+    size_t forEachBreach(F&& f) const {
+        size_t breaches = 0;
+        forEach([&](const MetricTraits& traits, unsigned int gpu, float value) {
+            bool breached = (traits.threshold.direction == MetricThreshold::ABOVE && value > traits.threshold.limit) ||
+                            (traits.threshold.direction == MetricThreshold::BELOW && value < traits.threshold.limit);
+            if (breached) {
+                ++breaches;
+                f(traits, gpu, value);
+            }
+        });
+        return breaches;
+    }
+    size_t breaches() const {
+        return forEachBreach([](const MetricTraits&, unsigned int, float) {});
+    }
+
+    // "Name: value unit" per present metric, per-GPU metrics as "Name[gpu]"
+    std::string format() const;
+
+    // The frame's bytes; deserialize() throws std::runtime_error on a size or schema mismatch
+    std::string serialize() const;
+    static MetricFrame deserialize(const std::string& bytes);
+
+private:
+    void setSlot(size_t slot, double value) {
+        values[slot] = static_cast<float>(value);
+        present[slot / 64] |= uint64_t(1) << (slot % 64);
+    }
+    bool hasSlot(size_t slot) const {
+        return (present[slot / 64] >> (slot % 64)) & 1u;
+    }
+};
+
+#endif // METRIC_SCHEMA_H
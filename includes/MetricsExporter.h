@@ -0,0 +1,27 @@
+#ifndef METRICS_EXPORTER_H
+#define METRICS_EXPORTER_H
+
+#include <cstdint>
+#include <seastar/core/future.hh>
+#include <seastar/http/httpd.hh>
+#include "MetricsExposition.h"
+
+// Serves GET /metrics for Prometheus and other OpenMetrics scrapers: the latest frame of
+// every node, from every shard's MetricsExposition. A scrape collects each shard's family
+// buffers and writes them to the connection as they are, without copying or rendering;
+// OpenMetrics is served when the scraper's Accept header asks for it.
+class MetricsExporter {
+public:
+    static constexpr const char* PORT_ENV = "DIRECTOR_METRICS_PORT";
+    static constexpr uint16_t DEFAULT_PORT = 9464;
+
+    // Listens on PORT_ENV, or DEFAULT_PORT, on every address
+    seastar::future<> start();
+    seastar::future<> stop();
+
+private:
+    seastar::httpd::http_server_control server;
+    bool started = false;
+};
+
+#endif // METRICS_EXPORTER_H
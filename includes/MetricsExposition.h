@@ -0,0 +1,87 @@
+#ifndef METRICS_EXPOSITION_H
+#define METRICS_EXPOSITION_H
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "MetricSchema.h"
+
+// The latest frame of every node on a shard, kept rendered in the Prometheus text format
+// so a scrape only has to collect buffers. A metric is one family, named after the schema
+// (GpuUsage in PERCENT is director_gpu_usage_percent), with node and gpu labels.
+//
+// Each node keeps its rendered lines per family; a frame re-renders only that node, and
+// publish() re-joins only the families whose lines changed since the last publish. The
+// joined buffers are immutable and shared, so another shard can send them as they are.
+// One instance per shard, not thread-safe.
+class MetricsExposition {
+public:
+    enum class Format { PROMETHEUS, OPENMETRICS };
+
+    using Buffer = std::shared_ptr<const std::string>;
+
+    // Every node's lines of a family, in family (schema) order; null when no node of the
+    // shard has the metric
+    using Snapshot = std::array<Buffer, METRIC_COUNT>;
+
+    static MetricsExposition& forShard();
+
+    // Replaces the node's lines with the present slots of frame
+    void update(const std::string& node, const MetricFrame& frame);
+    void remove(const std::string& node);
+
+    // Re-joins the families changed since the last publish
+    void publish();
+    // publish(), then shares the family buffers
+    Snapshot snapshot();
+
+    size_t nodes() const { return entries.size(); }
+
+    // "# TYPE" line of a family
+    static const std::string& familyHeader(MetricId id, Format format);
+    static const char* contentType(Format format);
+    // What ends an exposition: "# EOF" for OpenMetrics, nothing for Prometheus
+    static const std::string& trailer(Format format);
+
+    // Calls piece(text, owner) for every buffer of a scrape over the shards' snapshots, in
+    // the order they are sent: families in schema order, each one header then every
+    // shard's lines, then the trailer. owner holds text alive; it is null for static text.
+    template<typename F>
+    static void forEachPiece(const std::vector<Snapshot>& shards, Format format, F&& piece) {
+        static const Buffer none;
+        for (size_t i = 0; i < METRIC_COUNT; ++i) {
+            bool header = false;
+            for (const Snapshot& shard : shards) {
+                if (!shard[i]) {
+                    continue;
+                }
+                if (!header) {
+                    piece(familyHeader(static_cast<MetricId>(i), format), none);
+                    header = true;
+                }
+                piece(*shard[i], shard[i]);
+            }
+        }
+        if (!trailer(format).empty()) {
+            piece(trailer(format), none);
+        }
+    }
+
+private:
+    struct Entry {
+        std::string node;
+        std::string labels;                           // {node="..."
+        std::array<std::string, METRIC_COUNT> lines;  // Rendered samples per family
+    };
+
+    std::vector<Entry> entries;
+    std::unordered_map<std::string, size_t> index;   // Node to its entry
+    Snapshot families;
+    std::array<bool, METRIC_COUNT> dirty{};
+    std::string scratch;                              // Renders a family before the compare
+};
+
+#endif // METRICS_EXPOSITION_H
@@ -0,0 +1,88 @@
+#ifndef METRICS_SAMPLER_H
+#define METRICS_SAMPLER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Background sampler for the counter-based /proc metrics. A worker thread keeps a
+// ring buffer of timestamped raw counters from /proc/stat, /proc/diskstats and
+// /proc/net/dev so rate queries can be answered from the two newest samples
+// instead of sleeping between two reads on the caller's thread.
+class MetricsSampler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct DiskCounters {
+        uint64_t readIos = 0;
+        uint64_t readSectors = 0;
+        uint64_t readTimeMs = 0;
+        uint64_t writeIos = 0;
+        uint64_t writeSectors = 0;
+        uint64_t writeTimeMs = 0;
+        uint64_t ioTimeMs = 0;
+    };
+
+    struct NetCounters {
+        uint64_t rxBytes = 0;
+        uint64_t rxPackets = 0;
+        uint64_t txBytes = 0;
+        uint64_t txPackets = 0;
+    };
+
+    struct Sample {
+        Clock::time_point timestamp;
+        uint64_t cpuIdle = 0;
+        uint64_t cpuTotal = 0;
+        std::map<std::string, DiskCounters> disks;
+        std::map<std::string, NetCounters> interfaces;
+    };
+
+    explicit MetricsSampler(std::chrono::milliseconds interval = std::chrono::milliseconds(1000),
+                            size_t capacity = 60);
+    ~MetricsSampler();
+
+    MetricsSampler(const MetricsSampler&) = delete;
+    MetricsSampler& operator=(const MetricsSampler&) = delete;
+
+    void start();
+    void stop();
+
+    // Every query accepts the maximum age of the newest sample it may use. When the
+    // ring buffer is older than that, a fresh sample is taken on the caller's thread.
+    double cpuUtilization(std::chrono::milliseconds maxAge);
+    double diskIoUtilization(const std::string& disk, std::chrono::milliseconds maxAge);
+    double diskReadThroughput(const std::string& disk, std::chrono::milliseconds maxAge);
+    double diskWriteThroughput(const std::string& disk, std::chrono::milliseconds maxAge);
+    double diskLatency(const std::string& disk, std::chrono::milliseconds maxAge);
+    double networkBandwidth(const std::string& interface, std::chrono::milliseconds maxAge);
+
+private:
+    static Sample takeSample();
+    void run();
+    void push(Sample sample);
+
+    // Calls func(older, newest) under the lock with a sample pair spanning at least
+    // MIN_WINDOW, refreshing the buffer first if the newest sample is too old.
+    template<typename Func>
+    double withSamplePair(std::chrono::milliseconds maxAge, Func func);
+
+    static constexpr std::chrono::milliseconds MIN_WINDOW{100};
+
+    std::chrono::milliseconds interval;
+    std::vector<Sample> ring;
+    size_t head = 0;  // Index of the next slot to write
+    size_t count = 0;
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::thread worker;
+    bool running = false;
+};
+
+#endif // METRICS_SAMPLER_H
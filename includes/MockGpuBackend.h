@@ -0,0 +1,87 @@
+#ifndef MOCK_GPU_BACKEND_H
+#define MOCK_GPU_BACKEND_H
+
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "GpuBackend.h"
+
+// Deterministic stand-in for NVML. Without a script it has no devices, which is what a
+// CPU-only node should report. A script gives readings one field per line:
+//
+//     # device field value[,value...]
+//     0 temperature 65
+//     0 utilization.gpu 20,50,95
+//     0 fan n/a
+//
+// A comma-separated list is returned one value per read, wrapping around, so a test can
+// step a GPU through a load curve. "n/a" makes the reading throw the way NVML does for an
+// unsupported field; fields that are not scripted read as 0. The device count is one
+// more than the highest index. The file is re-read when its modification time changes.
+//
+// Fields: temperature, utilization.gpu, utilization.memory, memory.total, memory.used,
+// power (mW), fan, clock.graphics, clock.sm, clock.memory, compute_mode (0-3),
+// pcie.tx, pcie.rx (KB/s), energy (mJ).
+//
+// samples.gpu, samples.memory and samples.power script the driver's sample buffers
+// instead. Starting when the script is loaded, the mock "records" one value every
+// samples.period microseconds (default 166667, NVML's utilization rate), cycling
+// through the list, and keeps the last BUFFER_DEPTH of them. Unscripted buffers are empty.
+//
+// process.<pid>.memory (bytes), .sm, .mem, .enc and .dec (%) put a process on the device
+// for processUsage(); each call takes the next value of each list.
+class MockGpuBackend : public GpuBackend {
+public:
+    MockGpuBackend() = default;
+    // Throws std::runtime_error if the script cannot be read or parsed
+    explicit MockGpuBackend(std::string scriptPath);
+
+    std::string name() const override { return "mock"; }
+    unsigned int deviceCount() override;
+
+    unsigned int temperature(unsigned int index) override;
+    GpuUtilization utilization(unsigned int index) override;
+    GpuMemoryInfo memory(unsigned int index) override;
+    unsigned int powerUsage(unsigned int index) override;
+    unsigned int fanSpeed(unsigned int index) override;
+    unsigned int clock(unsigned int index, GpuClock clock) override;
+    GpuComputeMode computeMode(unsigned int index) override;
+    unsigned int pcieThroughput(unsigned int index, GpuPcieCounter counter) override;
+
+    // One lock and one script check for the whole sample
+    GpuSample sample(unsigned int index) override;
+    // Every read holds the one mutex, so sweep threads would only queue on it
+    bool concurrentReads() const override { return false; }
+
+    std::vector<GpuTimedValue> bufferedSamples(unsigned int index, GpuSampleType type, uint64_t sinceMicros) override;
+
+    std::vector<GpuProcessUsage> processUsage(unsigned int index, uint64_t sinceMicros) override;
+
+    static constexpr uint64_t DEFAULT_SAMPLE_PERIOD_MICROS = 166667;
+    static constexpr uint64_t BUFFER_DEPTH = 120;
+
+private:
+    struct Series {
+        std::vector<uint64_t> values; // Empty means unsupported
+        size_t next = 0;
+    };
+
+    void reloadIfChanged();
+    uint64_t read(unsigned int index, const std::string& field);
+    // Caller holds mutex and has checked index; nullopt for an "n/a" field
+    std::optional<uint64_t> next(unsigned int index, const std::string& field);
+
+    std::mutex mutex;
+    std::string scriptPath;
+    timespec loadedAt{};
+    uint64_t samplesStartMicros = 0; // Wall clock at the last load; synthetic buffers start here
+    unsigned int devices = 0;
+    std::map<std::pair<unsigned int, std::string>, Series> series;
+};
+
+#endif // MOCK_GPU_BACKEND_H
@@ -17,6 +17,11 @@
 #include <azure/identity.hpp>
 #include <azure/compute.hpp>
 #import "MPIController.h" // MPIController
+#include "MetricArchive.h"
+#include "MetricQuery.h"
+#include "MetricSchema.h"
+#include "MetricsExposition.h"
+#include "TimeSeriesStore.h"
 #include <azure/core.hpp>
 #include <aws/core/Aws.h>
 #include "NodeQueue.hh" // NodeQueue - in-memory, thread safe Double Edge Queue, insert/delete = O(1)
@@ -28,6 +33,7 @@
 
 #include <algorithm>
 #include <iostream>
+#include <optional>
 #include <vector>
 
 
@@ -55,26 +61,31 @@ private:
     float hddUsage;
     float trafficIn;
     float trafficOut;
-    std::unordered_map<std::string, float> gpuMetrics;
+    MetricFrame metrics;
 
     // Add threshold values for scaling decisions
     const float CPU_USAGE_THRESHOLD = 80.0f; // Example threshold
     const float MEMORY_USAGE_THRESHOLD = 75.0f; // Example threshold
     const float HDD_USAGE_THRESHOLD = 70.0f; // Example threshold
     const float GPU_USAGE_THRESHOLD = 80.0f; // Example threshold
-    const float GPU_TEMPERATURE_THRESHOLD = 85.0f; // Example threshold
-    const float GPU_MEMORY_USAGE_THRESHOLD = 80.0f; // Example threshold
     const float GPU_POWER_USAGE_THRESHOLD = 90.0f; // Example threshold
     const float GPU_FAN_SPEED_THRESHOLD = 90.0f; // Example threshold
 
+    // History windows: node load is averaged over LOAD_WINDOW_SECONDS, and a schema rule
+    // has to hold for SUSTAIN_WINDOW_SECONDS before it scales a node
+    const uint64_t LOAD_WINDOW_SECONDS = 300;
+    const uint64_t SUSTAIN_WINDOW_SECONDS = 60;
+
     DistributedLinkedHashMap<std::string, std::string> registeredNodes;
     NodeQueue queueToScaleUp;
     NodeQueue queueToScaleDown;
     MPIController mpiController;
 
-    seastar::future<int> getNodeLoad(const std::string &ipAddress); // Example load calculation method
+    seastar::future<int> getNodeLoad(const std::string &ipAddress, std::optional<float> gpuUsage = std::nullopt); // Example load calculation method; gpuUsage replaces the instantaneous GPU term
+    size_t sustainedBreaches(const std::string &ipAddress, const MetricFrame &current); // Schema rules breached now and for the whole sustain window
     seastar::future<int> getProcessLoad(const std::string &processName); // Load calculation for processes
     seastar::future<bool> needsScaling(const std::string &processName); // Determine if a process needs scaling
+    seastar::future<bool> needsScaling(const std::string &ipAddress, const std::string &processName, const MetricFrame &metrics); // Determine if a node needs scaling from its collected frame
     seastar::future<> gracefulShutdown(const std::string &processName); // Graceful shutdown of a process
     seastar::future<> updateProcessInfo(const std::string &oldProcessName, const std::string &newProcessName, const std::string &newIpAddress); // Update process information
 
@@ -0,0 +1,47 @@
+#ifndef NVML_GPU_BACKEND_H
+#define NVML_GPU_BACKEND_H
+
+#include "GpuBackend.h"
+
+// NVML resolved at run time with dlopen("libnvidia-ml.so.1"), so the binary carries no
+// link-time dependency on the driver and runs unchanged on CPU-only nodes. Device
+// handles are looked up once at load; the device set is fixed while the driver is loaded.
+class NvmlGpuBackend : public GpuBackend {
+public:
+    // nullptr when the library is missing or nvmlInit fails (no driver loaded)
+    static std::unique_ptr<NvmlGpuBackend> load();
+
+    ~NvmlGpuBackend() override;
+    NvmlGpuBackend(const NvmlGpuBackend&) = delete;
+    NvmlGpuBackend& operator=(const NvmlGpuBackend&) = delete;
+
+    std::string name() const override { return "nvml"; }
+    unsigned int deviceCount() override;
+
+    unsigned int temperature(unsigned int index) override;
+    GpuUtilization utilization(unsigned int index) override;
+    GpuMemoryInfo memory(unsigned int index) override;
+    unsigned int powerUsage(unsigned int index) override;
+    unsigned int fanSpeed(unsigned int index) override;
+    unsigned int clock(unsigned int index, GpuClock clock) override;
+    GpuComputeMode computeMode(unsigned int index) override;
+    unsigned int pcieThroughput(unsigned int index, GpuPcieCounter counter) override;
+
+    // Power and energy come from one nvmlDeviceGetFieldValues batch; the gauges NVML
+    // has no field IDs for are read directly off the cached handle
+    GpuSample sample(unsigned int index) override;
+    std::vector<GpuTimedValue> bufferedSamples(unsigned int index, GpuSampleType type, uint64_t sinceMicros) override;
+    // Memory from the compute and graphics running-process lists, joined by pid with
+    // nvmlDeviceGetProcessUtilization samples
+    std::vector<GpuProcessUsage> processUsage(unsigned int index, uint64_t sinceMicros) override;
+
+private:
+    struct Api;
+
+    NvmlGpuBackend(void* library, std::unique_ptr<Api> api);
+
+    void* library;
+    std::unique_ptr<Api> api;
+};
+
+#endif // NVML_GPU_BACKEND_H
@@ -0,0 +1,61 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+// Counter values scaled for multiplexing. Hardware fields stay 0 when the PMU is not
+// exposed (most VMs and containers) and only software events could be opened.
+struct PerfSample {
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    uint64_t cacheMisses = 0;
+    uint64_t taskClockNs = 0;
+    uint64_t contextSwitches = 0;
+    uint64_t pageFaults = 0;
+    bool hardware = false;
+
+    double ipc() const;
+    double missesPerKiloInstruction() const;
+
+    // Counts accumulated between an earlier sample and this one
+    PerfSample since(const PerfSample& earlier) const;
+};
+
+// Opens cycles, instructions, cache-misses, task-clock, context-switches and
+// page-faults as one perf_event_open group, so the ratios between them come from the
+// same scheduling intervals. Falls back to a software-only group when the hardware
+// events are unavailable.
+class PerfCounters {
+public:
+    // Counts every thread of pid on any CPU: one group per thread running at the time of
+    // the call, each inherited by the threads it creates afterwards
+    static PerfCounters forProcess(pid_t pid);
+    // Counts every task in a cgroup v2 group; needs one group per CPU and, on most
+    // systems, CAP_PERFMON or perf_event_paranoid <= 0
+    static PerfCounters forCgroup(const std::string& cgroupPath);
+
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+    PerfCounters(PerfCounters&& other) noexcept;
+    PerfCounters& operator=(PerfCounters&& other) noexcept;
+
+    // Cumulative counts since the counters were opened
+    PerfSample read() const;
+    bool hasHardwareCounters() const { return hardware; }
+
+private:
+    PerfCounters() = default;
+    // One group per target (a tid, or a cgroup fd with PERF_FLAG_PID_CGROUP) and CPU
+    void openGroups(const std::vector<pid_t>& targets, const std::vector<int>& cpus, unsigned long flags);
+    void close();
+
+    // One group per CPU in cgroup mode, one per thread otherwise
+    std::vector<std::vector<int>> groups;
+    bool hardware = false;
+};
+
+#endif // PERF_COUNTERS_H
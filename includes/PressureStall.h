@@ -0,0 +1,76 @@
+#ifndef PRESSURE_STALL_H
+#define PRESSURE_STALL_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+enum class PressureResource { Cpu, Memory, Io };
+
+// One line of a PSI file: share of wall time stalled over the last 10/60/300 seconds
+// (in percent) and the cumulative stall time in microseconds.
+struct PressureLine {
+    double avg10 = 0.0;
+    double avg60 = 0.0;
+    double avg300 = 0.0;
+    uint64_t totalUs = 0;
+};
+
+// "some": at least one task stalled. "full": all non-idle tasks stalled at once.
+struct PressureStats {
+    PressureLine some;
+    PressureLine full;
+};
+
+// Parses the contents of /proc/pressure/* or a cgroup's *.pressure file.
+PressureStats parsePressure(std::string_view text);
+
+const char* pressurePath(PressureResource resource);
+
+// Registers PSI triggers and waits for them with poll(). A trigger fires when the
+// tasks stall for more than the threshold within the window, so callers are woken
+// as soon as saturation starts instead of on their next polling tick.
+class PressureMonitor {
+public:
+    enum class StallKind { Some, Full };
+
+    PressureMonitor();
+    ~PressureMonitor();
+
+    PressureMonitor(const PressureMonitor&) = delete;
+    PressureMonitor& operator=(const PressureMonitor&) = delete;
+
+    // Returns the trigger index. The kernel requires 500ms <= window <= 10s, and for
+    // unprivileged users a window that is a multiple of 2s.
+    size_t addTrigger(PressureResource resource, StallKind kind,
+                      std::chrono::microseconds stall, std::chrono::microseconds window);
+    size_t addTrigger(const std::string& path, StallKind kind,
+                      std::chrono::microseconds stall, std::chrono::microseconds window);
+
+    // Blocks until at least one trigger fires or the timeout expires, and returns the
+    // indices of the triggers that fired.
+    std::vector<size_t> wait(std::chrono::milliseconds timeout);
+
+    // Waits on a background thread instead and writes to notifyFd (an eventfd) each
+    // time a trigger fires. Triggers must be registered before start().
+    void start(int notifyFd);
+    void stop();
+
+    uint64_t eventCount() const { return events.load(); }
+
+private:
+    std::vector<size_t> pollOnce(int timeoutMs);
+    void run(int notifyFd);
+
+    std::vector<int> triggerFds;
+    int stopFd;
+    std::thread worker;
+    std::atomic<bool> stopping{false};
+    std::atomic<uint64_t> events{0};
+};
+
+#endif // PRESSURE_STALL_H
@@ -0,0 +1,75 @@
+#ifndef PROBE_WORKER_H
+#define PROBE_WORKER_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <seastar/core/future.hh>
+#include <seastar/core/reactor.hh>
+
+// Runs blocking probes (file reads that sleep for a rate baseline, synchronous database
+// clients, NVML) on a thread of its own and hands the result back to the reactor as a
+// future, so the shard keeps serving while a probe waits. One thread per shard, so the
+// per-thread caches in SystemMetrics persist between probes; use forShard().
+class ProbeWorker {
+public:
+    ProbeWorker();
+    ~ProbeWorker();
+
+    ProbeWorker(const ProbeWorker&) = delete;
+    ProbeWorker& operator=(const ProbeWorker&) = delete;
+
+    // The calling shard's worker
+    static ProbeWorker& forShard();
+
+    // Runs probe on the worker thread, in submission order. Exceptions it throws fail
+    // the returned future.
+    template<typename Func>
+    auto run(Func probe) -> seastar::future<std::invoke_result_t<Func>> {
+        using Result = std::invoke_result_t<Func>;
+        if constexpr (std::is_void_v<Result>) {
+            return submit(std::move(probe));
+        } else {
+            auto result = std::make_shared<std::optional<Result>>();
+            return submit([probe = std::move(probe), result]() mutable {
+                result->emplace(probe());
+            }).then([result] {
+                return std::move(**result);
+            });
+        }
+    }
+
+    // Lets queued probes finish, then ends the thread
+    seastar::future<> stop();
+
+private:
+    struct Job {
+        std::function<void()> work;
+        std::exception_ptr error;
+        seastar::promise<> done;
+    };
+
+    seastar::future<> submit(std::function<void()> work);
+    void runJobs();
+    seastar::future<> deliverFinished();
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::deque<std::unique_ptr<Job>> queued;
+    std::deque<std::unique_ptr<Job>> finished;
+    bool stopping = false;
+    bool exited = false;
+
+    // The worker writes here when a job finishes; the reactor sets the promises
+    seastar::readable_eventfd completions;
+    std::optional<seastar::future<>> delivering;
+    std::thread worker;
+};
+
+#endif // PROBE_WORKER_H
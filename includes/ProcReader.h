@@ -0,0 +1,74 @@
+#ifndef PROC_READER_H
+#define PROC_READER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Keeps a /proc or /sys file open and re-reads it with pread() at offset 0 into a
+// buffer that is reused across reads. Not thread-safe: give each thread its own
+// reader (the helpers use thread_local instances).
+class ProcReader {
+public:
+    explicit ProcReader(std::string path);
+    ~ProcReader();
+
+    ProcReader(const ProcReader&) = delete;
+    ProcReader& operator=(const ProcReader&) = delete;
+    ProcReader(ProcReader&& other) noexcept;
+    ProcReader& operator=(ProcReader&& other) noexcept;
+
+    // Returns the current file contents. The view stays valid until the next read().
+    // Throws std::runtime_error if the file cannot be opened or read.
+    std::string_view read();
+
+    // Same as read() but returns false instead of throwing, for optional files.
+    bool tryRead(std::string_view& contents);
+
+    const std::string& path() const { return filePath; }
+
+private:
+    bool open();
+    void close();
+
+    std::string filePath;
+    int fd = -1;
+    std::vector<char> buffer;
+};
+
+// Allocation-free scanner over the text returned by ProcReader. Numbers are parsed
+// by hand; there is no locale or stream state involved.
+class ProcScanner {
+public:
+    explicit ProcScanner(std::string_view text)
+        : cursor(text.data()), end(text.data() + text.size()) {}
+
+    bool atEnd() const { return cursor >= end; }
+    bool atEndOfLine() const { return cursor >= end || *cursor == '\n'; }
+
+    // Moves to the first character after the next newline. Returns false at the end of input.
+    bool nextLine();
+
+    // Returns the next blank-delimited token on the current line, or an empty view.
+    std::string_view token();
+
+    // Returns the next token on the current line, stopping early at the given delimiter
+    // (which is consumed). Used for "eth0:" style keys in /proc/net/dev.
+    std::string_view tokenUntil(char delimiter);
+
+    bool skipTokens(size_t count);
+    bool parseUnsigned(uint64_t& value);
+    bool parseSigned(int64_t& value);
+
+    // Remaining characters of the current line, without the newline.
+    std::string_view restOfLine();
+
+private:
+    void skipBlanks();
+
+    const char* cursor;
+    const char* end;
+};
+
+#endif // PROC_READER_H
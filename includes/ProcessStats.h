@@ -0,0 +1,43 @@
+#ifndef PROCESS_STATS_H
+#define PROCESS_STATS_H
+
+#include <cstdint>
+#include <sys/types.h>
+#include <vector>
+
+// Per-process accounting in struct-of-arrays layout: entry i of every column belongs
+// to pids[i]. Flat columns can be shipped over MPI without repacking.
+struct ProcessStats {
+    std::vector<pid_t> pids;
+    std::vector<uint64_t> rssBytes;
+    std::vector<uint64_t> cpuTicks;     // utime + stime, in clock ticks
+    std::vector<uint64_t> majorFaults;
+    std::vector<uint32_t> threads;
+
+    size_t size() const { return pids.size(); }
+    void reserve(size_t count);
+    void append(const ProcessStats& other);
+};
+
+// Reads /proc/<pid>/statm and /proc/<pid>/stat for a batch of pids, split across
+// worker threads. Pids that exit while being read are skipped rather than reported
+// as errors, so the result may be shorter than the input.
+class ProcessStatsCollector {
+public:
+    explicit ProcessStatsCollector(unsigned workers = 0); // 0 uses hardware_concurrency()
+    ~ProcessStatsCollector();
+
+    ProcessStatsCollector(const ProcessStatsCollector&) = delete;
+    ProcessStatsCollector& operator=(const ProcessStatsCollector&) = delete;
+
+    ProcessStats collect(const std::vector<pid_t>& pids) const;
+
+private:
+    void collectRange(const pid_t* begin, const pid_t* end, ProcessStats& out) const;
+
+    unsigned workers;
+    int procFd; // Directory fd for /proc, so each open is a short openat()
+    long pageSize;
+};
+
+#endif // PROCESS_STATS_H
@@ -0,0 +1,99 @@
+#ifndef RTT_PROBER_H
+#define RTT_PROBER_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "SockDiag.h"
+
+// Rolling round-trip statistics over the last few probes to one target
+struct RttStats {
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    double minMs = 0.0;
+    double avgMs = 0.0;
+    double maxMs = 0.0;
+    double jitterMs = 0.0; // Mean absolute difference between consecutive answered RTTs
+
+    double lossRatio() const;
+};
+
+// Measures RTT from inside the process instead of running ping(8). A round sends one
+// probe to every target at once and waits for the answers on a handful of sockets
+// with poll(). Plain targets are pinged with an unprivileged ICMP datagram socket
+// (net.ipv4.ping_group_range); when the kernel refuses those, they get a TCP connect
+// to port 443 instead, where a SYN-ACK and a RST both count as an answer.
+// "tcp://host:port" and "udp://host:port" (an echo service) pick the method explicitly,
+// and "icmp://host" pins ICMP for hosts that serve nothing on 443, such as gateways:
+// while ICMP is refused those are not probed at all rather than counted as lost.
+// Receive times, and send times where the kernel reports them, come from
+// SO_TIMESTAMPING, so scheduling delay in this process does not count as network RTT.
+// Not thread-safe.
+class RttProber {
+public:
+    static constexpr size_t DEFAULT_WINDOW = 64;
+    static constexpr std::chrono::milliseconds DEFAULT_TIMEOUT{1000};
+    static constexpr uint16_t TCP_FALLBACK_PORT = 443;
+
+    // Probes leave from interface's addresses when one is given, otherwise the routing
+    // table picks. window is the number of probes per target the statistics cover.
+    explicit RttProber(const std::string& interface = "", size_t window = DEFAULT_WINDOW);
+    ~RttProber();
+
+    RttProber(const RttProber&) = delete;
+    RttProber& operator=(const RttProber&) = delete;
+
+    // One probe to each target; unanswered probes count as lost after timeout
+    void probe(const std::vector<std::string>& targets, std::chrono::milliseconds timeout = DEFAULT_TIMEOUT);
+
+    // Statistics for a target as spelled in probe(); all zero if it was never probed
+    RttStats stats(const std::string& target) const;
+
+    // False once the kernel has refused an ICMP datagram socket
+    bool icmpAvailable() const { return !icmpDenied; }
+
+private:
+    enum class Method { ICMP, ICMP_ONLY, TCP_CONNECT, UDP_ECHO };
+
+    struct Target {
+        Method method = Method::ICMP;
+        std::string host;
+        uint16_t port = 0;
+        std::optional<std::pair<int, std::array<unsigned char, 16>>> address; // family, bytes
+        std::deque<std::optional<double>> samples; // Milliseconds, nullopt when lost
+    };
+
+    // A datagram socket shared by every target of one method and family
+    struct Socket {
+        int fd = -1;
+        Method method = Method::ICMP;
+        uint32_t nextTxKey = 0;      // SOF_TIMESTAMPING_OPT_ID counts sends from 0
+        bool txTimestamps = false;   // Cleared if a failed send desynchronizes the keys
+    };
+
+    struct Pending;
+
+    Target& target(const std::string& spec);
+    bool resolve(Target& target);
+    Socket* datagramSocket(Method method, int family);
+    void bindSource(int fd, int family) const;
+
+    bool send(Pending& pending, uint16_t sequence);
+    void receive(Socket& socket, std::vector<Pending>& pending);
+    void drainTxTimestamps(Socket& socket, std::vector<Pending>& pending);
+
+    size_t window;
+    std::vector<LocalAddress> sourceAddresses;
+    std::map<std::string, Target> targets;
+    std::map<std::pair<Method, int>, Socket> sockets;
+    bool icmpDenied = false;
+    uint16_t nextSequence = 0;
+};
+
+#endif // RTT_PROBER_H
@@ -0,0 +1,51 @@
+#ifndef SOCK_DIAG_H
+#define SOCK_DIAG_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// TCP connection counts indexed by kernel TCP state (TCP_ESTABLISHED = 1 ... TCP_CLOSING = 11).
+struct TcpStateCounts {
+    static constexpr size_t STATE_COUNT = 12;
+
+    std::array<uint64_t, STATE_COUNT> byState{};
+
+    uint64_t total() const;
+    uint64_t established() const;
+};
+
+// A local address a socket may be bound to, in network byte order.
+struct LocalAddress {
+    int family = 0; // AF_INET or AF_INET6
+    std::array<unsigned char, 16> bytes{};
+
+    bool matches(int socketFamily, const unsigned char* socketAddress) const;
+};
+
+// Counts TCP sockets through NETLINK_SOCK_DIAG. The kernel filters by state and,
+// when a port is given, by local port via inet_diag bytecode, so userspace never
+// sees the sockets it is not interested in and no text is formatted.
+class SockDiag {
+public:
+    static constexpr uint32_t ALL_STATES = (1u << TcpStateCounts::STATE_COUNT) - 1;
+
+    static uint32_t stateBit(int state) { return 1u << state; }
+
+    // Counts IPv4 and IPv6 TCP sockets in stateMask. localPort == 0 means any port, and an
+    // empty localAddresses means any local address. Throws std::runtime_error when the
+    // netlink socket cannot be used (old kernel, seccomp, missing module).
+    static TcpStateCounts countTcp(uint32_t stateMask, uint16_t localPort = 0,
+                                   const std::vector<LocalAddress>& localAddresses = {});
+
+    // Same filters, computed by parsing /proc/net/tcp and /proc/net/tcp6. Slow on hosts
+    // with many sockets; used only when netlink is unavailable.
+    static TcpStateCounts countTcpFromProc(uint32_t stateMask, uint16_t localPort = 0,
+                                           const std::vector<LocalAddress>& localAddresses = {});
+
+    // Addresses currently assigned to the named interface.
+    static std::vector<LocalAddress> interfaceAddresses(const std::string& interface);
+};
+
+#endif // SOCK_DIAG_H
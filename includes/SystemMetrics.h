@@ -4,10 +4,25 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <chrono>
+#include <memory>
+#include "SockDiag.h"
+#include "ProcessStats.h"
+#include "PressureStall.h"
+#include "PerfCounters.h"
+#include "HttpProber.h"
+#include "RttProber.h"
+#include "GpuBackend.h"
+#include "GpuHistory.h"
+#include "GpuProcessAccounting.h"
 
 class SystemMetrics {
 public:
-    double getCpuUtilization();
+    // Rate getters are served by a background sampler; maxAge bounds how old the
+    // newest sample behind the returned value may be.
+    static constexpr std::chrono::milliseconds DEFAULT_MAX_SAMPLE_AGE{2000};
+
+    double getCpuUtilization(std::chrono::milliseconds maxAge = DEFAULT_MAX_SAMPLE_AGE);
     std::vector<double> getCpuLoadAverage();
     double getCpuStealTime();
     double getCpuTemperature();
@@ -17,29 +32,80 @@ public:
     double getSwapUsage();
     double getMemoryPageFaults();
 
-    double getDiskIoUtilization(const std::string& disk);
-    double getDiskReadThroughput(const std::string& disk);
-    double getDiskWriteThroughput(const std::string& disk);
-    double getDiskLatency(const std::string& disk);
+    // Pressure Stall Information from /proc/pressure/{cpu,memory,io}
+    PressureStats getCpuPressure();
+    PressureStats getMemoryPressure();
+    PressureStats getIoPressure();
+
+    // Per-workload numbers from the cgroup v2 group of the named process, so load from
+    // other tenants on the host is not counted. 0 when the process is not running here.
+    static double getWorkloadCpuUtilization(const std::string& processName);    // % of the group's CPU allowance
+    static double getWorkloadMemoryUtilization(const std::string& processName); // % of memory.max
+    static double getWorkloadCpuPressure(const std::string& processName);       // cpu.pressure some avg10
+    static double getWorkloadIoPressure(const std::string& processName);        // io.pressure some avg10
+
+    // Cycles, instructions, cache misses, context switches and page faults for the named
+    // process's cgroup since the previous call. IPC and MPKI tell a CPU-bound workload
+    // (more cores help) from a memory-stall-bound one (they do not). The first call for a
+    // process opens the counters and returns zero counts.
+    static PerfSample getWorkloadPerfCounters(const std::string& processName);
+
+    // GPU memory and SM, memory, encoder and decoder utilization of the named process's
+    // cgroup on its busiest GPU here. All zero when the process is not running here.
+    static GpuWorkloadUsage getWorkloadGpuUsage(const std::string& processName);
+
+    double getDiskIoUtilization(const std::string& disk, std::chrono::milliseconds maxAge = DEFAULT_MAX_SAMPLE_AGE);
+    double getDiskReadThroughput(const std::string& disk, std::chrono::milliseconds maxAge = DEFAULT_MAX_SAMPLE_AGE);
+    double getDiskWriteThroughput(const std::string& disk, std::chrono::milliseconds maxAge = DEFAULT_MAX_SAMPLE_AGE);
+    double getDiskLatency(const std::string& disk, std::chrono::milliseconds maxAge = DEFAULT_MAX_SAMPLE_AGE);
     double getDiskSpaceUtilization(const std::string& path);
-
-    double getNetworkBandwidthUtilization(const std::string& interface);
-    double getNetworkLatency(const std::string& interface);
+    // Whole disks of this node by the name the disk getters take (sda, nvme0n1), without
+    // loop, ram and zram devices
+    std::vector<std::string> getDisks();
+
+    // The interface the network getters read by default: DIRECTOR_NETWORK_INTERFACE when
+    // set, else the one the default route goes out of
+    static constexpr const char* NETWORK_INTERFACE_ENV = "DIRECTOR_NETWORK_INTERFACE";
+    std::string getPrimaryInterface();
+
+    double getNetworkBandwidthUtilization(const std::string& interface, std::chrono::milliseconds maxAge = DEFAULT_MAX_SAMPLE_AGE);
+    // RTT is measured to DIRECTOR_RTT_TARGET when set (a host, tcp://host:port or
+    // udp://host:port; see RttProber), else to the interface's default gateway
+    static constexpr const char* NETWORK_RTT_TARGET_ENV = "DIRECTOR_RTT_TARGET";
+    double getNetworkLatency(const std::string& interface); // Rolling mean RTT, ms
+    RttStats getNetworkRttStats(const std::string& interface); // Min/avg/jitter/loss over the recent probes
     double getNetworkErrors(const std::string& interface);
     double getPacketLoss(const std::string& interface);
     int getActiveConnections(const std::string& interface);
+    TcpStateCounts getTcpConnectionStates(const std::string& interface, uint16_t localPort = 0);
 
-    double getApplicationResponseTime(const std::string& app);
+    // Served from one concurrent probe window per app (see HttpProber), reused for a few
+    // seconds so reading all four costs a single window
+    std::shared_ptr<const HttpProbeResult> getApplicationProbe(const std::string& app); // p50/p99/p999 via latencyMicros
+    double getApplicationResponseTime(const std::string& app);   // Median, seconds
     double getApplicationErrorRate(const std::string& app);
     double getRequestRate(const std::string& app);
     double getThroughput(const std::string& app);
 
+    // PostgreSQL URIs are probed through the shard's AsyncPgProbe, which waits without
+    // blocking the reactor and so needs a seastar::thread: the five getters below throw
+    // std::runtime_error for a PostgreSQL URI when called anywhere else, e.g. from a plain
+    // continuation or a non-Seastar thread. Other databases block the caller.
     double getQueryPerformance(const std::string& db);
+    double getDatabaseConnectLatency(const std::string& db); // Seconds to open the pooled connection
     double getConnectionPoolUtilization(const std::string& db);
     double getCacheHitMissRate(const std::string& db);
     double getTransactionRate(const std::string& db);
 
     int getFailedLoginAttempts();
+
+    // Running totals from the system auth log, counted in a single pass
+    struct AuthLogCounts {
+        int failedPasswords;
+        int invalidUsers;
+        int sudoFailures;
+    };
+    AuthLogCounts getAuthLogCounts();
     int getIntrusionDetectionAlerts();
     int getFirewallLogEntries();
     int getVulnerabilityScans();
@@ -52,7 +118,7 @@ public:
     double getEnergyEfficiency();
     bool shouldScale(SystemMetrics& sysMetrics, const std::string& instance, const std::string& app, const std::string& disk, const std::string& interface);
     std::string getIpAddress();
-    bool hasNvidiaGpu();
+    static bool hasNvidiaGpu(); // Any device on the GPU backend; cheap after the first call
     bool isTbbAvailable();
     bool isMpiAvailable();
 
@@ -63,7 +129,18 @@ public:
 
     std::vector<ProcessMemoryInfo> getProcessMemoryUsage(const std::vector<pid_t>& pids);
 
+    // Batched RSS, CPU ticks, major faults and thread counts; exited pids are skipped
+    static ProcessStats getProcessStats(const std::vector<pid_t>& pids);
+
     // GPU Methods
+    // Every gauge of one GPU in a single pass; prefer this over the getters below when
+    // more than one value is needed
+    static GpuSample getGpuSample(unsigned int gpuIndex);
+    // Every GPU on the node sampled in parallel, with node-level aggregates
+    static GpuSweep getGpuSweep();
+    // Every reading the GPU drivers buffered in the last tick, per GPU; callers in the
+    // same tick share one collection. Empty when the driver keeps no sample buffers
+    static std::shared_ptr<const GpuHistory::Interval> getGpuHistory();
     float getGpuTemperature(unsigned int gpuIndex);
     float getGpuUsage(unsigned int gpuIndex);
     float getGpuMemoryUsage(unsigned int gpuIndex);
@@ -74,15 +151,13 @@ public:
     float getGpuMemoryClock(unsigned int gpuIndex);
     float getGpuMemoryBandwidthUsage(unsigned int gpuIndex);
     std::string getGpuComputeMode(unsigned int gpuIndex);
-    float getGpuPCIeThroughput(unsigned int gpuIndex, nvmlPcieUtilCounter_t counter);    
+    float getGpuPCIeThroughput(unsigned int gpuIndex, GpuPcieCounter counter);
 
 private:
     double readStatFile();
     double readProcFile(const std::string& path);
     std::map<std::string, double> readNetDevFile();
     std::string detectDatabaseType(const std::string& db);
-    void initializeNVML();
-    void shutdownNVML();
 
 };
 
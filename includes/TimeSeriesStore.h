@@ -0,0 +1,130 @@
+#ifndef TIME_SERIES_STORE_H
+#define TIME_SERIES_STORE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "MetricSchema.h"
+
+// One stored sample
+struct TimeSeriesPoint {
+    uint64_t timestampMicros = 0; // Millisecond resolution; the sub-millisecond part is dropped
+    float value = 0.0f;
+};
+
+// Decoded samples of one series, a vector per column, for the query kernels
+struct ColumnBatch {
+    std::vector<uint64_t> timestamps; // Microseconds, ascending
+    std::vector<float> values;
+
+    size_t size() const { return values.size(); }
+    void clear() {
+        timestamps.clear();
+        values.clear();
+    }
+};
+
+// Reduction of one series over a time range
+struct TimeSeriesSummary {
+    uint64_t count = 0;
+    float min = 0.0f;
+    float max = 0.0f;
+    double sum = 0.0;
+    double mean = 0.0;
+    float first = 0.0f;
+    float last = 0.0f;
+    uint64_t firstMicros = 0; // Timestamps of first and last
+    uint64_t lastMicros = 0;
+};
+
+// Metric history per node, compressed the way Gorilla (Pelkonen et al., VLDB 2015)
+// does it: within a block, timestamps are stored as delta-of-deltas and values as the
+// XOR with the previous value, so a regular 1 Hz series with slowly moving values costs
+// a few bits per sample. Each series is a chain of sealed, immutable blocks plus one open
+// block. When the store grows past its memory budget it drops the oldest sealed blocks,
+// whichever series they belong to.
+//
+// The budget is per store, and forShard() gives every shard a store of its own, so a
+// node's total is the budget times the shard count. It is also soft: open blocks and
+// the per-node and per-series bookkeeping are never evicted, since appends need them,
+// so with enough series the store stays over budget by up to that much until blocks seal.
+//
+// Thread-safe. An append holds its series' lock for one encode; a read holds it only
+// long enough to copy the open block and take references to the sealed ones, and
+// decodes after releasing it, so reads do not stall appends.
+class TimeSeriesStore {
+public:
+    static constexpr size_t DEFAULT_MEMORY_BUDGET = size_t(256) << 20;
+    static constexpr uint32_t BLOCK_SAMPLES = 120; // Two minutes at 1 Hz
+
+    // memoryBudgetBytes bounds what eviction aims for; see above for what it cannot evict
+    explicit TimeSeriesStore(size_t memoryBudgetBytes = DEFAULT_MEMORY_BUDGET);
+    ~TimeSeriesStore();
+
+    TimeSeriesStore(const TimeSeriesStore&) = delete;
+    TimeSeriesStore& operator=(const TimeSeriesStore&) = delete;
+
+    // The calling shard's store, with DEFAULT_MEMORY_BUDGET to itself
+    static TimeSeriesStore& forShard();
+
+    // Every present slot of frame at frame.timestampMicros. A sample not newer than the
+    // last one stored for its series is dropped, so series stay in time order.
+    void append(const std::string& node, const MetricFrame& frame);
+
+    // Samples with fromMicros <= timestamp <= toMicros, oldest first
+    std::vector<TimeSeriesPoint> range(const std::string& node, MetricId id, unsigned int gpu,
+                                       uint64_t fromMicros, uint64_t toMicros) const;
+    // Over the same samples; blocks wholly inside the range are taken from their
+    // summaries rather than decoded
+    TimeSeriesSummary aggregate(const std::string& node, MetricId id, unsigned int gpu,
+                                uint64_t fromMicros, uint64_t toMicros) const;
+    // The samples of range(), appended to batch
+    void read(const std::string& node, MetricId id, unsigned int gpu, uint64_t fromMicros, uint64_t toMicros,
+              ColumnBatch& batch) const;
+
+    // Every node that has been appended
+    std::vector<std::string> nodeNames() const;
+
+    size_t memoryUsed() const { return bytes.load(std::memory_order_relaxed); } // May exceed memoryBudget()
+    size_t memoryBudget() const { return budget; }
+    uint64_t samples() const { return stored.load(std::memory_order_relaxed); }
+    uint64_t evictedBlocks() const { return evicted.load(std::memory_order_relaxed); }
+
+private:
+    struct Block;
+    struct Series;
+    struct Node;
+
+    Series* find(const std::string& node, size_t slot) const;
+    void evictIfOverBudget();
+
+    // Calls visit(millis, value) for every sample in the range, except in blocks for which
+    // visitWhole(block, fromMillis, toMillis) returns true
+    template<typename Visit, typename VisitWhole>
+    void scan(const std::string& node, MetricId id, unsigned int gpu, uint64_t fromMicros, uint64_t toMicros,
+              Visit visit, VisitWhole visitWhole) const;
+    template<typename Visit>
+    void scan(const std::string& node, MetricId id, unsigned int gpu, uint64_t fromMicros, uint64_t toMicros,
+              Visit visit) const;
+
+    const size_t budget;
+    std::atomic<size_t> bytes{0};
+    std::atomic<uint64_t> stored{0};
+    std::atomic<uint64_t> evicted{0};
+
+    mutable std::shared_mutex nodesMutex;
+    std::unordered_map<std::string, std::unique_ptr<Node>> nodes;
+
+    // Sealed blocks in the order they were sealed, which is oldest first
+    std::mutex sealedMutex;
+    std::deque<Series*> sealedOrder;
+};
+
+#endif // TIME_SERIES_STORE_H
@@ -0,0 +1,285 @@
+#include "AsyncPgProbe.h"
+#include <cstdlib>
+#include <fcntl.h>
+#include <map>
+#include <stdexcept>
+#include <seastar/core/posix.hh>
+#include <seastar/core/sleep.hh>
+#include <seastar/core/thread.hh>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+    using ResultPtr = std::unique_ptr<PGresult, decltype(&PQclear)>;
+
+    // Sent together; the order fixes the result indices read in roundTrip()
+    constexpr const char* PROBE_QUERIES[] = {
+        "SELECT 1",
+        "SELECT xact_commit + xact_rollback FROM pg_stat_database WHERE datname = current_database()",
+        "SELECT sum(blks_hit) / nullif(sum(blks_hit) + sum(blks_read), 0)::float, "
+            "sum(numbackends) / count(*)::float FROM pg_stat_database",
+        // Through jsonb so columns moved to pg_stat_checkpointer in PostgreSQL 17 read as NULL
+        // instead of failing the whole pipeline
+        "SELECT (to_jsonb(b) ->> 'buffers_checkpoint')::float, (to_jsonb(b) ->> 'buffers_clean')::float, "
+            "(to_jsonb(b) ->> 'buffers_backend')::float FROM pg_stat_bgwriter b",
+    };
+    constexpr size_t PROBE_COUNT = sizeof(PROBE_QUERIES) / sizeof(PROBE_QUERIES[0]);
+
+    double value(const PGresult* result, int column) {
+        if (PQntuples(result) == 0 || PQgetisnull(result, 0, column)) {
+            return 0.0;
+        }
+        return std::strtod(PQgetvalue(result, 0, column), nullptr);
+    }
+
+    double secondsBetween(Clock::time_point from, Clock::time_point to) {
+        return std::chrono::duration<double>(to - from).count();
+    }
+}
+
+AsyncPgProbe::AsyncPgProbe(std::string uri) : uri(std::move(uri)) {}
+
+AsyncPgProbe::~AsyncPgProbe() {
+    disconnect();
+}
+
+AsyncPgProbe& AsyncPgProbe::forShard(const std::string& uri) {
+    // Shards are threads, and a reactor may only wait on sockets it registered itself
+    static thread_local std::map<std::string, std::unique_ptr<AsyncPgProbe>> probes;
+    auto& probe = probes[uri];
+    if (!probe) {
+        probe = std::make_unique<AsyncPgProbe>(uri);
+    }
+    return *probe;
+}
+
+void AsyncPgProbe::watchSocket() {
+    int fd = PQsocket(conn);
+    if (fd == watchedSocket) {
+        return;
+    }
+    socket.reset();
+    watchedSocket = -1;
+    if (fd < 0) {
+        return;
+    }
+
+    // The reactor owns and closes what it is given, so it gets a duplicate; libpq keeps the original
+    int copy = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (copy < 0) {
+        throw std::runtime_error("Failed to duplicate PostgreSQL socket");
+    }
+    socket = std::make_unique<seastar::pollable_fd>(seastar::file_desc::from_fd(copy));
+    watchedSocket = fd;
+}
+
+void AsyncPgProbe::disconnect() {
+    socket.reset(); // Unregister before libpq closes the socket
+    watchedSocket = -1;
+    if (conn) {
+        PQfinish(conn);
+        conn = nullptr;
+    }
+    connectSeconds.reset();
+}
+
+void AsyncPgProbe::connect() {
+    auto start = Clock::now();
+    conn = PQconnectStart(uri.c_str());
+    if (!conn || PQstatus(conn) == CONNECTION_BAD) {
+        disconnect();
+        throw std::runtime_error("Failed to connect to PostgreSQL");
+    }
+
+    // Per the libpq docs, start as if PQconnectPoll had asked for a writable socket
+    PostgresPollingStatusType status = PGRES_POLLING_WRITING;
+    while (status != PGRES_POLLING_OK) {
+        watchSocket(); // libpq opens a new socket for each host it tries
+        if (status == PGRES_POLLING_READING) {
+            socket->readable().get();
+        } else if (status == PGRES_POLLING_WRITING) {
+            socket->writeable().get();
+        }
+
+        status = PQconnectPoll(conn);
+        if (status == PGRES_POLLING_FAILED) {
+            std::string message = PQerrorMessage(conn);
+            disconnect();
+            throw std::runtime_error("Failed to connect to PostgreSQL: " + message);
+        }
+    }
+    watchSocket();
+
+    if (PQsetnonblocking(conn, 1) != 0) {
+        disconnect();
+        throw std::runtime_error("Failed to make the PostgreSQL connection non-blocking");
+    }
+#ifdef LIBPQ_HAS_PIPELINING
+    if (!PQenterPipelineMode(conn)) {
+        disconnect();
+        throw std::runtime_error("Failed to enter PostgreSQL pipeline mode");
+    }
+#endif
+    connectSeconds = secondsBetween(start, Clock::now());
+}
+
+void AsyncPgProbe::flush() {
+    for (;;) {
+        int pending = PQflush(conn);
+        if (pending < 0) {
+            throw std::runtime_error("Failed to send PostgreSQL probe: " + std::string(PQerrorMessage(conn)));
+        }
+        if (pending == 0) {
+            return;
+        }
+        socket->writeable().get();
+    }
+}
+
+PGresult* AsyncPgProbe::nextResult() {
+    for (;;) {
+        if (!PQconsumeInput(conn)) {
+            throw std::runtime_error("Lost PostgreSQL connection: " + std::string(PQerrorMessage(conn)));
+        }
+        if (!PQisBusy(conn)) {
+            return PQgetResult(conn);
+        }
+        socket->readable().get();
+    }
+}
+
+PgProbeSnapshot AsyncPgProbe::roundTrip() {
+    std::vector<ResultPtr> results;
+    results.reserve(PROBE_COUNT);
+
+    auto sentAt = Clock::now();
+    Clock::time_point firstResultAt;
+
+#ifdef LIBPQ_HAS_PIPELINING
+    for (const char* sql : PROBE_QUERIES) {
+        // Pipeline mode only allows the extended query protocol
+        if (!PQsendQueryParams(conn, sql, 0, nullptr, nullptr, nullptr, nullptr, 0)) {
+            throw std::runtime_error("Failed to queue PostgreSQL probe: " + std::string(PQerrorMessage(conn)));
+        }
+    }
+    if (!PQpipelineSync(conn)) {
+        throw std::runtime_error("Failed to sync PostgreSQL pipeline: " + std::string(PQerrorMessage(conn)));
+    }
+    flush();
+
+    // Each query yields its result followed by a null, then the sync point reports
+    for (size_t i = 0; i < PROBE_COUNT; ++i) {
+        results.emplace_back(nextResult(), &PQclear);
+        if (i == 0) {
+            firstResultAt = Clock::now();
+        }
+        ResultPtr terminator(nextResult(), &PQclear);
+        if (terminator) {
+            throw std::runtime_error("Unexpected extra result in PostgreSQL pipeline");
+        }
+    }
+    ResultPtr sync(nextResult(), &PQclear);
+    if (!sync || PQresultStatus(sync.get()) != PGRES_PIPELINE_SYNC) {
+        throw std::runtime_error("PostgreSQL pipeline did not reach its sync point");
+    }
+#else
+    // Without pipelining, one multi-statement query still makes a single round trip
+    std::string combined;
+    for (const char* sql : PROBE_QUERIES) {
+        combined += sql;
+        combined += ";";
+    }
+    if (!PQsendQuery(conn, combined.c_str())) {
+        throw std::runtime_error("Failed to send PostgreSQL probe: " + std::string(PQerrorMessage(conn)));
+    }
+    flush();
+    while (PGresult* result = nextResult()) {
+        if (results.empty()) {
+            firstResultAt = Clock::now();
+        }
+        results.emplace_back(result, &PQclear);
+    }
+    if (results.size() != PROBE_COUNT) {
+        throw std::runtime_error("PostgreSQL probe returned an unexpected number of results");
+    }
+#endif
+
+    for (const auto& result : results) {
+        if (!result || PQresultStatus(result.get()) != PGRES_TUPLES_OK) {
+            throw std::runtime_error("PostgreSQL probe query failed: " +
+                                     std::string(result ? PQresultErrorMessage(result.get()) : "no result"));
+        }
+    }
+
+    PgProbeSnapshot snapshot;
+    snapshot.takenAt = Clock::now();
+    snapshot.latencySeconds = secondsBetween(sentAt, firstResultAt);
+    snapshot.transactions = value(results[1].get(), 0);
+    snapshot.cacheHitRatio = value(results[2].get(), 0);
+    snapshot.poolUtilization = value(results[2].get(), 1);
+    snapshot.buffersCheckpoint = value(results[3].get(), 0);
+    snapshot.buffersClean = value(results[3].get(), 1);
+    snapshot.buffersBackend = value(results[3].get(), 2);
+    return snapshot;
+}
+
+seastar::future<PgProbeSnapshot> AsyncPgProbe::probe() {
+    return seastar::with_semaphore(inFlight, 1, [this] {
+        return seastar::async([this] {
+            try {
+                if (!conn || PQstatus(conn) != CONNECTION_OK) {
+                    disconnect();
+                    connect();
+                }
+                PgProbeSnapshot snapshot = roundTrip();
+                last = snapshot;
+                return snapshot;
+            } catch (...) {
+                // A half-read pipeline cannot be resumed; start clean next time
+                disconnect();
+                throw;
+            }
+        });
+    });
+}
+
+seastar::future<double> AsyncPgProbe::queryLatency() {
+    return probe().then([](PgProbeSnapshot snapshot) {
+        return snapshot.latencySeconds;
+    });
+}
+
+seastar::future<double> AsyncPgProbe::cacheHitRatio() {
+    return probe().then([](PgProbeSnapshot snapshot) {
+        return snapshot.cacheHitRatio;
+    });
+}
+
+seastar::future<double> AsyncPgProbe::poolUtilization() {
+    return probe().then([](PgProbeSnapshot snapshot) {
+        return snapshot.poolUtilization;
+    });
+}
+
+seastar::future<double> AsyncPgProbe::transactionRate() {
+    auto rate = [](const PgProbeSnapshot& from, const PgProbeSnapshot& to) {
+        double elapsed = secondsBetween(from.takenAt, to.takenAt);
+        if (elapsed <= 0.0 || to.transactions < from.transactions) {
+            return 0.0; // Counters reset by a server restart
+        }
+        return (to.transactions - from.transactions) / elapsed;
+    };
+
+    // Every probe refreshes the baseline, so only the very first call has to wait
+    if (last) {
+        return probe().then([rate, baseline = *last](PgProbeSnapshot current) {
+            return rate(baseline, current);
+        });
+    }
+    return probe().then([this, rate](PgProbeSnapshot first) {
+        return seastar::sleep(std::chrono::seconds(1)).then([this, rate, first] {
+            return probe().then([rate, first](PgProbeSnapshot second) {
+                return rate(first, second);
+            });
+        });
+    });
+}
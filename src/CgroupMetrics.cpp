@@ -0,0 +1,276 @@
+#include "CgroupMetrics.h"
+#include <algorithm>
+#include <dirent.h>
+#include <limits>
+#include <stdexcept>
+#include <sys/sysinfo.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+    // Mount point of the unified (v2) hierarchy, from /proc/self/mountinfo
+    const std::string& cgroupMountPoint() {
+        static const std::string mountPoint = [] {
+            ProcReader mountinfo("/proc/self/mountinfo");
+            ProcScanner scanner(mountinfo.read());
+            do {
+                // id parent major:minor root mountpoint options... - fstype source superoptions
+                scanner.skipTokens(4);
+                std::string_view point = scanner.token();
+                std::string_view rest = scanner.restOfLine();
+                if (rest.find(" - cgroup2 ") != std::string_view::npos) {
+                    return std::string(point);
+                }
+            } while (scanner.nextLine());
+            return std::string("/sys/fs/cgroup");
+        }();
+        return mountPoint;
+    }
+
+    // Single-value files hold a number or "max" for no limit
+    uint64_t parseValue(std::string_view contents) {
+        if (contents.compare(0, 3, "max") == 0) {
+            return std::numeric_limits<uint64_t>::max();
+        }
+        uint64_t value = 0;
+        ProcScanner(contents).parseUnsigned(value);
+        return value;
+    }
+
+    // Parses "key value" lines (cpu.stat, memory.events) and hands each pair to assign
+    template<typename Assign>
+    void readKeyValues(ProcReader& file, Assign assign) {
+        ProcScanner scanner(file.read());
+        do {
+            std::string_view key = scanner.token();
+            uint64_t value;
+            if (!key.empty() && scanner.parseUnsigned(value)) {
+                assign(key, value);
+            }
+        } while (scanner.nextLine());
+    }
+}
+
+CgroupMetrics::CgroupMetrics(std::string cgroupPath)
+    : cgroupPath(cgroupPath),
+      cpuStatFile(cgroupPath + "/cpu.stat"),
+      cpuMaxFile(cgroupPath + "/cpu.max"),
+      memoryCurrentFile(cgroupPath + "/memory.current"),
+      memoryMaxFile(cgroupPath + "/memory.max"),
+      memoryEventsFile(cgroupPath + "/memory.events"),
+      ioStatFile(cgroupPath + "/io.stat"),
+      cpuPressureFile(cgroupPath + "/cpu.pressure"),
+      memoryPressureFile(cgroupPath + "/memory.pressure"),
+      ioPressureFile(cgroupPath + "/io.pressure") {}
+
+std::string CgroupMetrics::resolveCgroup(pid_t pid) {
+    ProcReader cgroupFile("/proc/" + std::to_string(pid) + "/cgroup");
+    std::string_view contents;
+    if (!cgroupFile.tryRead(contents)) {
+        throw std::runtime_error("Failed to read /proc/" + std::to_string(pid) + "/cgroup");
+    }
+
+    ProcScanner scanner(contents);
+    do {
+        std::string_view line = scanner.restOfLine();
+        if (line.compare(0, 3, "0::") == 0) {
+            std::string_view relative = line.substr(3);
+            return relative == "/" ? cgroupMountPoint() : cgroupMountPoint() + std::string(relative);
+        }
+    } while (scanner.nextLine());
+
+    throw std::runtime_error("Process " + std::to_string(pid) + " is not in a cgroup v2 hierarchy");
+}
+
+CgroupMetrics CgroupMetrics::forProcess(pid_t pid) {
+    return CgroupMetrics(resolveCgroup(pid));
+}
+
+pid_t CgroupMetrics::findProcess(const std::string& processName) {
+    DIR* proc = opendir("/proc");
+    if (!proc) {
+        throw std::runtime_error("Failed to open /proc");
+    }
+
+    pid_t found = -1;
+    while (dirent* entry = readdir(proc)) {
+        if (entry->d_name[0] < '0' || entry->d_name[0] > '9') {
+            continue;
+        }
+
+        ProcReader commFile(std::string("/proc/") + entry->d_name + "/comm");
+        std::string_view comm;
+        if (commFile.tryRead(comm) && ProcScanner(comm).restOfLine() == processName) {
+            found = static_cast<pid_t>(std::stol(entry->d_name));
+            break;
+        }
+    }
+
+    closedir(proc);
+    return found;
+}
+
+CgroupCpuStat CgroupMetrics::cpuStat() {
+    CgroupCpuStat stat;
+    readKeyValues(cpuStatFile, [&stat](std::string_view key, uint64_t value) {
+        if (key == "usage_usec") {
+            stat.usageUsec = value;
+        } else if (key == "user_usec") {
+            stat.userUsec = value;
+        } else if (key == "system_usec") {
+            stat.systemUsec = value;
+        } else if (key == "nr_periods") {
+            stat.nrPeriods = value;
+        } else if (key == "nr_throttled") {
+            stat.nrThrottled = value;
+        } else if (key == "throttled_usec") {
+            stat.throttledUsec = value;
+        }
+    });
+    return stat;
+}
+
+uint64_t CgroupMetrics::memoryCurrent() {
+    return parseValue(memoryCurrentFile.read());
+}
+
+uint64_t CgroupMetrics::memoryMax() {
+    std::string_view contents;
+    if (!memoryMaxFile.tryRead(contents)) {
+        return std::numeric_limits<uint64_t>::max(); // The root cgroup has no memory.max
+    }
+    return parseValue(contents);
+}
+
+CgroupMemoryEvents CgroupMetrics::memoryEvents() {
+    CgroupMemoryEvents events;
+    readKeyValues(memoryEventsFile, [&events](std::string_view key, uint64_t value) {
+        if (key == "low") {
+            events.low = value;
+        } else if (key == "high") {
+            events.high = value;
+        } else if (key == "max") {
+            events.max = value;
+        } else if (key == "oom") {
+            events.oom = value;
+        } else if (key == "oom_kill") {
+            events.oomKill = value;
+        }
+    });
+    return events;
+}
+
+CgroupIoStat CgroupMetrics::ioStat() {
+    // One line per device: "8:0 rbytes=1 wbytes=2 rios=3 wios=4 dbytes=0 dios=0"
+    CgroupIoStat stat;
+    ProcScanner scanner(ioStatFile.read());
+    do {
+        scanner.token(); // major:minor
+        for (std::string_view field = scanner.token(); !field.empty(); field = scanner.token()) {
+            auto equals = field.find('=');
+            if (equals == std::string_view::npos) {
+                continue;
+            }
+            uint64_t value = 0;
+            ProcScanner(field.substr(equals + 1)).parseUnsigned(value);
+
+            std::string_view key = field.substr(0, equals);
+            if (key == "rbytes") {
+                stat.rbytes += value;
+            } else if (key == "wbytes") {
+                stat.wbytes += value;
+            } else if (key == "rios") {
+                stat.rios += value;
+            } else if (key == "wios") {
+                stat.wios += value;
+            }
+        }
+    } while (scanner.nextLine());
+    return stat;
+}
+
+PressureStats CgroupMetrics::cpuPressure() {
+    return parsePressure(cpuPressureFile.read());
+}
+
+PressureStats CgroupMetrics::memoryPressure() {
+    return parsePressure(memoryPressureFile.read());
+}
+
+PressureStats CgroupMetrics::ioPressure() {
+    return parsePressure(ioPressureFile.read());
+}
+
+double CgroupMetrics::allowedCpus() {
+    double onlineCpus = static_cast<double>(sysconf(_SC_NPROCESSORS_ONLN));
+
+    // cpu.max is "<quota> <period>" or "max <period>"; absent in the root cgroup
+    std::string_view contents;
+    if (!cpuMaxFile.tryRead(contents)) {
+        return onlineCpus;
+    }
+    ProcScanner scanner(contents);
+    uint64_t quota, period;
+    if (!scanner.parseUnsigned(quota) || !scanner.parseUnsigned(period) || period == 0) {
+        return onlineCpus;
+    }
+    return std::min(onlineCpus, static_cast<double>(quota) / static_cast<double>(period));
+}
+
+double CgroupMetrics::cpuUtilization() {
+    uint64_t usage = cpuStat().usageUsec;
+    auto now = std::chrono::steady_clock::now();
+    // The first call only takes the baseline; waiting for a second sample would block the caller
+    if (lastCpuSampleAt == std::chrono::steady_clock::time_point{}) {
+        lastCpuUsageUsec = usage;
+        lastCpuSampleAt = now;
+        return 0.0;
+    }
+
+    double elapsedUsec = std::chrono::duration<double, std::micro>(now - lastCpuSampleAt).count();
+    double delta = static_cast<double>(usage - lastCpuUsageUsec);
+
+    lastCpuUsageUsec = usage;
+    lastCpuSampleAt = now;
+
+    if (elapsedUsec <= 0.0) {
+        return 0.0;
+    }
+    return delta / (elapsedUsec * allowedCpus()) * 100.0;
+}
+
+double CgroupMetrics::memoryUtilization() {
+    uint64_t limit = memoryMax();
+    if (limit == std::numeric_limits<uint64_t>::max()) {
+        struct sysinfo memInfo;
+        sysinfo(&memInfo);
+        limit = static_cast<uint64_t>(memInfo.totalram) * memInfo.mem_unit;
+    }
+    if (limit == 0) {
+        return 0.0;
+    }
+    return 100.0 * static_cast<double>(memoryCurrent()) / static_cast<double>(limit);
+}
+
+double CgroupMetrics::ioThroughput() {
+    auto totalBytes = [this] {
+        CgroupIoStat stat = ioStat();
+        return stat.rbytes + stat.wbytes;
+    };
+
+    uint64_t bytes = totalBytes();
+    auto now = std::chrono::steady_clock::now();
+    if (lastIoSampleAt == std::chrono::steady_clock::time_point{}) {
+        lastIoBytes = bytes;
+        lastIoSampleAt = now;
+        return 0.0;
+    }
+
+    double elapsed = std::chrono::duration<double>(now - lastIoSampleAt).count();
+    double delta = static_cast<double>(bytes - lastIoBytes);
+
+    lastIoBytes = bytes;
+    lastIoSampleAt = now;
+
+    return elapsed > 0.0 ? delta / 1024.0 / elapsed : 0.0; // KB/s
+}
@@ -0,0 +1,212 @@
+#include "DbProbePool.h"
+#include <chrono>
+#include <stdexcept>
+#include <scylladb-client/ScyllaDBClient.h>  // ScyllaDB
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    double secondsSince(Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+}
+
+struct DbProbePool::Entry {
+    std::mutex mutex;
+
+    mongoc_client_t* mongo = nullptr;
+    aerospike as;
+    bool aerospikeConnected = false;
+    std::unique_ptr<ScyllaDBClient> scylla;
+
+    std::optional<double> connectSeconds;
+
+    struct CounterSample {
+        Clock::time_point at;
+        double value;
+    };
+    std::map<std::string, CounterSample> counters;
+
+    ~Entry() {
+        disconnectMongo();
+        disconnectAerospike();
+        disconnectScylla();
+    }
+
+    // Counter baselines stay valid across reconnects: they are server-side totals
+    void disconnectMongo() {
+        if (mongo) {
+            mongoc_client_destroy(mongo);
+            mongo = nullptr;
+            connectSeconds.reset();
+        }
+    }
+
+    void disconnectAerospike() {
+        if (aerospikeConnected) {
+            as_error err;
+            aerospike_close(&as, &err);
+            aerospike_destroy(&as);
+            aerospikeConnected = false;
+            connectSeconds.reset();
+        }
+    }
+
+    void disconnectScylla() {
+        if (scylla) {
+            scylla.reset();
+            connectSeconds.reset();
+        }
+    }
+};
+
+bool DbProbePool::isConnectionError(const bson_error_t& error) {
+    return error.domain == MONGOC_ERROR_STREAM || error.domain == MONGOC_ERROR_SERVER_SELECTION;
+}
+
+bool DbProbePool::isConnectionError(as_status status) {
+    switch (status) {
+        case AEROSPIKE_ERR_CONNECTION:
+        case AEROSPIKE_ERR_TLS_ERROR:
+        case AEROSPIKE_ERR_INVALID_NODE:
+        case AEROSPIKE_ERR_NO_MORE_CONNECTIONS:
+        case AEROSPIKE_ERR_CLUSTER:
+            return true;
+        default:
+            return false;
+    }
+}
+
+DbProbePool& DbProbePool::instance() {
+    static DbProbePool pool;
+    return pool;
+}
+
+DbProbePool::DbProbePool() {
+    mongoc_init(); // Once per process, not per probe
+}
+
+DbProbePool::~DbProbePool() {
+    entries.clear();
+    mongoc_cleanup();
+}
+
+DbProbePool::Entry& DbProbePool::entry(const std::string& uri) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& slot = entries[uri];
+    if (!slot) {
+        slot = std::make_unique<Entry>();
+    }
+    return *slot;
+}
+
+void DbProbePool::withMongo(const std::string& uri, const std::function<void(mongoc_client_t*)>& probe) {
+    Entry& e = entry(uri);
+    std::lock_guard<std::mutex> lock(e.mutex);
+
+    if (!e.mongo) {
+        auto start = Clock::now();
+        mongoc_client_t* client = mongoc_client_new(uri.c_str());
+        if (!client) {
+            throw std::runtime_error("Failed to connect to MongoDB");
+        }
+
+        // The driver connects lazily; a ping forces server selection and the handshake
+        bson_t* ping = BCON_NEW("ping", BCON_INT32(1));
+        bson_error_t error;
+        bool ok = mongoc_client_command_simple(client, "admin", ping, NULL, NULL, &error);
+        bson_destroy(ping);
+        if (!ok) {
+            mongoc_client_destroy(client);
+            throw std::runtime_error("Failed to connect to MongoDB");
+        }
+        e.mongo = client;
+        e.connectSeconds = secondsSince(start);
+    }
+
+    try {
+        probe(e.mongo);
+    } catch (const ConnectionError&) {
+        e.disconnectMongo();
+        throw;
+    }
+}
+
+void DbProbePool::withAerospike(const std::string& uri, const std::function<void(aerospike*)>& probe) {
+    Entry& e = entry(uri);
+    std::lock_guard<std::mutex> lock(e.mutex);
+
+    if (!e.aerospikeConnected) {
+        auto start = Clock::now();
+        as_config config;
+        as_config_init(&config);
+        if (!as_config_add_hosts(&config, uri.c_str(), 3000)) {
+            throw std::runtime_error("Failed to add AerospikeDB host");
+        }
+
+        as_error err;
+        aerospike_init(&e.as, &config);
+        if (aerospike_connect(&e.as, &err) != AEROSPIKE_OK) {
+            aerospike_destroy(&e.as);
+            throw std::runtime_error("Failed to connect to AerospikeDB");
+        }
+        e.aerospikeConnected = true;
+        e.connectSeconds = secondsSince(start);
+    }
+
+    try {
+        probe(&e.as);
+    } catch (const ConnectionError&) {
+        e.disconnectAerospike();
+        throw;
+    }
+}
+
+void DbProbePool::withScylla(const std::string& uri, const std::function<void(ScyllaDBClient&)>& probe) {
+    Entry& e = entry(uri);
+    std::lock_guard<std::mutex> lock(e.mutex);
+
+    if (!e.scylla) {
+        auto start = Clock::now();
+        auto client = std::make_unique<ScyllaDBClient>();
+        if (!client->connect(uri)) {
+            throw std::runtime_error("Failed to connect to ScyllaDB");
+        }
+        e.scylla = std::move(client);
+        e.connectSeconds = secondsSince(start);
+    }
+
+    try {
+        probe(*e.scylla);
+    } catch (const ConnectionError&) {
+        e.disconnectScylla();
+        throw;
+    }
+}
+
+std::optional<double> DbProbePool::connectLatency(const std::string& uri) {
+    Entry& e = entry(uri);
+    std::lock_guard<std::mutex> lock(e.mutex);
+    return e.connectSeconds;
+}
+
+std::optional<double> DbProbePool::counterRate(const std::string& uri, const std::string& counter, double value) {
+    Entry& e = entry(uri);
+    std::lock_guard<std::mutex> lock(e.mutex);
+
+    auto now = Clock::now();
+    auto it = e.counters.find(counter);
+    if (it == e.counters.end()) {
+        e.counters.emplace(counter, Entry::CounterSample{now, value});
+        return std::nullopt;
+    }
+
+    Entry::CounterSample previous = it->second;
+    it->second = {now, value};
+
+    double elapsed = std::chrono::duration<double>(now - previous.at).count();
+    if (value < previous.value || elapsed <= 0.0) {
+        return std::nullopt; // The server restarted and its counters reset
+    }
+    return (value - previous.value) / elapsed;
+}
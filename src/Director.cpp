@@ -1,7 +1,19 @@
 #include "Director.h"
+#include <charconv>
+#include <cstdint>
 #include <iostream>
 #include <chrono>
 #include <ctime>
+#include <string_view>
+#include <unistd.h>
+#include <seastar/core/loop.hh>
+#include <seastar/core/smp.hh>
+
+namespace {
+    constexpr auto MONITOR_INTERVAL = std::chrono::seconds(10);
+    // Unprivileged PSI triggers need a window that is a multiple of 2s
+    constexpr auto STALL_WINDOW = std::chrono::seconds(2);
+}
 
 Director::Director()
     : ganCodirector(), mpiController(), systemResources() {
@@ -9,6 +21,7 @@ Director::Director()
     tbbAvailable = SystemResources::isTbbAvailable();
     cudaAvailable = SystemResources::hasNvidiaGpu();
     isLeader = false;
+    leaderRank = -1;
 
     zkHandle = zookeeper_init("localhost:2181", watcher, 2000, 0, this, 0);
     if (!zkHandle) {
@@ -19,10 +32,116 @@ Director::Director()
 
 seastar::future<> Director::initialize() {
     return seastar::async([this] {
+        // Every rank builds the rank directory here, in step, and answers targeted queries
+        MPIController::initialize();
+        MPIController::buildDirectory().get();
+        MPIController::serveQueries().get();
+        // Other hosts' stalls arrive as queries, answered on MPI_SHARD
+        seastar::smp::submit_to(MPIController::MPI_SHARD, [this] {
+            MPIController::onStallReport([this](const std::string&) {
+                if (isLeader) {
+                    stallWakeup.signal();
+                }
+            });
+        }).get();
+        startStallWatch();
+        startMetricsExporter();
+        startArchive();
         checkLeadership();
     });
 }
 
+void Director::startStallWatch() {
+    // One set of triggers per host, however many ranks it runs
+    if (MPIController::rankOf(MPIController::localIp()) != MPIController::localRank()) {
+        return;
+    }
+
+    auto addTrigger = [this](PressureResource resource, PressureMonitor::StallKind kind, std::chrono::milliseconds stall) {
+        try {
+            pressureMonitor.addTrigger(resource, kind, stall, STALL_WINDOW);
+            return true;
+        } catch (const std::runtime_error& e) {
+            std::cerr << "PSI trigger unavailable: " << e.what() << std::endl;
+            return false;
+        }
+    };
+
+    bool cpu = addTrigger(PressureResource::Cpu, PressureMonitor::StallKind::Some, std::chrono::milliseconds(200));
+    bool memory = addTrigger(PressureResource::Memory, PressureMonitor::StallKind::Full, std::chrono::milliseconds(100));
+    bool io = addTrigger(PressureResource::Io, PressureMonitor::StallKind::Full, std::chrono::milliseconds(200));
+    if (!cpu && !memory && !io) {
+        return; // Fall back to the fixed monitoring interval
+    }
+
+    pressureMonitor.start(stallEvents.get_write_fd());
+
+    // The monitor thread writes to the eventfd; the reactor picks it up without blocking
+    stallWatch = seastar::do_until([this] { return stallWatchAbort.abort_requested(); }, [this] {
+        return stallEvents.wait().then([this](size_t) {
+            return stallWatchAbort.abort_requested() ? seastar::make_ready_future<>() : onStall();
+        });
+    });
+}
+
+seastar::future<> Director::onStall() {
+    if (isLeader) {
+        stallWakeup.signal();
+        return seastar::make_ready_future<>();
+    }
+    if (leaderRank < 0) {
+        return seastar::make_ready_future<>();
+    }
+    return MPIController::reportStall(leaderRank).handle_exception([](std::exception_ptr) {
+        // The leader still ticks on its interval
+    });
+}
+
+seastar::future<> Director::stop() {
+    stallWatchAbort.request_abort();
+    pressureMonitor.stop();
+    // Wakes the watch loop so it sees the abort
+    uint64_t one = 1;
+    ssize_t ignored = write(stallEvents.get_write_fd(), &one, sizeof(one));
+    (void)ignored;
+
+    seastar::future<> watched = stallWatch ? std::move(*stallWatch) : seastar::make_ready_future<>();
+    stallWatch.reset();
+    return watched.then([] {
+        return seastar::smp::submit_to(MPIController::MPI_SHARD, [] {
+            MPIController::onStallReport(nullptr);
+        });
+    }).then([this] {
+        return metricsExporter.stop();
+    }).then([] {
+        return MPIController::stopServing();
+    });
+}
+
+void Director::startMetricsExporter() {
+    try {
+        metricsExporter.start().get();
+    } catch (const std::exception& e) {
+        // Monitoring and scaling carry on unscraped
+        std::cerr << "Metrics endpoint unavailable: " << e.what() << std::endl;
+    }
+}
+
+void Director::startArchive() {
+    try {
+        MetricArchiveWriter::openShared();
+    } catch (const std::exception& e) {
+        // Frames still reach the in-memory history and the scaling decisions
+        std::cerr << "Metric archive unavailable: " << e.what() << std::endl;
+    }
+}
+
+seastar::future<> Director::waitForNextTick() {
+    return stallWakeup.wait(MONITOR_INTERVAL).handle_exception_type([](const seastar::condition_variable_timed_out&) {
+        // Regular tick; no stall was reported in this interval
+    });
+}
+
 seastar::future<> Director::nodeController() {
     if (isLeader) {
         return monitorNodes().then([this] {
@@ -37,12 +156,12 @@ seastar::future<> Director::nodeController() {
 
 seastar::future<> Director::monitorNodes() {
     return seastar::repeat([this] {
-        return nodeManager.monitorNodes().then([] {
+        return nodeManager.monitorNodes().then([this] {
             seastar::print("Monitoring nodes completed.\n");
-            return seastar::sleep(std::chrono::seconds(10)); // Adjust the interval as needed
-        }).handle_exception([](std::exception_ptr ex) {
+            return waitForNextTick(); // Returns early when a PSI trigger fires
+        }).handle_exception([this](std::exception_ptr ex) {
             seastar::print("Error during monitoring: %s\n", seastar::current_exception_as_string().c_str());
-            return seastar::sleep(std::chrono::seconds(10)); // Adjust the interval as needed
+            return waitForNextTick();
         }).then([] {
             return seastar::stop_iteration::no;
         });
@@ -50,16 +169,32 @@ seastar::future<> Director::monitorNodes() {
 }
 
 void Director::checkLeadership() {
-    int rc = zoo_create(zkHandle, "/director/leader", ipAddress.c_str(), ipAddress.size(),
+    // The leader's IP address and MPI rank, so followers know where to report stalls
+    std::string leader = ipAddress + " " + std::to_string(MPIController::localRank());
+    int rc = zoo_create(zkHandle, "/director/leader", leader.c_str(), leader.size(),
                         &ZOO_OPEN_ACL_UNSAFE, ZOO_EPHEMERAL, nullptr, 0);
     if (rc == ZOK) {
         std::cout << "I am the leader" << std::endl;
         isLeader = true;
+        leaderRank = -1;
         nodeController();
     } else {
         std::cout << "I am a follower" << std::endl;
         isLeader = false;
         rc = zoo_wexists(zkHandle, "/director/leader", watcher, this, nullptr);
+
+        char current[128] = {};
+        int length = sizeof(current) - 1;
+        leaderRank = -1;
+        if (zoo_get(zkHandle, "/director/leader", 0, current, &length, nullptr) == ZOK && length > 0) {
+            std::string_view data(current, length);
+            size_t space = data.rfind(' ');
+            int rank;
+            if (space != std::string_view::npos &&
+                std::from_chars(data.data() + space + 1, data.data() + data.size(), rank).ec == std::errc()) {
+                leaderRank = rank;
+            }
+        }
     }
 }
 
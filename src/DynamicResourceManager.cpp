@@ -1,18 +1,11 @@
 #include "DynamicResourceManager.h"
+#include "GpuBackend.h"
+#include "MPIController.h"
 #include <iostream>
-#include <mpi.h>
 #include <algorithm>
 #include <chrono>
 #include <thread>
 
-DynamicResourceManager::DynamicResourceManager() {
-    initNVML();
-}
-
-DynamicResourceManager::~DynamicResourceManager() {
-    shutdownNVML();
-}
-
 double DynamicResourceManager::gpuUsage() {
     // Aggregate GPU usage from all instances
     double totalGpuUsage = 0.0;
@@ -22,34 +15,8 @@ double DynamicResourceManager::gpuUsage() {
     return totalGpuUsage;
 }
 
-void DynamicResourceManager::initNVML() {
-    nvmlReturn_t result = nvmlInit();
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to initialize NVML: " + std::string(nvmlErrorString(result)));
-    }
-}
-
-void DynamicResourceManager::shutdownNVML() {
-    nvmlReturn_t result = nvmlShutdown();
-    if (NVML_SUCCESS != result) {
-        std::cerr << "Failed to shutdown NVML: " + std::string(nvmlErrorString(result)) << std::endl;
-    }
-}
-
 double DynamicResourceManager::gpuTemperature(int instanceId) {
-    nvmlDevice_t device;
-    nvmlReturn_t result = nvmlDeviceGetHandleByIndex(deviceIndex, &device);
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to get handle for device " + std::to_string(deviceIndex) + ": " + std::string(nvmlErrorString(result)));
-    }
-
-    unsigned int temperature;
-    result = nvmlDeviceGetTemperature(device, NVML_TEMPERATURE_GPU, &temperature);
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to get temperature for device " + std::to_string(deviceIndex) + ": " + std::string(nvmlErrorString(result)));
-    }
-
-    return static_cast<double>(temperature);
+    return static_cast<double>(GpuBackend::instance().temperature(instanceId));
 }
 
 double DynamicResourceManager::cpuUsage(int instanceId) {
@@ -111,10 +78,10 @@ void DynamicResourceManager::instanceTracker() {
 }
 
 void DynamicResourceManager::healthReporter(int instanceId) {
-    // Simulate gathering resource usage data via MPI
-    MPI_Init(NULL, NULL);
-    int world_rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    // Simulate gathering resource usage data via MPI. This runs on its own thread, so it
+    // makes no MPI calls of its own; MPI stays on MPIController::MPI_SHARD.
+    MPIController::initialize();
+    int world_rank = MPIController::localRank();
 
     // Replace the following with actual MPI communication logic
     gpuUsageMap[instanceId] = 30.0 + world_rank; // Simulated value
@@ -122,6 +89,4 @@ void DynamicResourceManager::healthReporter(int instanceId) {
     cpuUsageMap[instanceId] = 50.0 + world_rank; // Simulated value
     memoryUsageMap[instanceId] = 60.0 + world_rank; // Simulated value
     driveUsageMap[instanceId] = 40.0 + world_rank; // Simulated value
-
-    MPI_Finalize();
 }
@@ -0,0 +1,199 @@
+#include "GpuBackend.h"
+#include "MockGpuBackend.h"
+#include "NvmlGpuBackend.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable<GpuSample>::value, "GpuSample is copied as raw bytes");
+
+namespace {
+    void sampleInto(GpuBackend& backend, unsigned int index, GpuSample& out) {
+        try {
+            out = backend.sample(index);
+        } catch (const std::runtime_error&) {
+            // Left with valid == 0, e.g. a device that fell off the bus
+        }
+    }
+}
+
+// Threads that stay up between sweeps, one per device beyond the first; the sweeping
+// thread reads devices too. Sweeps from several threads take turns.
+class GpuBackend::SweepWorkers {
+public:
+    explicit SweepWorkers(GpuBackend& backend) : backend(backend) {}
+
+    ~SweepWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    // Fills every element of devices and returns once all of them are read
+    void sampleAll(std::vector<GpuSample>& devices) {
+        std::lock_guard<std::mutex> turn(sweeping);
+        std::unique_lock<std::mutex> lock(mutex);
+        while (threads.size() + 1 < devices.size()) {
+            threads.emplace_back([this] { work(); });
+        }
+        round = &devices;
+        nextDevice = 0;
+        outstanding = devices.size();
+        wakeup.notify_all();
+
+        sampleClaimed(lock);
+        finished.wait(lock, [this] { return outstanding == 0; });
+        round = nullptr;
+    }
+
+private:
+    // Reads devices of the current round until none is left unclaimed; mutex is held
+    // between reads only
+    void sampleClaimed(std::unique_lock<std::mutex>& lock) {
+        while (round && nextDevice < round->size()) {
+            unsigned int index = static_cast<unsigned int>(nextDevice++);
+            GpuSample& out = (*round)[index];
+            lock.unlock();
+            sampleInto(backend, index, out);
+            lock.lock();
+            if (--outstanding == 0) {
+                finished.notify_all();
+            }
+        }
+    }
+
+    void work() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wakeup.wait(lock, [this] { return stopping || (round && nextDevice < round->size()); });
+            if (stopping) {
+                return;
+            }
+            sampleClaimed(lock);
+        }
+    }
+
+    GpuBackend& backend;
+    std::mutex sweeping;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::condition_variable finished;
+    std::vector<std::thread> threads;
+    std::vector<GpuSample>* round = nullptr;
+    size_t nextDevice = 0;
+    size_t outstanding = 0;
+    bool stopping = false;
+};
+
+GpuBackend::GpuBackend() : sweepWorkers(std::make_unique<SweepWorkers>(*this)) {}
+
+GpuBackend::~GpuBackend() = default;
+
+GpuBackend& GpuBackend::instance() {
+    static std::unique_ptr<GpuBackend> backend = []() -> std::unique_ptr<GpuBackend> {
+        if (const char* script = std::getenv(MOCK_ENV)) {
+            return std::make_unique<MockGpuBackend>(script);
+        }
+        if (auto nvml = NvmlGpuBackend::load()) {
+            return nvml;
+        }
+        return std::make_unique<MockGpuBackend>(); // No driver: a node without GPUs
+    }();
+    return *backend;
+}
+
+double GpuSample::memoryUsedPercent() const {
+    return memoryTotal ? static_cast<double>(memoryUsed) / static_cast<double>(memoryTotal) * 100.0 : 0.0;
+}
+
+GpuSample GpuBackend::sample(unsigned int index) {
+    GpuSample sample;
+    // The temperature read doubles as the device check, so a bad index still throws
+    try {
+        sample.temperatureC = temperature(index);
+        sample.valid |= GpuSample::TEMPERATURE;
+    } catch (const std::runtime_error&) {
+        if (index >= deviceCount()) {
+            throw;
+        }
+    }
+
+    auto tryRead = [&](GpuSample::Field field, auto read) {
+        try {
+            read();
+            sample.valid |= field;
+        } catch (const std::runtime_error&) {
+        }
+    };
+    tryRead(GpuSample::UTILIZATION, [&] {
+        GpuUtilization rates = utilization(index);
+        sample.gpuUtilization = rates.gpu;
+        sample.memoryUtilization = rates.memory;
+    });
+    tryRead(GpuSample::MEMORY, [&] {
+        GpuMemoryInfo info = memory(index);
+        sample.memoryTotal = info.total;
+        sample.memoryUsed = info.used;
+    });
+    tryRead(GpuSample::POWER, [&] { sample.powerMilliwatts = powerUsage(index); });
+    tryRead(GpuSample::FAN, [&] { sample.fanPercent = fanSpeed(index); });
+    tryRead(GpuSample::CLOCKS, [&] {
+        sample.smClockMHz = clock(index, GpuClock::SM);
+        sample.memoryClockMHz = clock(index, GpuClock::MEMORY);
+    });
+    return sample;
+}
+
+GpuSweep GpuBackend::sweep() {
+    GpuSweep sweep;
+    unsigned int count;
+    try {
+        count = deviceCount();
+    } catch (const std::runtime_error&) {
+        return sweep;
+    }
+    sweep.devices.resize(count);
+
+    if (concurrentReads() && count > 1) {
+        sweepWorkers->sampleAll(sweep.devices);
+    } else {
+        for (unsigned int index = 0; index < count; ++index) {
+            sampleInto(*this, index, sweep.devices[index]);
+        }
+    }
+
+    unsigned int utilizationCount = 0;
+    double utilizationSum = 0.0;
+    uint64_t memoryTotal = 0, memoryUsed = 0;
+    for (const GpuSample& device : sweep.devices) {
+        if (device.has(GpuSample::TEMPERATURE)) {
+            sweep.maxTemperatureC = std::max(sweep.maxTemperatureC.value_or(0), device.temperatureC);
+        }
+        if (device.has(GpuSample::UTILIZATION)) {
+            double utilization = device.gpuUtilization;
+            sweep.minUtilization = std::min(sweep.minUtilization.value_or(utilization), utilization);
+            utilizationSum += utilization;
+            ++utilizationCount;
+        }
+        if (device.has(GpuSample::MEMORY)) {
+            memoryTotal += device.memoryTotal;
+            memoryUsed += device.memoryUsed;
+        }
+    }
+    if (utilizationCount) {
+        sweep.meanUtilization = utilizationSum / utilizationCount;
+    }
+    if (memoryTotal) {
+        sweep.memoryPressure = static_cast<double>(memoryUsed) / static_cast<double>(memoryTotal) * 100.0;
+    }
+    return sweep;
+}
@@ -0,0 +1,100 @@
+#include "GpuHistory.h"
+#include <stdexcept>
+#include <utility>
+
+namespace {
+    // Only the gauges an Interval reports; draining others would cost driver calls for nothing
+    constexpr GpuSampleType BUFFERED_TYPES[] = {
+        GpuSampleType::GPU_UTILIZATION,
+        GpuSampleType::POWER,
+    };
+}
+
+LatencyHistogram GpuHistory::Interval::utilization() const {
+    LatencyHistogram merged;
+    for (const Device& device : devices) {
+        merged.merge(device.utilization);
+    }
+    return merged;
+}
+
+LatencyHistogram GpuHistory::Interval::power() const {
+    LatencyHistogram merged;
+    for (const Device& device : devices) {
+        merged.merge(device.power);
+    }
+    return merged;
+}
+
+GpuHistory::GpuHistory(GpuBackend& backend) : backend(backend) {}
+
+GpuHistory& GpuHistory::instance() {
+    static GpuHistory history(GpuBackend::instance());
+    return history;
+}
+
+void GpuHistory::collect() {
+    unsigned int count;
+    try {
+        count = backend.deviceCount();
+    } catch (const std::runtime_error&) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (unsigned int index = 0; index < count; ++index) {
+        for (GpuSampleType type : BUFFERED_TYPES) {
+            Track& track = tracks[{index, type}];
+            std::vector<GpuTimedValue> samples;
+            try {
+                samples = backend.bufferedSamples(index, type, track.lastSeenMicros);
+            } catch (const std::runtime_error&) {
+                continue;
+            }
+            for (const GpuTimedValue& sample : samples) {
+                // The driver filters on the timestamp too; this guards against a buffer
+                // handed back whole after the timestamp fell out of it
+                if (sample.timestampMicros <= track.lastSeenMicros) {
+                    continue;
+                }
+                track.interval.record(sample.value);
+                track.lastSeenMicros = sample.timestampMicros;
+            }
+        }
+    }
+}
+
+std::shared_ptr<const GpuHistory::Interval> GpuHistory::latest(std::chrono::milliseconds maxAge) {
+    auto fresh = [this, maxAge] {
+        return closed && std::chrono::steady_clock::now() - closedAt < maxAge;
+    };
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (fresh()) {
+            return closed;
+        }
+    }
+    collect();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fresh()) {
+        // Another caller closed the tick meanwhile; what this collect() found opens the next
+        return closed;
+    }
+    auto interval = std::make_shared<Interval>();
+    for (auto& [key, track] : tracks) {
+        if (interval->devices.size() <= key.first) {
+            interval->devices.resize(key.first + 1);
+        }
+        Interval::Device& device = interval->devices[key.first];
+        // Swapped with the device's empty histogram, which then opens the track's next interval
+        if (key.second == GpuSampleType::GPU_UTILIZATION) {
+            std::swap(device.utilization, track.interval);
+        } else if (key.second == GpuSampleType::POWER) {
+            std::swap(device.power, track.interval);
+        }
+        track.interval.reset();
+    }
+    closed = std::move(interval);
+    closedAt = std::chrono::steady_clock::now();
+    return closed;
+}
@@ -0,0 +1,103 @@
+#include "GpuProcessAccounting.h"
+#include "CgroupMetrics.h"
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+uint64_t GpuProcessShare::memoryUsed() const {
+    uint64_t total = 0;
+    for (const GpuProcessUsage& device : devices) {
+        total += device.memoryUsed;
+    }
+    return total;
+}
+
+double GpuProcessShare::peakSmUtilization() const {
+    double peak = 0.0;
+    for (const GpuProcessUsage& device : devices) {
+        peak = std::max(peak, device.smUtilization);
+    }
+    return peak;
+}
+
+GpuProcessAccounting::GpuProcessAccounting(GpuBackend& backend) : backend(backend) {}
+
+GpuProcessAccounting& GpuProcessAccounting::instance() {
+    static GpuProcessAccounting accounting(GpuBackend::instance());
+    return accounting;
+}
+
+std::vector<GpuProcessShare> GpuProcessAccounting::collect(std::chrono::milliseconds maxAge) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto now = std::chrono::steady_clock::now();
+    if (collectedAt.time_since_epoch().count() != 0 && now - collectedAt < maxAge) {
+        return last;
+    }
+
+    unsigned int count;
+    try {
+        count = backend.deviceCount();
+    } catch (const std::runtime_error&) {
+        count = 0;
+    }
+    lastSampleMicros.resize(count, 0);
+
+    std::map<pid_t, GpuProcessShare> byPid;
+    for (unsigned int index = 0; index < count; ++index) {
+        std::vector<GpuProcessUsage> processes;
+        try {
+            processes = backend.processUsage(index, lastSampleMicros[index]);
+        } catch (const std::runtime_error&) {
+            continue; // Device gone or no per-process accounting on this driver
+        }
+        for (const GpuProcessUsage& usage : processes) {
+            GpuProcessShare& share = byPid[static_cast<pid_t>(usage.pid)];
+            share.pid = static_cast<pid_t>(usage.pid);
+            share.devices.push_back(usage);
+            lastSampleMicros[index] = std::max(lastSampleMicros[index], usage.lastSampleMicros);
+        }
+    }
+
+    last.clear();
+    last.reserve(byPid.size());
+    for (auto& [pid, share] : byPid) {
+        try {
+            share.cgroup = CgroupMetrics::resolveCgroup(pid);
+        } catch (const std::runtime_error&) {
+            // Exited since the driver listed it, or not in a v2 group; kept without a cgroup
+        }
+        last.push_back(std::move(share));
+    }
+    collectedAt = now;
+    return last;
+}
+
+GpuWorkloadUsage GpuProcessAccounting::forCgroup(const std::vector<GpuProcessShare>& shares, const std::string& cgroup) {
+    struct DeviceTotals {
+        double sm = 0.0, memory = 0.0, encoder = 0.0, decoder = 0.0;
+    };
+    std::map<unsigned int, DeviceTotals> perDevice;
+
+    GpuWorkloadUsage usage;
+    for (const GpuProcessShare& share : shares) {
+        if (share.cgroup.empty() || share.cgroup != cgroup) {
+            continue;
+        }
+        ++usage.processes;
+        for (const GpuProcessUsage& device : share.devices) {
+            usage.memoryUsed += device.memoryUsed;
+            DeviceTotals& totals = perDevice[device.device];
+            totals.sm += device.smUtilization;
+            totals.memory += device.memoryUtilization;
+            totals.encoder += device.encoderUtilization;
+            totals.decoder += device.decoderUtilization;
+        }
+    }
+    for (const auto& [device, totals] : perDevice) {
+        usage.smUtilization = std::max(usage.smUtilization, std::min(totals.sm, 100.0));
+        usage.memoryUtilization = std::max(usage.memoryUtilization, std::min(totals.memory, 100.0));
+        usage.encoderUtilization = std::max(usage.encoderUtilization, std::min(totals.encoder, 100.0));
+        usage.decoderUtilization = std::max(usage.decoderUtilization, std::min(totals.decoder, 100.0));
+    }
+    return usage;
+}
@@ -0,0 +1,157 @@
+#include "HttpProber.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+    // Bodies are only counted, never stored
+    size_t discardBody(char*, size_t size, size_t nmemb, void*) {
+        return size * nmemb;
+    }
+}
+
+double HttpProbeResult::errorRate() const {
+    return requests ? static_cast<double>(errors) / static_cast<double>(requests) : 0.0;
+}
+
+double HttpProbeResult::requestsPerSecond() const {
+    return seconds > 0.0 ? static_cast<double>(latencyMicros.count()) / seconds : 0.0;
+}
+
+double HttpProbeResult::bytesPerSecond() const {
+    return seconds > 0.0 ? static_cast<double>(bytes) / seconds : 0.0;
+}
+
+double HttpProbeResult::latencySeconds(double percentile) const {
+    return static_cast<double>(latencyMicros.percentile(percentile)) / 1e6;
+}
+
+HttpProber& HttpProber::instance() {
+    static HttpProber prober;
+    return prober;
+}
+
+HttpProber::HttpProber() {
+    curl_global_init(CURL_GLOBAL_DEFAULT); // Once per process; not thread-safe on its own
+    multi = curl_multi_init();
+    if (!multi) {
+        throw std::runtime_error("Failed to initialize curl");
+    }
+}
+
+HttpProber::~HttpProber() {
+    for (CURL* easy : idle) {
+        curl_easy_cleanup(easy);
+    }
+    curl_multi_cleanup(multi);
+    curl_global_cleanup();
+}
+
+CURL* HttpProber::acquire(const std::string& url, long timeoutMs) {
+    CURL* easy;
+    if (!idle.empty()) {
+        easy = idle.back();
+        idle.pop_back();
+    } else {
+        easy = curl_easy_init();
+        if (!easy) {
+            throw std::runtime_error("Failed to initialize curl");
+        }
+        curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, discardBody);
+        curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    }
+    curl_easy_setopt(easy, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, timeoutMs);
+    return easy;
+}
+
+HttpProbeResult HttpProber::probe(const std::string& endpoint) {
+    return probe(std::vector<std::string>{endpoint}, Options());
+}
+
+HttpProbeResult HttpProber::probe(const std::vector<std::string>& endpoints, const Options& options) {
+    HttpProbeResult result;
+    if (endpoints.empty() || options.requestBudget == 0) {
+        return result;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t parallel = std::max<size_t>(1, options.parallel);
+    long timeoutMs = static_cast<long>(options.timeout.count());
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(parallel));
+    curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, static_cast<long>(parallel * endpoints.size()));
+
+    size_t started = 0;
+    size_t finished = 0;
+    std::vector<CURL*> active;
+    auto startNext = [&] {
+        CURL* easy = acquire(endpoints[started % endpoints.size()], timeoutMs);
+        if (curl_multi_add_handle(multi, easy) != CURLM_OK) {
+            idle.push_back(easy);
+            throw std::runtime_error("Failed to start HTTP probe");
+        }
+        active.push_back(easy);
+        ++started;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    try {
+        while (started < options.requestBudget && started < parallel) {
+            startNext();
+        }
+
+        while (finished < options.requestBudget) {
+            int running = 0;
+            if (curl_multi_perform(multi, &running) != CURLM_OK) {
+                throw std::runtime_error("HTTP probe failed");
+            }
+
+            int queued = 0;
+            while (CURLMsg* message = curl_multi_info_read(multi, &queued)) {
+                if (message->msg != CURLMSG_DONE) {
+                    continue;
+                }
+                CURL* easy = message->easy_handle;
+                CURLcode code = message->data.result;
+
+                ++result.requests;
+                if (code == CURLE_OK) {
+                    long status = 0;
+                    curl_off_t totalMicros = 0;
+                    curl_off_t received = 0;
+                    curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
+                    curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME_T, &totalMicros);
+                    curl_easy_getinfo(easy, CURLINFO_SIZE_DOWNLOAD_T, &received);
+                    result.latencyMicros.record(static_cast<uint64_t>(totalMicros));
+                    result.bytes += static_cast<uint64_t>(received);
+                    if (status >= 500) {
+                        ++result.errors;
+                    }
+                } else {
+                    ++result.errors;
+                }
+
+                curl_multi_remove_handle(multi, easy);
+                active.erase(std::find(active.begin(), active.end(), easy));
+                idle.push_back(easy);
+                ++finished;
+                if (started < options.requestBudget) {
+                    startNext();
+                }
+            }
+
+            if (finished < options.requestBudget &&
+                curl_multi_poll(multi, nullptr, 0, 1000, nullptr) != CURLM_OK) {
+                throw std::runtime_error("HTTP probe failed");
+            }
+        }
+    } catch (...) {
+        // Abandon whatever is still in flight; the handles stay reusable
+        for (CURL* easy : active) {
+            curl_multi_remove_handle(multi, easy);
+            idle.push_back(easy);
+        }
+        throw;
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
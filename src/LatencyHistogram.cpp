@@ -0,0 +1,81 @@
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    constexpr size_t HALF = size_t(1) << (LatencyHistogram::SUB_BUCKET_BITS - 1);
+    // One exact range of 2 * HALF values, then HALF buckets per remaining power of two
+    constexpr size_t BUCKETS = (64 - LatencyHistogram::SUB_BUCKET_BITS + 2) * HALF;
+}
+
+LatencyHistogram::LatencyHistogram() : counts(BUCKETS, 0) {}
+
+size_t LatencyHistogram::indexOf(uint64_t value) {
+    if (value < 2 * HALF) {
+        return static_cast<size_t>(value);
+    }
+    unsigned exponent = 63 - static_cast<unsigned>(__builtin_clzll(value));
+    unsigned shift = exponent - SUB_BUCKET_BITS + 1;
+    size_t mantissa = static_cast<size_t>(value >> shift); // In [HALF, 2 * HALF)
+    return (exponent - SUB_BUCKET_BITS + 2) * HALF + (mantissa - HALF);
+}
+
+uint64_t LatencyHistogram::midpointOf(size_t index) {
+    if (index < 2 * HALF) {
+        return index;
+    }
+    unsigned shift = static_cast<unsigned>(index / HALF) - 1;
+    uint64_t lower = static_cast<uint64_t>(index % HALF + HALF) << shift;
+    return lower + ((uint64_t(1) << shift) >> 1);
+}
+
+void LatencyHistogram::record(uint64_t value, uint64_t times) {
+    if (times == 0) {
+        return;
+    }
+    counts[indexOf(value)] += times;
+    total += times;
+    lowest = std::min(lowest, value);
+    highest = std::max(highest, value);
+    sum += static_cast<double>(value) * static_cast<double>(times);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        counts[i] += other.counts[i];
+    }
+    total += other.total;
+    lowest = std::min(lowest, other.lowest);
+    highest = std::max(highest, other.highest);
+    sum += other.sum;
+}
+
+void LatencyHistogram::reset() {
+    std::fill(counts.begin(), counts.end(), 0);
+    total = 0;
+    lowest = UINT64_MAX;
+    highest = 0;
+    sum = 0.0;
+}
+
+double LatencyHistogram::mean() const {
+    return total ? sum / static_cast<double>(total) : 0.0;
+}
+
+uint64_t LatencyHistogram::percentile(double percentile) const {
+    if (total == 0) {
+        return 0;
+    }
+    percentile = std::clamp(percentile, 0.0, 100.0);
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(percentile / 100.0 * static_cast<double>(total))));
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            // The bucket midpoint can fall outside what was actually recorded
+            return std::clamp(midpointOf(i), lowest, highest);
+        }
+    }
+    return highest;
+}
@@ -0,0 +1,234 @@
+#include "LogScanner.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+    constexpr size_t BLOCK = 64;
+
+    // Two-byte prefixes that can start a match; every '\n' is reported as well so the
+    // caller can track line boundaries
+    struct PrefixSet {
+        char first[LogScanner::MAX_PREFIXES];
+        char second[LogScanner::MAX_PREFIXES];
+        size_t count;
+
+        bool matches(const char* p) const {
+            if (p[0] == '\n') {
+                return true;
+            }
+            for (size_t i = 0; i < count; ++i) {
+                if (p[0] == first[i] && p[1] == second[i]) {
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    // Each returns a mask with bit i set when p + i is a candidate, for 64 positions.
+    // They read p[0..BLOCK], one byte past the block, for the second prefix byte.
+    using BlockMask = uint64_t (*)(const char* p, const PrefixSet& set);
+
+#if !defined(__x86_64__)
+    uint64_t blockMaskScalar(const char* p, const PrefixSet& set) {
+        uint64_t mask = 0;
+        for (size_t i = 0; i < BLOCK; ++i) {
+            if (set.matches(p + i)) {
+                mask |= uint64_t(1) << i;
+            }
+        }
+        return mask;
+    }
+#else
+    uint64_t blockMaskSse2(const char* p, const PrefixSet& set) {
+        const __m128i newline = _mm_set1_epi8('\n');
+        uint64_t mask = 0;
+        for (int i = 0; i < 4; ++i) {
+            __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+            __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i + 1));
+
+            __m128i hits = _mm_cmpeq_epi8(current, newline);
+            for (size_t b = 0; b < set.count; ++b) {
+                hits = _mm_or_si128(hits, _mm_and_si128(_mm_cmpeq_epi8(current, _mm_set1_epi8(set.first[b])),
+                                                        _mm_cmpeq_epi8(next, _mm_set1_epi8(set.second[b]))));
+            }
+            mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(hits))) << (16 * i);
+        }
+        return mask;
+    }
+
+    __attribute__((target("avx2")))
+    uint64_t blockMaskAvx2(const char* p, const PrefixSet& set) {
+        const __m256i newline = _mm256_set1_epi8('\n');
+        uint64_t mask = 0;
+        for (int i = 0; i < 2; ++i) {
+            __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32 * i));
+            __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32 * i + 1));
+
+            __m256i hits = _mm256_cmpeq_epi8(current, newline);
+            for (size_t b = 0; b < set.count; ++b) {
+                hits = _mm256_or_si256(hits, _mm256_and_si256(_mm256_cmpeq_epi8(current, _mm256_set1_epi8(set.first[b])),
+                                                              _mm256_cmpeq_epi8(next, _mm256_set1_epi8(set.second[b]))));
+            }
+            mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(hits))) << (32 * i);
+        }
+        return mask;
+    }
+#endif
+
+    BlockMask selectBlockMask() {
+#if defined(__x86_64__)
+        if (__builtin_cpu_supports("avx2")) {
+            return blockMaskAvx2;
+        }
+        return blockMaskSse2; // Part of the x86-64 baseline
+#else
+        return blockMaskScalar;
+#endif
+    }
+
+    // Calls visit for every candidate position in [begin, end), in order
+    template<typename Visit>
+    void forEachCandidate(const char* begin, const char* end, const PrefixSet& set, Visit visit) {
+        static const BlockMask blockMask = selectBlockMask();
+
+        const char* p = begin;
+        // Keep one byte of slack past the block for the second-byte load
+        for (; end - p > static_cast<ptrdiff_t>(BLOCK); p += BLOCK) {
+            for (uint64_t mask = blockMask(p, set); mask != 0; mask &= mask - 1) {
+                visit(p + __builtin_ctzll(mask));
+            }
+        }
+        for (; p < end; ++p) {
+            if (*p == '\n' || (end - p >= 2 && set.matches(p))) {
+                visit(p);
+            }
+        }
+    }
+}
+
+size_t LogScanner::addPattern(std::string_view pattern) {
+    Pattern parsed;
+    size_t star = pattern.find('*');
+    parsed.head = std::string(pattern.substr(0, star));
+    while (star != std::string_view::npos) {
+        size_t next = pattern.find('*', star + 1);
+        std::string_view piece = pattern.substr(star + 1, next == std::string_view::npos ? std::string_view::npos : next - star - 1);
+        if (!piece.empty()) {
+            parsed.tail.emplace_back(piece);
+        }
+        star = next;
+    }
+
+    if (parsed.head.size() < 2) {
+        throw std::invalid_argument("Log pattern must start with a literal of at least two bytes");
+    }
+    if (pattern.find('\n') != std::string_view::npos) {
+        throw std::invalid_argument("Log pattern cannot span lines");
+    }
+
+    char first = parsed.head[0];
+    std::pair<char, char> prefix(first, parsed.head[1]);
+    if (std::find(prefixes.begin(), prefixes.end(), prefix) == prefixes.end()) {
+        if (prefixes.size() == MAX_PREFIXES) {
+            throw std::invalid_argument("Too many distinct prefixes across log patterns");
+        }
+        prefixes.push_back(prefix);
+    }
+
+    patterns.push_back(std::move(parsed));
+    patternsByFirstByte[static_cast<unsigned char>(first)].push_back(patterns.size() - 1);
+    return patterns.size() - 1;
+}
+
+bool LogScanner::matchesAt(const Pattern& pattern, const char* at, const char* end) const {
+    size_t available = static_cast<size_t>(end - at);
+    if (available < pattern.head.size() || std::memcmp(at, pattern.head.data(), pattern.head.size()) != 0) {
+        return false;
+    }
+    if (pattern.tail.empty()) {
+        return true;
+    }
+
+    const char* rest = at + pattern.head.size();
+    const char* lineEnd = static_cast<const char*>(std::memchr(rest, '\n', static_cast<size_t>(end - rest)));
+    std::string_view line(rest, static_cast<size_t>((lineEnd ? lineEnd : end) - rest));
+    for (const auto& piece : pattern.tail) {
+        size_t found = line.find(piece);
+        if (found == std::string_view::npos) {
+            return false;
+        }
+        line.remove_prefix(found + piece.size());
+    }
+    return true;
+}
+
+void LogScanner::scan(std::string_view text, uint64_t* counts) const {
+    PrefixSet set;
+    set.count = prefixes.size();
+    for (size_t i = 0; i < prefixes.size(); ++i) {
+        set.first[i] = prefixes[i].first;
+        set.second[i] = prefixes[i].second;
+    }
+
+    // Line of each pattern's last counted match, so repeats on one line count once
+    constexpr uint64_t NONE = std::numeric_limits<uint64_t>::max();
+    std::vector<uint64_t> countedOnLine(patterns.size(), NONE);
+    uint64_t line = 0;
+
+    const char* end = text.data() + text.size();
+    forEachCandidate(text.data(), end, set, [&](const char* at) {
+        if (*at == '\n') {
+            ++line;
+            return;
+        }
+        for (size_t index : patternsByFirstByte[static_cast<unsigned char>(*at)]) {
+            if (countedOnLine[index] != line && matchesAt(patterns[index], at, end)) {
+                countedOnLine[index] = line;
+                ++counts[index];
+            }
+        }
+    });
+}
+
+std::vector<uint64_t> LogScanner::scanFile(const std::string& path) const {
+    std::vector<uint64_t> counts(patterns.size(), 0);
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open " + path + ": " + std::string(strerror(errno)));
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        int error = errno;
+        close(fd);
+        throw std::runtime_error("Failed to stat " + path + ": " + std::string(strerror(error)));
+    }
+    if (info.st_size == 0) {
+        close(fd);
+        return counts;
+    }
+
+    size_t length = static_cast<size_t>(info.st_size);
+    void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("Failed to map " + path + ": " + std::string(strerror(errno)));
+    }
+    madvise(mapped, length, MADV_SEQUENTIAL);
+
+    scan(std::string_view(static_cast<const char*>(mapped), length), counts.data());
+    munmap(mapped, length);
+    return counts;
+}
@@ -0,0 +1,227 @@
+#include "LogTailer.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    constexpr size_t READ_CHUNK = 64 * 1024;
+    constexpr uint32_t WATCH_MASK = IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF;
+}
+
+LogTailer::LogTailer(std::string path, BlockHandler handler, std::string checkpointPath)
+    : filePath(std::move(path)), checkpointPath(std::move(checkpointPath)), handler(std::move(handler)) {
+    // Without inotify (e.g. the per-user watch limit is exhausted) every poll falls back to fstat
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (!openFile()) {
+        if (inotifyFd >= 0) {
+            close(inotifyFd);
+        }
+        throw std::runtime_error("Failed to open log file " + filePath + ": " + std::string(strerror(errno)));
+    }
+    loadCheckpoint();
+    drain();
+    saveCheckpoint();
+}
+
+LogTailer::~LogTailer() {
+    closeFile();
+    if (inotifyFd >= 0) {
+        close(inotifyFd);
+    }
+}
+
+bool LogTailer::openFile() {
+    fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        closeFile();
+        return false;
+    }
+    inode = info.st_ino;
+
+    if (inotifyFd >= 0) {
+        watch = inotify_add_watch(inotifyFd, filePath.c_str(), WATCH_MASK);
+    }
+    return true;
+}
+
+void LogTailer::closeFile() {
+    if (watch >= 0) {
+        inotify_rm_watch(inotifyFd, watch); // Fails harmlessly if the kernel already dropped it
+        watch = -1;
+    }
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+// Returns true if the file may have changed since the last call
+bool LogTailer::drainEvents() {
+    if (inotifyFd < 0 || watch < 0) {
+        return true;
+    }
+
+    alignas(inotify_event) char buffer[4096];
+    bool changed = false;
+    for (;;) {
+        ssize_t bytes = read(inotifyFd, buffer, sizeof(buffer));
+        if (bytes <= 0) {
+            break; // EAGAIN: queue drained
+        }
+        for (char* cursor = buffer; cursor < buffer + bytes;) {
+            auto* event = reinterpret_cast<inotify_event*>(cursor);
+            if (event->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED)) {
+                rotationPending = true;
+            }
+            if (event->mask & IN_Q_OVERFLOW) {
+                rotationPending = true; // Events were lost; re-check everything
+            }
+            changed = true;
+            cursor += sizeof(inotify_event) + event->len;
+        }
+    }
+    return changed;
+}
+
+void LogTailer::drain() {
+    if (fd < 0) {
+        return;
+    }
+
+    for (;;) {
+        size_t held = pending.size();
+        pending.resize(held + READ_CHUNK);
+        ssize_t bytes = pread(fd, pending.data() + held, READ_CHUNK, static_cast<off_t>(committedOffset + held));
+        if (bytes <= 0) {
+            pending.resize(held);
+            if (bytes < 0 && errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        pending.resize(held + static_cast<size_t>(bytes));
+
+        // Everything before `held` is a partial line, so the last newline is in the new bytes if anywhere
+        size_t lastNewline = pending.rfind('\n');
+        if (lastNewline == std::string::npos) {
+            continue;
+        }
+        size_t complete = lastNewline + 1;
+        handler(std::string_view(pending.data(), complete), counters);
+        committedOffset += complete;
+        pending.erase(0, complete);
+    }
+}
+
+const LogCounters& LogTailer::poll() {
+    uint64_t offsetBefore = committedOffset;
+    ino_t inodeBefore = inode;
+
+    if (!drainEvents() && !rotationPending) {
+        return counters;
+    }
+
+    // Finish the file we have open first: after a rename the writer may have appended
+    // to it right up to the rotation
+    drain();
+
+    struct stat info;
+    if (stat(filePath.c_str(), &info) != 0) {
+        rotationPending = true; // Moved away and not recreated yet
+    } else if (info.st_ino != inode) {
+        closeFile();
+        if (openFile()) {
+            committedOffset = 0;
+            pending.clear();
+            rotationPending = false;
+            drain();
+        }
+    } else {
+        rotationPending = false;
+        if (static_cast<uint64_t>(info.st_size) < committedOffset + pending.size()) {
+            // Truncated in place (copytruncate rotation); start over on the same inode
+            committedOffset = 0;
+            pending.clear();
+            drain();
+        }
+    }
+
+    if (committedOffset != offsetBefore || inode != inodeBefore) {
+        saveCheckpoint();
+    }
+    return counters;
+}
+
+// Checkpoint format: "<inode> <offset> <count0..count3> <sum0..sum3>"
+void LogTailer::loadCheckpoint() {
+    if (checkpointPath.empty()) {
+        return;
+    }
+    FILE* file = std::fopen(checkpointPath.c_str(), "r");
+    if (!file) {
+        return;
+    }
+
+    unsigned long long savedInode, savedOffset;
+    LogCounters saved;
+    bool ok = std::fscanf(file, "%llu %llu", &savedInode, &savedOffset) == 2;
+    for (size_t i = 0; ok && i < LogCounters::SLOTS; ++i) {
+        unsigned long long count;
+        ok = std::fscanf(file, "%llu", &count) == 1;
+        saved.count[i] = count;
+    }
+    for (size_t i = 0; ok && i < LogCounters::SLOTS; ++i) {
+        ok = std::fscanf(file, "%lf", &saved.sum[i]) == 1;
+    }
+    std::fclose(file);
+    if (!ok) {
+        return;
+    }
+
+    // Counters are running totals and carry over a rotation; the offset only applies
+    // to the same file, and only if it has not been truncated since
+    counters = saved;
+    struct stat info;
+    if (static_cast<ino_t>(savedInode) == inode && fstat(fd, &info) == 0
+            && savedOffset <= static_cast<unsigned long long>(info.st_size)) {
+        committedOffset = savedOffset;
+    }
+}
+
+void LogTailer::saveCheckpoint() const {
+    if (checkpointPath.empty()) {
+        return;
+    }
+
+    // Write-and-rename so a crash mid-write leaves the previous checkpoint intact
+    std::string temporary = checkpointPath + ".tmp";
+    FILE* file = std::fopen(temporary.c_str(), "w");
+    if (!file) {
+        return; // Best effort: without a checkpoint a restart rescans from the start
+    }
+    std::fprintf(file, "%llu %llu", static_cast<unsigned long long>(inode),
+                 static_cast<unsigned long long>(committedOffset));
+    for (uint64_t count : counters.count) {
+        std::fprintf(file, " %llu", static_cast<unsigned long long>(count));
+    }
+    for (double sum : counters.sum) {
+        std::fprintf(file, " %.17g", sum);
+    }
+    std::fprintf(file, "\n");
+
+    bool written = std::fclose(file) == 0;
+    if (written) {
+        std::rename(temporary.c_str(), checkpointPath.c_str());
+    }
+}
@@ -1,262 +1,1103 @@
 #include "MPIController.h"
+#include "AsyncPgProbe.h"
+#include "ProbeWorker.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <seastar/core/gate.hh>
+#include <seastar/core/loop.hh>
+#include <seastar/core/reactor.hh>
+#include <seastar/core/sleep.hh>
+#include <seastar/core/smp.hh>
+#include <seastar/core/thread.hh>
+#include <stdexcept>
+#include <sys/sysinfo.h>
 
-void distributeAndGatherMemoryUsage(const std::vector<pid_t>& pids, int target_rank) {
-    int world_size;
-    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+namespace {
+    // NodeFrame field by field, resized to its C++ extent so arrays of it match
+    MPI_Datatype nodeFrameType() {
+        constexpr int FIELDS = 6;
+        int lengths[FIELDS] = {static_cast<int>(NodeFrame::NODE_BYTES), 1, 1, 1, static_cast<int>(METRIC_SLOTS),
+                               static_cast<int>(MetricFrame::PRESENT_WORDS)};
+        MPI_Aint displacements[FIELDS] = {
+            static_cast<MPI_Aint>(offsetof(NodeFrame, node)),
+            static_cast<MPI_Aint>(offsetof(NodeFrame, frame) + offsetof(MetricFrame, schemaVersion)),
+            static_cast<MPI_Aint>(offsetof(NodeFrame, frame) + offsetof(MetricFrame, reserved)),
+            static_cast<MPI_Aint>(offsetof(NodeFrame, frame) + offsetof(MetricFrame, timestampMicros)),
+            static_cast<MPI_Aint>(offsetof(NodeFrame, frame) + offsetof(MetricFrame, values)),
+            static_cast<MPI_Aint>(offsetof(NodeFrame, frame) + offsetof(MetricFrame, present)),
+        };
+        MPI_Datatype types[FIELDS] = {MPI_CHAR, MPI_UINT32_T, MPI_UINT32_T, MPI_UINT64_T, MPI_FLOAT, MPI_UINT64_T};
 
-    int world_rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+        MPI_Datatype fields;
+        MPI_Datatype frameType;
+        MPI_Type_create_struct(FIELDS, lengths, displacements, types, &fields);
+        MPI_Type_create_resized(fields, 0, sizeof(NodeFrame), &frameType);
+        MPI_Type_commit(&frameType);
+        MPI_Type_free(&fields);
+        return frameType;
+    }
+}
+
+namespace {
+    constexpr int QUERY_TAG = 7101;
+    // Each query a rank has in flight is answered on a tag of its own, so answers to two
+    // queries to the same rank cannot cross. The range stays within the 32767 that
+    // MPI_TAG_UB is guaranteed to be.
+    constexpr int FIRST_ANSWER_TAG = 8192;
+    constexpr uint64_t ANSWER_TAGS = 16384;
+    constexpr size_t QUERY_ARGUMENTS = 4;
+    constexpr size_t ARGUMENT_BYTES = 256; // Room for a database URI with credentials
+    // How often an idle rank looks for queries
+    constexpr auto QUERY_POLL_INTERVAL = std::chrono::microseconds(200);
+
+    std::atomic<int> worldRank{-1};
+
+    struct HostRecord {
+        char ip[NodeFrame::NODE_BYTES];
+        char hostname[NodeFrame::NODE_BYTES];
+    };
 
-    // Only execute on the specified target rank
-    if (world_rank != target_rank) {
-        return;
+    struct Directory {
+        int self = 0;
+        MPI_Comm queries = MPI_COMM_NULL; // Targeted queries and their answers, apart from any other traffic
+        std::vector<RankAddress> ranks;
+        std::unordered_map<std::string, int> byName; // IP or hostname to its lowest rank
+        std::vector<int> hosts; // Lowest rank of every host, in rank order
+    };
+
+    // Written once on MPI_SHARD before serving starts, read-only afterwards
+    std::optional<Directory>& builtDirectory() {
+        static std::optional<Directory> built;
+        return built;
+    }
+
+    const Directory& directory() {
+        const std::optional<Directory>& built = builtDirectory();
+        if (!built) {
+            throw std::runtime_error("The rank directory has not been built");
+        }
+        return *built;
     }
 
-    std::vector<pid_t> local_pids;
+    // Nonblocking MPI requests the reactor waits on. MPI_SHARD only: while any is
+    // outstanding a poller tests them between tasks, and the promise of each one that
+    // completes is set.
+    struct Progress {
+        std::vector<MPI_Request> requests;
+        std::vector<seastar::promise<>> waiting;
+        std::vector<int> completed;
+        std::optional<seastar::reactor::poller> poller;
+
+        seastar::future<> wait(MPI_Request request) {
+            if (request == MPI_REQUEST_NULL) {
+                return seastar::make_ready_future<>();
+            }
+            requests.push_back(request);
+            waiting.emplace_back();
+            seastar::future<> done = waiting.back().get_future();
+            if (!poller) {
+                poller = seastar::reactor::poller::simple([this] { return poll(); });
+            }
+            return done;
+        }
+
+        bool poll() {
+            if (requests.empty()) {
+                return false;
+            }
+            int count = 0;
+            completed.resize(requests.size());
+            MPI_Testsome(static_cast<int>(requests.size()), requests.data(), &count, completed.data(), MPI_STATUSES_IGNORE);
+            if (count == MPI_UNDEFINED || count == 0) {
+                return false;
+            }
+            // Completed requests are MPI_REQUEST_NULL now. Setting a promise only schedules
+            // its continuation, so the vectors are settled before anything can add to them.
+            std::vector<seastar::promise<>> done;
+            size_t kept = 0;
+            for (size_t i = 0; i < requests.size(); ++i) {
+                if (requests[i] == MPI_REQUEST_NULL) {
+                    done.push_back(std::move(waiting[i]));
+                } else {
+                    requests[kept] = requests[i];
+                    waiting[kept] = std::move(waiting[i]);
+                    ++kept;
+                }
+            }
+            requests.resize(kept);
+            waiting.resize(kept);
+            for (seastar::promise<>& promise : done) {
+                promise.set_value();
+            }
+            return true;
+        }
+
+        // A simple poller keeps the reactor from sleeping, so it only lives while there is
+        // something to wait for. Not called from poll(), which the poller is running.
+        void idle() {
+            if (requests.empty()) {
+                poller.reset();
+            }
+        }
+    };
+
+    Progress& progress() {
+        static Progress waiting;
+        return waiting;
+    }
 
-    // Distribute pids to each process
-    int num_pids = pids.size();
-    int chunk_size = num_pids / world_size;
-    int start_index = world_rank * chunk_size;
-    int end_index = (world_rank == world_size - 1) ? num_pids : start_index + chunk_size;
+    // MPI_SHARD only
+    uint64_t nextSequence() {
+        static uint64_t sequence = 0;
+        return ++sequence;
+    }
 
-    for (int i = start_index; i < end_index; ++i) {
-        local_pids.push_back(pids[i]);
+    int answerTag(uint64_t sequence) {
+        return FIRST_ANSWER_TAG + static_cast<int>(sequence % ANSWER_TAGS);
     }
 
-    // Each process calculates memory usage for its local pids
-    auto memory_usage = SystemMetrics::getProcessMemoryUsage(local_pids);
+    struct QueryRequest {
+        NodeQuery query;
+        uint32_t gpuIndex;
+        uint64_t sequence;
+        int32_t answerTag;
+        uint32_t reserved;
+        char arguments[QUERY_ARGUMENTS][ARGUMENT_BYTES];
+    };
+
+    struct QueryAnswer {
+        uint64_t sequence;
+        int32_t failed;
+        uint32_t reserved;
+        NodeQueryValues values;
+    };
 
-    // Gather results from all processes
-    std::vector<int> all_memory_usages;
-    if (world_rank == 0) {
-        all_memory_usages.resize(num_pids);
+    uint64_t nowMicros() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
     }
 
-    MPI_Gather(memory_usage.data(), memory_usage.size(), MPI_INT, 
-               all_memory_usages.data(), memory_usage.size(), MPI_INT, 
-               0, MPI_COMM_WORLD);
+    // Adds the GPU part of the schema from one sweep of this node's GPUs
+    void addGpuMetrics(MetricFrame& frame) {
+        GpuSweep sweep = SystemMetrics::getGpuSweep();
+        // Everything the driver sampled since the last tick, not just this instant
+        auto history = SystemMetrics::getGpuHistory();
+        LatencyHistogram usage = history->utilization();
+        LatencyHistogram power = history->power();
 
-    // Process 0 can now aggregate the results
-    if (world_rank == 0) {
-        for (int i = 0; i < num_pids; ++i) {
-            std::cout << "PID: " << pids[i] << ", Memory Usage: " << all_memory_usages[i] << std::endl;
+        // A GPU-less node, or a gauge no device reports, leaves the aggregate absent so
+        // it does not drag down the cluster's mean and minimum as a 0
+        if (!sweep.devices.empty()) {
+            frame.set(MetricId::GPU_COUNT, sweep.devices.size());
+        }
+        if (sweep.maxTemperatureC) {
+            frame.set(MetricId::GPU_MAX_TEMPERATURE, *sweep.maxTemperatureC);
+        }
+        if (sweep.meanUtilization) {
+            frame.set(MetricId::GPU_MEAN_USAGE, *sweep.meanUtilization);
+            frame.set(MetricId::GPU_MIN_USAGE, *sweep.minUtilization);
+        }
+        if (sweep.memoryPressure) {
+            frame.set(MetricId::GPU_MEMORY_PRESSURE, *sweep.memoryPressure);
+        }
+        if (usage.count()) {
+            frame.set(MetricId::GPU_USAGE_P50, usage.percentile(50.0));
+            frame.set(MetricId::GPU_USAGE_P90, usage.percentile(90.0));
+            frame.set(MetricId::GPU_USAGE_P99, usage.percentile(99.0));
+        } else if (sweep.meanUtilization) {
+            // No sample buffers: the instantaneous mean is all there is
+            frame.set(MetricId::GPU_USAGE_P50, *sweep.meanUtilization);
+            frame.set(MetricId::GPU_USAGE_P90, *sweep.meanUtilization);
+            frame.set(MetricId::GPU_USAGE_P99, *sweep.meanUtilization);
+        }
+        if (power.count()) {
+            frame.set(MetricId::GPU_POWER_P90, power.percentile(90.0) / 1000.0); // Convert to watts
+        }
+        for (unsigned int gpu = 0; gpu < history->devices.size(); ++gpu) {
+            const GpuHistory::Interval::Device& device = history->devices[gpu];
+            if (device.utilization.count()) {
+                frame.set(MetricId::GPU_DEVICE_USAGE_P90, gpu, device.utilization.percentile(90.0));
+            }
+            if (device.power.count()) {
+                frame.set(MetricId::GPU_DEVICE_POWER_P90, gpu, device.power.percentile(90.0) / 1000.0);
+            }
+        }
+
+        // Fields a device does not report stay absent rather than reading as 0
+        for (unsigned int gpu = 0; gpu < sweep.devices.size(); ++gpu) {
+            const GpuSample& sample = sweep.devices[gpu];
+            if (sample.has(GpuSample::TEMPERATURE)) {
+                frame.set(MetricId::GPU_TEMPERATURE, gpu, sample.temperatureC);
+            }
+            if (sample.has(GpuSample::UTILIZATION)) {
+                frame.set(MetricId::GPU_USAGE, gpu, sample.gpuUtilization);
+            }
+            if (sample.has(GpuSample::MEMORY)) {
+                frame.set(MetricId::GPU_MEMORY_USAGE, gpu, sample.memoryUsedPercent());
+            }
+            if (sample.has(GpuSample::POWER)) {
+                frame.set(MetricId::GPU_POWER_USAGE, gpu, sample.powerMilliwatts / 1000.0); // Convert to watts
+            }
+            if (sample.has(GpuSample::FAN)) {
+                frame.set(MetricId::GPU_FAN_SPEED, gpu, sample.fanPercent);
+            }
+            if (sample.has(GpuSample::CLOCKS)) {
+                frame.set(MetricId::GPU_CORE_CLOCK, gpu, sample.smClockMHz);
+                frame.set(MetricId::GPU_MEMORY_CLOCK, gpu, sample.memoryClockMHz);
+            }
         }
     }
-}
 
-float MPIController::mpiWrapperFunction(const std::string& target_ip, std::function<float(unsigned int)> func, unsigned int gpuIndex) {
-    int world_rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    // Everything this node reports in a collection round
+    MetricFrame localNodeFrame() {
+        static SystemMetrics systemMetrics;
+        MetricFrame frame;
+        frame.timestampMicros = nowMicros();
 
-    // Get the IP address of the current node
-    std::string current_ip = getIPAddress();
+        struct sysinfo memory;
+        if (sysinfo(&memory) == 0) {
+            frame.set(MetricId::TOTAL_MEMORY, static_cast<double>(memory.totalram) * memory.mem_unit);
+            frame.set(MetricId::FREE_MEMORY, static_cast<double>(memory.freeram) * memory.mem_unit);
+            frame.set(MetricId::USED_MEMORY, static_cast<double>(memory.totalram - memory.freeram) * memory.mem_unit);
+        }
+        // A reading this node cannot take stays absent and does not cost the round
+        auto trySet = [&frame](MetricId id, auto read) {
+            try {
+                frame.set(id, read());
+            } catch (const std::runtime_error&) {
+            }
+        };
+        trySet(MetricId::CPU_USAGE, [] { return systemMetrics.getCpuUtilization(); });
+        trySet(MetricId::CPU_TEMPERATURE, [] { return systemMetrics.getCpuTemperature(); });
+        trySet(MetricId::MEMORY_PAGE_FAULTS, [] { return systemMetrics.getMemoryPageFaults(); });
+        trySet(MetricId::NETWORK_BANDWIDTH, [] {
+            return systemMetrics.getNetworkBandwidthUtilization(systemMetrics.getPrimaryInterface());
+        });
+        // The slowest disk is the one that holds the node back
+        trySet(MetricId::DISK_LATENCY, [] {
+            std::optional<double> slowest;
+            for (const std::string& disk : systemMetrics.getDisks()) {
+                try {
+                    slowest = std::max(slowest.value_or(0.0), systemMetrics.getDiskLatency(disk));
+                } catch (const std::runtime_error&) {
+                    // Appeared since the sampler last read /proc/diskstats
+                }
+            }
+            if (!slowest) {
+                throw std::runtime_error("No disk latency on this node");
+            }
+            return *slowest / 1000.0; // ms to seconds
+        });
+        // One pass over the new auth log lines counts all three patterns
+        try {
+            SystemMetrics::AuthLogCounts auth = systemMetrics.getAuthLogCounts();
+            frame.set(MetricId::AUTH_FAILED_PASSWORDS, auth.failedPasswords);
+            frame.set(MetricId::AUTH_INVALID_USERS, auth.invalidUsers);
+            frame.set(MetricId::AUTH_SUDO_FAILURES, auth.sudoFailures);
+        } catch (const std::runtime_error&) {
+        }
+        addGpuMetrics(frame);
+        return frame;
+    }
 
-    float result = 0.0;
+    // Queries answered with a whole NodeFrame rather than a QueryAnswer
+    bool answersWithFrame(NodeQuery query) {
+        return query == NodeQuery::GPU_FRAME || query == NodeQuery::NODE_FRAME;
+    }
 
-    if (current_ip == target_ip) {
-        result = func(gpuIndex);
+    const MPI_Datatype& frameType() {
+        static const MPI_Datatype type = nodeFrameType();
+        return type;
     }
 
-    float global_result = 0.0;
-    MPI_Reduce(&result, &global_result, 1, MPI_FLOAT, MPI_SUM, 0, MPI_COMM_WORLD);
+    // Runs on the shard's probe worker: some of these sleep for a rate baseline or block
+    // on a database client
+    double probe(const QueryRequest& request) {
+        static SystemMetrics systemMetrics;
+        auto argument = [&request](size_t index) { return std::string(request.arguments[index]); };
+        // Askers need not know the node's interface names
+        auto interface = [&request]() {
+            return request.arguments[0][0] ? std::string(request.arguments[0]) : systemMetrics.getPrimaryInterface();
+        };
+        unsigned int gpu = request.gpuIndex;
+        switch (request.query) {
+            case NodeQuery::GPU_TEMPERATURE: return systemMetrics.getGpuTemperature(gpu);
+            case NodeQuery::GPU_USAGE: return systemMetrics.getGpuUsage(gpu);
+            case NodeQuery::GPU_MEMORY_USAGE: return systemMetrics.getGpuMemoryUsage(gpu);
+            case NodeQuery::GPU_POWER_USAGE: return systemMetrics.getGpuPowerUsage(gpu);
+            case NodeQuery::GPU_FAN_SPEED: return systemMetrics.getGpuFanSpeed(gpu);
+            case NodeQuery::GPU_CORE_CLOCK: return systemMetrics.getGpuCoreClock(gpu);
+            case NodeQuery::GPU_MEMORY_CLOCK: return systemMetrics.getGpuMemoryClock(gpu);
+            case NodeQuery::AVAILABLE_MEMORY: return systemMetrics.getAvailableMemory();
+            case NodeQuery::CPU_TEMPERATURE: return systemMetrics.getCpuTemperature();
+            case NodeQuery::SWAP_USAGE: return systemMetrics.getSwapUsage();
+            case NodeQuery::MEMORY_PAGE_FAULTS: return systemMetrics.getMemoryPageFaults();
+            case NodeQuery::DISK_LATENCY: return systemMetrics.getDiskLatency(argument(0));
+            case NodeQuery::DISK_SPACE_UTILIZATION: return systemMetrics.getDiskSpaceUtilization(argument(0));
+            case NodeQuery::NETWORK_BANDWIDTH_UTILIZATION: return systemMetrics.getNetworkBandwidthUtilization(interface());
+            case NodeQuery::NETWORK_LATENCY: return systemMetrics.getNetworkLatency(interface());
+            case NodeQuery::NETWORK_ERRORS: return systemMetrics.getNetworkErrors(interface());
+            case NodeQuery::PACKET_LOSS: return systemMetrics.getPacketLoss(interface());
+            case NodeQuery::ACTIVE_CONNECTIONS: return systemMetrics.getActiveConnections(interface());
+            case NodeQuery::APPLICATION_RESPONSE_TIME: return systemMetrics.getApplicationResponseTime(argument(0));
+            case NodeQuery::APPLICATION_ERROR_RATE: return systemMetrics.getApplicationErrorRate(argument(0));
+            case NodeQuery::REQUEST_RATE: return systemMetrics.getRequestRate(argument(0));
+            case NodeQuery::THROUGHPUT: return systemMetrics.getThroughput(argument(0));
+            case NodeQuery::QUERY_PERFORMANCE: return systemMetrics.getQueryPerformance(argument(0));
+            case NodeQuery::CONNECTION_POOL_UTILIZATION: return systemMetrics.getConnectionPoolUtilization(argument(0));
+            case NodeQuery::CACHE_HIT_MISS_RATE: return systemMetrics.getCacheHitMissRate(argument(0));
+            case NodeQuery::TRANSACTION_RATE: return systemMetrics.getTransactionRate(argument(0));
+            case NodeQuery::FAILED_LOGIN_ATTEMPTS: return systemMetrics.getFailedLoginAttempts();
+            case NodeQuery::INTRUSION_DETECTION_ALERTS: return systemMetrics.getIntrusionDetectionAlerts();
+            case NodeQuery::FIREWALL_LOG_ENTRIES: return systemMetrics.getFirewallLogEntries();
+            case NodeQuery::VULNERABILITY_SCANS: return systemMetrics.getVulnerabilityScans();
+            case NodeQuery::INSTANCE_TYPE_UTILIZATION: return systemMetrics.getInstanceTypeUtilization();
+            case NodeQuery::AUTO_SCALING_METRICS: return systemMetrics.getAutoScalingMetrics();
+            case NodeQuery::RESOURCE_RESERVATIONS: return systemMetrics.getResourceReservations();
+            case NodeQuery::POWER_USAGE: return systemMetrics.getPowerUsage();
+            case NodeQuery::ENERGY_EFFICIENCY: return systemMetrics.getEnergyEfficiency();
+            case NodeQuery::WORKLOAD_CPU: return SystemMetrics::getWorkloadCpuUtilization(argument(0));
+            case NodeQuery::WORKLOAD_MEMORY: return SystemMetrics::getWorkloadMemoryUtilization(argument(0));
+            case NodeQuery::WORKLOAD_IO_PRESSURE: return SystemMetrics::getWorkloadIoPressure(argument(0));
+            case NodeQuery::SHOULD_SCALE:
+                return systemMetrics.shouldScale(systemMetrics, argument(0), argument(1), argument(2), argument(3)) ? 1.0 : 0.0;
+            case NodeQuery::WORKLOAD_PERF_COUNTERS:
+            case NodeQuery::WORKLOAD_GPU_USAGE:
+                break; // Answered with several values
+            case NodeQuery::STALL_REPORT:
+                break; // Answered on the reactor
+            case NodeQuery::GPU_FRAME:
+            case NodeQuery::NODE_FRAME:
+                break; // Answered with a frame
+        }
+        throw std::runtime_error("Unknown node query " + std::to_string(static_cast<int>(request.query)));
+    }
 
-    if (current_ip == target_ip) {
-        return global_result;
+    // Values in the order the asking side unpacks them
+    NodeQueryValues probeValues(const QueryRequest& request) {
+        NodeQueryValues values = {};
+        switch (request.query) {
+            case NodeQuery::WORKLOAD_PERF_COUNTERS: {
+                PerfSample perf = SystemMetrics::getWorkloadPerfCounters(request.arguments[0]);
+                values = {static_cast<double>(perf.cycles), static_cast<double>(perf.instructions),
+                          static_cast<double>(perf.cacheMisses), static_cast<double>(perf.taskClockNs),
+                          static_cast<double>(perf.contextSwitches), static_cast<double>(perf.pageFaults),
+                          perf.hardware ? 1.0 : 0.0};
+                break;
+            }
+            case NodeQuery::WORKLOAD_GPU_USAGE: {
+                GpuWorkloadUsage gpu = SystemMetrics::getWorkloadGpuUsage(request.arguments[0]);
+                values = {static_cast<double>(gpu.processes), static_cast<double>(gpu.memoryUsed), gpu.smUtilization,
+                          gpu.memoryUtilization, gpu.encoderUtilization, gpu.decoderUtilization};
+                break;
+            }
+            default:
+                values[0] = probe(request);
+        }
+        return values;
     }
 
-    return 0.0;
-}
+    // Database queries for a PostgreSQL URI, which AsyncPgProbe answers on the reactor
+    // instead of a blocking client on the probe worker; nullopt for everything else
+    std::optional<seastar::future<double>> probePostgres(const QueryRequest& request) {
+        std::string db(request.arguments[0]);
+        if (db.rfind("postgresql://", 0) != 0) {
+            return std::nullopt;
+        }
+        AsyncPgProbe& probe = AsyncPgProbe::forShard(db);
+        switch (request.query) {
+            case NodeQuery::QUERY_PERFORMANCE: return probe.queryLatency();
+            case NodeQuery::CONNECTION_POOL_UTILIZATION: return probe.poolUtilization();
+            case NodeQuery::CACHE_HIT_MISS_RATE: return probe.cacheHitRatio();
+            case NodeQuery::TRANSACTION_RATE: return probe.transactionRate();
+            default: return std::nullopt;
+        }
+    }
 
-double MPIController::mpiWrapperFunction(const std::string& target_ip, std::function<double()> func) {
-    int world_rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    // MPI_SHARD only
+    MPIController::StallHandler& stallHandler() {
+        static MPIController::StallHandler handler;
+        return handler;
+    }
 
-    // Get the IP address of the current node
-    std::string current_ip = getIPAddress();
+    seastar::future<NodeQueryValues> answer(const QueryRequest& request) {
+        if (request.query == NodeQuery::STALL_REPORT) {
+            if (stallHandler()) {
+                stallHandler()(request.arguments[0]);
+            }
+            return seastar::make_ready_future<NodeQueryValues>(NodeQueryValues{});
+        }
+        if (std::optional<seastar::future<double>> postgres = probePostgres(request)) {
+            return std::move(*postgres).then([](double value) {
+                NodeQueryValues values = {};
+                values[0] = value;
+                return values;
+            });
+        }
+        return ProbeWorker::forShard().run([request] {
+            return probeValues(request);
+        });
+    }
 
-    double result = 0.0;
+    // The PostgreSQL metrics of this node's own database, when it names one, added to answer.
+    // A database that does not answer leaves them absent.
+    seastar::future<NodeFrame> addPostgresMetrics(NodeFrame answer) {
+        const char* db = std::getenv(MPIController::POSTGRES_URI_ENV);
+        if (!db || !*db) {
+            return seastar::make_ready_future<NodeFrame>(answer);
+        }
+        return MPIController::postgresMetrics(db).then_wrapped([answer](seastar::future<MetricFrame> probed) mutable {
+            try {
+                probed.get().forEach([&answer](const MetricTraits& traits, unsigned int gpu, float value) {
+                    if (traits.perGpu) {
+                        answer.frame.set(traits.id, gpu, value);
+                    } else {
+                        answer.frame.set(traits.id, value);
+                    }
+                });
+            } catch (const std::exception&) {
+            }
+            return answer;
+        });
+    }
+
+    // Frames are answered with this node's IP in NodeFrame::node; a failed read leaves it empty
+    seastar::future<NodeFrame> answerFrame(const QueryRequest& request) {
+        std::string self = MPIController::localIp();
+        return ProbeWorker::forShard().run([self, query = request.query] {
+            NodeFrame answer;
+            answer.frame.timestampMicros = nowMicros();
+            switch (query) {
+                case NodeQuery::GPU_FRAME:
+                    addGpuMetrics(answer.frame);
+                    break;
+                case NodeQuery::NODE_FRAME:
+                    answer.frame = localNodeFrame();
+                    break;
+                default:
+                    throw std::runtime_error("Node query " + std::to_string(static_cast<int>(query)) + " has no frame");
+            }
+            self.copy(answer.node, NodeFrame::NODE_BYTES - 1);
+            return answer;
+        }).then([query = request.query](NodeFrame answer) {
+            return query == NodeQuery::NODE_FRAME ? addPostgresMetrics(answer) : seastar::make_ready_future<NodeFrame>(answer);
+        });
+    }
+
+    seastar::future<> replyWithFrame(int source, const QueryRequest& request) {
+        return answerFrame(request).then_wrapped([source, tag = request.answerTag](seastar::future<NodeFrame> answered) {
+            auto reply = std::make_unique<NodeFrame>();
+            try {
+                *reply = answered.get();
+            } catch (const std::exception&) {
+                *reply = NodeFrame();
+            }
+            MPI_Request sending;
+            MPI_Isend(reply.get(), 1, frameType(), source, tag, directory().queries, &sending);
+            return progress().wait(sending).finally([reply = std::move(reply)] {});
+        });
+    }
+
+    // Sends the answer to request back to source once it has been read
+    seastar::future<> reply(int source, const QueryRequest& request) {
+        if (answersWithFrame(request.query)) {
+            return replyWithFrame(source, request);
+        }
+        return answer(request).then_wrapped([source, sequence = request.sequence, tag = request.answerTag](
+                seastar::future<NodeQueryValues> answered) {
+            auto reply = std::make_unique<QueryAnswer>();
+            reply->sequence = sequence;
+            reply->failed = 0;
+            reply->reserved = 0;
+            try {
+                reply->values = answered.get();
+            } catch (const std::exception&) {
+                reply->values = {};
+                reply->failed = 1;
+            }
+            MPI_Request sending;
+            MPI_Isend(reply.get(), sizeof(QueryAnswer), MPI_BYTE, source, tag, directory().queries, &sending);
+            // The buffer has to outlive the send
+            return progress().wait(sending).finally([reply = std::move(reply)] {});
+        });
+    }
+
+    // This rank's side of other ranks' queries, on MPI_SHARD: one receive always posted,
+    // and the answers being read or sent
+    struct QueryServer {
+        MPI_Request incoming = MPI_REQUEST_NULL;
+        QueryRequest request;
+        bool serving = false;
+        std::optional<seastar::future<>> loop;
+        seastar::gate answering;
+
+        void take(int source) {
+            (void)seastar::with_gate(answering, [source, arrived = request] {
+                return reply(source, arrived);
+            });
+        }
+
+        // Starts answering every query that has arrived
+        void poll() {
+            const Directory& ranks = directory();
+            for (;;) {
+                if (incoming == MPI_REQUEST_NULL) {
+                    MPI_Irecv(&request, sizeof(QueryRequest), MPI_BYTE, MPI_ANY_SOURCE, QUERY_TAG, ranks.queries, &incoming);
+                }
+                int arrived = 0;
+                MPI_Status status;
+                MPI_Test(&incoming, &arrived, &status);
+                if (!arrived) {
+                    return;
+                }
+                take(status.MPI_SOURCE);
+            }
+        }
+
+        // Withdraws the posted receive, answering a query that got in first
+        void cancel() {
+            if (incoming == MPI_REQUEST_NULL) {
+                return;
+            }
+            MPI_Status status;
+            int cancelled = 0;
+            MPI_Cancel(&incoming);
+            MPI_Wait(&incoming, &status);
+            MPI_Test_cancelled(&status, &cancelled);
+            if (!cancelled) {
+                take(status.MPI_SOURCE);
+            }
+        }
+    };
+
+    QueryServer& queryServer() {
+        static QueryServer server;
+        return server;
+    }
+}
+
+void MPIController::initialize() {
+    // Once per process, so a second caller on another thread makes no MPI calls at all
+    static std::once_flag started;
+    std::call_once(started, [] {
+        int initialized = 0;
+        int provided = MPI_THREAD_SINGLE;
+        MPI_Initialized(&initialized);
+        if (initialized) {
+            MPI_Query_thread(&provided);
+        } else {
+            MPI_Init_thread(nullptr, nullptr, MPI_THREAD_SERIALIZED, &provided);
+        }
+        if (provided < MPI_THREAD_SERIALIZED) {
+            throw std::runtime_error("MPI provides thread level " + std::to_string(provided) +
+                                     "; the Director needs MPI_THREAD_SERIALIZED");
+        }
+        int rank;
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        worldRank = rank;
+    });
+}
 
-    if (current_ip == target_ip) {
-        result = func();
+int MPIController::localRank() {
+    int rank = worldRank;
+    if (rank < 0) {
+        throw std::runtime_error("MPI has not been initialized");
     }
+    return rank;
+}
+
+seastar::future<> MPIController::buildDirectory() {
+    return seastar::smp::submit_to(MPI_SHARD, [] {
+        if (builtDirectory()) {
+            return seastar::make_ready_future<>();
+        }
+        auto local = std::make_unique<HostRecord>();
+        *local = {};
+        try {
+            SystemMetrics systemMetrics;
+            systemMetrics.getIpAddress().copy(local->ip, sizeof(local->ip) - 1);
+        } catch (const std::runtime_error&) {
+            // Still found by hostname; the other ranks are waiting in the Allgather
+        }
+        gethostname(local->hostname, sizeof(local->hostname) - 1);
+
+        int worldSize;
+        auto result = std::make_unique<Directory>();
+        MPI_Comm_rank(MPI_COMM_WORLD, &result->self);
+        MPI_Comm_size(MPI_COMM_WORLD, &worldSize);
+        auto records = std::make_unique<std::vector<HostRecord>>(worldSize);
+
+        // Both collectives are posted in the same order on every rank, so they match up
+        MPI_Request gathering;
+        MPI_Request duplicating;
+        MPI_Iallgather(local.get(), sizeof(HostRecord), MPI_BYTE, records->data(), sizeof(HostRecord), MPI_BYTE,
+                       MPI_COMM_WORLD, &gathering);
+        MPI_Comm_idup(MPI_COMM_WORLD, &result->queries, &duplicating);
+        seastar::future<> gathered = progress().wait(gathering);
+        seastar::future<> duplicated = progress().wait(duplicating);
+        return gathered.then([duplicated = std::move(duplicated)]() mutable {
+            return std::move(duplicated);
+        }).then([local = std::move(local), records = std::move(records), result = std::move(result), worldSize] {
+            for (int rank = 0; rank < worldSize; ++rank) {
+                RankAddress address{(*records)[rank].ip, (*records)[rank].hostname};
+                if (!address.ip.empty()) {
+                    result->byName.emplace(address.ip, rank);
+                }
+                if (result->byName.emplace(address.hostname, rank).second) {
+                    result->hosts.push_back(rank);
+                }
+                result->ranks.push_back(std::move(address));
+            }
+            builtDirectory() = std::move(*result);
+        });
+    });
+}
+
+const std::vector<RankAddress>& MPIController::rankAddresses() {
+    return directory().ranks;
+}
+
+int MPIController::rankOf(const std::string& node) {
+    const Directory& ranks = directory();
+    auto found = ranks.byName.find(node);
+    return found == ranks.byName.end() ? -1 : found->second;
+}
+
+const std::string& MPIController::localIp() {
+    const Directory& ranks = directory();
+    return ranks.ranks[ranks.self].ip;
+}
+
+seastar::future<> MPIController::serveQueries() {
+    return seastar::smp::submit_to(MPI_SHARD, [] {
+        QueryServer& server = queryServer();
+        if (server.loop) {
+            return;
+        }
+        directory();
+        server.serving = true;
+        server.loop = seastar::do_until([&server] { return !server.serving; }, [&server] {
+            server.poll();
+            progress().idle();
+            return seastar::sleep(QUERY_POLL_INTERVAL);
+        });
+    });
+}
+
+seastar::future<> MPIController::stopServing() {
+    return seastar::smp::submit_to(MPI_SHARD, [] {
+        QueryServer& server = queryServer();
+        if (!server.loop) {
+            return seastar::make_ready_future<>();
+        }
+        server.serving = false;
+        seastar::future<> loop = std::move(*server.loop);
+        server.loop.reset();
+        return loop.then([&server] {
+            server.cancel();
+            return server.answering.close();
+        });
+    });
+}
 
-    double global_result = 0.0;
-    MPI_Reduce(&result, &global_result, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+seastar::future<NodeQueryValues> MPIController::queryRank(int rank, NodeQuery query, unsigned int gpuIndex,
+                                                          std::vector<std::string> arguments) {
+    return seastar::smp::submit_to(MPI_SHARD, [rank, query, gpuIndex, arguments = std::move(arguments)] {
+        const Directory& ranks = directory();
 
-    if (current_ip == target_ip) {
-        return global_result;
+        auto request = std::make_unique<QueryRequest>();
+        *request = {};
+        request->query = query;
+        request->gpuIndex = gpuIndex;
+        request->sequence = nextSequence();
+        request->answerTag = answerTag(request->sequence);
+        for (size_t i = 0; i < arguments.size() && i < QUERY_ARGUMENTS; ++i) {
+            if (arguments[i].size() >= ARGUMENT_BYTES) {
+                return seastar::make_exception_future<NodeQueryValues>(std::runtime_error(
+                    "Query argument longer than " + std::to_string(ARGUMENT_BYTES - 1) + " bytes"));
+            }
+            arguments[i].copy(request->arguments[i], ARGUMENT_BYTES - 1);
+        }
+        if (rank == ranks.self) {
+            return answer(*request);
+        }
+
+        auto reply = std::make_unique<QueryAnswer>();
+        MPI_Request receiving;
+        MPI_Request sending;
+        MPI_Irecv(reply.get(), sizeof(QueryAnswer), MPI_BYTE, rank, request->answerTag, ranks.queries, &receiving);
+        MPI_Isend(request.get(), sizeof(QueryRequest), MPI_BYTE, rank, QUERY_TAG, ranks.queries, &sending);
+        seastar::future<> received = progress().wait(receiving);
+        seastar::future<> sent = progress().wait(sending);
+        return sent.then([received = std::move(received)]() mutable {
+            return std::move(received);
+        }).then([request = std::move(request), reply = std::move(reply), rank] {
+            if (reply->failed || reply->sequence != request->sequence) {
+                throw std::runtime_error("Query " + std::to_string(static_cast<int>(request->query)) + " failed on rank " +
+                                         std::to_string(rank) + " (" + directory().ranks[rank].ip + ")");
+            }
+            return reply->values;
+        });
+    });
+}
+
+seastar::future<double> MPIController::queryNode(const std::string& target_ip, NodeQuery query, unsigned int gpuIndex,
+                                                 std::vector<std::string> arguments) {
+    int target = rankOf(target_ip);
+    if (target < 0) {
+        return seastar::make_ready_future<double>(0.0);
     }
+    return queryRank(target, query, gpuIndex, std::move(arguments)).then([](NodeQueryValues values) {
+        return values[0];
+    });
+}
 
-    return 0.0;
+seastar::future<NodeFrame> MPIController::queryFrame(int rank, NodeQuery query) {
+    return seastar::smp::submit_to(MPI_SHARD, [rank, query] {
+        const Directory& ranks = directory();
+        auto request = std::make_unique<QueryRequest>();
+        *request = {};
+        request->query = query;
+        request->sequence = nextSequence();
+        request->answerTag = answerTag(request->sequence);
+        if (rank == ranks.self) {
+            return answerFrame(*request);
+        }
+
+        auto reply = std::make_unique<NodeFrame>();
+        MPI_Request receiving;
+        MPI_Request sending;
+        MPI_Irecv(reply.get(), 1, frameType(), rank, request->answerTag, ranks.queries, &receiving);
+        MPI_Isend(request.get(), sizeof(QueryRequest), MPI_BYTE, rank, QUERY_TAG, ranks.queries, &sending);
+        seastar::future<> received = progress().wait(receiving);
+        seastar::future<> sent = progress().wait(sending);
+        return sent.then([received = std::move(received)]() mutable {
+            return std::move(received);
+        }).then([request = std::move(request), reply = std::move(reply), rank] {
+            if (reply->node[0] == '\0') {
+                throw std::runtime_error("Query " + std::to_string(static_cast<int>(request->query)) + " failed on rank " +
+                                         std::to_string(rank) + " (" + directory().ranks[rank].ip + ")");
+            }
+            return *reply;
+        });
+    });
 }
 
-float MPIController::mpiGetGpuTemperature(const std::string& target_ip, unsigned int gpuIndex) {
-    return mpiWrapperFunction(target_ip, SystemMetrics::getGpuTemperature, gpuIndex);
+seastar::future<float> MPIController::mpiGetGpuTemperature(const std::string& target_ip, unsigned int gpuIndex) {
+    return queryNode(target_ip, NodeQuery::GPU_TEMPERATURE, gpuIndex).then([](double value) { return static_cast<float>(value); });
 }
 
-float MPIController::mpiGetGpuUsage(const std::string& target_ip, unsigned int gpuIndex) {
-    return mpiWrapperFunction(target_ip, SystemMetrics::getGpuUsage, gpuIndex);
+seastar::future<float> MPIController::mpiGetGpuUsage(const std::string& target_ip, unsigned int gpuIndex) {
+    return queryNode(target_ip, NodeQuery::GPU_USAGE, gpuIndex).then([](double value) { return static_cast<float>(value); });
 }
 
-float MPIController::mpiGetGpuMemoryUsage(const std::string& target_ip, unsigned int gpuIndex) {
-    return mpiWrapperFunction(target_ip, SystemMetrics::getGpuMemoryUsage, gpuIndex);
+seastar::future<float> MPIController::mpiGetGpuMemoryUsage(const std::string& target_ip, unsigned int gpuIndex) {
+    return queryNode(target_ip, NodeQuery::GPU_MEMORY_USAGE, gpuIndex).then([](double value) { return static_cast<float>(value); });
 }
 
-float MPIController::mpiGetGpuPowerUsage(const std::string& target_ip, unsigned int gpuIndex) {
-    return mpiWrapperFunction(target_ip, SystemMetrics::getGpuPowerUsage, gpuIndex);
+seastar::future<float> MPIController::mpiGetGpuPowerUsage(const std::string& target_ip, unsigned int gpuIndex) {
+    return queryNode(target_ip, NodeQuery::GPU_POWER_USAGE, gpuIndex).then([](double value) { return static_cast<float>(value); });
 }
 
-float MPIController::mpiGetGpuFanSpeed(const std::string& target_ip, unsigned int gpuIndex) {
-    return mpiWrapperFunction(target_ip, NvidiaGPUInfo::getGpuFanSpeed, gpuIndex);
+seastar::future<float> MPIController::mpiGetGpuFanSpeed(const std::string& target_ip, unsigned int gpuIndex) {
+    return queryNode(target_ip, NodeQuery::GPU_FAN_SPEED, gpuIndex).then([](double value) { return static_cast<float>(value); });
 }
 
-float MPIController::mpiGetGpuCoreClock(const std::string& target_ip, unsigned int gpuIndex) {
-    return mpiWrapperFunction(target_ip, SystemMetrics::getGpuCoreClock, gpuIndex);
+seastar::future<float> MPIController::mpiGetGpuCoreClock(const std::string& target_ip, unsigned int gpuIndex) {
+    return queryNode(target_ip, NodeQuery::GPU_CORE_CLOCK, gpuIndex).then([](double value) { return static_cast<float>(value); });
 }
 
-float MPIController::mpiGetGpuMemoryClock(const std::string& target_ip, unsigned int gpuIndex) {
-    return mpiWrapperFunction(target_ip, SystemMetrics::getGpuMemoryClock, gpuIndex);
+seastar::future<float> MPIController::mpiGetGpuMemoryClock(const std::string& target_ip, unsigned int gpuIndex) {
+    return queryNode(target_ip, NodeQuery::GPU_MEMORY_CLOCK, gpuIndex).then([](double value) { return static_cast<float>(value); });
 }
 
-double MPIController::mpiGetAvailableMemory(const std::string& target_ip) {
-    return mpiWrapperFunction(target_ip, SystemMetrics::getAvailableMemory);
+seastar::future<double> MPIController::mpiGetAvailableMemory(const std::string& target_ip) {
+    return queryNode(target_ip, NodeQuery::AVAILABLE_MEMORY);
 }
 
-// New gpuMetrics function
-seastar::future<std::unordered_map<std::string, float>> MPIController::gpuMetrics(const std::string& target_ip, unsigned int gpuIndex) {
-    return seastar::async([=] {
-        std::unordered_map<std::string, float> metrics;
-        metrics["GpuTemperature"] = mpiGetGpuTemperature(target_ip, gpuIndex);
-        metrics["GpuUsage"] = mpiGetGpuUsage(target_ip, gpuIndex);
-        metrics["GpuMemoryUsage"] = mpiGetGpuMemoryUsage(target_ip, gpuIndex);
-        metrics["GpuPowerUsage"] = mpiGetGpuPowerUsage(target_ip, gpuIndex);
-        metrics["GpuFanSpeed"] = mpiGetGpuFanSpeed(target_ip, gpuIndex);
-        metrics["GpuCoreClock"] = mpiGetGpuCoreClock(target_ip, gpuIndex);
-        metrics["GpuMemoryClock"] = mpiGetGpuMemoryClock(target_ip, gpuIndex);
-        return metrics;
+seastar::future<MetricFrame> MPIController::gpuMetrics(const std::string& target_ip) {
+    int target = rankOf(target_ip);
+    if (target < 0) {
+        return seastar::make_ready_future<MetricFrame>();
+    }
+    return queryFrame(target, NodeQuery::GPU_FRAME).then([](NodeFrame answer) {
+        return answer.frame;
     });
 }
 
-double MPIController::mpiGetAvailableMemory(const std::string& target_ip) {
-    return mpiWrapperFunction(target_ip, SystemMetrics::getAvailableMemory);
+void MPIController::onStallReport(StallHandler handler) {
+    stallHandler() = std::move(handler);
 }
 
-// New MPI wrapper function for getCpuTemperature
-double MPIController::getCpuTemperatureMPI(const std::string& ipAddress, const std::string& processName) {
-    // Assuming the MPI wrapper function is implemented correctly to call the SystemMetrics function
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getCpuTemperature);
+seastar::future<> MPIController::reportStall(int leaderRank) {
+    return queryRank(leaderRank, NodeQuery::STALL_REPORT, 0, {localIp()}).discard_result();
 }
 
-double MPIController::getSwapUsageMPI(const std::string& ipAddress, const std::string& processName) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getSwapUsage);
+seastar::future<std::vector<NodeFrame>> MPIController::collectNodeFrames() {
+    std::vector<seastar::future<std::optional<NodeFrame>>> asked;
+    for (int rank : directory().hosts) {
+        asked.push_back(queryFrame(rank, NodeQuery::NODE_FRAME).then_wrapped([](seastar::future<NodeFrame> answered) {
+            try {
+                return std::optional<NodeFrame>(answered.get());
+            } catch (const std::exception&) {
+                return std::optional<NodeFrame>(); // Left out of this round
+            }
+        }));
+    }
+    return seastar::when_all_succeed(asked.begin(), asked.end()).then([](std::vector<std::optional<NodeFrame>> answers) {
+        std::vector<NodeFrame> frames;
+        frames.reserve(answers.size());
+        for (std::optional<NodeFrame>& answer : answers) {
+            if (answer) {
+                frames.push_back(*answer);
+            }
+        }
+        return frames;
+    });
 }
 
-double MPIController::getMemoryPageFaultsMPI(const std::string& ipAddress, const std::string& processName) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getMemoryPageFaults);
+seastar::future<double> MPIController::sumOverHosts(NodeQuery query, const std::string& processName) {
+    std::vector<seastar::future<double>> asked;
+    for (int rank : directory().hosts) {
+        asked.push_back(queryRank(rank, query, 0, {processName}).then_wrapped([](seastar::future<NodeQueryValues> answered) {
+            try {
+                return answered.get()[0];
+            } catch (const std::exception&) {
+                return 0.0; // A host that cannot be read adds nothing this round
+            }
+        }));
+    }
+    return seastar::when_all_succeed(asked.begin(), asked.end()).then([](std::vector<double> perHost) {
+        double total = 0.0;
+        for (double value : perHost) {
+            total += value;
+        }
+        return total;
+    });
 }
 
-double MPIController::getDiskLatencyMPI(const std::string& ipAddress, const std::string& processName, const std::string& disk) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getDiskLatency, disk);
+seastar::future<double> MPIController::getCpuUsageMPI(const std::string& processName) {
+    return sumOverHosts(NodeQuery::WORKLOAD_CPU, processName);
 }
 
-double MPIController::getDiskSpaceUtilizationMPI(const std::string& ipAddress, const std::string& processName, const std::string& path) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getDiskSpaceUtilization, path);
+seastar::future<double> MPIController::getMemoryUsageMPI(const std::string& processName) {
+    return sumOverHosts(NodeQuery::WORKLOAD_MEMORY, processName);
 }
 
-double MPIController::getNetworkBandwidthUtilizationMPI(const std::string& ipAddress, const std::string& processName, const std::string& interface) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getNetworkBandwidthUtilization, interface);
+seastar::future<double> MPIController::getIoUsageMPI(const std::string& processName) {
+    return sumOverHosts(NodeQuery::WORKLOAD_IO_PRESSURE, processName);
 }
 
-double MPIController::getNetworkLatencyMPI(const std::string& ipAddress, const std::string& processName, const std::string& interface) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getNetworkLatency, interface);
+seastar::future<PerfSample> MPIController::getPerfCountersMPI(const std::string& processName) {
+    std::vector<seastar::future<PerfSample>> asked;
+    for (int rank : directory().hosts) {
+        asked.push_back(queryRank(rank, NodeQuery::WORKLOAD_PERF_COUNTERS, 0, {processName}).then_wrapped(
+                [](seastar::future<NodeQueryValues> answered) {
+            PerfSample perf;
+            try {
+                NodeQueryValues values = answered.get();
+                perf.cycles = static_cast<uint64_t>(values[0]);
+                perf.instructions = static_cast<uint64_t>(values[1]);
+                perf.cacheMisses = static_cast<uint64_t>(values[2]);
+                perf.taskClockNs = static_cast<uint64_t>(values[3]);
+                perf.contextSwitches = static_cast<uint64_t>(values[4]);
+                perf.pageFaults = static_cast<uint64_t>(values[5]);
+                perf.hardware = values[6] != 0.0;
+            } catch (const std::exception&) {
+                // A host that cannot be read adds nothing this round
+            }
+            return perf;
+        }));
+    }
+    // Counts are summed rather than the ratios, so IPC and MPKI are weighted by how much
+    // each host's share of the workload actually ran
+    return seastar::when_all_succeed(asked.begin(), asked.end()).then([](std::vector<PerfSample> perHost) {
+        PerfSample total;
+        for (const PerfSample& perf : perHost) {
+            total.cycles += perf.cycles;
+            total.instructions += perf.instructions;
+            total.cacheMisses += perf.cacheMisses;
+            total.taskClockNs += perf.taskClockNs;
+            total.contextSwitches += perf.contextSwitches;
+            total.pageFaults += perf.pageFaults;
+            total.hardware = total.hardware || perf.hardware;
+        }
+        return total;
+    });
 }
 
-double MPIController::getNetworkErrorsMPI(const std::string& ipAddress, const std::string& processName, const std::string& interface) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getNetworkErrors, interface);
+seastar::future<GpuWorkloadUsage> MPIController::getGpuUsageMPI(const std::string& processName) {
+    std::vector<seastar::future<GpuWorkloadUsage>> asked;
+    for (int rank : directory().hosts) {
+        asked.push_back(queryRank(rank, NodeQuery::WORKLOAD_GPU_USAGE, 0, {processName}).then_wrapped(
+                [](seastar::future<NodeQueryValues> answered) {
+            GpuWorkloadUsage gpu;
+            try {
+                NodeQueryValues values = answered.get();
+                gpu.processes = static_cast<unsigned int>(values[0]);
+                gpu.memoryUsed = static_cast<uint64_t>(values[1]);
+                gpu.smUtilization = values[2];
+                gpu.memoryUtilization = values[3];
+                gpu.encoderUtilization = values[4];
+                gpu.decoderUtilization = values[5];
+            } catch (const std::exception&) {
+                // A host that cannot be read adds nothing this round
+            }
+            return gpu;
+        }));
+    }
+    return seastar::when_all_succeed(asked.begin(), asked.end()).then([](std::vector<GpuWorkloadUsage> perHost) {
+        GpuWorkloadUsage total;
+        for (const GpuWorkloadUsage& gpu : perHost) {
+            total.processes += gpu.processes;
+            total.memoryUsed += gpu.memoryUsed;
+            total.smUtilization = std::max(total.smUtilization, gpu.smUtilization);
+            total.memoryUtilization = std::max(total.memoryUtilization, gpu.memoryUtilization);
+            total.encoderUtilization = std::max(total.encoderUtilization, gpu.encoderUtilization);
+            total.decoderUtilization = std::max(total.decoderUtilization, gpu.decoderUtilization);
+        }
+        return total;
+    });
 }
 
-double MPIController::getPacketLossMPI(const std::string& ipAddress, const std::string& processName, const std::string& interface) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getPacketLoss, interface);
+seastar::future<MetricFrame> MPIController::postgresMetrics(const std::string& db) {
+    AsyncPgProbe& probe = AsyncPgProbe::forShard(db);
+    // transactionRate() probes, so every other value comes from that same round trip
+    return probe.transactionRate().then([&probe](double transactionRate) {
+        const PgProbeSnapshot& snapshot = *probe.lastSnapshot();
+        MetricFrame metrics;
+        metrics.timestampMicros = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+        metrics.set(MetricId::POSTGRES_TRANSACTION_RATE, transactionRate);
+        metrics.set(MetricId::POSTGRES_QUERY_LATENCY, snapshot.latencySeconds);
+        metrics.set(MetricId::POSTGRES_CACHE_HIT_RATIO, snapshot.cacheHitRatio);
+        metrics.set(MetricId::POSTGRES_POOL_UTILIZATION, snapshot.poolUtilization);
+        metrics.set(MetricId::POSTGRES_BUFFERS_CHECKPOINT, snapshot.buffersCheckpoint);
+        metrics.set(MetricId::POSTGRES_BUFFERS_CLEAN, snapshot.buffersClean);
+        metrics.set(MetricId::POSTGRES_BUFFERS_BACKEND, snapshot.buffersBackend);
+        if (auto connect = probe.connectLatency()) {
+            metrics.set(MetricId::POSTGRES_CONNECT_LATENCY, *connect);
+        }
+        return metrics;
+    });
 }
 
-int MPIController::getActiveConnectionsMPI(const std::string& ipAddress, const std::string& processName, const std::string& interface) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getActiveConnections, interface);
+seastar::future<double> MPIController::getCpuTemperatureMPI(const std::string& ipAddress, const std::string& processName) {
+    return queryNode(ipAddress, NodeQuery::CPU_TEMPERATURE);
 }
 
-double MPIController::getApplicationResponseTimeMPI(const std::string& ipAddress, const std::string& processName, const std::string& app) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getApplicationResponseTime, app);
+seastar::future<double> MPIController::getSwapUsageMPI(const std::string& ipAddress, const std::string& processName) {
+    return queryNode(ipAddress, NodeQuery::SWAP_USAGE);
 }
 
-double MPIController::getApplicationErrorRateMPI(const std::string& ipAddress, const std::string& processName, const std::string& app) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getApplicationErrorRate, app);
+seastar::future<double> MPIController::getMemoryPageFaultsMPI(const std::string& ipAddress, const std::string& processName) {
+    return queryNode(ipAddress, NodeQuery::MEMORY_PAGE_FAULTS);
 }
 
-double MPIController::getRequestRateMPI(const std::string& ipAddress, const std::string& processName, const std::string& app) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getRequestRate, app);
+seastar::future<double> MPIController::getDiskLatencyMPI(const std::string& ipAddress, const std::string& processName, const std::string& disk) {
+    return queryNode(ipAddress, NodeQuery::DISK_LATENCY, 0, {disk});
 }
 
-double MPIController::getThroughputMPI(const std::string& ipAddress, const std::string& processName, const std::string& app) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getThroughput, app);
+seastar::future<double> MPIController::getDiskSpaceUtilizationMPI(const std::string& ipAddress, const std::string& processName, const std::string& path) {
+    return queryNode(ipAddress, NodeQuery::DISK_SPACE_UTILIZATION, 0, {path});
 }
 
-double MPIController::getQueryPerformanceMPI(const std::string& ipAddress, const std::string& processName, const std::string& db) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getQueryPerformance, db);
+seastar::future<double> MPIController::getNetworkBandwidthUtilizationMPI(const std::string& ipAddress, const std::string& processName, const std::string& interface) {
+    return queryNode(ipAddress, NodeQuery::NETWORK_BANDWIDTH_UTILIZATION, 0, {interface});
 }
 
-double MPIController::getConnectionPoolUtilizationMPI(const std::string& ipAddress, const std::string& processName, const std::string& db) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getConnectionPoolUtilization, db);
+seastar::future<double> MPIController::getNetworkLatencyMPI(const std::string& ipAddress, const std::string& processName, const std::string& interface) {
+    return queryNode(ipAddress, NodeQuery::NETWORK_LATENCY, 0, {interface});
 }
 
-double MPIController::getCacheHitMissRateMPI(const std::string& ipAddress, const std::string& processName, const std::string& db) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getCacheHitMissRate, db);
+seastar::future<double> MPIController::getNetworkErrorsMPI(const std::string& ipAddress, const std::string& processName, const std::string& interface) {
+    return queryNode(ipAddress, NodeQuery::NETWORK_ERRORS, 0, {interface});
 }
 
-double MPIController::getTransactionRateMPI(const std::string& ipAddress, const std::string& processName, const std::string& db) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getTransactionRate, db);
+seastar::future<double> MPIController::getPacketLossMPI(const std::string& ipAddress, const std::string& processName, const std::string& interface) {
+    return queryNode(ipAddress, NodeQuery::PACKET_LOSS, 0, {interface});
 }
 
-int MPIController::getFailedLoginAttemptsMPI(const std::string& ipAddress, const std::string& processName) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getFailedLoginAttempts);
+seastar::future<int> MPIController::getActiveConnectionsMPI(const std::string& ipAddress, const std::string& processName, const std::string& interface) {
+    return queryNode(ipAddress, NodeQuery::ACTIVE_CONNECTIONS, 0, {interface}).then([](double value) { return static_cast<int>(value); });
 }
 
-int MPIController::getIntrusionDetectionAlertsMPI(const std::string& ipAddress, const std::string& processName) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getIntrusionDetectionAlerts);
+seastar::future<double> MPIController::getApplicationResponseTimeMPI(const std::string& ipAddress, const std::string& processName, const std::string& app) {
+    return queryNode(ipAddress, NodeQuery::APPLICATION_RESPONSE_TIME, 0, {app});
 }
 
-int MPIController::getFirewallLogEntriesMPI(const std::string& ipAddress, const std::string& processName) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getFirewallLogEntries);
+seastar::future<double> MPIController::getApplicationErrorRateMPI(const std::string& ipAddress, const std::string& processName, const std::string& app) {
+    return queryNode(ipAddress, NodeQuery::APPLICATION_ERROR_RATE, 0, {app});
 }
 
-int MPIController::getVulnerabilityScansMPI(const std::string& ipAddress, const std::string& processName) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getVulnerabilityScans);
+seastar::future<double> MPIController::getRequestRateMPI(const std::string& ipAddress, const std::string& processName, const std::string& app) {
+    return queryNode(ipAddress, NodeQuery::REQUEST_RATE, 0, {app});
 }
 
-double MPIController::getInstanceTypeUtilizationMPI(const std::string& ipAddress, const std::string& processName) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getInstanceTypeUtilization);
+seastar::future<double> MPIController::getThroughputMPI(const std::string& ipAddress, const std::string& processName, const std::string& app) {
+    return queryNode(ipAddress, NodeQuery::THROUGHPUT, 0, {app});
 }
 
-/// aasdf
-double MPIController::getInstanceTypeUtilizationMPI(const std::string& ipAddress, const std::string& processName) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getInstanceTypeUtilization);
+seastar::future<double> MPIController::getQueryPerformanceMPI(const std::string& ipAddress, const std::string& processName, const std::string& db) {
+    return queryNode(ipAddress, NodeQuery::QUERY_PERFORMANCE, 0, {db});
 }
 
-double MPIController::getAutoScalingMetricsMPI(const std::string& ipAddress, const std::string& processName) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getAutoScalingMetrics);
+seastar::future<double> MPIController::getConnectionPoolUtilizationMPI(const std::string& ipAddress, const std::string& processName, const std::string& db) {
+    return queryNode(ipAddress, NodeQuery::CONNECTION_POOL_UTILIZATION, 0, {db});
 }
 
-double MPIController::getResourceReservationsMPI(const std::string& ipAddress, const std::string& processName) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getResourceReservations);
+seastar::future<double> MPIController::getCacheHitMissRateMPI(const std::string& ipAddress, const std::string& processName, const std::string& db) {
+    return queryNode(ipAddress, NodeQuery::CACHE_HIT_MISS_RATE, 0, {db});
 }
 
-double MPIController::getPowerUsageMPI(const std::string& ipAddress, const std::string& processName) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getPowerUsage);
+seastar::future<double> MPIController::getTransactionRateMPI(const std::string& ipAddress, const std::string& processName, const std::string& db) {
+    return queryNode(ipAddress, NodeQuery::TRANSACTION_RATE, 0, {db});
 }
 
-double MPIController::getEnergyEfficiencyMPI(const std::string& ipAddress, const std::string& processName) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::getEnergyEfficiency);
+seastar::future<int> MPIController::getFailedLoginAttemptsMPI(const std::string& ipAddress, const std::string& processName) {
+    return queryNode(ipAddress, NodeQuery::FAILED_LOGIN_ATTEMPTS).then([](double value) { return static_cast<int>(value); });
 }
 
-bool MPIController::shouldScaleMPI(const std::string& ipAddress, const std::string& instance, const std::string& app, const std::string& disk, const std::string& interface) {
-    return mpiWrapperFunction(ipAddress, SystemMetrics::shouldScale, instance, app, disk, interface);
+seastar::future<int> MPIController::getIntrusionDetectionAlertsMPI(const std::string& ipAddress, const std::string& processName) {
+    return queryNode(ipAddress, NodeQuery::INTRUSION_DETECTION_ALERTS).then([](double value) { return static_cast<int>(value); });
+}
+
+seastar::future<int> MPIController::getFirewallLogEntriesMPI(const std::string& ipAddress, const std::string& processName) {
+    return queryNode(ipAddress, NodeQuery::FIREWALL_LOG_ENTRIES).then([](double value) { return static_cast<int>(value); });
+}
+
+seastar::future<int> MPIController::getVulnerabilityScansMPI(const std::string& ipAddress, const std::string& processName) {
+    return queryNode(ipAddress, NodeQuery::VULNERABILITY_SCANS).then([](double value) { return static_cast<int>(value); });
+}
+
+seastar::future<double> MPIController::getInstanceTypeUtilizationMPI(const std::string& ipAddress, const std::string& processName) {
+    return queryNode(ipAddress, NodeQuery::INSTANCE_TYPE_UTILIZATION);
+}
+
+seastar::future<double> MPIController::getAutoScalingMetricsMPI(const std::string& ipAddress, const std::string& processName) {
+    return queryNode(ipAddress, NodeQuery::AUTO_SCALING_METRICS);
+}
+
+seastar::future<double> MPIController::getResourceReservationsMPI(const std::string& ipAddress, const std::string& processName) {
+    return queryNode(ipAddress, NodeQuery::RESOURCE_RESERVATIONS);
+}
+
+seastar::future<double> MPIController::getPowerUsageMPI(const std::string& ipAddress, const std::string& processName) {
+    return queryNode(ipAddress, NodeQuery::POWER_USAGE);
+}
+
+seastar::future<double> MPIController::getEnergyEfficiencyMPI(const std::string& ipAddress, const std::string& processName) {
+    return queryNode(ipAddress, NodeQuery::ENERGY_EFFICIENCY);
+}
+
+seastar::future<bool> MPIController::shouldScaleMPI(const std::string& ipAddress, const std::string& instance, const std::string& app, const std::string& disk, const std::string& interface) {
+    return queryNode(ipAddress, NodeQuery::SHOULD_SCALE, 0, {instance, app, disk, interface}).then([](double value) {
+        return value != 0.0;
+    });
 }
\ No newline at end of file
@@ -0,0 +1,739 @@
+#include "MetricArchive.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <tuple>
+#include <unistd.h>
+#include <unordered_map>
+
+using namespace metric_archive;
+
+namespace {
+    size_t alignUp(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    bool slotPresent(const MetricFrame& frame, size_t slot) {
+        return (frame.present[slot / 64] >> (slot % 64)) & 1u;
+    }
+
+    // Set once by openShared(); appendShared() reads it from every shard
+    std::unique_ptr<MetricArchiveWriter> sharedWriter;
+    std::atomic<MetricArchiveWriter*> sharedOpen{nullptr};
+
+    std::string errnoText() {
+        return std::string(strerror(errno));
+    }
+
+    void makeDirectories(const std::string& path) {
+        for (size_t slash = path.find('/', 1);; slash = path.find('/', slash + 1)) {
+            std::string prefix = path.substr(0, slash);
+            if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) {
+                throw std::runtime_error("Failed to create " + prefix + ": " + errnoText());
+            }
+            if (slash == std::string::npos) {
+                return;
+            }
+        }
+    }
+
+    // Day start for a YYYYMMDD.metrics name, or for one the writer moved aside as
+    // YYYYMMDD.metrics.<mtime>.old; false for any other file
+    bool parsePartitionFileName(const char* name, uint64_t& startMicros, bool& movedAside) {
+        struct tm day = {};
+        const char* rest = strptime(name, "%Y%m%d", &day);
+        if (!rest || rest != name + 8 || std::strncmp(rest, ".metrics", 8) != 0) {
+            return false;
+        }
+        rest += 8;
+        movedAside = *rest != '\0';
+        if (movedAside) {
+            size_t digits = std::strspn(rest + 1, "0123456789");
+            if (*rest != '.' || digits == 0 || std::strcmp(rest + 1 + digits, ".old") != 0) {
+                return false;
+            }
+        }
+        time_t seconds = timegm(&day);
+        if (seconds < 0) {
+            return false;
+        }
+        startMicros = static_cast<uint64_t>(seconds) * 1000000;
+        return true;
+    }
+
+    constexpr size_t metricTableBytes() {
+        size_t bytes = 0;
+        for (const MetricTraits& traits : METRIC_SCHEMA) {
+            bytes += 2 * sizeof(uint16_t) + std::char_traits<char>::length(traits.name);
+        }
+        return bytes;
+    }
+
+    static_assert(sizeof(FileHeader) + metricTableBytes() <= ALIGNMENT, "The metric table must fit the header page");
+
+    void writeMetricTable(uint8_t* out) {
+        for (size_t i = 0; i < METRIC_COUNT; ++i) {
+            uint16_t slots = static_cast<uint16_t>(METRIC_OFFSETS[i + 1] - METRIC_OFFSETS[i]);
+            uint16_t length = static_cast<uint16_t>(std::strlen(METRIC_SCHEMA[i].name));
+            std::memcpy(out, &slots, sizeof(slots));
+            std::memcpy(out + sizeof(slots), &length, sizeof(length));
+            std::memcpy(out + 2 * sizeof(uint16_t), METRIC_SCHEMA[i].name, length);
+            out += 2 * sizeof(uint16_t) + length;
+        }
+    }
+
+    // The slot a file written with another schema keeps the queried metric in, by name
+    // from its metric table, or -1 when that schema has no such slot
+    int64_t mappedSlot(const FileHeader& header, const uint8_t* table, MetricId id, unsigned int gpu) {
+        const MetricTraits& traits = metricTraits(id);
+        size_t limit = std::min<size_t>(header.metricTableBytes, ALIGNMENT - sizeof(FileHeader));
+        size_t offset = 0;
+        int64_t slot = 0;
+        for (uint32_t i = 0; i < header.metrics && offset + 2 * sizeof(uint16_t) <= limit; ++i) {
+            uint16_t slots, length;
+            std::memcpy(&slots, table + offset, sizeof(slots));
+            std::memcpy(&length, table + offset + sizeof(slots), sizeof(length));
+            offset += 2 * sizeof(uint16_t);
+            if (offset + length > limit) {
+                break;
+            }
+            if (std::string_view(reinterpret_cast<const char*>(table + offset), length) == traits.name) {
+                if (traits.perGpu) {
+                    return gpu < slots ? slot + gpu : -1;
+                }
+                return slots == 1 ? slot : -1;
+            }
+            offset += length;
+            slot += slots;
+        }
+        return -1;
+    }
+
+    // Read-only mapping of a whole file
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::string& path) {
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                throw std::runtime_error("Failed to open " + path + ": " + errnoText());
+            }
+            struct stat info;
+            if (fstat(fd, &info) != 0) {
+                std::string error = errnoText();
+                close(fd);
+                throw std::runtime_error("Failed to stat " + path + ": " + error);
+            }
+            length = static_cast<size_t>(info.st_size);
+            if (length > 0) {
+                void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapped == MAP_FAILED) {
+                    std::string error = errnoText();
+                    close(fd);
+                    throw std::runtime_error("Failed to map " + path + ": " + error);
+                }
+                data = static_cast<const uint8_t*>(mapped);
+                madvise(mapped, length, MADV_SEQUENTIAL);
+            }
+            close(fd);
+        }
+
+        ~MappedFile() {
+            if (data) {
+                munmap(const_cast<uint8_t*>(data), length);
+            }
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const uint8_t* data = nullptr;
+        size_t length = 0;
+    };
+}
+
+std::string metric_archive::partitionFileName(uint64_t partitionStartMicros) {
+    time_t seconds = static_cast<time_t>(partitionStartMicros / 1000000);
+    struct tm day;
+    gmtime_r(&seconds, &day);
+    char name[32];
+    strftime(name, sizeof(name), "%Y%m%d.metrics", &day);
+    return name;
+}
+
+MetricArchiveWriter::MetricArchiveWriter(std::string directory, std::chrono::milliseconds flushInterval,
+                                         size_t maxPendingRows)
+    : directory(std::move(directory)), flushInterval(flushInterval), maxPendingRows(maxPendingRows),
+      buffer(nullptr, std::free) {
+    makeDirectories(this->directory);
+}
+
+MetricArchiveWriter::~MetricArchiveWriter() {
+    stop();
+    for (auto& [start, file] : partitions) {
+        close(file.fd);
+    }
+}
+
+void MetricArchiveWriter::openShared() {
+    static std::once_flag opened;
+    std::call_once(opened, [] {
+        const char* configured = std::getenv(DIRECTORY_ENV);
+        auto writer = std::make_unique<MetricArchiveWriter>(configured ? std::string(configured) : std::string(DEFAULT_DIRECTORY));
+        writer->start();
+        // Lives until exit, when its destructor writes what is still pending
+        sharedWriter = std::move(writer);
+        sharedOpen.store(sharedWriter.get(), std::memory_order_release);
+    });
+}
+
+void MetricArchiveWriter::appendShared(const std::string& node, const MetricFrame& frame) {
+    if (MetricArchiveWriter* writer = sharedOpen.load(std::memory_order_acquire)) {
+        writer->append(node, frame);
+    }
+}
+
+void MetricArchiveWriter::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running) {
+        return;
+    }
+    running = true;
+    worker = std::thread(&MetricArchiveWriter::run, this);
+}
+
+void MetricArchiveWriter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+    wakeup.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    try {
+        flush();
+    } catch (const std::runtime_error&) {
+        // Counted as dropped; nothing else to do on the way out
+    }
+}
+
+void MetricArchiveWriter::append(const std::string& node, const MetricFrame& frame) {
+    bool full;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending.size() >= maxPendingRows) {
+            ++dropped;
+            return;
+        }
+        pending.push_back({node, frame});
+        full = pending.size() >= SEGMENT_ROWS;
+    }
+    if (full) {
+        wakeup.notify_one();
+    }
+}
+
+void MetricArchiveWriter::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (running) {
+        wakeup.wait_for(lock, flushInterval, [this] { return !running || pending.size() >= SEGMENT_ROWS; });
+        lock.unlock();
+        try {
+            flush();
+        } catch (const std::runtime_error&) {
+            // The batch is counted as dropped; the next tick tries again with the next one
+        }
+        lock.lock();
+    }
+}
+
+void MetricArchiveWriter::flush() {
+    std::vector<Row> batch;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batch.swap(pending);
+    }
+    if (batch.empty()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(writeMutex);
+    auto older = [](const Row& a, const Row& b) { return a.frame.timestampMicros < b.frame.timestampMicros; };
+    if (!std::is_sorted(batch.begin(), batch.end(), older)) {
+        std::stable_sort(batch.begin(), batch.end(), older);
+    }
+
+    size_t done = 0;
+    try {
+        std::vector<uint64_t> touched;
+        while (done < batch.size()) {
+            uint64_t start = batch[done].frame.timestampMicros / PARTITION_MICROS * PARTITION_MICROS;
+            size_t end = done;
+            while (end < batch.size() && end - done < SEGMENT_ROWS &&
+                   batch[end].frame.timestampMicros < start + PARTITION_MICROS) {
+                ++end;
+            }
+            writeSegment(start, batch.data() + done, end - done);
+            touched.push_back(start);
+            done = end;
+        }
+
+        // Late rows for an older day are rare; keep only the files this flush used open
+        for (auto it = partitions.begin(); it != partitions.end();) {
+            if (std::find(touched.begin(), touched.end(), it->first) == touched.end()) {
+                close(it->second.fd);
+                it = partitions.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    } catch (const std::runtime_error&) {
+        std::lock_guard<std::mutex> pendingLock(mutex);
+        dropped += batch.size() - done;
+        throw;
+    }
+
+    // Hand the batch's storage back, so the next one fills memory that is already faulted in
+    batch.clear();
+    std::lock_guard<std::mutex> pendingLock(mutex);
+    if (pending.empty()) {
+        pending.swap(batch);
+    }
+}
+
+MetricArchiveWriter::Partition& MetricArchiveWriter::partition(uint64_t startMicros) {
+    auto it = partitions.find(startMicros);
+    if (it != partitions.end()) {
+        return it->second;
+    }
+
+    std::string path = directory + "/" + partitionFileName(startMicros);
+    Partition file;
+    file.direct = true;
+    file.fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC | O_DIRECT, 0644);
+    if (file.fd < 0 && errno == EINVAL) {
+        file.direct = false;
+        file.fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    }
+    if (file.fd < 0) {
+        throw std::runtime_error("Failed to open " + path + ": " + errnoText());
+    }
+
+    struct stat info;
+    FileHeader header;
+    bool reuse = fstat(file.fd, &info) == 0 && info.st_size >= static_cast<off_t>(ALIGNMENT);
+    if (reuse) {
+        // O_DIRECT reads need an aligned buffer as much as writes do
+        void* page = std::aligned_alloc(ALIGNMENT, ALIGNMENT);
+        reuse = page && pread(file.fd, page, ALIGNMENT, 0) == static_cast<ssize_t>(ALIGNMENT);
+        if (reuse) {
+            std::memcpy(&header, page, sizeof(header));
+        }
+        std::free(page);
+        reuse = reuse && std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) == 0 &&
+                header.version == FORMAT_VERSION && header.schemaVersion == METRIC_SCHEMA_VERSION;
+    }
+
+    if (reuse) {
+        // Resume after the last whole segment; anything past it is a torn write
+        file.end = ALIGNMENT;
+        void* page = std::aligned_alloc(ALIGNMENT, ALIGNMENT);
+        while (page && file.end + ALIGNMENT <= static_cast<uint64_t>(info.st_size) &&
+               pread(file.fd, page, ALIGNMENT, static_cast<off_t>(file.end)) == static_cast<ssize_t>(ALIGNMENT)) {
+            SegmentHeader segment;
+            std::memcpy(&segment, page, sizeof(segment));
+            if (segment.magic != SEGMENT_MAGIC || segment.length == 0 || segment.length % ALIGNMENT != 0 ||
+                file.end + segment.length > static_cast<uint64_t>(info.st_size)) {
+                break;
+            }
+            file.end += segment.length;
+        }
+        std::free(page);
+        if (ftruncate(file.fd, static_cast<off_t>(file.end)) != 0) {
+            std::string error = errnoText();
+            close(file.fd);
+            throw std::runtime_error("Failed to truncate " + path + ": " + error);
+        }
+    } else {
+        if (info.st_size > 0) {
+            // Another schema or format, or garbage: keep it aside instead of mixing layouts
+            std::string aside = path + "." + std::to_string(static_cast<uint64_t>(info.st_mtime)) + ".old";
+            if (rename(path.c_str(), aside.c_str()) != 0) {
+                std::string error = errnoText();
+                close(file.fd);
+                throw std::runtime_error("Failed to move aside " + path + ": " + error);
+            }
+            close(file.fd);
+            return partition(startMicros);
+        }
+        void* page = std::aligned_alloc(ALIGNMENT, ALIGNMENT);
+        if (!page) {
+            close(file.fd);
+            throw std::runtime_error("Failed to allocate archive header for " + path);
+        }
+        std::memset(page, 0, ALIGNMENT);
+        std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+        header.version = FORMAT_VERSION;
+        header.schemaVersion = METRIC_SCHEMA_VERSION;
+        header.partitionStartMicros = startMicros;
+        header.metrics = static_cast<uint32_t>(METRIC_COUNT);
+        header.metricTableBytes = static_cast<uint32_t>(metricTableBytes());
+        std::memcpy(page, &header, sizeof(header));
+        writeMetricTable(static_cast<uint8_t*>(page) + sizeof(header));
+        try {
+            writeAt(file, static_cast<const uint8_t*>(page), ALIGNMENT, 0);
+        } catch (const std::runtime_error&) {
+            std::free(page);
+            close(file.fd);
+            throw;
+        }
+        std::free(page);
+        file.end = ALIGNMENT;
+    }
+    return partitions.emplace(startMicros, file).first->second;
+}
+
+void MetricArchiveWriter::writeAt(Partition& file, const uint8_t* data, size_t length, uint64_t offset) {
+    while (length > 0) {
+        ssize_t count = pwrite(file.fd, data, length, static_cast<off_t>(offset));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0 && errno == EINVAL && file.direct) {
+            // The filesystem took O_DIRECT at open but not for this write
+            file.direct = false;
+            fcntl(file.fd, F_SETFL, fcntl(file.fd, F_GETFL) & ~O_DIRECT);
+            continue;
+        }
+        if (count <= 0) {
+            throw std::runtime_error("Failed to write metric archive: " + errnoText());
+        }
+        data += count;
+        length -= static_cast<size_t>(count);
+        offset += static_cast<uint64_t>(count);
+    }
+}
+
+void MetricArchiveWriter::writeSegment(uint64_t partitionStartMicros, const Row* rows, size_t count) {
+    // Columns: every slot present in at least one row, in slot order
+    std::array<uint64_t, MetricFrame::PRESENT_WORDS> anyPresent{};
+    for (size_t r = 0; r < count; ++r) {
+        for (size_t w = 0; w < anyPresent.size(); ++w) {
+            anyPresent[w] |= rows[r].frame.present[w];
+        }
+    }
+    std::vector<ColumnHeader> columns;
+    for (size_t slot = 0; slot < METRIC_SLOTS; ++slot) {
+        if ((anyPresent[slot / 64] >> (slot % 64)) & 1u) {
+            ColumnHeader column{};
+            column.slot = static_cast<uint16_t>(slot);
+            for (size_t r = 0; r < count; ++r) {
+                column.present += slotPresent(rows[r].frame, slot);
+            }
+            column.flags = column.present < count ? ColumnHeader::SPARSE : 0;
+            columns.push_back(column);
+        }
+    }
+
+    std::unordered_map<std::string_view, uint32_t> nodeIndex;
+    std::vector<std::string_view> nodeNames;
+    size_t nodeTableBytes = 0;
+    for (size_t r = 0; r < count; ++r) {
+        std::string_view name = std::string_view(rows[r].node).substr(0, UINT16_MAX);
+        if (nodeIndex.emplace(name, static_cast<uint32_t>(nodeNames.size())).second) {
+            nodeNames.push_back(name);
+            nodeTableBytes += sizeof(uint16_t) + name.size();
+        }
+    }
+
+    SegmentHeader header{};
+    header.rows = static_cast<uint32_t>(count);
+    header.columns = static_cast<uint32_t>(columns.size());
+    header.nodes = static_cast<uint32_t>(nodeNames.size());
+    header.minTimestampMicros = rows[0].frame.timestampMicros;
+    header.maxTimestampMicros = rows[count - 1].frame.timestampMicros;
+    header.nodeTableOffset = sizeof(SegmentHeader) + columns.size() * sizeof(ColumnHeader);
+    header.timestampOffset = alignUp(header.nodeTableOffset + nodeTableBytes, 8);
+    header.nodeColumnOffset = header.timestampOffset + count * sizeof(uint64_t);
+    size_t bitmapBytes = (count + 63) / 64 * sizeof(uint64_t);
+    size_t offset = alignUp(header.nodeColumnOffset + count * sizeof(uint32_t), 8);
+    for (ColumnHeader& column : columns) {
+        column.offset = offset;
+        offset = alignUp(offset + count * sizeof(float), 8) + (column.flags & ColumnHeader::SPARSE ? bitmapBytes : 0);
+    }
+    header.length = alignUp(offset, ALIGNMENT);
+
+    if (bufferCapacity < header.length) {
+        void* grown = std::aligned_alloc(ALIGNMENT, header.length);
+        if (!grown) {
+            throw std::runtime_error("Failed to allocate " + std::to_string(header.length) + " bytes for an archive segment");
+        }
+        buffer.reset(static_cast<uint8_t*>(grown));
+        bufferCapacity = header.length;
+    }
+    uint8_t* out = buffer.get();
+    std::memset(out, 0, header.length);
+
+    uint8_t* names = out + header.nodeTableOffset;
+    for (std::string_view name : nodeNames) {
+        uint16_t length = static_cast<uint16_t>(name.size());
+        std::memcpy(names, &length, sizeof(length));
+        std::memcpy(names + sizeof(length), name.data(), name.size());
+        names += sizeof(length) + name.size();
+    }
+    auto* timestamps = reinterpret_cast<uint64_t*>(out + header.timestampOffset);
+    auto* nodes = reinterpret_cast<uint32_t*>(out + header.nodeColumnOffset);
+    for (size_t r = 0; r < count; ++r) {
+        timestamps[r] = rows[r].frame.timestampMicros;
+        nodes[r] = nodeIndex[std::string_view(rows[r].node).substr(0, UINT16_MAX)];
+    }
+
+    for (ColumnHeader& column : columns) {
+        auto* values = reinterpret_cast<float*>(out + column.offset);
+        auto* bitmap = reinterpret_cast<uint64_t*>(out + alignUp(column.offset + count * sizeof(float), 8));
+        bool seen = false;
+        for (size_t r = 0; r < count; ++r) {
+            if (!slotPresent(rows[r].frame, column.slot)) {
+                continue;
+            }
+            float value = rows[r].frame.values[column.slot];
+            values[r] = value;
+            if (column.flags & ColumnHeader::SPARSE) {
+                bitmap[r / 64] |= uint64_t(1) << (r % 64);
+            }
+            column.min = seen ? std::min(column.min, value) : value;
+            column.max = seen ? std::max(column.max, value) : value;
+            seen = true;
+        }
+    }
+    std::memcpy(out + sizeof(SegmentHeader), columns.data(), columns.size() * sizeof(ColumnHeader));
+
+    // The body first with no magic, then the first page again with it. The body has to
+    // be on disk before the magic is, or a crash could leave a committed segment over
+    // pages that never made it
+    Partition& file = partition(partitionStartMicros);
+    std::memcpy(out, &header, sizeof(header));
+    writeAt(file, out, header.length, file.end);
+    if (fdatasync(file.fd) != 0) {
+        throw std::runtime_error("Failed to sync metric archive: " + errnoText());
+    }
+    header.magic = SEGMENT_MAGIC;
+    std::memcpy(out, &header, sizeof(header));
+    writeAt(file, out, ALIGNMENT, file.end);
+    file.end += header.length;
+
+    written += count;
+    writtenBytes += header.length;
+}
+
+uint64_t MetricArchiveWriter::rowsWritten() const {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    return written;
+}
+
+uint64_t MetricArchiveWriter::rowsDropped() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return dropped;
+}
+
+uint64_t MetricArchiveWriter::bytesWritten() const {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    return writtenBytes;
+}
+
+MetricArchiveReader::MetricArchiveReader(std::string directory) : directory(std::move(directory)) {}
+
+ArchiveScanStats MetricArchiveReader::scan(const Query& query, const std::function<void(const ArchiveChunk&)>& f) const {
+    ArchiveScanStats stats;
+    if (query.gpu >= MAX_GPUS || query.fromMicros > query.toMicros) {
+        return stats;
+    }
+    // Per day, files moved aside sort before the one still being written
+    std::vector<std::tuple<uint64_t, bool, std::string>> files;
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) {
+        throw std::runtime_error("Failed to open " + directory + ": " + errnoText());
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        uint64_t start;
+        bool movedAside;
+        if (parsePartitionFileName(entry->d_name, start, movedAside) && start <= query.toMicros &&
+            start + PARTITION_MICROS > query.fromMicros) {
+            files.emplace_back(start, !movedAside, directory + "/" + entry->d_name);
+        }
+    }
+    closedir(dir);
+    std::sort(files.begin(), files.end());
+
+    std::vector<std::string_view> nodeNames;
+    for (const auto& [start, current, path] : files) {
+        MappedFile file(path);
+        ++stats.files;
+        FileHeader header;
+        if (file.length < ALIGNMENT) {
+            continue; // Created but not yet written
+        }
+        std::memcpy(&header, file.data, sizeof(header));
+        if (std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 || header.version == 0 ||
+            header.version > FORMAT_VERSION) {
+            throw std::runtime_error(path + " is not a metric archive file");
+        }
+        // Version 1 files have no metric table, so only one with this schema can be read
+        int64_t slot = -1;
+        if (header.schemaVersion == METRIC_SCHEMA_VERSION) {
+            slot = static_cast<int64_t>(metricSlot(query.id, query.gpu));
+        } else if (header.version >= 2) {
+            slot = mappedSlot(header, file.data + sizeof(FileHeader), query.id, query.gpu);
+        }
+        if (slot < 0) {
+            ++stats.filesSkipped;
+            continue;
+        }
+
+        for (size_t offset = ALIGNMENT; offset + sizeof(SegmentHeader) <= file.length;) {
+            const uint8_t* base = file.data + offset;
+            SegmentHeader segment;
+            std::memcpy(&segment, base, sizeof(segment));
+            if (segment.magic != SEGMENT_MAGIC || segment.length == 0 || offset + segment.length > file.length) {
+                break; // The tail a writer has not committed yet
+            }
+            offset += segment.length;
+            ++stats.segments;
+
+            if (segment.maxTimestampMicros < query.fromMicros || segment.minTimestampMicros > query.toMicros) {
+                ++stats.segmentsSkipped;
+                continue;
+            }
+            const auto* columns = reinterpret_cast<const ColumnHeader*>(base + sizeof(SegmentHeader));
+            const ColumnHeader* column = nullptr;
+            for (uint32_t c = 0; c < segment.columns; ++c) {
+                if (columns[c].slot == slot) {
+                    column = &columns[c];
+                    break;
+                }
+            }
+            if (!column) {
+                ++stats.segmentsSkipped;
+                continue;
+            }
+            if (column->present == 0 || column->max < query.minValue || column->min > query.maxValue) {
+                ++stats.chunksSkipped;
+                continue;
+            }
+
+            nodeNames.clear();
+            int64_t wanted = query.node.empty() ? 0 : -1;
+            const uint8_t* names = base + segment.nodeTableOffset;
+            for (uint32_t n = 0; n < segment.nodes; ++n) {
+                uint16_t length;
+                std::memcpy(&length, names, sizeof(length));
+                nodeNames.emplace_back(reinterpret_cast<const char*>(names + sizeof(length)), length);
+                names += sizeof(length) + length;
+                if (!query.node.empty() && nodeNames.back() == query.node) {
+                    wanted = n;
+                }
+            }
+            if (wanted < 0) {
+                ++stats.segmentsSkipped;
+                continue;
+            }
+
+            ArchiveChunk chunk;
+            chunk.nodeNames = &nodeNames;
+            chunk.timestamps = reinterpret_cast<const uint64_t*>(base + segment.timestampOffset);
+            chunk.nodes = reinterpret_cast<const uint32_t*>(base + segment.nodeColumnOffset);
+            chunk.values = reinterpret_cast<const float*>(base + column->offset);
+            chunk.present = column->flags & ColumnHeader::SPARSE
+                ? reinterpret_cast<const uint64_t*>(base + alignUp(column->offset + segment.rows * sizeof(float), 8))
+                : nullptr;
+            chunk.begin = std::lower_bound(chunk.timestamps, chunk.timestamps + segment.rows, query.fromMicros) - chunk.timestamps;
+            chunk.end = std::upper_bound(chunk.timestamps, chunk.timestamps + segment.rows, query.toMicros) - chunk.timestamps;
+            chunk.node = query.node.empty() ? -1 : wanted;
+            ++stats.chunksRead;
+            stats.rowsScanned += chunk.end - chunk.begin;
+            f(chunk);
+        }
+    }
+    return stats;
+}
+
+ArchiveScanStats MetricArchiveReader::forEach(const Query& query,
+                                              const std::function<void(std::string_view, uint64_t, float)>& f) const {
+    return scan(query, [&](const ArchiveChunk& chunk) {
+        for (size_t r = chunk.begin; r < chunk.end; ++r) {
+            if ((chunk.node >= 0 && chunk.nodes[r] != chunk.node) ||
+                (chunk.present && !((chunk.present[r / 64] >> (r % 64)) & 1u))) {
+                continue;
+            }
+            float value = chunk.values[r];
+            if (value >= query.minValue && value <= query.maxValue) {
+                f((*chunk.nodeNames)[chunk.nodes[r]], chunk.timestamps[r], value);
+            }
+        }
+    });
+}
+
+TimeSeriesSummary MetricArchiveReader::summarize(const Query& query, ArchiveScanStats* stats) const {
+    TimeSeriesSummary summary;
+    double sum = 0.0;
+    uint64_t firstAt = 0, lastAt = 0;
+    ArchiveScanStats scanned = scan(query, [&](const ArchiveChunk& chunk) {
+        // Rows are in time order within a chunk, so only its first and last match can
+        // move the summary's ends
+        size_t firstRow = chunk.end, lastRow = chunk.end;
+        for (size_t r = chunk.begin; r < chunk.end; ++r) {
+            if ((chunk.node >= 0 && chunk.nodes[r] != chunk.node) ||
+                (chunk.present && !((chunk.present[r / 64] >> (r % 64)) & 1u))) {
+                continue;
+            }
+            float value = chunk.values[r];
+            if (value < query.minValue || value > query.maxValue) {
+                continue;
+            }
+            if (summary.count == 0) {
+                summary.min = summary.max = value;
+            }
+            summary.min = std::min(summary.min, value);
+            summary.max = std::max(summary.max, value);
+            sum += value;
+            ++summary.count;
+            if (firstRow == chunk.end) {
+                firstRow = r;
+            }
+            lastRow = r;
+        }
+        if (firstRow == chunk.end) {
+            return;
+        }
+        if (firstAt == 0 || chunk.timestamps[firstRow] < firstAt) {
+            firstAt = chunk.timestamps[firstRow];
+            summary.first = chunk.values[firstRow];
+        }
+        if (chunk.timestamps[lastRow] >= lastAt) {
+            lastAt = chunk.timestamps[lastRow];
+            summary.last = chunk.values[lastRow];
+        }
+    });
+    if (summary.count) {
+        summary.sum = sum;
+        summary.mean = sum / static_cast<double>(summary.count);
+        summary.firstMicros = firstAt;
+        summary.lastMicros = lastAt;
+    }
+    if (stats) {
+        *stats = scanned;
+    }
+    return summary;
+}
@@ -0,0 +1,389 @@
+#include "MetricQuery.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+    struct Reduction {
+        double sum = 0.0;
+        float min = std::numeric_limits<float>::infinity();
+        float max = -std::numeric_limits<float>::infinity();
+    };
+
+    // Sums in double so an hour of samples does not lose the small ones
+    using ReduceKernel = Reduction (*)(const float* values, size_t count);
+    // Sets bit i of mask when values[i] is above (or below) threshold; writes
+    // (count + 63) / 64 words and returns how many bits it set
+    using CompareKernel = size_t (*)(const float* values, size_t count, float threshold, bool above, uint64_t* mask);
+
+    void reduceTail(const float* values, size_t begin, size_t count, Reduction& result) {
+        for (size_t i = begin; i < count; ++i) {
+            result.sum += values[i];
+            result.min = std::min(result.min, values[i]);
+            result.max = std::max(result.max, values[i]);
+        }
+    }
+
+    uint64_t compareTail(const float* values, size_t begin, size_t end, float threshold, bool above) {
+        uint64_t word = 0;
+        for (size_t i = begin; i < end; ++i) {
+            bool hit = above ? values[i] > threshold : values[i] < threshold;
+            word |= static_cast<uint64_t>(hit) << (i % 64);
+        }
+        return word;
+    }
+
+#if !defined(__x86_64__)
+    Reduction reduceScalar(const float* values, size_t count) {
+        Reduction result;
+        reduceTail(values, 0, count, result);
+        return result;
+    }
+
+    size_t compareScalar(const float* values, size_t count, float threshold, bool above, uint64_t* mask) {
+        size_t hits = 0;
+        for (size_t begin = 0; begin < count; begin += 64) {
+            mask[begin / 64] = compareTail(values, begin, std::min(begin + 64, count), threshold, above);
+            hits += __builtin_popcountll(mask[begin / 64]);
+        }
+        return hits;
+    }
+#else
+    Reduction reduceSse2(const float* values, size_t count) {
+        __m128d sumLow = _mm_setzero_pd(), sumHigh = _mm_setzero_pd();
+        __m128 low = _mm_set1_ps(std::numeric_limits<float>::infinity());
+        __m128 high = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128 v = _mm_loadu_ps(values + i);
+            low = _mm_min_ps(low, v);
+            high = _mm_max_ps(high, v);
+            sumLow = _mm_add_pd(sumLow, _mm_cvtps_pd(v));
+            sumHigh = _mm_add_pd(sumHigh, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+        }
+
+        Reduction result;
+        alignas(16) double sums[2];
+        alignas(16) float lows[4], highs[4];
+        _mm_store_pd(sums, _mm_add_pd(sumLow, sumHigh));
+        _mm_store_ps(lows, low);
+        _mm_store_ps(highs, high);
+        result.sum = sums[0] + sums[1];
+        for (int lane = 0; lane < 4; ++lane) {
+            result.min = std::min(result.min, lows[lane]);
+            result.max = std::max(result.max, highs[lane]);
+        }
+        reduceTail(values, i, count, result);
+        return result;
+    }
+
+    size_t compareSse2(const float* values, size_t count, float threshold, bool above, uint64_t* mask) {
+        const __m128 limit = _mm_set1_ps(threshold);
+        size_t hits = 0;
+        size_t begin = 0;
+        for (; begin + 64 <= count; begin += 64) {
+            uint64_t word = 0;
+            for (size_t i = 0; i < 64; i += 4) {
+                __m128 v = _mm_loadu_ps(values + begin + i);
+                __m128 hit = above ? _mm_cmpgt_ps(v, limit) : _mm_cmplt_ps(v, limit);
+                word |= static_cast<uint64_t>(_mm_movemask_ps(hit)) << i;
+            }
+            mask[begin / 64] = word;
+            hits += __builtin_popcountll(word);
+        }
+        if (begin < count) {
+            mask[begin / 64] = compareTail(values, begin, count, threshold, above);
+            hits += __builtin_popcountll(mask[begin / 64]);
+        }
+        return hits;
+    }
+
+    __attribute__((target("avx2")))
+    Reduction reduceAvx2(const float* values, size_t count) {
+        __m256d sumLow = _mm256_setzero_pd(), sumHigh = _mm256_setzero_pd();
+        __m256 low = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+        __m256 high = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256 v = _mm256_loadu_ps(values + i);
+            low = _mm256_min_ps(low, v);
+            high = _mm256_max_ps(high, v);
+            sumLow = _mm256_add_pd(sumLow, _mm256_cvtps_pd(_mm256_castps256_ps128(v)));
+            sumHigh = _mm256_add_pd(sumHigh, _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)));
+        }
+
+        Reduction result;
+        alignas(32) double sums[4];
+        alignas(32) float lows[8], highs[8];
+        _mm256_store_pd(sums, _mm256_add_pd(sumLow, sumHigh));
+        _mm256_store_ps(lows, low);
+        _mm256_store_ps(highs, high);
+        result.sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+        for (int lane = 0; lane < 8; ++lane) {
+            result.min = std::min(result.min, lows[lane]);
+            result.max = std::max(result.max, highs[lane]);
+        }
+        reduceTail(values, i, count, result);
+        return result;
+    }
+
+    __attribute__((target("avx2")))
+    size_t compareAvx2(const float* values, size_t count, float threshold, bool above, uint64_t* mask) {
+        const __m256 limit = _mm256_set1_ps(threshold);
+        size_t hits = 0;
+        size_t begin = 0;
+        for (; begin + 64 <= count; begin += 64) {
+            uint64_t word = 0;
+            for (size_t i = 0; i < 64; i += 8) {
+                __m256 v = _mm256_loadu_ps(values + begin + i);
+                __m256 hit = above ? _mm256_cmp_ps(v, limit, _CMP_GT_OQ) : _mm256_cmp_ps(v, limit, _CMP_LT_OQ);
+                word |= static_cast<uint64_t>(_mm256_movemask_ps(hit)) << i;
+            }
+            mask[begin / 64] = word;
+            hits += __builtin_popcountll(word);
+        }
+        if (begin < count) {
+            mask[begin / 64] = compareTail(values, begin, count, threshold, above);
+            hits += __builtin_popcountll(mask[begin / 64]);
+        }
+        return hits;
+    }
+#endif
+
+    struct Kernels {
+        ReduceKernel reduce;
+        CompareKernel compare;
+    };
+
+    const Kernels& kernels() {
+        static const Kernels selected = [] {
+#if defined(__x86_64__)
+            if (__builtin_cpu_supports("avx2")) {
+                return Kernels{reduceAvx2, compareAvx2};
+            }
+            return Kernels{reduceSse2, compareSse2}; // Part of the x86-64 baseline
+#else
+            return Kernels{reduceScalar, compareScalar};
+#endif
+        }();
+        return selected;
+    }
+
+    // First index at or after from whose bit equals set, or count
+    size_t nextBit(const std::vector<uint64_t>& mask, size_t from, size_t count, bool set) {
+        while (from < count) {
+            uint64_t word = mask[from / 64];
+            word = (set ? word : ~word) >> (from % 64);
+            if (word) {
+                return std::min(from + __builtin_ctzll(word), count);
+            }
+            from = (from / 64 + 1) * 64;
+        }
+        return count;
+    }
+
+    // Aggregates the store's block summaries answer without a decode
+    bool fromSummary(QueryAggregate aggregate) {
+        switch (aggregate) {
+            case QueryAggregate::COUNT:
+            case QueryAggregate::SUM:
+            case QueryAggregate::MEAN:
+            case QueryAggregate::MIN:
+            case QueryAggregate::MAX:
+            case QueryAggregate::LAST:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    double valueOf(const TimeSeriesSummary& summary, QueryAggregate aggregate) {
+        switch (aggregate) {
+            case QueryAggregate::COUNT: return static_cast<double>(summary.count);
+            case QueryAggregate::SUM: return summary.sum;
+            case QueryAggregate::MEAN: return summary.mean;
+            case QueryAggregate::MIN: return summary.min;
+            case QueryAggregate::MAX: return summary.max;
+            default: return summary.last;
+        }
+    }
+
+    double percentileOf(QueryAggregate aggregate) {
+        switch (aggregate) {
+            case QueryAggregate::P50: return 0.50;
+            case QueryAggregate::P90: return 0.90;
+            case QueryAggregate::P95: return 0.95;
+            case QueryAggregate::P99: return 0.99;
+            default: return 0.0;
+        }
+    }
+}
+
+MetricQuery::MetricQuery(const TimeSeriesStore& store) : store(store) {}
+
+MetricQuery::Selection MetricQuery::lastSeconds(MetricId id, unsigned int gpu, uint64_t seconds) {
+    uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    Selection selection;
+    selection.id = id;
+    selection.gpu = gpu;
+    selection.toMicros = now;
+    selection.fromMicros = now > seconds * 1000000 ? now - seconds * 1000000 : 0;
+    return selection;
+}
+
+const std::vector<std::string>& MetricQuery::nodesOf(const Selection& selection) {
+    if (!selection.nodes.empty()) {
+        return selection.nodes;
+    }
+    allNodes = store.nodeNames();
+    return allNodes;
+}
+
+double MetricQuery::reduce(const float* values, size_t count, QueryAggregate aggregate) {
+    switch (aggregate) {
+        case QueryAggregate::COUNT:
+            return static_cast<double>(count);
+        case QueryAggregate::LAST:
+            return values[count - 1];
+        case QueryAggregate::SUM:
+        case QueryAggregate::MEAN:
+        case QueryAggregate::MIN:
+        case QueryAggregate::MAX: {
+            Reduction result = kernels().reduce(values, count);
+            return aggregate == QueryAggregate::SUM ? result.sum
+                 : aggregate == QueryAggregate::MEAN ? result.sum / static_cast<double>(count)
+                 : aggregate == QueryAggregate::MIN ? result.min : result.max;
+        }
+        default: {
+            // Selection works in place, so make the span ours first unless it already is
+            if (values != scratch.data()) {
+                scratch.assign(values, values + count);
+            }
+            size_t rank = static_cast<size_t>(std::ceil(percentileOf(aggregate) * static_cast<double>(count)));
+            auto nth = scratch.begin() + static_cast<ptrdiff_t>(rank ? rank - 1 : 0);
+            std::nth_element(scratch.begin(), nth, scratch.begin() + static_cast<ptrdiff_t>(count));
+            return *nth;
+        }
+    }
+}
+
+std::vector<NodeAggregate> MetricQuery::aggregate(const Selection& selection, QueryAggregate aggregate,
+                                                  const QueryPredicate* filter) {
+    std::vector<NodeAggregate> rows;
+    if (!filter && fromSummary(aggregate)) {
+        for (const std::string& node : nodesOf(selection)) {
+            TimeSeriesSummary summary = store.aggregate(node, selection.id, selection.gpu, selection.fromMicros,
+                                                        selection.toMicros);
+            if (summary.count == 0) {
+                continue;
+            }
+            rows.push_back({node, valueOf(summary, aggregate), summary.count, summary.firstMicros, summary.lastMicros});
+        }
+        return rows;
+    }
+
+    for (const std::string& node : nodesOf(selection)) {
+        batch.clear();
+        store.read(node, selection.id, selection.gpu, selection.fromMicros, selection.toMicros, batch);
+        size_t count = batch.size();
+        if (count == 0) {
+            continue;
+        }
+
+        NodeAggregate row;
+        row.node = node;
+        row.firstMicros = batch.timestamps.front();
+        row.lastMicros = batch.timestamps.back();
+        const float* values = batch.values.data();
+        if (filter) {
+            mask.resize((count + 63) / 64);
+            size_t hits = kernels().compare(values, count, filter->threshold, filter->comparison == QueryPredicate::ABOVE,
+                                            mask.data());
+            if (hits == 0) {
+                continue;
+            }
+            scratch.clear();
+            for (size_t w = 0; w < mask.size(); ++w) {
+                for (uint64_t word = mask[w]; word; word &= word - 1) {
+                    scratch.push_back(values[w * 64 + __builtin_ctzll(word)]);
+                }
+            }
+            values = scratch.data();
+            count = hits;
+        }
+        row.samples = count;
+        row.value = reduce(values, count, aggregate);
+        rows.push_back(std::move(row));
+    }
+    return rows;
+}
+
+std::vector<NodeWindows> MetricQuery::windowAggregate(const Selection& selection, QueryAggregate aggregate,
+                                                      uint64_t bucketMicros) {
+    std::vector<NodeWindows> result;
+    if (bucketMicros == 0) {
+        return result;
+    }
+    for (const std::string& node : nodesOf(selection)) {
+        batch.clear();
+        store.read(node, selection.id, selection.gpu, selection.fromMicros, selection.toMicros, batch);
+        if (batch.size() == 0) {
+            continue;
+        }
+
+        NodeWindows windows;
+        windows.node = node;
+        const uint64_t* timestamps = batch.timestamps.data();
+        size_t count = batch.size();
+        uint64_t origin = selection.fromMicros ? selection.fromMicros : timestamps[0] / bucketMicros * bucketMicros;
+        for (size_t begin = 0; begin < count;) {
+            uint64_t bucket = origin + (timestamps[begin] - origin) / bucketMicros * bucketMicros;
+            size_t end = std::lower_bound(timestamps + begin, timestamps + count, bucket + bucketMicros) - timestamps;
+            windows.bucketStartMicros.push_back(bucket);
+            windows.values.push_back(reduce(batch.values.data() + begin, end - begin, aggregate));
+            begin = end;
+        }
+        result.push_back(std::move(windows));
+    }
+    return result;
+}
+
+std::vector<NodeAggregate> MetricQuery::sustained(const Selection& selection, const QueryPredicate& predicate,
+                                                  uint64_t durationMicros) {
+    std::vector<NodeAggregate> rows;
+    for (const std::string& node : nodesOf(selection)) {
+        batch.clear();
+        store.read(node, selection.id, selection.gpu, selection.fromMicros, selection.toMicros, batch);
+        size_t count = batch.size();
+        if (count == 0) {
+            continue;
+        }
+
+        mask.resize((count + 63) / 64);
+        size_t hits = kernels().compare(batch.values.data(), count, predicate.threshold,
+                                        predicate.comparison == QueryPredicate::ABOVE, mask.data());
+        uint64_t longest = 0;
+        for (size_t start = hits ? nextBit(mask, 0, count, true) : count; start < count;) {
+            size_t end = nextBit(mask, start, count, false);
+            longest = std::max(longest, batch.timestamps[end - 1] - batch.timestamps[start]);
+            start = nextBit(mask, end, count, true);
+        }
+        if (hits == 0 || longest < durationMicros) {
+            continue;
+        }
+
+        NodeAggregate row;
+        row.node = node;
+        row.value = static_cast<double>(longest) / 1e6;
+        row.samples = hits;
+        row.firstMicros = batch.timestamps.front();
+        row.lastMicros = batch.timestamps.back();
+        rows.push_back(std::move(row));
+    }
+    return rows;
+}
@@ -0,0 +1,113 @@
+#include "MetricSchema.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable<MetricFrame>::value, "MetricFrame is copied as raw bytes");
+
+const char* metricUnitName(MetricUnit unit) {
+    switch (unit) {
+        case MetricUnit::NONE: return "";
+        case MetricUnit::PERCENT: return "%";
+        case MetricUnit::RATIO: return "ratio";
+        case MetricUnit::BYTES: return "bytes";
+        case MetricUnit::CELSIUS: return "C";
+        case MetricUnit::WATTS: return "W";
+        case MetricUnit::MEGAHERTZ: return "MHz";
+        case MetricUnit::SECONDS: return "s";
+        case MetricUnit::PER_SECOND: return "/s";
+        case MetricUnit::MEGABITS_PER_SECOND: return "Mbps";
+        case MetricUnit::KILOBYTES_PER_SECOND: return "KB/s";
+    }
+    return "";
+}
+
+void MetricFrame::clear() {
+    timestampMicros = 0;
+    values.fill(0.0f);
+    present.fill(0);
+}
+
+MetricFrame MetricFrame::aggregate(const MetricFrame* frames, size_t count) {
+    MetricFrame result;
+    const MetricFrame* newest = nullptr;
+    for (size_t f = 0; f < count; ++f) {
+        if (!newest || frames[f].timestampMicros >= newest->timestampMicros) {
+            newest = &frames[f];
+        }
+    }
+    if (!newest) {
+        return result;
+    }
+    result.timestampMicros = newest->timestampMicros;
+
+    for (size_t i = 0; i < METRIC_COUNT; ++i) {
+        const MetricTraits& traits = METRIC_SCHEMA[i];
+        for (size_t slot = METRIC_OFFSETS[i]; slot < METRIC_OFFSETS[i + 1]; ++slot) {
+            double combined = 0.0;
+            size_t seen = 0;
+            for (size_t f = 0; f < count; ++f) {
+                if (!frames[f].hasSlot(slot)) {
+                    continue;
+                }
+                double value = frames[f].values[slot];
+                switch (traits.aggregation) {
+                    case MetricAggregation::SUM:
+                    case MetricAggregation::MEAN:
+                        combined += value;
+                        break;
+                    case MetricAggregation::MAX:
+                        combined = seen ? std::max(combined, value) : value;
+                        break;
+                    case MetricAggregation::MIN:
+                        combined = seen ? std::min(combined, value) : value;
+                        break;
+                    case MetricAggregation::LAST:
+                        if (&frames[f] == newest || !seen) {
+                            combined = value;
+                        }
+                        break;
+                }
+                ++seen;
+            }
+            if (seen) {
+                result.setSlot(slot, traits.aggregation == MetricAggregation::MEAN ? combined / seen : combined);
+            }
+        }
+    }
+    return result;
+}
+
+std::string MetricFrame::format() const {
+    std::string text;
+    char line[128];
+    forEach([&](const MetricTraits& traits, unsigned int gpu, float value) {
+        const char* unit = metricUnitName(traits.unit);
+        if (traits.perGpu) {
+            std::snprintf(line, sizeof(line), "%s[%u]: %f%s%s\n", traits.name, gpu, value, *unit ? " " : "", unit);
+        } else {
+            std::snprintf(line, sizeof(line), "%s: %f%s%s\n", traits.name, value, *unit ? " " : "", unit);
+        }
+        text += line;
+    });
+    return text;
+}
+
+std::string MetricFrame::serialize() const {
+    return std::string(reinterpret_cast<const char*>(this), sizeof(MetricFrame));
+}
+
+MetricFrame MetricFrame::deserialize(const std::string& bytes) {
+    MetricFrame frame;
+    if (bytes.size() != sizeof(MetricFrame)) {
+        throw std::runtime_error("Metric frame is " + std::to_string(bytes.size()) + " bytes, expected " +
+                                 std::to_string(sizeof(MetricFrame)));
+    }
+    std::memcpy(&frame, bytes.data(), sizeof(MetricFrame));
+    if (frame.schemaVersion != METRIC_SCHEMA_VERSION) {
+        throw std::runtime_error("Metric frame was written with a different metric schema");
+    }
+    return frame;
+}
@@ -0,0 +1,87 @@
+#include "MetricsExporter.h"
+#include <cstdlib>
+#include <seastar/core/do_with.hh>
+#include <seastar/core/loop.hh>
+#include <seastar/core/smp.hh>
+#include <seastar/core/temporary_buffer.hh>
+#include <seastar/http/handlers.hh>
+#include <seastar/net/inet_address.hh>
+#include <vector>
+
+namespace {
+    // A buffer of this shard's that another shard still uses; freed with its last reference
+    seastar::temporary_buffer<char> shareBuffer(const MetricsExposition::Buffer& buffer) {
+        return seastar::temporary_buffer<char>(const_cast<char*>(buffer->data()), buffer->size(),
+                                               seastar::make_deleter([buffer] {}));
+    }
+
+    // Static text, never freed
+    seastar::temporary_buffer<char> staticBuffer(const std::string& text) {
+        return seastar::temporary_buffer<char>(const_cast<char*>(text.data()), text.size(), seastar::deleter());
+    }
+
+    seastar::future<std::vector<MetricsExposition::Snapshot>> collectShards() {
+        std::vector<seastar::future<MetricsExposition::Snapshot>> shards;
+        for (unsigned int shard = 0; shard < seastar::smp::count; ++shard) {
+            shards.push_back(seastar::smp::submit_to(shard, [] {
+                return MetricsExposition::forShard().snapshot();
+            }));
+        }
+        return seastar::when_all_succeed(shards.begin(), shards.end());
+    }
+
+    class ScrapeHandler : public seastar::httpd::handler_base {
+    public:
+        seastar::future<std::unique_ptr<seastar::http::reply>> handle(const seastar::sstring&,
+                                                                      std::unique_ptr<seastar::http::request> request,
+                                                                      std::unique_ptr<seastar::http::reply> reply) override {
+            MetricsExposition::Format format = request->get_header("Accept").find("application/openmetrics-text") != seastar::sstring::npos
+                                                   ? MetricsExposition::Format::OPENMETRICS
+                                                   : MetricsExposition::Format::PROMETHEUS;
+            return collectShards().then([format, reply = std::move(reply)](std::vector<MetricsExposition::Snapshot> shards) mutable {
+                std::vector<seastar::temporary_buffer<char>> pieces;
+                MetricsExposition::forEachPiece(shards, format, [&pieces](const std::string& text, const MetricsExposition::Buffer& owner) {
+                    pieces.push_back(owner ? shareBuffer(owner) : staticBuffer(text));
+                });
+
+                reply->write_body("txt", [pieces = std::move(pieces)](seastar::output_stream<char>&& stream) mutable {
+                    return seastar::do_with(std::move(stream), std::move(pieces), [](seastar::output_stream<char>& out, auto& pieces) {
+                        return seastar::do_for_each(pieces, [&out](seastar::temporary_buffer<char>& piece) {
+                            return out.write(std::move(piece));
+                        }).then([&out] {
+                            return out.flush();
+                        }).finally([&out] {
+                            return out.close();
+                        });
+                    });
+                });
+                // write_body only knows types by file extension
+                reply->_headers["Content-Type"] = MetricsExposition::contentType(format);
+                return seastar::make_ready_future<std::unique_ptr<seastar::http::reply>>(std::move(reply));
+            });
+        }
+    };
+}
+
+seastar::future<> MetricsExporter::start() {
+    uint16_t port = DEFAULT_PORT;
+    if (const char* configured = std::getenv(PORT_ENV)) {
+        port = static_cast<uint16_t>(std::strtoul(configured, nullptr, 10));
+    }
+    return server.start("metrics").then([this] {
+        started = true;
+        return server.set_routes([](seastar::httpd::routes& routes) {
+            routes.put(seastar::httpd::operation_type::GET, "/metrics", new ScrapeHandler());
+        });
+    }).then([this, port] {
+        return server.listen(seastar::socket_address(seastar::ipv4_addr(port)));
+    });
+}
+
+seastar::future<> MetricsExporter::stop() {
+    if (!started) {
+        return seastar::make_ready_future<>();
+    }
+    started = false;
+    return server.stop();
+}
@@ -0,0 +1,188 @@
+#include "MetricsExposition.h"
+#include <charconv>
+#include <cmath>
+
+namespace {
+    const char* unitSuffix(MetricUnit unit) {
+        switch (unit) {
+            case MetricUnit::NONE: return "";
+            case MetricUnit::PERCENT: return "_percent";
+            case MetricUnit::RATIO: return "_ratio";
+            case MetricUnit::BYTES: return "_bytes";
+            case MetricUnit::CELSIUS: return "_celsius";
+            case MetricUnit::WATTS: return "_watts";
+            case MetricUnit::MEGAHERTZ: return "_megahertz";
+            case MetricUnit::SECONDS: return "_seconds";
+            case MetricUnit::PER_SECOND: return "_per_second";
+            case MetricUnit::MEGABITS_PER_SECOND: return "_megabits_per_second";
+            case MetricUnit::KILOBYTES_PER_SECOND: return "_kilobytes_per_second";
+        }
+        return "";
+    }
+
+    // Family and sample names of every metric, worked out once from the schema
+    struct FamilyNames {
+        std::array<std::string, METRIC_COUNT> sample;     // Counters end in _total
+        std::array<std::string, METRIC_COUNT> prometheus; // "# TYPE" lines
+        std::array<std::string, METRIC_COUNT> openMetrics;
+        std::array<std::string, MAX_GPUS> gpuLabels;      // ,gpu="3"
+
+        FamilyNames() {
+            for (unsigned int gpu = 0; gpu < MAX_GPUS; ++gpu) {
+                gpuLabels[gpu] = ",gpu=\"" + std::to_string(gpu) + "\"";
+            }
+            for (const MetricTraits& traits : METRIC_SCHEMA) {
+                // GpuUsageP50 -> director_gpu_usage_p50
+                std::string name = "director";
+                for (const char* c = traits.name; *c; ++c) {
+                    if (*c >= 'A' && *c <= 'Z') {
+                        name += '_';
+                        name += static_cast<char>(*c - 'A' + 'a');
+                    } else {
+                        name += *c;
+                    }
+                }
+                name += unitSuffix(traits.unit);
+
+                size_t i = static_cast<size_t>(traits.id);
+                bool counter = traits.type == MetricType::COUNTER;
+                const char* type = counter ? "counter" : "gauge";
+                sample[i] = counter ? name + "_total" : name;
+                prometheus[i] = "# TYPE " + sample[i] + " " + type + "\n";
+                // OpenMetrics names the family without the _total of its samples
+                openMetrics[i] = "# TYPE " + name + " " + type + "\n";
+            }
+        }
+    };
+
+    const FamilyNames& familyNames() {
+        static const FamilyNames names;
+        return names;
+    }
+
+    void appendValue(std::string& out, float value) {
+        if (std::isnan(value)) {
+            out += "NaN";
+        } else if (std::isinf(value)) {
+            out += value > 0 ? "+Inf" : "-Inf";
+        } else {
+            // Shortest text that reads back as the same float
+            char text[32];
+            auto result = std::to_chars(text, text + sizeof(text), value);
+            out.append(text, result.ptr);
+        }
+    }
+}
+
+MetricsExposition& MetricsExposition::forShard() {
+    static thread_local MetricsExposition exposition;
+    return exposition;
+}
+
+const std::string& MetricsExposition::familyHeader(MetricId id, Format format) {
+    const FamilyNames& names = familyNames();
+    size_t i = static_cast<size_t>(id);
+    return format == Format::OPENMETRICS ? names.openMetrics[i] : names.prometheus[i];
+}
+
+const char* MetricsExposition::contentType(Format format) {
+    return format == Format::OPENMETRICS ? "application/openmetrics-text; version=1.0.0; charset=utf-8"
+                                         : "text/plain; version=0.0.4; charset=utf-8";
+}
+
+const std::string& MetricsExposition::trailer(Format format) {
+    static const std::string eof = "# EOF\n";
+    static const std::string none;
+    return format == Format::OPENMETRICS ? eof : none;
+}
+
+void MetricsExposition::update(const std::string& node, const MetricFrame& frame) {
+    auto [position, inserted] = index.try_emplace(node, entries.size());
+    if (inserted) {
+        Entry entry;
+        entry.node = node;
+        entry.labels = "{node=\"";
+        for (char c : node) {
+            switch (c) {
+                case '\\': entry.labels += "\\\\"; break;
+                case '"': entry.labels += "\\\""; break;
+                case '\n': entry.labels += "\\n"; break;
+                default: entry.labels += c;
+            }
+        }
+        entry.labels += '"';
+        entries.push_back(std::move(entry));
+    }
+    Entry& entry = entries[position->second];
+
+    const FamilyNames& names = familyNames();
+    for (size_t i = 0; i < METRIC_COUNT; ++i) {
+        const MetricTraits& traits = METRIC_SCHEMA[i];
+        unsigned int slots = traits.perGpu ? static_cast<unsigned int>(MAX_GPUS) : 1u;
+        scratch.clear();
+        for (unsigned int gpu = 0; gpu < slots; ++gpu) {
+            if (!frame.has(traits.id, gpu)) {
+                continue;
+            }
+            scratch += names.sample[i];
+            scratch += entry.labels;
+            if (traits.perGpu) {
+                scratch += names.gpuLabels[gpu];
+            }
+            scratch += "} ";
+            appendValue(scratch, frame.values[metricSlot(traits.id, gpu)]);
+            scratch += '\n';
+        }
+        // An unchanged family keeps its joined buffer
+        if (scratch != entry.lines[i]) {
+            entry.lines[i].swap(scratch);
+            dirty[i] = true;
+        }
+    }
+}
+
+void MetricsExposition::remove(const std::string& node) {
+    auto position = index.find(node);
+    if (position == index.end()) {
+        return;
+    }
+    size_t slot = position->second;
+    index.erase(position);
+    for (size_t i = 0; i < METRIC_COUNT; ++i) {
+        dirty[i] = dirty[i] || !entries[slot].lines[i].empty();
+    }
+    if (slot + 1 != entries.size()) {
+        entries[slot] = std::move(entries.back());
+        index[entries[slot].node] = slot;
+    }
+    entries.pop_back();
+}
+
+void MetricsExposition::publish() {
+    for (size_t i = 0; i < METRIC_COUNT; ++i) {
+        if (!dirty[i]) {
+            continue;
+        }
+        dirty[i] = false;
+        size_t length = 0;
+        for (const Entry& entry : entries) {
+            length += entry.lines[i].size();
+        }
+        if (length == 0) {
+            families[i].reset();
+            continue;
+        }
+        // A fresh buffer rather than an edit: scrapes in flight may still hold the old one
+        auto joined = std::make_shared<std::string>();
+        joined->reserve(length);
+        for (const Entry& entry : entries) {
+            *joined += entry.lines[i];
+        }
+        families[i] = std::move(joined);
+    }
+}
+
+MetricsExposition::Snapshot MetricsExposition::snapshot() {
+    publish();
+    return families;
+}
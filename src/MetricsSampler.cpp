@@ -0,0 +1,247 @@
+#include "MetricsSampler.h"
+#include "ProcReader.h"
+#include <stdexcept>
+
+namespace {
+    // /proc/diskstats always reports sectors in 512-byte units, independent of the
+    // device's hardware sector size.
+    constexpr double DISKSTATS_SECTOR_BYTES = 512.0;
+
+    void readCpuCounters(MetricsSampler::Sample& sample) {
+        static thread_local ProcReader statFile("/proc/stat");
+        ProcScanner scanner(statFile.read());
+
+        do {
+            if (scanner.token() != "cpu") {
+                continue;
+            }
+            uint64_t user, nice, system, idle, iowait, irq, softirq, steal;
+            if (scanner.parseUnsigned(user) && scanner.parseUnsigned(nice) && scanner.parseUnsigned(system)
+                    && scanner.parseUnsigned(idle) && scanner.parseUnsigned(iowait) && scanner.parseUnsigned(irq)
+                    && scanner.parseUnsigned(softirq) && scanner.parseUnsigned(steal)) {
+                sample.cpuIdle = idle + iowait;
+                sample.cpuTotal = user + nice + system + idle + iowait + irq + softirq + steal;
+                return;
+            }
+        } while (scanner.nextLine());
+
+        throw std::runtime_error("Failed to read CPU stats from /proc/stat");
+    }
+
+    void readDiskCounters(MetricsSampler::Sample& sample) {
+        static thread_local ProcReader diskstatsFile("/proc/diskstats");
+        ProcScanner scanner(diskstatsFile.read());
+
+        do {
+            uint64_t major, minor, readMerges, writeMerges, ioInProgress;
+            MetricsSampler::DiskCounters counters;
+            if (!scanner.parseUnsigned(major) || !scanner.parseUnsigned(minor)) {
+                continue;
+            }
+            std::string_view device = scanner.token();
+            if (scanner.parseUnsigned(counters.readIos) && scanner.parseUnsigned(readMerges)
+                    && scanner.parseUnsigned(counters.readSectors) && scanner.parseUnsigned(counters.readTimeMs)
+                    && scanner.parseUnsigned(counters.writeIos) && scanner.parseUnsigned(writeMerges)
+                    && scanner.parseUnsigned(counters.writeSectors) && scanner.parseUnsigned(counters.writeTimeMs)
+                    && scanner.parseUnsigned(ioInProgress) && scanner.parseUnsigned(counters.ioTimeMs)) {
+                sample.disks[std::string(device)] = counters;
+            }
+        } while (scanner.nextLine());
+    }
+
+    void readNetCounters(MetricsSampler::Sample& sample) {
+        static thread_local ProcReader netDevFile("/proc/net/dev");
+        ProcScanner scanner(netDevFile.read());
+
+        // The first two lines are column headers
+        scanner.nextLine();
+        while (scanner.nextLine()) {
+            std::string_view iface = scanner.tokenUntil(':');
+            MetricsSampler::NetCounters counters;
+            if (scanner.parseUnsigned(counters.rxBytes) && scanner.parseUnsigned(counters.rxPackets)
+                    && scanner.skipTokens(6)
+                    && scanner.parseUnsigned(counters.txBytes) && scanner.parseUnsigned(counters.txPackets)) {
+                sample.interfaces[std::string(iface)] = counters;
+            }
+        }
+    }
+
+    double seconds(const MetricsSampler::Sample& older, const MetricsSampler::Sample& newer) {
+        return std::chrono::duration<double>(newer.timestamp - older.timestamp).count();
+    }
+
+    const MetricsSampler::DiskCounters& findDisk(const MetricsSampler::Sample& sample, const std::string& disk) {
+        auto it = sample.disks.find(disk);
+        if (it == sample.disks.end()) {
+            throw std::runtime_error("Disk " + disk + " not found in /proc/diskstats");
+        }
+        return it->second;
+    }
+
+    const MetricsSampler::NetCounters& findInterface(const MetricsSampler::Sample& sample, const std::string& interface) {
+        auto it = sample.interfaces.find(interface);
+        if (it == sample.interfaces.end()) {
+            throw std::runtime_error("Interface " + interface + " not found in /proc/net/dev");
+        }
+        return it->second;
+    }
+}
+
+MetricsSampler::MetricsSampler(std::chrono::milliseconds interval, size_t capacity)
+    : interval(interval), ring(capacity < 2 ? 2 : capacity) {
+    start();
+}
+
+MetricsSampler::~MetricsSampler() {
+    stop();
+}
+
+void MetricsSampler::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running) {
+        return;
+    }
+    running = true;
+    worker = std::thread(&MetricsSampler::run, this);
+}
+
+void MetricsSampler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+    wakeup.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+MetricsSampler::Sample MetricsSampler::takeSample() {
+    Sample sample;
+    readCpuCounters(sample);
+    readDiskCounters(sample);
+    readNetCounters(sample);
+    sample.timestamp = Clock::now();
+    return sample;
+}
+
+void MetricsSampler::push(Sample sample) {
+    ring[head] = std::move(sample);
+    head = (head + 1) % ring.size();
+    if (count < ring.size()) {
+        ++count;
+    }
+}
+
+void MetricsSampler::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (running) {
+        lock.unlock();
+        try {
+            Sample sample = takeSample();
+            lock.lock();
+            push(std::move(sample));
+        } catch (const std::runtime_error&) {
+            // Keep the previous samples; the next tick retries
+            lock.lock();
+        }
+        wakeup.wait_for(lock, interval, [this] { return !running; });
+    }
+}
+
+template<typename Func>
+double MetricsSampler::withSamplePair(std::chrono::milliseconds maxAge, Func func) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    auto newestAt = [this](size_t back) -> const Sample& {
+        return ring[(head + ring.size() - 1 - back) % ring.size()];
+    };
+
+    bool stale = count == 0 || Clock::now() - newestAt(0).timestamp > maxAge;
+    if (stale) {
+        lock.unlock();
+        Sample sample = takeSample();
+        lock.lock();
+        push(std::move(sample));
+    }
+
+    if (count < 2) {
+        // Cold start: nothing to diff against yet, so take a second sample one window later
+        lock.unlock();
+        std::this_thread::sleep_for(MIN_WINDOW);
+        Sample sample = takeSample();
+        lock.lock();
+        push(std::move(sample));
+    }
+
+    const Sample& newest = newestAt(0);
+    const Sample* older = &newestAt(1);
+    for (size_t back = 1; back < count; ++back) {
+        older = &newestAt(back);
+        if (newest.timestamp - older->timestamp >= MIN_WINDOW) {
+            break;
+        }
+    }
+
+    return func(*older, newest);
+}
+
+double MetricsSampler::cpuUtilization(std::chrono::milliseconds maxAge) {
+    return withSamplePair(maxAge, [](const Sample& older, const Sample& newer) {
+        uint64_t deltaIdle = newer.cpuIdle - older.cpuIdle;
+        uint64_t deltaTotal = newer.cpuTotal - older.cpuTotal;
+        if (deltaTotal == 0) {
+            return 0.0;
+        }
+        return (1.0 - static_cast<double>(deltaIdle) / deltaTotal) * 100.0;
+    });
+}
+
+double MetricsSampler::diskIoUtilization(const std::string& disk, std::chrono::milliseconds maxAge) {
+    return withSamplePair(maxAge, [&disk](const Sample& older, const Sample& newer) {
+        uint64_t deltaIoTime = findDisk(newer, disk).ioTimeMs - findDisk(older, disk).ioTimeMs;
+        return static_cast<double>(deltaIoTime) / (seconds(older, newer) * 1000.0) * 100.0; // Percent of wall time busy
+    });
+}
+
+double MetricsSampler::diskReadThroughput(const std::string& disk, std::chrono::milliseconds maxAge) {
+    return withSamplePair(maxAge, [&disk](const Sample& older, const Sample& newer) {
+        uint64_t sectorsRead = findDisk(newer, disk).readSectors - findDisk(older, disk).readSectors;
+        return (sectorsRead * DISKSTATS_SECTOR_BYTES) / 1024.0 / seconds(older, newer); // KB/s
+    });
+}
+
+double MetricsSampler::diskWriteThroughput(const std::string& disk, std::chrono::milliseconds maxAge) {
+    return withSamplePair(maxAge, [&disk](const Sample& older, const Sample& newer) {
+        uint64_t sectorsWritten = findDisk(newer, disk).writeSectors - findDisk(older, disk).writeSectors;
+        return (sectorsWritten * DISKSTATS_SECTOR_BYTES) / 1024.0 / seconds(older, newer); // KB/s
+    });
+}
+
+double MetricsSampler::diskLatency(const std::string& disk, std::chrono::milliseconds maxAge) {
+    return withSamplePair(maxAge, [&disk](const Sample& older, const Sample& newer) {
+        const DiskCounters& before = findDisk(older, disk);
+        const DiskCounters& after = findDisk(newer, disk);
+
+        uint64_t deltaIos = (after.readIos + after.writeIos) - (before.readIos + before.writeIos);
+        if (deltaIos == 0) {
+            return 0.0; // Avoid division by zero if no I/O operations occurred
+        }
+
+        uint64_t deltaWait = (after.readTimeMs + after.writeTimeMs) - (before.readTimeMs + before.writeTimeMs);
+        return static_cast<double>(deltaWait) / deltaIos; // Milliseconds per I/O operation
+    });
+}
+
+double MetricsSampler::networkBandwidth(const std::string& interface, std::chrono::milliseconds maxAge) {
+    return withSamplePair(maxAge, [&interface](const Sample& older, const Sample& newer) {
+        const NetCounters& before = findInterface(older, interface);
+        const NetCounters& after = findInterface(newer, interface);
+
+        uint64_t deltaBytes = (after.rxBytes - before.rxBytes) + (after.txBytes - before.txBytes);
+        return static_cast<double>(deltaBytes) / 1024.0 / seconds(older, newer); // KB/s
+    });
+}
@@ -0,0 +1,274 @@
+#include "MockGpuBackend.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+MockGpuBackend::MockGpuBackend(std::string scriptPath) : scriptPath(std::move(scriptPath)) {
+    std::lock_guard<std::mutex> lock(mutex);
+    reloadIfChanged();
+}
+
+void MockGpuBackend::reloadIfChanged() {
+    if (scriptPath.empty()) {
+        return;
+    }
+    struct stat info;
+    if (stat(scriptPath.c_str(), &info) != 0) {
+        throw std::runtime_error("Failed to read GPU mock script " + scriptPath);
+    }
+    if (info.st_mtim.tv_sec == loadedAt.tv_sec && info.st_mtim.tv_nsec == loadedAt.tv_nsec) {
+        return;
+    }
+
+    std::ifstream file(scriptPath);
+    if (!file) {
+        throw std::runtime_error("Failed to read GPU mock script " + scriptPath);
+    }
+
+    std::map<std::pair<unsigned int, std::string>, Series> parsed;
+    unsigned int count = 0;
+    std::string line;
+    for (size_t number = 1; std::getline(file, line); ++number) {
+        std::istringstream fields(line);
+        std::string index, field, values;
+        if (!(fields >> index) || index[0] == '#') {
+            continue;
+        }
+        unsigned int device;
+        if (!(fields >> field >> values) ||
+            std::from_chars(index.data(), index.data() + index.size(), device).ec != std::errc()) {
+            throw std::runtime_error("Malformed GPU mock script line " + std::to_string(number) + ": " + line);
+        }
+
+        Series entry;
+        if (values != "n/a") {
+            std::string_view rest = values;
+            while (!rest.empty()) {
+                size_t comma = rest.find(',');
+                std::string_view item = rest.substr(0, comma);
+                uint64_t value;
+                if (std::from_chars(item.data(), item.data() + item.size(), value).ec != std::errc()) {
+                    throw std::runtime_error("Malformed GPU mock value on line " + std::to_string(number) + ": " + line);
+                }
+                entry.values.push_back(value);
+                rest = comma == std::string_view::npos ? std::string_view() : rest.substr(comma + 1);
+            }
+        }
+        parsed[{device, field}] = std::move(entry);
+        count = std::max(count, device + 1);
+    }
+
+    // A rewritten script starts every series over
+    series = std::move(parsed);
+    devices = count;
+    loadedAt = info.st_mtim;
+    samplesStartMicros = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+std::optional<uint64_t> MockGpuBackend::next(unsigned int index, const std::string& field) {
+    auto it = series.find({index, field});
+    if (it == series.end()) {
+        return 0;
+    }
+    Series& entry = it->second;
+    if (entry.values.empty()) {
+        return std::nullopt;
+    }
+    uint64_t value = entry.values[entry.next];
+    entry.next = (entry.next + 1) % entry.values.size();
+    return value;
+}
+
+uint64_t MockGpuBackend::read(unsigned int index, const std::string& field) {
+    std::lock_guard<std::mutex> lock(mutex);
+    reloadIfChanged();
+    if (index >= devices) {
+        throw std::runtime_error("Failed to get handle for device " + std::to_string(index) + ": Invalid Argument");
+    }
+    std::optional<uint64_t> value = next(index, field);
+    if (!value) {
+        throw std::runtime_error("Failed to get " + field + ": Not Supported");
+    }
+    return *value;
+}
+
+unsigned int MockGpuBackend::deviceCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    reloadIfChanged();
+    return devices;
+}
+
+unsigned int MockGpuBackend::temperature(unsigned int index) {
+    return static_cast<unsigned int>(read(index, "temperature"));
+}
+
+GpuUtilization MockGpuBackend::utilization(unsigned int index) {
+    GpuUtilization rates;
+    rates.gpu = static_cast<unsigned int>(read(index, "utilization.gpu"));
+    rates.memory = static_cast<unsigned int>(read(index, "utilization.memory"));
+    return rates;
+}
+
+GpuMemoryInfo MockGpuBackend::memory(unsigned int index) {
+    GpuMemoryInfo info;
+    info.total = read(index, "memory.total");
+    info.used = read(index, "memory.used");
+    return info;
+}
+
+unsigned int MockGpuBackend::powerUsage(unsigned int index) {
+    return static_cast<unsigned int>(read(index, "power"));
+}
+
+unsigned int MockGpuBackend::fanSpeed(unsigned int index) {
+    return static_cast<unsigned int>(read(index, "fan"));
+}
+
+unsigned int MockGpuBackend::clock(unsigned int index, GpuClock clock) {
+    switch (clock) {
+        case GpuClock::GRAPHICS:
+            return static_cast<unsigned int>(read(index, "clock.graphics"));
+        case GpuClock::SM:
+            return static_cast<unsigned int>(read(index, "clock.sm"));
+        case GpuClock::MEMORY:
+            return static_cast<unsigned int>(read(index, "clock.memory"));
+    }
+    return 0;
+}
+
+GpuComputeMode MockGpuBackend::computeMode(unsigned int index) {
+    return static_cast<GpuComputeMode>(read(index, "compute_mode"));
+}
+
+unsigned int MockGpuBackend::pcieThroughput(unsigned int index, GpuPcieCounter counter) {
+    return static_cast<unsigned int>(read(index, counter == GpuPcieCounter::TX_BYTES ? "pcie.tx" : "pcie.rx"));
+}
+
+GpuSample MockGpuBackend::sample(unsigned int index) {
+    std::lock_guard<std::mutex> lock(mutex);
+    reloadIfChanged();
+    if (index >= devices) {
+        throw std::runtime_error("Failed to get handle for device " + std::to_string(index) + ": Invalid Argument");
+    }
+
+    GpuSample sample;
+    // Sets the field bit only when every value behind it is supported
+    auto fill = [&](GpuSample::Field field, std::initializer_list<std::pair<const char*, uint64_t*>> reads) {
+        bool supported = true;
+        for (const auto& [name, target] : reads) {
+            std::optional<uint64_t> value = next(index, name);
+            supported = supported && value.has_value();
+            *target = value.value_or(0);
+        }
+        if (supported) {
+            sample.valid |= field;
+        }
+    };
+
+    uint64_t temperature, gpu, memoryBusy, power, fan, smClock, memoryClock;
+    fill(GpuSample::TEMPERATURE, {{"temperature", &temperature}});
+    fill(GpuSample::UTILIZATION, {{"utilization.gpu", &gpu}, {"utilization.memory", &memoryBusy}});
+    fill(GpuSample::MEMORY, {{"memory.total", &sample.memoryTotal}, {"memory.used", &sample.memoryUsed}});
+    fill(GpuSample::POWER, {{"power", &power}});
+    fill(GpuSample::FAN, {{"fan", &fan}});
+    fill(GpuSample::CLOCKS, {{"clock.sm", &smClock}, {"clock.memory", &memoryClock}});
+    fill(GpuSample::ENERGY, {{"energy", &sample.energyMillijoules}});
+
+    sample.temperatureC = static_cast<uint32_t>(temperature);
+    sample.gpuUtilization = static_cast<uint32_t>(gpu);
+    sample.memoryUtilization = static_cast<uint32_t>(memoryBusy);
+    sample.powerMilliwatts = static_cast<uint32_t>(power);
+    sample.fanPercent = static_cast<uint32_t>(fan);
+    sample.smClockMHz = static_cast<uint32_t>(smClock);
+    sample.memoryClockMHz = static_cast<uint32_t>(memoryClock);
+    return sample;
+}
+
+std::vector<GpuTimedValue> MockGpuBackend::bufferedSamples(unsigned int index, GpuSampleType type, uint64_t sinceMicros) {
+    std::lock_guard<std::mutex> lock(mutex);
+    reloadIfChanged();
+    if (index >= devices) {
+        throw std::runtime_error("Failed to get handle for device " + std::to_string(index) + ": Invalid Argument");
+    }
+
+    const char* field = type == GpuSampleType::POWER ? "samples.power"
+        : type == GpuSampleType::GPU_UTILIZATION ? "samples.gpu" : "samples.memory";
+    auto it = series.find({index, field});
+    if (it == series.end()) {
+        return {};
+    }
+    const std::vector<uint64_t>& values = it->second.values;
+    if (values.empty()) {
+        throw std::runtime_error(std::string("Failed to get ") + field + ": Not Supported");
+    }
+
+    uint64_t period = DEFAULT_SAMPLE_PERIOD_MICROS;
+    auto scriptedPeriod = series.find({index, "samples.period"});
+    if (scriptedPeriod != series.end() && !scriptedPeriod->second.values.empty() &&
+        scriptedPeriod->second.values[0] > 0) {
+        period = scriptedPeriod->second.values[0];
+    }
+
+    // Reading k was taken at samplesStartMicros + k * period
+    uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    if (now < samplesStartMicros) {
+        return {};
+    }
+    uint64_t newest = (now - samplesStartMicros) / period;
+    uint64_t first = newest >= BUFFER_DEPTH ? newest - BUFFER_DEPTH + 1 : 0;
+    if (sinceMicros >= samplesStartMicros) {
+        first = std::max(first, (sinceMicros - samplesStartMicros) / period + 1);
+    }
+
+    std::vector<GpuTimedValue> samples;
+    for (uint64_t k = first; k <= newest; ++k) {
+        samples.push_back({samplesStartMicros + k * period, values[k % values.size()]});
+    }
+    return samples;
+}
+
+std::vector<GpuProcessUsage> MockGpuBackend::processUsage(unsigned int index, uint64_t) {
+    std::lock_guard<std::mutex> lock(mutex);
+    reloadIfChanged();
+    if (index >= devices) {
+        throw std::runtime_error("Failed to get handle for device " + std::to_string(index) + ": Invalid Argument");
+    }
+
+    std::vector<uint32_t> pids;
+    for (const auto& [key, entry] : series) {
+        const std::string& field = key.second;
+        if (key.first != index || field.compare(0, 8, "process.") != 0) {
+            continue;
+        }
+        uint32_t pid;
+        size_t end = field.find('.', 8);
+        if (std::from_chars(field.data() + 8, field.data() + std::min(end, field.size()), pid).ec == std::errc() &&
+            std::find(pids.begin(), pids.end(), pid) == pids.end()) {
+            pids.push_back(pid);
+        }
+    }
+
+    uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    std::vector<GpuProcessUsage> processes;
+    for (uint32_t pid : pids) {
+        std::string prefix = "process." + std::to_string(pid) + ".";
+        GpuProcessUsage usage;
+        usage.pid = pid;
+        usage.device = index;
+        usage.memoryUsed = next(index, prefix + "memory").value_or(0);
+        usage.smUtilization = static_cast<double>(next(index, prefix + "sm").value_or(0));
+        usage.memoryUtilization = static_cast<double>(next(index, prefix + "mem").value_or(0));
+        usage.encoderUtilization = static_cast<double>(next(index, prefix + "enc").value_or(0));
+        usage.decoderUtilization = static_cast<double>(next(index, prefix + "dec").value_or(0));
+        usage.lastSampleMicros = now;
+        processes.push_back(usage);
+    }
+    return processes;
+}
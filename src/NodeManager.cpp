@@ -15,35 +15,28 @@ NodeManager::NodeManager() {
 
 seastar::future<> NodeManager::monitorNodes() {
     return seastar::async([this] {
+        // One collection round for every node, rather than collectives per node and metric
+        auto collected = std::make_shared<std::unordered_map<std::string, MetricFrame>>();
+        for (const NodeFrame& nodeFrame : mpiController.collectNodeFrames().get()) {
+            (*collected)[nodeFrame.node] = nodeFrame.frame;
+        }
+
         // Loop through all registered nodes to monitor and scale as needed
         return registeredNodes.maps.map_reduce0(
-            [this](auto& map) {
+            [this, collected](auto& map) {
                 std::vector<seastar::future<>> futures;
                 for (const auto& [ipAddress, processName] : map) {
+                    // A registered node without a rank reports nothing
+                    auto nodeFrame = collected->find(ipAddress);
                     futures.push_back(
-                        mpiController.gpuMetrics(ipAddress, 0).then([this, ipAddress, processName](std::unordered_map<std::string, float> gpuMetrics) {
-                            auto cpuUsage = seastar::engine().cpu_id();
-                            auto memoryUsage = seastar::memory::stats();
-                            auto hddUsage = 40.0; // Example value, replace with actual HDD usage query
-                            auto trafficIn = 100.0; // Example value, replace with actual traffic input query
-                            auto trafficOut = 150.0; // Example value, replace with actual traffic output query
-
-                            seastar::vector<std::pair<std::string, float>> metrics;
-
-                            metrics.emplace_back("CpuUsage", cpuUsage);
-                            metrics.emplace_back("TotalMemory", memoryUsage.total_memory());
-                            metrics.emplace_back("FreeMemory", memoryUsage.free_memory());
-                            metrics.emplace_back("UsedMemory", memoryUsage.used_memory());
-                            metrics.emplace_back("HddUsage", hddUsage);
-                            metrics.emplace_back("TrafficIn", trafficIn);
-                            metrics.emplace_back("TrafficOut", trafficOut);
-
-                            for (const auto& metric : gpuMetrics) {
-                                metrics.emplace_back(metric.first, metric.second);
-                            }
-
-                            for (const auto& metric : metrics) {
-                                seastar::print("%s: %f\n", metric.first, metric.second);
+                        seastar::make_ready_future<MetricFrame>(nodeFrame != collected->end() ? nodeFrame->second : MetricFrame())
+                        .then([this, ipAddress, processName](MetricFrame metrics) {
+                            // Keep the history on this shard and on disk. A node that reported nothing
+                            // keeps its last exposed values rather than dropping out of the scrape.
+                            if (!metrics.empty()) {
+                                MetricsExposition::forShard().update(ipAddress, metrics);
+                                TimeSeriesStore::forShard().append(ipAddress, metrics);
+                                MetricArchiveWriter::appendShared(ipAddress, metrics);
                             }
 
                             // Append the current timestamp to the process name
@@ -51,7 +44,7 @@ seastar::future<> NodeManager::monitorNodes() {
                             std::string newProcessName = processName + "_" + std::to_string(timestamp);
 
                             // Implement deterministic scaling logic based on collected metrics
-                            return needsScaling(ipAddress, processName).then([this, ipAddress, newProcessName](bool scaleUpNeeded) {
+                            return needsScaling(ipAddress, processName, metrics).then([this, ipAddress, newProcessName](bool scaleUpNeeded) {
                                 if (scaleUpNeeded) {
                                     return queueToScaleUp.enqueue_back({ipAddress, newProcessName});
                                 } else {
@@ -61,7 +54,10 @@ seastar::future<> NodeManager::monitorNodes() {
                         })
                     );
                 }
-                return seastar::when_all(futures.begin(), futures.end()).discard_result();
+                // Scrapes between ticks find this shard's exposition already joined
+                return seastar::when_all(futures.begin(), futures.end()).discard_result().finally([] {
+                    MetricsExposition::forShard().publish();
+                });
             },
             std::vector<seastar::future<>>(),
             [](auto&& a, auto&& b) {
@@ -92,75 +88,76 @@ seastar::future<> NodeManager::process_node(NodeQueue& queue) {
     });
 }
 
-seastar::future<int> NodeManager::getNodeLoad(const std::string &ipAddress) {
-    return seastar::async([this, ipAddress] {
-        int totalLoad = 0;
-
-        return mpiController.getCpuTemperatureMPI(ipAddress, "").then([&totalLoad](double cpuTemp) {
-            totalLoad += static_cast<int>(cpuTemp);
-
-            return mpiController.getMemoryPageFaultsMPI(ipAddress, "");
-        }).then([&totalLoad](double memPageFaults) {
-            totalLoad += static_cast<int>(memPageFaults);
+seastar::future<int> NodeManager::getNodeLoad(const std::string &ipAddress, std::optional<float> gpuUsage) {
+    return seastar::async([this, ipAddress, gpuUsage] {
+        // All three queries are in flight at once; each is one round trip to the node
+        auto cpuTemp = mpiController.getCpuTemperatureMPI(ipAddress, "");
+        auto memPageFaults = mpiController.getMemoryPageFaultsMPI(ipAddress, "");
+        auto netBandwidth = mpiController.getNetworkBandwidthUtilizationMPI(ipAddress, "", "");
 
-            return mpiController.getNetworkBandwidthUtilizationMPI(ipAddress, "", "eth0");
-        }).then([&totalLoad](double netBandwidth) {
-            totalLoad += static_cast<int>(netBandwidth);
+        int totalLoad = static_cast<int>(cpuTemp.get());
+        totalLoad += static_cast<int>(memPageFaults.get());
+        totalLoad += static_cast<int>(netBandwidth.get());
 
-            return mpiController.getGpuUsage(ipAddress, 0); // Assuming GPU index 0
-        }).then([&totalLoad](float gpuUsage) {
-            totalLoad += static_cast<int>(gpuUsage);
-
-            return seastar::make_ready_future<int>(totalLoad);
-        });
+        // A windowed value from history saves the GPU round trip
+        if (gpuUsage) {
+            totalLoad += static_cast<int>(*gpuUsage);
+        } else {
+            totalLoad += static_cast<int>(mpiController.gpuMetrics(ipAddress).get().get(MetricId::GPU_MEAN_USAGE));
+        }
+        return totalLoad;
     });
 }
 
-seastar::future<bool> NodeManager::needsScaling(const std::string &ipAddress, const std::string &processName) {
+seastar::future<bool> NodeManager::needsScaling(const std::string &ipAddress, const std::string &processName, const MetricFrame &metrics) {
     const double CPU_TEMP_THRESHOLD = 80.0; // Example threshold in degrees Celsius
     const double MEM_PAGE_FAULTS_THRESHOLD = 1000.0; // Example threshold for page faults
-    const double NET_BANDWIDTH_THRESHOLD = 1000.0; // Example threshold in MBps
-    const double GPU_USAGE_THRESHOLD = 80.0; // Example threshold in percent
+    const double NET_BANDWIDTH_THRESHOLD = 1000.0; // Example threshold in KB/s
     const double MEM_AVAILABLE_THRESHOLD = 512.0; // Example threshold in MB
     const double DISK_LATENCY_THRESHOLD = 10.0; // Example threshold in ms
 
-    return mpiController.getCpuTemperatureMPI(ipAddress, processName).then([this, ipAddress, processName](double cpuTemp) {
-        if (cpuTemp > CPU_TEMP_THRESHOLD) {
-            return seastar::make_ready_future<bool>(true);
-        }
-
-        return mpiController.getMemoryPageFaultsMPI(ipAddress, processName);
-    }).then([this, ipAddress, processName](double memPageFaults) {
-        if (memPageFaults > MEM_PAGE_FAULTS_THRESHOLD) {
-            return seastar::make_ready_future<bool>(true);
-        }
-
-        return mpiController.getNetworkBandwidthUtilizationMPI(ipAddress, processName, "eth0");
-    }).then([this, ipAddress, processName](double netBandwidth) {
-        if (netBandwidth > NET_BANDWIDTH_THRESHOLD) {
-            return seastar::make_ready_future<bool>(true);
-        }
-
-        return mpiController.gpuMetrics(ipAddress, 0); // Assuming GPU index 0
-    }).then([this, ipAddress, processName](std::unordered_map<std::string, float> gpuMetrics) {
-        if (gpuMetrics["GpuUsage"] > GPU_USAGE_THRESHOLD) {
-            return seastar::make_ready_future<bool>(true);
-        }
-
-        return mpiController.mpiGetAvailableMemory(ipAddress);
-    }).then([this, ipAddress, processName](double memAvailable) {
-        if (memAvailable < MEM_AVAILABLE_THRESHOLD) {
-            return seastar::make_ready_future<bool>(true);
-        }
+    // Every reading comes from the node's frame of this tick's collection round, so
+    // deciding costs no collectives
+    if (metrics.get(MetricId::CPU_TEMPERATURE) > CPU_TEMP_THRESHOLD ||
+        metrics.get(MetricId::MEMORY_PAGE_FAULTS) > MEM_PAGE_FAULTS_THRESHOLD ||
+        metrics.get(MetricId::NETWORK_BANDWIDTH) > NET_BANDWIDTH_THRESHOLD) {
+        return seastar::make_ready_future<bool>(true);
+    }
+
+    // The GPU rules live in the metric schema: median usage, the hottest device and
+    // memory pressure
+    if (sustainedBreaches(ipAddress, metrics) > 0) {
+        return seastar::make_ready_future<bool>(true);
+    }
+
+    if (metrics.has(MetricId::FREE_MEMORY) && metrics.get(MetricId::FREE_MEMORY) / (1024.0 * 1024.0) < MEM_AVAILABLE_THRESHOLD) {
+        return seastar::make_ready_future<bool>(true);
+    }
+    if (metrics.get(MetricId::DISK_LATENCY) * 1000.0 > DISK_LATENCY_THRESHOLD) {
+        return seastar::make_ready_future<bool>(true);
+    }
+
+    return seastar::make_ready_future<bool>(false); // No scaling needed
+}
 
-        return mpiController.getDiskLatencyMPI(ipAddress, processName, "/dev/sda"); // Example disk path
-    }).then([this](double diskLatency) {
-        if (diskLatency > DISK_LATENCY_THRESHOLD) {
-            return seastar::make_ready_future<bool>(true);
+size_t NodeManager::sustainedBreaches(const std::string &ipAddress, const MetricFrame &current) {
+    MetricQuery history;
+    size_t sustained = 0;
+    current.forEachBreach([&](const MetricTraits& traits, unsigned int gpu, float) {
+        MetricQuery::Selection window = MetricQuery::lastSeconds(traits.id, gpu, SUSTAIN_WINDOW_SECONDS);
+        window.nodes = {ipAddress};
+        // Breached throughout when even the window's least extreme sample breaches
+        bool above = traits.threshold.direction == MetricThreshold::ABOVE;
+        std::vector<NodeAggregate> extreme = history.aggregate(window, above ? QueryAggregate::MIN : QueryAggregate::MAX);
+
+        // Less than a window of history (a new node, or a restart): the current frame decides
+        uint64_t slack = SUSTAIN_WINDOW_SECONDS * 1000000 / 10;
+        if (extreme.empty() || extreme[0].firstMicros > window.fromMicros + slack ||
+            (above ? extreme[0].value > traits.threshold.limit : extreme[0].value < traits.threshold.limit)) {
+            ++sustained;
         }
-
-        return seastar::make_ready_future<bool>(false); // No scaling needed
     });
+    return sustained;
 }
 
 seastar::future<bool> NodeManager::needsTermination() {
@@ -416,6 +413,9 @@ seastar::future<> NodeManager::unregisterNode(const std::string &ipAddress) {
     return seastar::async([this, ipAddress] {
         // Remove ipAddress from the registeredNodes DistributedLinkedHashMap
         registeredNodes.remove(ipAddress).get(); // Ensure to use .get() to wait for the future to complete
+        seastar::smp::invoke_on_all([ipAddress] {
+            MetricsExposition::forShard().remove(ipAddress);
+        }).get();
         seastar::print("Unregistering node with IP: %s\n", ipAddress);
     });
 }
@@ -432,9 +432,28 @@ seastar::future<> NodeManager::loadBalancer() {
         // Fetch loads for all nodes
         return registeredNodes.maps.map_reduce0(
             [this](auto& map) {
+                // GPU usage averaged over the window, for every node of this shard in one
+                // group-by over the shard's history; nodes without history fall back to a
+                // fresh sample
+                MetricQuery::Selection window = MetricQuery::lastSeconds(MetricId::GPU_MEAN_USAGE, 0, LOAD_WINDOW_SECONDS);
+                for (const auto& [ip, name] : map) {
+                    window.nodes.push_back(ip);
+                }
+                std::unordered_map<std::string, float> gpuUsage;
+                if (!window.nodes.empty()) {
+                    for (const NodeAggregate& row : MetricQuery().aggregate(window, QueryAggregate::MEAN)) {
+                        gpuUsage[row.node] = static_cast<float>(row.value);
+                    }
+                }
+
                 std::vector<seastar::future<std::pair<std::string, int>>> loadFutures;
                 for (const auto& [ip, name] : map) {
-                    loadFutures.push_back(getNodeLoad(ip).then([ip](int load) {
+                    auto smoothed = gpuUsage.find(ip);
+                    std::optional<float> usage;
+                    if (smoothed != gpuUsage.end()) {
+                        usage = smoothed->second;
+                    }
+                    loadFutures.push_back(getNodeLoad(ip, usage).then([ip](int load) {
                         return std::make_pair(ip, load);
                     }));
                 }
@@ -619,33 +638,54 @@ seastar::future<> NodeManager::deleteNode(const std::string &instanceId, const s
 }
 
 seastar::future<int> NodeManager::getProcessLoad(const std::string &processName) {
-    // Example implementation to get the load of a process
     return seastar::async([this, processName] {
-        int totalLoad = 0;
-
-        // Replace with actual logic to get the load of the process
-        // This could include CPU, memory, and other resource usage metrics
-        return mpiController.getCpuUsageMPI(processName).then([&totalLoad](double cpuUsage) {
-            totalLoad += static_cast<int>(cpuUsage);
-
-            return mpiController.getMemoryUsageMPI(processName);
-        }).then([&totalLoad](double memUsage) {
-            totalLoad += static_cast<int>(memUsage);
-
-            return mpiController.getNetworkUsageMPI(processName);
-        }).then([&totalLoad](double netUsage) {
-            totalLoad += static_cast<int>(netUsage);
-
-            return seastar::make_ready_future<int>(totalLoad);
-        });
+        // Read from the workload's own cgroup: CPU against its quota, memory against
+        // memory.max, the share of time its tasks stalled on IO and its SM share of the
+        // busiest GPU it runs on. Host-wide numbers would let a noisy neighbour trigger a
+        // scale-up that does nothing for us.
+        seastar::future<double> cpu = mpiController.getCpuUsageMPI(processName);
+        seastar::future<double> memory = mpiController.getMemoryUsageMPI(processName);
+        seastar::future<double> io = mpiController.getIoUsageMPI(processName);
+        seastar::future<GpuWorkloadUsage> gpu = mpiController.getGpuUsageMPI(processName);
+        double cpuUsage = cpu.get();
+        double memUsage = memory.get();
+        double ioStall = io.get();
+        double gpuUsage = gpu.get().smUtilization;
+
+        return static_cast<int>(cpuUsage + memUsage + ioStall + gpuUsage);
     });
 }
 
 seastar::future<bool> NodeManager::needsScaling(const std::string &processName) {
     const double LOAD_THRESHOLD = 80.0; // Example threshold
+    // Below this IPC with at least this many cache misses per 1000 instructions the
+    // workload is waiting on memory; extra cores would stall the same way
+    const double MEMORY_BOUND_IPC = 0.7;
+    const double MEMORY_BOUND_MPKI = 10.0;
+
+    return getProcessLoad(processName).then([this, processName, LOAD_THRESHOLD, MEMORY_BOUND_IPC, MEMORY_BOUND_MPKI](int load) {
+        if (load <= LOAD_THRESHOLD) {
+            return seastar::make_ready_future<bool>(false);
+        }
+
+        return seastar::async([this, processName, MEMORY_BOUND_IPC, MEMORY_BOUND_MPKI] {
+            // A process that saturates a GPU needs another GPU, whatever its CPU side does
+            if (mpiController.getGpuUsageMPI(processName).get().smUtilization > GPU_USAGE_THRESHOLD) {
+                return true;
+            }
+
+            PerfSample perf = mpiController.getPerfCountersMPI(processName).get();
+            if (!perf.hardware || perf.instructions == 0) {
+                return true; // No PMU on this host; fall back to utilization alone
+            }
 
-    return getProcessLoad(processName).then([LOAD_THRESHOLD](int load) {
-        return seastar::make_ready_future<bool>(load > LOAD_THRESHOLD);
+            bool memoryBound = perf.ipc() < MEMORY_BOUND_IPC && perf.missesPerKiloInstruction() >= MEMORY_BOUND_MPKI;
+            if (memoryBound) {
+                seastar::print("%s is memory-stall bound (IPC %.2f, %.1f MPKI); scaling would not help\n",
+                               processName, perf.ipc(), perf.missesPerKiloInstruction());
+            }
+            return !memoryBound;
+        });
     });
 }
 
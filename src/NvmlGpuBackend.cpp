@@ -0,0 +1,361 @@
+#include "NvmlGpuBackend.h"
+#include <algorithm>
+#include <climits>
+#include <dlfcn.h>
+#include <map>
+#include <stdexcept>
+#include <vector>
+#include <nvml.h>  // Types only; every function is resolved with dlsym
+
+struct NvmlGpuBackend::Api {
+    decltype(&nvmlInit_v2) init;
+    decltype(&nvmlShutdown) shutdown;
+    decltype(&nvmlErrorString) errorString;
+    decltype(&nvmlDeviceGetCount_v2) getCount;
+    decltype(&nvmlDeviceGetHandleByIndex_v2) getHandleByIndex;
+    decltype(&nvmlDeviceGetTemperature) getTemperature;
+    decltype(&nvmlDeviceGetUtilizationRates) getUtilizationRates;
+    decltype(&nvmlDeviceGetMemoryInfo) getMemoryInfo;
+    decltype(&nvmlDeviceGetPowerUsage) getPowerUsage;
+    decltype(&nvmlDeviceGetFanSpeed) getFanSpeed;
+    decltype(&nvmlDeviceGetClockInfo) getClockInfo;
+    decltype(&nvmlDeviceGetComputeMode) getComputeMode;
+    decltype(&nvmlDeviceGetPcieThroughput) getPcieThroughput;
+    decltype(&nvmlDeviceGetFieldValues) getFieldValues = nullptr; // Missing from old drivers
+    decltype(&nvmlDeviceGetSamples) getSamples = nullptr;
+    decltype(&nvmlDeviceGetComputeRunningProcesses_v3) getComputeProcesses = nullptr;
+    decltype(&nvmlDeviceGetGraphicsRunningProcesses_v3) getGraphicsProcesses = nullptr;
+    decltype(&nvmlDeviceGetProcessUtilization) getProcessUtilization = nullptr;
+
+    std::vector<nvmlDevice_t> handles;
+
+    // Throws with NVML's own message when result is not NVML_SUCCESS
+    void check(nvmlReturn_t result, const std::string& what) const {
+        if (result != NVML_SUCCESS) {
+            throw std::runtime_error("Failed to get " + what + ": " + std::string(errorString(result)));
+        }
+    }
+
+    nvmlDevice_t device(unsigned int index) const {
+        if (index >= handles.size()) {
+            throw std::runtime_error("Failed to get handle for device " + std::to_string(index) + ": " +
+                                     std::string(errorString(NVML_ERROR_INVALID_ARGUMENT)));
+        }
+        return handles[index];
+    }
+};
+
+namespace {
+    // NVML's size-query convention: a call without a buffer reports the entry count,
+    // with INSUFFICIENT_SIZE or SUCCESS depending on the query. Processes can start
+    // between the two calls, so the buffer gets some slack and the query is retried once.
+    template<typename Entry, typename Query>
+    nvmlReturn_t queryList(Query query, std::vector<Entry>& entries) {
+        entries.clear();
+        unsigned int count = 0;
+        nvmlReturn_t result = query(&count, nullptr);
+        bool sized = result == NVML_ERROR_INSUFFICIENT_SIZE || (result == NVML_SUCCESS && count > 0);
+        for (int attempt = 0; sized && attempt < 2; ++attempt) {
+            entries.resize(count + 8);
+            count = static_cast<unsigned int>(entries.size());
+            result = query(&count, entries.data());
+            sized = result == NVML_ERROR_INSUFFICIENT_SIZE;
+        }
+        entries.resize(result == NVML_SUCCESS ? count : 0);
+        return result;
+    }
+
+    template<typename Function>
+    bool resolve(void* library, const char* name, Function& function) {
+        function = reinterpret_cast<Function>(dlsym(library, name));
+        return function != nullptr;
+    }
+}
+
+std::unique_ptr<NvmlGpuBackend> NvmlGpuBackend::load() {
+    void* library = dlopen("libnvidia-ml.so.1", RTLD_NOW | RTLD_LOCAL);
+    if (!library) {
+        return nullptr;
+    }
+
+    auto api = std::make_unique<Api>();
+    bool complete = resolve(library, "nvmlInit_v2", api->init)
+        && resolve(library, "nvmlShutdown", api->shutdown)
+        && resolve(library, "nvmlErrorString", api->errorString)
+        && resolve(library, "nvmlDeviceGetCount_v2", api->getCount)
+        && resolve(library, "nvmlDeviceGetHandleByIndex_v2", api->getHandleByIndex)
+        && resolve(library, "nvmlDeviceGetTemperature", api->getTemperature)
+        && resolve(library, "nvmlDeviceGetUtilizationRates", api->getUtilizationRates)
+        && resolve(library, "nvmlDeviceGetMemoryInfo", api->getMemoryInfo)
+        && resolve(library, "nvmlDeviceGetPowerUsage", api->getPowerUsage)
+        && resolve(library, "nvmlDeviceGetFanSpeed", api->getFanSpeed)
+        && resolve(library, "nvmlDeviceGetClockInfo", api->getClockInfo)
+        && resolve(library, "nvmlDeviceGetComputeMode", api->getComputeMode)
+        && resolve(library, "nvmlDeviceGetPcieThroughput", api->getPcieThroughput);
+
+    // The library can be installed without a loaded kernel driver; init fails then
+    if (!complete || api->init() != NVML_SUCCESS) {
+        dlclose(library);
+        return nullptr;
+    }
+    resolve(library, "nvmlDeviceGetFieldValues", api->getFieldValues);
+    resolve(library, "nvmlDeviceGetSamples", api->getSamples);
+    resolve(library, "nvmlDeviceGetComputeRunningProcesses_v3", api->getComputeProcesses);
+    resolve(library, "nvmlDeviceGetGraphicsRunningProcesses_v3", api->getGraphicsProcesses);
+    resolve(library, "nvmlDeviceGetProcessUtilization", api->getProcessUtilization);
+
+    unsigned int count = 0;
+    if (api->getCount(&count) == NVML_SUCCESS) {
+        for (unsigned int i = 0; i < count; ++i) {
+            nvmlDevice_t handle;
+            if (api->getHandleByIndex(i, &handle) != NVML_SUCCESS) {
+                break; // Keep indices dense; a device NVML cannot open ends the list
+            }
+            api->handles.push_back(handle);
+        }
+    }
+    return std::unique_ptr<NvmlGpuBackend>(new NvmlGpuBackend(library, std::move(api)));
+}
+
+NvmlGpuBackend::NvmlGpuBackend(void* library, std::unique_ptr<Api> api)
+    : library(library), api(std::move(api)) {}
+
+NvmlGpuBackend::~NvmlGpuBackend() {
+    api->shutdown();
+    dlclose(library);
+}
+
+unsigned int NvmlGpuBackend::deviceCount() {
+    return static_cast<unsigned int>(api->handles.size());
+}
+
+unsigned int NvmlGpuBackend::temperature(unsigned int index) {
+    unsigned int temperature;
+    api->check(api->getTemperature(api->device(index), NVML_TEMPERATURE_GPU, &temperature), "temperature");
+    return temperature;
+}
+
+GpuUtilization NvmlGpuBackend::utilization(unsigned int index) {
+    nvmlUtilization_t rates;
+    api->check(api->getUtilizationRates(api->device(index), &rates), "utilization");
+    return GpuUtilization{rates.gpu, rates.memory};
+}
+
+GpuMemoryInfo NvmlGpuBackend::memory(unsigned int index) {
+    nvmlMemory_t memory;
+    api->check(api->getMemoryInfo(api->device(index), &memory), "memory info");
+    return GpuMemoryInfo{memory.total, memory.used};
+}
+
+unsigned int NvmlGpuBackend::powerUsage(unsigned int index) {
+    unsigned int power;
+    api->check(api->getPowerUsage(api->device(index), &power), "power usage");
+    return power;
+}
+
+unsigned int NvmlGpuBackend::fanSpeed(unsigned int index) {
+    unsigned int speed;
+    api->check(api->getFanSpeed(api->device(index), &speed), "fan speed");
+    return speed;
+}
+
+unsigned int NvmlGpuBackend::clock(unsigned int index, GpuClock clock) {
+    unsigned int mhz;
+    api->check(api->getClockInfo(api->device(index), static_cast<nvmlClockType_t>(clock), &mhz), "clock");
+    return mhz;
+}
+
+GpuComputeMode NvmlGpuBackend::computeMode(unsigned int index) {
+    nvmlComputeMode_t mode;
+    api->check(api->getComputeMode(api->device(index), &mode), "compute mode");
+    return static_cast<GpuComputeMode>(mode);
+}
+
+unsigned int NvmlGpuBackend::pcieThroughput(unsigned int index, GpuPcieCounter counter) {
+    unsigned int throughput;
+    api->check(api->getPcieThroughput(api->device(index), static_cast<nvmlPcieUtilCounter_t>(counter), &throughput),
+               "PCIe throughput");
+    return throughput;
+}
+
+GpuSample NvmlGpuBackend::sample(unsigned int index) {
+    nvmlDevice_t device = api->device(index);
+    GpuSample sample;
+
+    unsigned int temperature;
+    if (api->getTemperature(device, NVML_TEMPERATURE_GPU, &temperature) == NVML_SUCCESS) {
+        sample.temperatureC = temperature;
+        sample.valid |= GpuSample::TEMPERATURE;
+    }
+    nvmlUtilization_t rates;
+    if (api->getUtilizationRates(device, &rates) == NVML_SUCCESS) {
+        sample.gpuUtilization = rates.gpu;
+        sample.memoryUtilization = rates.memory;
+        sample.valid |= GpuSample::UTILIZATION;
+    }
+    nvmlMemory_t memory;
+    if (api->getMemoryInfo(device, &memory) == NVML_SUCCESS) {
+        sample.memoryTotal = memory.total;
+        sample.memoryUsed = memory.used;
+        sample.valid |= GpuSample::MEMORY;
+    }
+    unsigned int fan;
+    if (api->getFanSpeed(device, &fan) == NVML_SUCCESS) {
+        sample.fanPercent = fan;
+        sample.valid |= GpuSample::FAN;
+    }
+    unsigned int smClock, memoryClock;
+    if (api->getClockInfo(device, NVML_CLOCK_SM, &smClock) == NVML_SUCCESS &&
+        api->getClockInfo(device, NVML_CLOCK_MEM, &memoryClock) == NVML_SUCCESS) {
+        sample.smClockMHz = smClock;
+        sample.memoryClockMHz = memoryClock;
+        sample.valid |= GpuSample::CLOCKS;
+    }
+
+    if (api->getFieldValues) {
+        nvmlFieldValue_t fields[2] = {};
+        fields[0].fieldId = NVML_FI_DEV_POWER_INSTANT;
+        fields[1].fieldId = NVML_FI_DEV_TOTAL_ENERGY_CONSUMPTION;
+        if (api->getFieldValues(device, 2, fields) == NVML_SUCCESS) {
+            // Each field carries its own status
+            if (fields[0].nvmlReturn == NVML_SUCCESS) {
+                sample.powerMilliwatts = fields[0].value.uiVal;
+                sample.valid |= GpuSample::POWER;
+            }
+            if (fields[1].nvmlReturn == NVML_SUCCESS) {
+                sample.energyMillijoules = fields[1].value.ullVal;
+                sample.valid |= GpuSample::ENERGY;
+            }
+        }
+    }
+    if (!sample.has(GpuSample::POWER)) {
+        unsigned int power; // Drivers without POWER_INSTANT
+        if (api->getPowerUsage(device, &power) == NVML_SUCCESS) {
+            sample.powerMilliwatts = power;
+            sample.valid |= GpuSample::POWER;
+        }
+    }
+    return sample;
+}
+
+std::vector<GpuTimedValue> NvmlGpuBackend::bufferedSamples(unsigned int index, GpuSampleType type, uint64_t sinceMicros) {
+    if (!api->getSamples) {
+        api->check(NVML_ERROR_FUNCTION_NOT_FOUND, "samples");
+    }
+    nvmlDevice_t device = api->device(index);
+    auto samplingType = static_cast<nvmlSamplingType_t>(type);
+
+    // A null buffer asks for the size needed; NOT_FOUND means nothing newer than sinceMicros
+    nvmlValueType_t valueType;
+    unsigned int count = 0;
+    nvmlReturn_t result = api->getSamples(device, samplingType, sinceMicros, &valueType, &count, nullptr);
+    if (result == NVML_ERROR_NOT_FOUND || (result == NVML_SUCCESS && count == 0)) {
+        return {};
+    }
+    api->check(result, "sample count");
+
+    std::vector<nvmlSample_t> raw(count);
+    result = api->getSamples(device, samplingType, sinceMicros, &valueType, &count, raw.data());
+    if (result == NVML_ERROR_NOT_FOUND) {
+        return {};
+    }
+    api->check(result, "samples");
+
+    std::vector<GpuTimedValue> samples;
+    samples.reserve(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        const nvmlValue_t& value = raw[i].sampleValue;
+        GpuTimedValue sample;
+        sample.timestampMicros = raw[i].timeStamp;
+        switch (valueType) {
+            case NVML_VALUE_TYPE_DOUBLE:
+                sample.value = value.dVal > 0.0 ? static_cast<uint64_t>(value.dVal) : 0;
+                break;
+            case NVML_VALUE_TYPE_UNSIGNED_INT:
+                sample.value = value.uiVal;
+                break;
+            case NVML_VALUE_TYPE_UNSIGNED_LONG:
+                sample.value = value.ulVal;
+                break;
+            case NVML_VALUE_TYPE_SIGNED_LONG_LONG:
+                sample.value = value.sllVal > 0 ? static_cast<uint64_t>(value.sllVal) : 0;
+                break;
+            default:
+                sample.value = value.ullVal;
+                break;
+        }
+        samples.push_back(sample);
+    }
+    // NVML does not document the order of the buffer it copies out
+    std::sort(samples.begin(), samples.end(), [](const GpuTimedValue& a, const GpuTimedValue& b) {
+        return a.timestampMicros < b.timestampMicros;
+    });
+    return samples;
+}
+
+std::vector<GpuProcessUsage> NvmlGpuBackend::processUsage(unsigned int index, uint64_t sinceMicros) {
+    if (!api->getComputeProcesses || !api->getGraphicsProcesses) {
+        api->check(NVML_ERROR_FUNCTION_NOT_FOUND, "running processes");
+    }
+    nvmlDevice_t device = api->device(index);
+
+    std::map<unsigned int, GpuProcessUsage> byPid;
+    auto addMemory = [&](decltype(api->getComputeProcesses) list, const char* what) {
+        std::vector<nvmlProcessInfo_t> processes;
+        api->check(queryList<nvmlProcessInfo_t>([&](unsigned int* count, nvmlProcessInfo_t* out) {
+            return list(device, count, out);
+        }, processes), what);
+        for (const nvmlProcessInfo_t& process : processes) {
+            GpuProcessUsage& usage = byPid[process.pid];
+            usage.pid = process.pid;
+            usage.device = index;
+            // A process in both lists has one allocation, reported twice
+            if (process.usedGpuMemory != ULLONG_MAX) { // NVML_VALUE_NOT_AVAILABLE
+                usage.memoryUsed = std::max<uint64_t>(usage.memoryUsed, process.usedGpuMemory);
+            }
+        }
+    };
+    addMemory(api->getComputeProcesses, "compute processes");
+    addMemory(api->getGraphicsProcesses, "graphics processes");
+
+    // Utilization is optional: some boards keep no per-process samples
+    std::vector<nvmlProcessUtilizationSample_t> samples;
+    if (api->getProcessUtilization) {
+        nvmlReturn_t result = queryList<nvmlProcessUtilizationSample_t>(
+            [&](unsigned int* count, nvmlProcessUtilizationSample_t* out) {
+                return api->getProcessUtilization(device, out, count, sinceMicros);
+            }, samples);
+        if (result != NVML_SUCCESS && result != NVML_ERROR_NOT_FOUND && result != NVML_ERROR_NOT_SUPPORTED) {
+            api->check(result, "process utilization");
+        }
+    }
+
+    std::map<unsigned int, unsigned int> sampleCounts;
+    for (const nvmlProcessUtilizationSample_t& sample : samples) {
+        if (sample.timeStamp <= sinceMicros) {
+            continue;
+        }
+        GpuProcessUsage& usage = byPid[sample.pid];
+        usage.pid = sample.pid;
+        usage.device = index;
+        usage.smUtilization += sample.smUtil;
+        usage.memoryUtilization += sample.memUtil;
+        usage.encoderUtilization += sample.encUtil;
+        usage.decoderUtilization += sample.decUtil;
+        usage.lastSampleMicros = std::max<uint64_t>(usage.lastSampleMicros, sample.timeStamp);
+        ++sampleCounts[sample.pid];
+    }
+
+    std::vector<GpuProcessUsage> processes;
+    processes.reserve(byPid.size());
+    for (auto& [pid, usage] : byPid) {
+        if (unsigned int count = sampleCounts[pid]) {
+            usage.smUtilization /= count;
+            usage.memoryUtilization /= count;
+            usage.encoderUtilization /= count;
+            usage.decoderUtilization /= count;
+        }
+        processes.push_back(usage);
+    }
+    return processes;
+}
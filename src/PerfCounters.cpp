@@ -0,0 +1,266 @@
+#include "PerfCounters.h"
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <stdexcept>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+    struct EventSpec {
+        uint32_t type;
+        uint64_t config;
+        uint64_t PerfSample::*field;
+    };
+
+    constexpr EventSpec HARDWARE_EVENTS[] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, &PerfSample::cycles},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, &PerfSample::instructions},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, &PerfSample::cacheMisses},
+    };
+    constexpr EventSpec SOFTWARE_EVENTS[] = {
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, &PerfSample::taskClockNs},
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, &PerfSample::contextSwitches},
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, &PerfSample::pageFaults},
+    };
+    constexpr size_t HARDWARE_EVENT_COUNT = sizeof(HARDWARE_EVENTS) / sizeof(HARDWARE_EVENTS[0]);
+    constexpr size_t SOFTWARE_EVENT_COUNT = sizeof(SOFTWARE_EVENTS) / sizeof(SOFTWARE_EVENTS[0]);
+
+    int perfEventOpen(perf_event_attr& attr, pid_t pid, int cpu, int groupFd, unsigned long flags) {
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, pid, cpu, groupFd, flags | PERF_FLAG_FD_CLOEXEC));
+    }
+
+    void closeAll(std::vector<int>& fds) {
+        for (int fd : fds) {
+            ::close(fd);
+        }
+        fds.clear();
+    }
+
+    // Opens the group for one pid/cpu pair. Returns an empty vector with errno set if
+    // any event fails, so the caller can retry with a smaller set.
+    std::vector<int> openGroup(pid_t pid, int cpu, unsigned long flags, bool withHardware, bool excludeKernel) {
+        std::vector<int> fds;
+        auto add = [&](const EventSpec& spec) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = spec.type;
+            attr.config = spec.config;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            attr.exclude_kernel = excludeKernel;
+            attr.exclude_hv = excludeKernel;
+            // Threads created after the open are counted into their creator's totals; cgroup
+            // mode covers them anyway
+            attr.inherit = (flags & PERF_FLAG_PID_CGROUP) == 0;
+
+            int fd = perfEventOpen(attr, pid, cpu, fds.empty() ? -1 : fds.front(), flags);
+            if (fd < 0) {
+                int error = errno;
+                closeAll(fds);
+                errno = error;
+                return false;
+            }
+            fds.push_back(fd);
+            return true;
+        };
+
+        if (withHardware) {
+            for (const auto& spec : HARDWARE_EVENTS) {
+                if (!add(spec)) {
+                    return fds;
+                }
+            }
+        }
+        for (const auto& spec : SOFTWARE_EVENTS) {
+            if (!add(spec)) {
+                return fds;
+            }
+        }
+        return fds;
+    }
+
+    // Every thread of pid at this moment
+    std::vector<pid_t> threadsOf(pid_t pid) {
+        std::string taskPath = "/proc/" + std::to_string(pid) + "/task";
+        DIR* tasks = opendir(taskPath.c_str());
+        if (!tasks) {
+            throw std::runtime_error("Failed to open " + taskPath + ": " + std::string(strerror(errno)));
+        }
+
+        std::vector<pid_t> tids;
+        while (dirent* entry = readdir(tasks)) {
+            if (entry->d_name[0] >= '0' && entry->d_name[0] <= '9') {
+                tids.push_back(static_cast<pid_t>(std::stol(entry->d_name)));
+            }
+        }
+        closedir(tasks);
+        if (tids.empty()) {
+            throw std::runtime_error("Process " + std::to_string(pid) + " has no threads");
+        }
+        return tids;
+    }
+}
+
+double PerfSample::ipc() const {
+    return cycles == 0 ? 0.0 : static_cast<double>(instructions) / static_cast<double>(cycles);
+}
+
+double PerfSample::missesPerKiloInstruction() const {
+    return instructions == 0 ? 0.0 : 1000.0 * static_cast<double>(cacheMisses) / static_cast<double>(instructions);
+}
+
+PerfSample PerfSample::since(const PerfSample& earlier) const {
+    PerfSample delta;
+    delta.cycles = cycles - earlier.cycles;
+    delta.instructions = instructions - earlier.instructions;
+    delta.cacheMisses = cacheMisses - earlier.cacheMisses;
+    delta.taskClockNs = taskClockNs - earlier.taskClockNs;
+    delta.contextSwitches = contextSwitches - earlier.contextSwitches;
+    delta.pageFaults = pageFaults - earlier.pageFaults;
+    delta.hardware = hardware;
+    return delta;
+}
+
+PerfCounters PerfCounters::forProcess(pid_t pid) {
+    // inherit only reaches threads created after the open, so every thread that already
+    // runs gets a group of its own and read() sums them
+    PerfCounters counters;
+    counters.openGroups(threadsOf(pid), {-1}, 0);
+    return counters;
+}
+
+PerfCounters PerfCounters::forCgroup(const std::string& cgroupPath) {
+    int cgroupFd = open(cgroupPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (cgroupFd < 0) {
+        throw std::runtime_error("Failed to open cgroup " + cgroupPath + ": " + std::string(strerror(errno)));
+    }
+
+    // Cgroup events cannot follow tasks across CPUs, so each CPU needs its own group
+    std::vector<int> cpus;
+    long cpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int cpu = 0; cpu < cpuCount; ++cpu) {
+        cpus.push_back(cpu);
+    }
+
+    PerfCounters counters;
+    try {
+        counters.openGroups({cgroupFd}, cpus, PERF_FLAG_PID_CGROUP);
+    } catch (...) {
+        ::close(cgroupFd);
+        throw;
+    }
+    ::close(cgroupFd);
+    return counters;
+}
+
+void PerfCounters::openGroups(const std::vector<pid_t>& targets, const std::vector<int>& cpus, unsigned long flags) {
+    // Try the full set first, then without kernel-mode counting (perf_event_paranoid=2),
+    // then software events only for guests without a virtualized PMU. The first target
+    // and CPU decide the mode; the rest are opened the same way.
+    struct Mode {
+        bool withHardware;
+        bool excludeKernel;
+    };
+    constexpr Mode MODES[] = {{true, false}, {true, true}, {false, false}, {false, true}};
+
+    int error = 0;
+    for (const Mode& mode : MODES) {
+        std::vector<int> first = openGroup(targets.front(), cpus.front(), flags, mode.withHardware, mode.excludeKernel);
+        if (first.empty()) {
+            error = errno;
+            continue;
+        }
+
+        groups.push_back(std::move(first));
+        for (size_t target = 0; target < targets.size(); ++target) {
+            for (size_t cpu = target == 0 ? 1 : 0; cpu < cpus.size(); ++cpu) {
+                std::vector<int> group = openGroup(targets[target], cpus[cpu], flags, mode.withHardware, mode.excludeKernel);
+                if (group.empty() && errno == ESRCH && (flags & PERF_FLAG_PID_CGROUP) == 0) {
+                    break; // The thread exited since it was listed
+                }
+                if (group.empty()) {
+                    error = errno;
+                    close();
+                    throw std::runtime_error("perf_event_open failed for " + std::to_string(targets[target]) + " on CPU " +
+                                             std::to_string(cpus[cpu]) + ": " + std::string(strerror(error)));
+                }
+                groups.push_back(std::move(group));
+            }
+        }
+        hardware = mode.withHardware;
+        return;
+    }
+
+    throw std::runtime_error("perf_event_open failed: " + std::string(strerror(error)));
+}
+
+PerfCounters::~PerfCounters() {
+    close();
+}
+
+PerfCounters::PerfCounters(PerfCounters&& other) noexcept
+    : groups(std::move(other.groups)), hardware(other.hardware) {
+    other.groups.clear();
+}
+
+PerfCounters& PerfCounters::operator=(PerfCounters&& other) noexcept {
+    if (this != &other) {
+        close();
+        groups = std::move(other.groups);
+        hardware = other.hardware;
+        other.groups.clear();
+    }
+    return *this;
+}
+
+void PerfCounters::close() {
+    for (auto& group : groups) {
+        closeAll(group);
+    }
+    groups.clear();
+}
+
+PerfSample PerfCounters::read() const {
+    // PERF_FORMAT_GROUP layout: nr, time_enabled, time_running, value[nr]
+    uint64_t buffer[3 + HARDWARE_EVENT_COUNT + SOFTWARE_EVENT_COUNT];
+
+    PerfSample sample;
+    sample.hardware = hardware;
+
+    for (const auto& group : groups) {
+        ssize_t bytes = ::read(group.front(), buffer, sizeof(buffer));
+        if (bytes < static_cast<ssize_t>(3 * sizeof(uint64_t))) {
+            throw std::runtime_error("Failed to read perf counters: " + std::string(strerror(errno)));
+        }
+
+        uint64_t count = buffer[0];
+        uint64_t enabled = buffer[1];
+        uint64_t running = buffer[2];
+        if (running == 0) {
+            continue; // The group never got onto the PMU, or the task has not run yet
+        }
+        // The kernel multiplexes groups when there are more events than PMU slots;
+        // extrapolate to the full enabled time
+        double scale = static_cast<double>(enabled) / static_cast<double>(running);
+
+        size_t index = 0;
+        auto accumulate = [&](const EventSpec& spec) {
+            if (index < count) {
+                sample.*spec.field += static_cast<uint64_t>(static_cast<double>(buffer[3 + index]) * scale);
+            }
+            ++index;
+        };
+        if (hardware) {
+            for (const auto& spec : HARDWARE_EVENTS) {
+                accumulate(spec);
+            }
+        }
+        for (const auto& spec : SOFTWARE_EVENTS) {
+            accumulate(spec);
+        }
+    }
+    return sample;
+}
@@ -0,0 +1,189 @@
+#include "PressureStall.h"
+#include "ProcReader.h"
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace {
+    // Parses "avg10=1.25" style fields; only the fixed-point form the kernel prints is needed
+    bool parseField(std::string_view token, std::string_view key, double& value) {
+        if (token.size() <= key.size() + 1 || token.compare(0, key.size(), key) != 0 || token[key.size()] != '=') {
+            return false;
+        }
+        std::string_view number = token.substr(key.size() + 1);
+
+        uint64_t whole = 0;
+        uint64_t fraction = 0;
+        double scale = 1.0;
+        size_t i = 0;
+        for (; i < number.size() && number[i] != '.'; ++i) {
+            whole = whole * 10 + static_cast<uint64_t>(number[i] - '0');
+        }
+        for (++i; i < number.size(); ++i) {
+            fraction = fraction * 10 + static_cast<uint64_t>(number[i] - '0');
+            scale *= 10.0;
+        }
+        value = static_cast<double>(whole) + static_cast<double>(fraction) / scale;
+        return true;
+    }
+
+    void signalEventFd(int fd, uint64_t count) {
+        // eventfd writes only fail on counter overflow or a closed reader; neither is actionable here
+        ssize_t ignored = write(fd, &count, sizeof(count));
+        (void)ignored;
+    }
+
+    void parseLine(ProcScanner& scanner, PressureLine& line) {
+        for (std::string_view token = scanner.token(); !token.empty(); token = scanner.token()) {
+            if (parseField(token, "avg10", line.avg10) || parseField(token, "avg60", line.avg60)
+                    || parseField(token, "avg300", line.avg300)) {
+                continue;
+            }
+            if (token.compare(0, 6, "total=") == 0) {
+                std::from_chars(token.data() + 6, token.data() + token.size(), line.totalUs);
+            }
+        }
+    }
+}
+
+PressureStats parsePressure(std::string_view text) {
+    PressureStats stats;
+    ProcScanner scanner(text);
+    do {
+        std::string_view kind = scanner.token();
+        if (kind == "some") {
+            parseLine(scanner, stats.some);
+        } else if (kind == "full") {
+            parseLine(scanner, stats.full);
+        }
+    } while (scanner.nextLine());
+    return stats;
+}
+
+const char* pressurePath(PressureResource resource) {
+    switch (resource) {
+        case PressureResource::Cpu:
+            return "/proc/pressure/cpu";
+        case PressureResource::Memory:
+            return "/proc/pressure/memory";
+        case PressureResource::Io:
+            return "/proc/pressure/io";
+    }
+    return "";
+}
+
+PressureMonitor::PressureMonitor() : stopFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+    if (stopFd < 0) {
+        throw std::runtime_error("Failed to create eventfd: " + std::string(strerror(errno)));
+    }
+}
+
+PressureMonitor::~PressureMonitor() {
+    stop();
+    for (int fd : triggerFds) {
+        close(fd);
+    }
+    close(stopFd);
+}
+
+size_t PressureMonitor::addTrigger(PressureResource resource, StallKind kind,
+                                   std::chrono::microseconds stall, std::chrono::microseconds window) {
+    return addTrigger(pressurePath(resource), kind, stall, window);
+}
+
+size_t PressureMonitor::addTrigger(const std::string& path, StallKind kind,
+                                   std::chrono::microseconds stall, std::chrono::microseconds window) {
+    int fd = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open " + path + ": " + std::string(strerror(errno)));
+    }
+
+    std::string trigger = std::string(kind == StallKind::Some ? "some " : "full ")
+        + std::to_string(stall.count()) + " " + std::to_string(window.count());
+
+    // The kernel expects the terminating NUL to be part of the write
+    if (write(fd, trigger.c_str(), trigger.size() + 1) < 0) {
+        int error = errno;
+        close(fd);
+        throw std::runtime_error("Failed to register PSI trigger on " + path + ": " + std::string(strerror(error)));
+    }
+
+    triggerFds.push_back(fd);
+    return triggerFds.size() - 1;
+}
+
+std::vector<size_t> PressureMonitor::pollOnce(int timeoutMs) {
+    std::vector<pollfd> fds;
+    fds.reserve(triggerFds.size() + 1);
+    for (int fd : triggerFds) {
+        fds.push_back({fd, POLLPRI, 0});
+    }
+    fds.push_back({stopFd, POLLIN, 0});
+
+    std::vector<size_t> fired;
+    int ready = poll(fds.data(), fds.size(), timeoutMs);
+    if (ready < 0) {
+        if (errno == EINTR) {
+            return fired;
+        }
+        throw std::runtime_error("poll on PSI triggers failed: " + std::string(strerror(errno)));
+    }
+
+    for (size_t i = 0; i < triggerFds.size(); ++i) {
+        if (fds[i].revents & POLLERR) {
+            // The monitored cgroup was removed; the trigger will never fire again
+            throw std::runtime_error("PSI trigger " + std::to_string(i) + " is no longer valid");
+        }
+        if (fds[i].revents & POLLPRI) {
+            fired.push_back(i);
+        }
+    }
+
+    events += fired.size();
+    return fired;
+}
+
+std::vector<size_t> PressureMonitor::wait(std::chrono::milliseconds timeout) {
+    return pollOnce(static_cast<int>(timeout.count()));
+}
+
+void PressureMonitor::start(int notifyFd) {
+    if (worker.joinable()) {
+        return;
+    }
+    worker = std::thread(&PressureMonitor::run, this, notifyFd);
+}
+
+void PressureMonitor::stop() {
+    if (!worker.joinable()) {
+        return;
+    }
+    stopping = true;
+    signalEventFd(stopFd, 1);
+    worker.join();
+
+    uint64_t drained;
+    ssize_t ignored = read(stopFd, &drained, sizeof(drained));
+    (void)ignored;
+    stopping = false;
+}
+
+void PressureMonitor::run(int notifyFd) {
+    while (!stopping) {
+        std::vector<size_t> fired;
+        try {
+            fired = pollOnce(-1);
+        } catch (const std::runtime_error&) {
+            return;
+        }
+
+        if (!fired.empty() && !stopping) {
+            signalEventFd(notifyFd, fired.size());
+        }
+    }
+}
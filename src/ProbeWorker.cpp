@@ -0,0 +1,117 @@
+#include "ProbeWorker.h"
+#include <cstdint>
+#include <seastar/core/loop.hh>
+#include <unistd.h>
+
+namespace {
+    void signalEventFd(int fd) {
+        // eventfd writes only fail on counter overflow or a closed reader; neither is actionable here
+        uint64_t one = 1;
+        ssize_t ignored = write(fd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+ProbeWorker::ProbeWorker() {
+    worker = std::thread([this] { runJobs(); });
+}
+
+ProbeWorker::~ProbeWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+ProbeWorker& ProbeWorker::forShard() {
+    static thread_local ProbeWorker worker;
+    return worker;
+}
+
+seastar::future<> ProbeWorker::submit(std::function<void()> work) {
+    auto job = std::make_unique<Job>();
+    job->work = std::move(work);
+    seastar::future<> done = job->done.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            return seastar::make_exception_future<>(std::runtime_error("Probe worker is stopped"));
+        }
+        queued.push_back(std::move(job));
+    }
+    wakeup.notify_one();
+    if (!delivering) {
+        delivering = deliverFinished();
+    }
+    return done;
+}
+
+void ProbeWorker::runJobs() {
+    for (;;) {
+        std::unique_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeup.wait(lock, [this] { return stopping || !queued.empty(); });
+            if (queued.empty()) {
+                exited = true;
+                break;
+            }
+            job = std::move(queued.front());
+            queued.pop_front();
+        }
+        try {
+            job->work();
+        } catch (...) {
+            job->error = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.push_back(std::move(job));
+        }
+        signalEventFd(completions.get_write_fd());
+    }
+    // Lets the delivery loop see that nothing more is coming
+    signalEventFd(completions.get_write_fd());
+}
+
+seastar::future<> ProbeWorker::deliverFinished() {
+    return seastar::repeat([this] {
+        return completions.wait().then([this](size_t) {
+            std::deque<std::unique_ptr<Job>> done;
+            bool drained;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                done.swap(finished);
+                drained = exited;
+            }
+            for (auto& job : done) {
+                if (job->error) {
+                    job->done.set_exception(job->error);
+                } else {
+                    job->done.set_value();
+                }
+            }
+            return drained ? seastar::stop_iteration::yes : seastar::stop_iteration::no;
+        });
+    });
+}
+
+seastar::future<> ProbeWorker::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_one();
+    // Jobs still queued run to completion; the thread has returned once the loop ends
+    seastar::future<> delivered = delivering ? std::move(*delivering) : seastar::make_ready_future<>();
+    delivering.reset();
+    return delivered.then([this] {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    });
+}
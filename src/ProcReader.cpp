@@ -0,0 +1,174 @@
+#include "ProcReader.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+#include <utility>
+
+namespace {
+    constexpr size_t INITIAL_BUFFER_SIZE = 4096;
+}
+
+ProcReader::ProcReader(std::string path)
+    : filePath(std::move(path)), buffer(INITIAL_BUFFER_SIZE) {}
+
+ProcReader::~ProcReader() {
+    close();
+}
+
+ProcReader::ProcReader(ProcReader&& other) noexcept
+    : filePath(std::move(other.filePath)), fd(other.fd), buffer(std::move(other.buffer)) {
+    other.fd = -1;
+}
+
+ProcReader& ProcReader::operator=(ProcReader&& other) noexcept {
+    if (this != &other) {
+        close();
+        filePath = std::move(other.filePath);
+        fd = other.fd;
+        buffer = std::move(other.buffer);
+        other.fd = -1;
+    }
+    return *this;
+}
+
+bool ProcReader::open() {
+    if (fd < 0) {
+        fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    return fd >= 0;
+}
+
+void ProcReader::close() {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+bool ProcReader::tryRead(std::string_view& contents) {
+    if (!open()) {
+        return false;
+    }
+
+    // seq_file and sysfs regenerate their contents on a read at offset 0, and may
+    // return the file in several chunks, so keep reading until pread reports EOF.
+    size_t total = 0;
+    while (true) {
+        if (total == buffer.size()) {
+            buffer.resize(buffer.size() * 2);
+        }
+
+        ssize_t bytes = ::pread(fd, buffer.data() + total, buffer.size() - total, static_cast<off_t>(total));
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // The file went away underneath us (e.g. a hot-unplugged device); reopen next time
+            close();
+            return false;
+        }
+        if (bytes == 0) {
+            break;
+        }
+        total += static_cast<size_t>(bytes);
+    }
+
+    contents = std::string_view(buffer.data(), total);
+    return true;
+}
+
+std::string_view ProcReader::read() {
+    std::string_view contents;
+    if (!tryRead(contents)) {
+        throw std::runtime_error("Failed to read " + filePath);
+    }
+    return contents;
+}
+
+void ProcScanner::skipBlanks() {
+    while (cursor < end && (*cursor == ' ' || *cursor == '\t')) {
+        ++cursor;
+    }
+}
+
+bool ProcScanner::nextLine() {
+    while (cursor < end && *cursor != '\n') {
+        ++cursor;
+    }
+    if (cursor < end) {
+        ++cursor;
+    }
+    return cursor < end;
+}
+
+std::string_view ProcScanner::token() {
+    skipBlanks();
+    const char* start = cursor;
+    while (cursor < end && *cursor != ' ' && *cursor != '\t' && *cursor != '\n') {
+        ++cursor;
+    }
+    return std::string_view(start, static_cast<size_t>(cursor - start));
+}
+
+std::string_view ProcScanner::tokenUntil(char delimiter) {
+    skipBlanks();
+    const char* start = cursor;
+    while (cursor < end && *cursor != delimiter && *cursor != ' ' && *cursor != '\t' && *cursor != '\n') {
+        ++cursor;
+    }
+    std::string_view result(start, static_cast<size_t>(cursor - start));
+    if (cursor < end && *cursor == delimiter) {
+        ++cursor;
+    }
+    return result;
+}
+
+bool ProcScanner::skipTokens(size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        if (token().empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ProcScanner::parseUnsigned(uint64_t& value) {
+    skipBlanks();
+    if (cursor >= end || *cursor < '0' || *cursor > '9') {
+        return false;
+    }
+
+    uint64_t result = 0;
+    while (cursor < end && *cursor >= '0' && *cursor <= '9') {
+        result = result * 10 + static_cast<uint64_t>(*cursor - '0');
+        ++cursor;
+    }
+    value = result;
+    return true;
+}
+
+bool ProcScanner::parseSigned(int64_t& value) {
+    skipBlanks();
+    bool negative = false;
+    if (cursor < end && (*cursor == '-' || *cursor == '+')) {
+        negative = *cursor == '-';
+        ++cursor;
+    }
+
+    uint64_t magnitude;
+    if (!parseUnsigned(magnitude)) {
+        return false;
+    }
+    value = negative ? -static_cast<int64_t>(magnitude) : static_cast<int64_t>(magnitude);
+    return true;
+}
+
+std::string_view ProcScanner::restOfLine() {
+    skipBlanks();
+    const char* start = cursor;
+    while (cursor < end && *cursor != '\n') {
+        ++cursor;
+    }
+    return std::string_view(start, static_cast<size_t>(cursor - start));
+}
@@ -0,0 +1,160 @@
+#include "ProcessStats.h"
+#include "ProcReader.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+    // Pids per worker below which spawning threads costs more than it saves
+    constexpr size_t MIN_PIDS_PER_WORKER = 64;
+    constexpr size_t READ_BUFFER_SIZE = 4096;
+
+    // Reads "<pid>/<file>" relative to /proc into buffer. Returns false if the process is gone.
+    bool readPidFile(int procFd, pid_t pid, const char* file, char* buffer, size_t& length) {
+        char path[64];
+        auto [end, ec] = std::to_chars(path, path + 32, pid);
+        if (ec != std::errc()) {
+            return false;
+        }
+        *end++ = '/';
+        std::strcpy(end, file);
+
+        int fd = openat(procFd, path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false; // ENOENT: the process exited before we got to it
+        }
+
+        ssize_t bytes;
+        do {
+            bytes = read(fd, buffer, READ_BUFFER_SIZE);
+        } while (bytes < 0 && errno == EINTR);
+        close(fd);
+
+        if (bytes <= 0) {
+            return false; // ESRCH: the process exited between open and read
+        }
+        length = static_cast<size_t>(bytes);
+        return true;
+    }
+}
+
+void ProcessStats::reserve(size_t count) {
+    pids.reserve(count);
+    rssBytes.reserve(count);
+    cpuTicks.reserve(count);
+    majorFaults.reserve(count);
+    threads.reserve(count);
+}
+
+void ProcessStats::append(const ProcessStats& other) {
+    pids.insert(pids.end(), other.pids.begin(), other.pids.end());
+    rssBytes.insert(rssBytes.end(), other.rssBytes.begin(), other.rssBytes.end());
+    cpuTicks.insert(cpuTicks.end(), other.cpuTicks.begin(), other.cpuTicks.end());
+    majorFaults.insert(majorFaults.end(), other.majorFaults.begin(), other.majorFaults.end());
+    threads.insert(threads.end(), other.threads.begin(), other.threads.end());
+}
+
+ProcessStatsCollector::ProcessStatsCollector(unsigned workers)
+    : workers(workers != 0 ? workers : std::max(1u, std::thread::hardware_concurrency())),
+      procFd(open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC)),
+      pageSize(sysconf(_SC_PAGESIZE)) {
+    if (procFd < 0) {
+        throw std::runtime_error("Failed to open /proc");
+    }
+}
+
+ProcessStatsCollector::~ProcessStatsCollector() {
+    close(procFd);
+}
+
+void ProcessStatsCollector::collectRange(const pid_t* begin, const pid_t* end, ProcessStats& out) const {
+    char buffer[READ_BUFFER_SIZE];
+    out.reserve(static_cast<size_t>(end - begin));
+
+    for (const pid_t* pid = begin; pid != end; ++pid) {
+        size_t length;
+
+        // statm: size resident shared text lib data dt (in pages)
+        if (!readPidFile(procFd, *pid, "statm", buffer, length)) {
+            continue;
+        }
+        uint64_t sizePages, residentPages;
+        ProcScanner statm(std::string_view(buffer, length));
+        if (!statm.parseUnsigned(sizePages) || !statm.parseUnsigned(residentPages)) {
+            continue;
+        }
+
+        // stat: the command name is wrapped in parentheses and may itself contain spaces
+        // or ')', so parsing starts after the last ')'
+        if (!readPidFile(procFd, *pid, "stat", buffer, length)) {
+            continue;
+        }
+        std::string_view stat(buffer, length);
+        auto closeParen = stat.rfind(')');
+        if (closeParen == std::string_view::npos) {
+            continue;
+        }
+
+        ProcScanner fields(stat.substr(closeParen + 1));
+        uint64_t majflt, utime, stime, numThreads;
+        if (!fields.skipTokens(9)                   // state .. cminflt (fields 3-11)
+                || !fields.parseUnsigned(majflt)     // field 12
+                || !fields.skipTokens(1)             // cmajflt
+                || !fields.parseUnsigned(utime)      // field 14
+                || !fields.parseUnsigned(stime)      // field 15
+                || !fields.skipTokens(4)             // cutime cstime priority nice
+                || !fields.parseUnsigned(numThreads)) { // field 20
+            continue;
+        }
+
+        out.pids.push_back(*pid);
+        out.rssBytes.push_back(residentPages * static_cast<uint64_t>(pageSize));
+        out.cpuTicks.push_back(utime + stime);
+        out.majorFaults.push_back(majflt);
+        out.threads.push_back(static_cast<uint32_t>(numThreads));
+    }
+}
+
+ProcessStats ProcessStatsCollector::collect(const std::vector<pid_t>& pids) const {
+    size_t workerCount = std::min<size_t>(workers, std::max<size_t>(1, pids.size() / MIN_PIDS_PER_WORKER));
+
+    if (workerCount <= 1) {
+        ProcessStats result;
+        collectRange(pids.data(), pids.data() + pids.size(), result);
+        return result;
+    }
+
+    // Contiguous chunks keep the output in input order once the parts are concatenated
+    std::vector<ProcessStats> parts(workerCount);
+    std::vector<std::thread> threads;
+    threads.reserve(workerCount - 1);
+
+    size_t chunk = (pids.size() + workerCount - 1) / workerCount;
+    for (size_t i = 1; i < workerCount; ++i) {
+        const pid_t* begin = pids.data() + std::min(pids.size(), i * chunk);
+        const pid_t* end = pids.data() + std::min(pids.size(), (i + 1) * chunk);
+        threads.emplace_back(&ProcessStatsCollector::collectRange, this, begin, end, std::ref(parts[i]));
+    }
+    collectRange(pids.data(), pids.data() + std::min(pids.size(), chunk), parts[0]);
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    ProcessStats result;
+    size_t total = 0;
+    for (const auto& part : parts) {
+        total += part.size();
+    }
+    result.reserve(total);
+    for (const auto& part : parts) {
+        result.append(part);
+    }
+    return result;
+}
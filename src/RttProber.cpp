@@ -0,0 +1,552 @@
+#include "RttProber.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <set>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+    constexpr unsigned char ICMP_ECHO_REQUEST = 8;
+    constexpr unsigned char ICMP_ECHO_REPLY = 0;
+    constexpr unsigned char ICMPV6_ECHO_REQUEST = 128;
+    constexpr unsigned char ICMPV6_ECHO_REPLY = 129;
+
+    // Payload that marks our probes; UDP echo replies are matched on it
+    constexpr unsigned char MAGIC[4] = {'D', 'R', 'T', 'T'};
+
+    socklen_t toSockaddr(int family, const std::array<unsigned char, 16>& bytes, uint16_t port, sockaddr_storage& out) {
+        std::memset(&out, 0, sizeof(out));
+        if (family == AF_INET) {
+            auto* in = reinterpret_cast<sockaddr_in*>(&out);
+            in->sin_family = AF_INET;
+            in->sin_port = htons(port);
+            std::memcpy(&in->sin_addr, bytes.data(), 4);
+            return sizeof(sockaddr_in);
+        }
+        auto* in6 = reinterpret_cast<sockaddr_in6*>(&out);
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(port);
+        std::memcpy(&in6->sin6_addr, bytes.data(), 16);
+        return sizeof(sockaddr_in6);
+    }
+
+    bool sameAddress(int family, const std::array<unsigned char, 16>& bytes, const sockaddr_storage& from) {
+        if (from.ss_family != family) {
+            return false;
+        }
+        if (family == AF_INET) {
+            return std::memcmp(&reinterpret_cast<const sockaddr_in*>(&from)->sin_addr, bytes.data(), 4) == 0;
+        }
+        return std::memcmp(&reinterpret_cast<const sockaddr_in6*>(&from)->sin6_addr, bytes.data(), 16) == 0;
+    }
+
+    timespec now() {
+        timespec at;
+        clock_gettime(CLOCK_REALTIME, &at); // The clock SO_TIMESTAMPING reports in
+        return at;
+    }
+
+    double millisecondsBetween(const timespec& from, const timespec& to) {
+        return (to.tv_sec - from.tv_sec) * 1e3 + (to.tv_nsec - from.tv_nsec) / 1e6;
+    }
+
+    // Software timestamp from an SCM_TIMESTAMPING control message, if the kernel sent one
+    std::optional<timespec> kernelTimestamp(msghdr& message) {
+        for (cmsghdr* control = CMSG_FIRSTHDR(&message); control; control = CMSG_NXTHDR(&message, control)) {
+            if (control->cmsg_level == SOL_SOCKET && control->cmsg_type == SCM_TIMESTAMPING) {
+                scm_timestamping stamps;
+                std::memcpy(&stamps, CMSG_DATA(control), sizeof(stamps));
+                if (stamps.ts[0].tv_sec != 0 || stamps.ts[0].tv_nsec != 0) {
+                    return stamps.ts[0];
+                }
+            }
+        }
+        return std::nullopt;
+    }
+}
+
+struct RttProber::Pending {
+    Target* target = nullptr;
+    Method method = Method::ICMP;
+    Socket* socket = nullptr; // Datagram methods
+    int tcpFd = -1;           // TCP_CONNECT
+    uint16_t sequence = 0;
+    std::optional<uint32_t> txKey;
+    timespec sentUser{};
+    std::optional<timespec> sentKernel;
+    std::optional<timespec> received;
+    bool done = false;
+};
+
+double RttStats::lossRatio() const {
+    return sent ? 1.0 - static_cast<double>(received) / static_cast<double>(sent) : 0.0;
+}
+
+RttProber::RttProber(const std::string& interface, size_t window) : window(std::max<size_t>(1, window)) {
+    if (!interface.empty()) {
+        sourceAddresses = SockDiag::interfaceAddresses(interface);
+    }
+}
+
+RttProber::~RttProber() {
+    for (auto& entry : sockets) {
+        if (entry.second.fd >= 0) {
+            close(entry.second.fd);
+        }
+    }
+}
+
+RttProber::Target& RttProber::target(const std::string& spec) {
+    auto it = targets.find(spec);
+    if (it != targets.end()) {
+        return it->second;
+    }
+
+    Target parsed;
+    std::string_view rest = spec;
+    if (rest.rfind("icmp://", 0) == 0) {
+        parsed.method = Method::ICMP_ONLY;
+        rest.remove_prefix(7);
+    } else if (rest.rfind("tcp://", 0) == 0) {
+        parsed.method = Method::TCP_CONNECT;
+        rest.remove_prefix(6);
+    } else if (rest.rfind("udp://", 0) == 0) {
+        parsed.method = Method::UDP_ECHO;
+        rest.remove_prefix(6);
+    }
+
+    if (parsed.method == Method::ICMP || parsed.method == Method::ICMP_ONLY) {
+        parsed.host = std::string(rest);
+        parsed.port = TCP_FALLBACK_PORT;
+    } else {
+        size_t colon = rest.rfind(':');
+        if (colon == std::string_view::npos ||
+            std::from_chars(rest.data() + colon + 1, rest.data() + rest.size(), parsed.port).ec != std::errc()) {
+            throw std::invalid_argument("RTT target needs a port: " + spec);
+        }
+        std::string_view host = rest.substr(0, colon);
+        if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+            host = host.substr(1, host.size() - 2); // [v6]:port
+        }
+        parsed.host = std::string(host);
+    }
+    return targets.emplace(spec, std::move(parsed)).first->second;
+}
+
+bool RttProber::resolve(Target& target) {
+    if (target.address) {
+        return true;
+    }
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* results = nullptr;
+    if (getaddrinfo(target.host.c_str(), nullptr, &hints, &results) != 0) {
+        return false; // Retried next round
+    }
+
+    // With a source interface, prefer a family it has an address in
+    addrinfo* chosen = nullptr;
+    for (addrinfo* result = results; result; result = result->ai_next) {
+        if (result->ai_family != AF_INET && result->ai_family != AF_INET6) {
+            continue;
+        }
+        bool reachable = sourceAddresses.empty() ||
+            std::any_of(sourceAddresses.begin(), sourceAddresses.end(), [&](const LocalAddress& local) {
+                return local.family == result->ai_family;
+            });
+        if (!chosen || reachable) {
+            chosen = result;
+        }
+        if (reachable) {
+            break;
+        }
+    }
+
+    if (chosen) {
+        std::array<unsigned char, 16> bytes{};
+        if (chosen->ai_family == AF_INET) {
+            std::memcpy(bytes.data(), &reinterpret_cast<sockaddr_in*>(chosen->ai_addr)->sin_addr, 4);
+        } else {
+            std::memcpy(bytes.data(), &reinterpret_cast<sockaddr_in6*>(chosen->ai_addr)->sin6_addr, 16);
+        }
+        target.address = std::make_pair(chosen->ai_family, bytes);
+    }
+    freeaddrinfo(results);
+    return target.address.has_value();
+}
+
+void RttProber::bindSource(int fd, int family) const {
+    for (const LocalAddress& local : sourceAddresses) {
+        // Link-local IPv6 addresses would need a scope id; leave those to the routing table
+        if (local.family != family || (family == AF_INET6 && local.bytes[0] == 0xfe && (local.bytes[1] & 0xc0) == 0x80)) {
+            continue;
+        }
+        sockaddr_storage address;
+        socklen_t length = toSockaddr(family, local.bytes, 0, address);
+        bind(fd, reinterpret_cast<sockaddr*>(&address), length);
+        return;
+    }
+}
+
+RttProber::Socket* RttProber::datagramSocket(Method method, int family) {
+    auto key = std::make_pair(method, family);
+    auto it = sockets.find(key);
+    if (it != sockets.end()) {
+        return &it->second;
+    }
+
+    int protocol = IPPROTO_UDP;
+    if (method == Method::ICMP) {
+        protocol = family == AF_INET ? static_cast<int>(IPPROTO_ICMP) : static_cast<int>(IPPROTO_ICMPV6);
+    }
+    int fd = socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, protocol);
+    if (fd < 0) {
+        if (method == Method::ICMP && (errno == EACCES || errno == EPERM || errno == EPROTONOSUPPORT)) {
+            icmpDenied = true; // Outside net.ipv4.ping_group_range
+        }
+        return nullptr;
+    }
+    bindSource(fd, family);
+
+    Socket opened;
+    opened.fd = fd;
+    opened.method = method;
+    // Send timestamps come back on the error queue keyed by send count; fall back to
+    // receive timestamps only if the kernel will not report them
+    int flags = SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_TX_SOFTWARE |
+                SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+    if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0) {
+        opened.txTimestamps = true;
+    } else {
+        flags = SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE;
+        setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags));
+    }
+    return &sockets.emplace(key, opened).first->second;
+}
+
+bool RttProber::send(Pending& pending, uint16_t sequence) {
+    Target& target = *pending.target;
+    int family = target.address->first;
+    pending.sequence = sequence;
+
+    if (pending.method == Method::ICMP) {
+        pending.socket = datagramSocket(Method::ICMP, family);
+        if (!pending.socket && icmpDenied && pending.target->method != Method::ICMP_ONLY) {
+            pending.method = Method::TCP_CONNECT;
+        } else if (!pending.socket) {
+            return false;
+        }
+    }
+
+    if (pending.method == Method::TCP_CONNECT) {
+        int fd = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return false;
+        }
+        bindSource(fd, family);
+        linger abort{1, 0}; // Close with a RST so probes do not pile up in TIME_WAIT
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+
+        sockaddr_storage to;
+        socklen_t length = toSockaddr(family, target.address->second, target.port, to);
+        pending.sentUser = now();
+        if (connect(fd, reinterpret_cast<sockaddr*>(&to), length) == 0 || errno == ECONNREFUSED) {
+            pending.received = now(); // Loopback can answer before connect() returns
+            pending.done = true;
+            close(fd);
+            return true;
+        }
+        if (errno != EINPROGRESS) {
+            close(fd);
+            return false;
+        }
+        pending.tcpFd = fd;
+        return true;
+    }
+
+    if (pending.method == Method::UDP_ECHO) {
+        pending.socket = datagramSocket(Method::UDP_ECHO, family);
+        if (!pending.socket) {
+            return false;
+        }
+    }
+
+    unsigned char packet[16] = {};
+    size_t length;
+    uint16_t port = 0;
+    uint16_t networkSequence = htons(sequence);
+    if (pending.method == Method::ICMP) {
+        // The kernel fills in the identifier and checksum for datagram ICMP sockets
+        packet[0] = family == AF_INET ? ICMP_ECHO_REQUEST : ICMPV6_ECHO_REQUEST;
+        std::memcpy(packet + 6, &networkSequence, 2);
+        std::memcpy(packet + 8, MAGIC, sizeof(MAGIC));
+        length = 16;
+    } else {
+        std::memcpy(packet, MAGIC, sizeof(MAGIC));
+        std::memcpy(packet + 4, &networkSequence, 2);
+        length = 8;
+        port = target.port;
+    }
+
+    sockaddr_storage to;
+    socklen_t toLength = toSockaddr(family, target.address->second, port, to);
+    Socket& socket = *pending.socket;
+    pending.sentUser = now();
+    if (sendto(socket.fd, packet, length, 0, reinterpret_cast<sockaddr*>(&to), toLength) < 0) {
+        // Whether a failed send consumed a timestamp key is not specified; stop trusting them
+        socket.txTimestamps = false;
+        return false;
+    }
+    if (socket.txTimestamps) {
+        pending.txKey = socket.nextTxKey++;
+    }
+    return true;
+}
+
+void RttProber::receive(Socket& socket, std::vector<Pending>& pending) {
+    for (;;) {
+        unsigned char buffer[256];
+        alignas(cmsghdr) char control[512];
+        sockaddr_storage from;
+        iovec vector{buffer, sizeof(buffer)};
+        msghdr message{};
+        message.msg_name = &from;
+        message.msg_namelen = sizeof(from);
+        message.msg_iov = &vector;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        ssize_t length = recvmsg(socket.fd, &message, MSG_DONTWAIT);
+        if (length < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return; // Drained
+        }
+        timespec at = kernelTimestamp(message).value_or(now());
+
+        uint16_t networkSequence;
+        if (socket.method == Method::ICMP) {
+            unsigned char reply = from.ss_family == AF_INET ? ICMP_ECHO_REPLY : ICMPV6_ECHO_REPLY;
+            if (length < 8 || buffer[0] != reply) {
+                continue;
+            }
+            std::memcpy(&networkSequence, buffer + 6, 2);
+        } else {
+            if (length < 6 || std::memcmp(buffer, MAGIC, sizeof(MAGIC)) != 0) {
+                continue;
+            }
+            std::memcpy(&networkSequence, buffer + 4, 2);
+        }
+        uint16_t sequence = ntohs(networkSequence);
+
+        for (Pending& candidate : pending) {
+            if (!candidate.done && candidate.socket == &socket && candidate.sequence == sequence &&
+                sameAddress(candidate.target->address->first, candidate.target->address->second, from)) {
+                candidate.received = at;
+                candidate.done = true;
+                break;
+            }
+        }
+    }
+}
+
+void RttProber::drainTxTimestamps(Socket& socket, std::vector<Pending>& pending) {
+    for (;;) {
+        alignas(cmsghdr) char control[512];
+        msghdr message{};
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        if (recvmsg(socket.fd, &message, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        std::optional<uint32_t> key;
+        for (cmsghdr* header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+            bool extendedError = (header->cmsg_level == SOL_IP && header->cmsg_type == IP_RECVERR) ||
+                                 (header->cmsg_level == SOL_IPV6 && header->cmsg_type == IPV6_RECVERR);
+            if (extendedError) {
+                sock_extended_err error;
+                std::memcpy(&error, CMSG_DATA(header), sizeof(error));
+                if (error.ee_origin == SO_EE_ORIGIN_TIMESTAMPING) {
+                    key = error.ee_data;
+                }
+            }
+        }
+        std::optional<timespec> at = kernelTimestamp(message);
+        if (!key || !at) {
+            continue;
+        }
+        for (Pending& candidate : pending) {
+            if (candidate.socket == &socket && candidate.txKey == key) {
+                candidate.sentKernel = at;
+                break;
+            }
+        }
+    }
+}
+
+void RttProber::probe(const std::vector<std::string>& specs, std::chrono::milliseconds timeout) {
+    std::vector<Pending> pending;
+    pending.reserve(specs.size());
+    for (const std::string& spec : specs) {
+        Pending probe;
+        probe.target = &target(spec);
+        // Pinned targets go out as ICMP but never fall back to TCP
+        bool pinned = probe.target->method == Method::ICMP_ONLY;
+        probe.method = pinned ? Method::ICMP : probe.target->method;
+        bool sent = !(pinned && icmpDenied) && resolve(*probe.target) && send(probe, nextSequence++);
+        if (!sent && pinned && icmpDenied) {
+            continue; // No sample at all, so the statistics do not read as loss
+        } else if (!sent) {
+            probe.done = true; // Counted as lost
+        }
+        pending.push_back(probe);
+    }
+
+    std::set<Socket*> used;
+    for (const Pending& probe : pending) {
+        if (probe.socket) {
+            used.insert(probe.socket);
+        }
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    std::vector<pollfd> fds;
+    for (;;) {
+        fds.clear();
+        for (Socket* socket : used) {
+            fds.push_back({socket->fd, POLLIN, 0});
+        }
+        size_t outstanding = 0;
+        for (const Pending& probe : pending) {
+            if (!probe.done) {
+                ++outstanding;
+                if (probe.tcpFd >= 0) {
+                    fds.push_back({probe.tcpFd, POLLOUT, 0});
+                }
+            }
+        }
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (outstanding == 0 || remaining.count() <= 0) {
+            break;
+        }
+        if (poll(fds.data(), fds.size(), static_cast<int>(remaining.count()) + 1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        for (const pollfd& ready : fds) {
+            if (ready.revents == 0) {
+                continue;
+            }
+            auto socket = std::find_if(used.begin(), used.end(), [&](Socket* s) { return s->fd == ready.fd; });
+            if (socket != used.end()) {
+                if (ready.revents & POLLERR) {
+                    drainTxTimestamps(**socket, pending);
+                }
+                if (ready.revents & POLLIN) {
+                    receive(**socket, pending);
+                }
+                continue;
+            }
+
+            for (Pending& probe : pending) {
+                if (probe.tcpFd != ready.fd || probe.done) {
+                    continue;
+                }
+                int error = 0;
+                socklen_t length = sizeof(error);
+                getsockopt(probe.tcpFd, SOL_SOCKET, SO_ERROR, &error, &length);
+                // A RST is as much a round trip as a SYN-ACK; unreachable errors are not
+                if (error == 0 || error == ECONNREFUSED) {
+                    probe.received = now();
+                }
+                probe.done = true;
+                break;
+            }
+        }
+    }
+
+    // Send timestamps usually arrive first, but collect any that are still queued
+    for (Socket* socket : used) {
+        drainTxTimestamps(*socket, pending);
+    }
+
+    for (Pending& probe : pending) {
+        if (probe.tcpFd >= 0) {
+            close(probe.tcpFd);
+        }
+
+        std::optional<double> rtt;
+        if (probe.received) {
+            double ms = millisecondsBetween(probe.sentKernel.value_or(probe.sentUser), *probe.received);
+            if (ms < 0.0) {
+                ms = millisecondsBetween(probe.sentUser, *probe.received);
+            }
+            rtt = std::max(0.0, ms);
+        }
+
+        auto& samples = probe.target->samples;
+        samples.push_back(rtt);
+        while (samples.size() > window) {
+            samples.pop_front();
+        }
+    }
+}
+
+RttStats RttProber::stats(const std::string& spec) const {
+    RttStats stats;
+    auto it = targets.find(spec);
+    if (it == targets.end()) {
+        return stats;
+    }
+
+    double sum = 0.0;
+    double jitterSum = 0.0;
+    std::optional<double> previous;
+    for (const auto& sample : it->second.samples) {
+        ++stats.sent;
+        if (!sample) {
+            continue;
+        }
+        if (stats.received == 0 || *sample < stats.minMs) {
+            stats.minMs = *sample;
+        }
+        stats.maxMs = std::max(stats.maxMs, *sample);
+        sum += *sample;
+        if (previous) {
+            jitterSum += std::fabs(*sample - *previous);
+        }
+        previous = sample;
+        ++stats.received;
+    }
+
+    if (stats.received > 0) {
+        stats.avgMs = sum / static_cast<double>(stats.received);
+    }
+    if (stats.received > 1) {
+        stats.jitterMs = jitterSum / static_cast<double>(stats.received - 1);
+    }
+    return stats;
+}
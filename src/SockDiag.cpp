@@ -0,0 +1,284 @@
+#include "SockDiag.h"
+#include "ProcReader.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <ifaddrs.h>
+#include <linux/inet_diag.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sock_diag.h>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+    constexpr size_t RECEIVE_BUFFER_SIZE = 64 * 1024;
+
+    class NetlinkSocket {
+    public:
+        NetlinkSocket() {
+            fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+            if (fd < 0) {
+                throw std::runtime_error("Failed to open NETLINK_SOCK_DIAG socket: " + std::string(strerror(errno)));
+            }
+        }
+
+        ~NetlinkSocket() {
+            close(fd);
+        }
+
+        NetlinkSocket(const NetlinkSocket&) = delete;
+        NetlinkSocket& operator=(const NetlinkSocket&) = delete;
+
+        int fd;
+    };
+
+    // Builds "sport >= port && sport <= port" in inet_diag bytecode. A failed comparison
+    // jumps past the end of the program (len + 4), which the kernel treats as reject.
+    std::vector<inet_diag_bc_op> portFilter(uint16_t port) {
+        std::vector<inet_diag_bc_op> ops(4);
+        const unsigned char OP_PAIR = 2 * sizeof(inet_diag_bc_op);
+        const unsigned short programLength = 4 * sizeof(inet_diag_bc_op);
+
+        ops[0] = {INET_DIAG_BC_S_GE, OP_PAIR, static_cast<unsigned short>(programLength + 4)};
+        ops[1] = {0, 0, port};
+        ops[2] = {INET_DIAG_BC_S_LE, OP_PAIR, static_cast<unsigned short>(programLength / 2 + 4)};
+        ops[3] = {0, 0, port};
+        return ops;
+    }
+
+    bool acceptsAddress(const std::vector<LocalAddress>& localAddresses, int family, const unsigned char* address) {
+        if (localAddresses.empty()) {
+            return true;
+        }
+        for (const auto& local : localAddresses) {
+            if (local.matches(family, address)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void dumpFamily(NetlinkSocket& sock, uint8_t family, uint32_t stateMask, uint16_t localPort,
+                    const std::vector<LocalAddress>& localAddresses, TcpStateCounts& counts) {
+        std::vector<inet_diag_bc_op> bytecode;
+        if (localPort != 0) {
+            bytecode = portFilter(localPort);
+        }
+        const size_t bytecodeLength = bytecode.size() * sizeof(inet_diag_bc_op);
+
+        nlmsghdr header{};
+        inet_diag_req_v2 request{};
+        rtattr attribute{};
+
+        header.nlmsg_len = NLMSG_LENGTH(sizeof(request)) + (bytecode.empty() ? 0 : RTA_LENGTH(bytecodeLength));
+        header.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+        header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+
+        request.sdiag_family = family;
+        request.sdiag_protocol = IPPROTO_TCP;
+        request.idiag_states = stateMask;
+
+        attribute.rta_type = INET_DIAG_REQ_BYTECODE;
+        attribute.rta_len = RTA_LENGTH(bytecodeLength);
+
+        iovec iov[4] = {
+            {&header, sizeof(header)},
+            {&request, sizeof(request)},
+            {&attribute, sizeof(attribute)},
+            {bytecode.data(), bytecodeLength},
+        };
+
+        sockaddr_nl kernel{};
+        kernel.nl_family = AF_NETLINK;
+
+        msghdr message{};
+        message.msg_name = &kernel;
+        message.msg_namelen = sizeof(kernel);
+        message.msg_iov = iov;
+        message.msg_iovlen = bytecode.empty() ? 2 : 4;
+
+        if (sendmsg(sock.fd, &message, 0) < 0) {
+            throw std::runtime_error("Failed to send sock_diag request: " + std::string(strerror(errno)));
+        }
+
+        std::vector<char> buffer(RECEIVE_BUFFER_SIZE);
+        while (true) {
+            ssize_t received = recv(sock.fd, buffer.data(), buffer.size(), 0);
+            if (received < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error("Failed to receive sock_diag reply: " + std::string(strerror(errno)));
+            }
+
+            int remaining = static_cast<int>(received);
+            for (auto* reply = reinterpret_cast<nlmsghdr*>(buffer.data()); NLMSG_OK(reply, remaining);
+                 reply = NLMSG_NEXT(reply, remaining)) {
+                if (reply->nlmsg_type == NLMSG_DONE) {
+                    return;
+                }
+                if (reply->nlmsg_type == NLMSG_ERROR) {
+                    auto* error = static_cast<nlmsgerr*>(NLMSG_DATA(reply));
+                    throw std::runtime_error("sock_diag request failed: " + std::string(strerror(-error->error)));
+                }
+                if (reply->nlmsg_type != SOCK_DIAG_BY_FAMILY) {
+                    continue;
+                }
+
+                auto* diag = static_cast<inet_diag_msg*>(NLMSG_DATA(reply));
+                if (diag->idiag_state >= TcpStateCounts::STATE_COUNT) {
+                    continue;
+                }
+                if (acceptsAddress(localAddresses, diag->idiag_family,
+                                   reinterpret_cast<const unsigned char*>(diag->id.idiag_src))) {
+                    ++counts.byState[diag->idiag_state];
+                }
+            }
+        }
+    }
+
+    // /proc/net/tcp prints each 32-bit word of the address with %08X on the raw
+    // network-order value, so converting the hex back to a native integer and copying
+    // its bytes recovers the original address.
+    bool parseHexAddress(std::string_view hex, unsigned char* out, size_t words) {
+        if (hex.size() != words * 8) {
+            return false;
+        }
+        for (size_t word = 0; word < words; ++word) {
+            uint32_t value = 0;
+            for (size_t i = 0; i < 8; ++i) {
+                char c = hex[word * 8 + i];
+                value <<= 4;
+                if (c >= '0' && c <= '9') {
+                    value |= static_cast<uint32_t>(c - '0');
+                } else if (c >= 'A' && c <= 'F') {
+                    value |= static_cast<uint32_t>(c - 'A' + 10);
+                } else if (c >= 'a' && c <= 'f') {
+                    value |= static_cast<uint32_t>(c - 'a' + 10);
+                } else {
+                    return false;
+                }
+            }
+            std::memcpy(out + word * 4, &value, sizeof(value));
+        }
+        return true;
+    }
+
+    uint32_t parseHex(std::string_view hex) {
+        uint32_t value = 0;
+        for (char c : hex) {
+            value <<= 4;
+            value |= static_cast<uint32_t>(c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+        }
+        return value;
+    }
+
+    void scanProcFile(ProcReader& reader, int family, uint32_t stateMask, uint16_t localPort,
+                      const std::vector<LocalAddress>& localAddresses, TcpStateCounts& counts) {
+        std::string_view contents;
+        if (!reader.tryRead(contents)) {
+            return; // tcp6 is absent when IPv6 is disabled
+        }
+
+        const size_t words = family == AF_INET ? 1 : 4;
+        ProcScanner scanner(contents);
+        while (scanner.nextLine()) { // The first line is the header
+            scanner.token(); // "sl:"
+            std::string_view local = scanner.token();
+            scanner.token(); // remote address
+            uint32_t state = parseHex(scanner.token());
+
+            auto colon = local.find(':');
+            if (colon == std::string_view::npos || state >= TcpStateCounts::STATE_COUNT
+                    || !(stateMask & SockDiag::stateBit(static_cast<int>(state)))) {
+                continue;
+            }
+            if (localPort != 0 && parseHex(local.substr(colon + 1)) != localPort) {
+                continue;
+            }
+
+            unsigned char address[16] = {};
+            if (!parseHexAddress(local.substr(0, colon), address, words)) {
+                continue;
+            }
+            if (acceptsAddress(localAddresses, family, address)) {
+                ++counts.byState[state];
+            }
+        }
+    }
+}
+
+uint64_t TcpStateCounts::total() const {
+    uint64_t sum = 0;
+    for (uint64_t count : byState) {
+        sum += count;
+    }
+    return sum;
+}
+
+uint64_t TcpStateCounts::established() const {
+    return byState[1]; // TCP_ESTABLISHED
+}
+
+bool LocalAddress::matches(int socketFamily, const unsigned char* socketAddress) const {
+    if (socketFamily == family) {
+        return std::memcmp(bytes.data(), socketAddress, family == AF_INET ? 4 : 16) == 0;
+    }
+
+    // IPv4 connections accepted on a dual-stack socket show up as ::ffff:a.b.c.d
+    static const unsigned char v4MappedPrefix[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+    return family == AF_INET && socketFamily == AF_INET6
+        && std::memcmp(socketAddress, v4MappedPrefix, sizeof(v4MappedPrefix)) == 0
+        && std::memcmp(socketAddress + 12, bytes.data(), 4) == 0;
+}
+
+TcpStateCounts SockDiag::countTcp(uint32_t stateMask, uint16_t localPort, const std::vector<LocalAddress>& localAddresses) {
+    NetlinkSocket sock;
+    TcpStateCounts counts;
+    dumpFamily(sock, AF_INET, stateMask, localPort, localAddresses, counts);
+    dumpFamily(sock, AF_INET6, stateMask, localPort, localAddresses, counts);
+    return counts;
+}
+
+TcpStateCounts SockDiag::countTcpFromProc(uint32_t stateMask, uint16_t localPort, const std::vector<LocalAddress>& localAddresses) {
+    static thread_local ProcReader tcpFile("/proc/net/tcp");
+    static thread_local ProcReader tcp6File("/proc/net/tcp6");
+
+    TcpStateCounts counts;
+    scanProcFile(tcpFile, AF_INET, stateMask, localPort, localAddresses, counts);
+    scanProcFile(tcp6File, AF_INET6, stateMask, localPort, localAddresses, counts);
+    return counts;
+}
+
+std::vector<LocalAddress> SockDiag::interfaceAddresses(const std::string& interface) {
+    ifaddrs* addresses;
+    if (getifaddrs(&addresses) != 0) {
+        throw std::runtime_error("Failed to list interface addresses: " + std::string(strerror(errno)));
+    }
+
+    std::vector<LocalAddress> result;
+    for (ifaddrs* entry = addresses; entry != nullptr; entry = entry->ifa_next) {
+        if (entry->ifa_addr == nullptr || interface != entry->ifa_name) {
+            continue;
+        }
+
+        LocalAddress local;
+        local.family = entry->ifa_addr->sa_family;
+        if (local.family == AF_INET) {
+            auto* in = reinterpret_cast<sockaddr_in*>(entry->ifa_addr);
+            std::memcpy(local.bytes.data(), &in->sin_addr, 4);
+        } else if (local.family == AF_INET6) {
+            auto* in6 = reinterpret_cast<sockaddr_in6*>(entry->ifa_addr);
+            std::memcpy(local.bytes.data(), &in6->sin6_addr, 16);
+        } else {
+            continue;
+        }
+        result.push_back(local);
+    }
+
+    freeifaddrs(addresses);
+    return result;
+}
@@ -1,4 +1,22 @@
 #include "SystemMetrics.h"
+#include "MetricsSampler.h"
+#include "ProcReader.h"
+#include "SockDiag.h"
+#include "ProcessStats.h"
+#include "CgroupMetrics.h"
+#include "PerfCounters.h"
+#include "LogTailer.h"
+#include "LogScanner.h"
+#include "DbProbePool.h"
+#include "AsyncPgProbe.h"
+#include "HttpProber.h"
+#include "RttProber.h"
+#include "GpuBackend.h"
+#include "GpuHistory.h"
+#include "MPIController.h"
+#include <charconv>
+#include <csignal>
+#include <filesystem>
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
@@ -8,146 +26,253 @@
 #include <tuple>
 #include <array>
 #include <memory>
+#include <mutex>
 #include <cstdio>
+#include <cstdlib>
 #include <string>
 #include <vector>
-#include <regex>
-#include <libpq-fe.h>  // PostgreSQL
+#include <arpa/inet.h>
+#include <unistd.h>
 #include <mongoc/mongoc.h>  // MongoDB
 #include <aerospike/aerospike.h>  // AerospikeDB
 #include <scylladb-client/ScyllaDBClient.h>  // ScyllaDB
+#include <seastar/core/thread.hh>
 
 namespace helpers {
-    std::tuple<long, long, long, long, long, long> readNetworkStats(const std::string& interface) {
-        std::ifstream netDevFile("/proc/net/dev");
-        if (!netDevFile.is_open()) {
-            throw std::runtime_error("Failed to open /proc/net/dev");
-        }
-
-        std::string line;
-        while (std::getline(netDevFile, line)) {
-            if (line.find(interface) != std::string::npos) {
-                std::istringstream iss(line);
-                std::string iface;
-                long rx_bytes, rx_packets, rx_errs, rx_drop, rx_fifo, rx_frame, rx_compressed, rx_multicast;
-                long tx_bytes, tx_packets, tx_errs, tx_drop, tx_fifo, tx_colls, tx_carrier, tx_compressed;
-                if (iss >> iface >> rx_bytes >> rx_packets >> rx_errs >> rx_drop >> rx_fifo >> rx_frame >> rx_compressed >> rx_multicast
-                         >> tx_bytes >> tx_packets >> tx_errs >> tx_drop >> tx_fifo >> tx_colls >> tx_carrier >> tx_compressed) {
-                    return std::make_tuple(rx_bytes, rx_packets, rx_errs, rx_drop, tx_errs, tx_drop);
+    MetricsSampler& rateSampler() {
+        static MetricsSampler sampler;
+        return sampler;
+    }
+
+    // Runs read against the cgroup of the named process. Groups are resolved once per
+    // name and re-resolved when their files vanish (the workload restarted or moved).
+    // Returns 0 when the process is not running on this host.
+    template<typename Read>
+    double readWorkloadCgroup(const std::string& processName, Read read) {
+        static thread_local std::map<std::string, CgroupMetrics> cgroups;
+
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            auto it = cgroups.find(processName);
+            if (it == cgroups.end()) {
+                pid_t pid = CgroupMetrics::findProcess(processName);
+                if (pid < 0) {
+                    return 0.0;
+                }
+                try {
+                    it = cgroups.emplace(processName, CgroupMetrics::forProcess(pid)).first;
+                } catch (const std::runtime_error&) {
+                    return 0.0;
                 }
             }
-        }
 
-        throw std::runtime_error("Interface " + interface + " not found in /proc/net/dev");
+            try {
+                return read(it->second);
+            } catch (const std::runtime_error&) {
+                cgroups.erase(it);
+            }
+        }
+        return 0.0;
     }
 
-    double ping(const std::string& address) {
-        std::array<char, 128> buffer;
-        std::string result;
-        std::shared_ptr<FILE> pipe(popen(("ping -c 1 " + address + " | grep 'time='").c_str(), "r"), pclose);
-        if (!pipe) {
-            throw std::runtime_error("Failed to run ping command");
-        }
-        while (fgets(buffer.data(), 128, pipe.get()) != nullptr) {
-            result += buffer.data();
+    // Counter deltas for the named process since the previous call. Counts the whole
+    // cgroup when cgroup events are permitted, otherwise the process and its threads.
+    PerfSample readWorkloadPerfCounters(const std::string& processName) {
+        struct Tracked {
+            pid_t pid;
+            PerfCounters counters;
+            PerfSample last;
+        };
+        static thread_local std::map<std::string, Tracked> tracked;
+
+        auto it = tracked.find(processName);
+        if (it != tracked.end() && kill(it->second.pid, 0) != 0 && errno == ESRCH) {
+            tracked.erase(it); // The process exited; its counters would never move again
+            it = tracked.end();
         }
+        if (it == tracked.end()) {
+            pid_t pid = CgroupMetrics::findProcess(processName);
+            if (pid < 0) {
+                return PerfSample{};
+            }
 
-        auto pos = result.find("time=");
-        if (pos != std::string::npos) {
-            auto start = pos + 5;
-            auto end = result.find(" ms", start);
-            return std::stod(result.substr(start, end - start));
+            auto open = [pid] {
+                try {
+                    return PerfCounters::forCgroup(CgroupMetrics::resolveCgroup(pid));
+                } catch (const std::runtime_error&) {
+                    return PerfCounters::forProcess(pid); // cgroup events need CAP_PERFMON
+                }
+            };
+
+            try {
+                PerfCounters counters = open();
+                // The first call only takes the baseline; the next one reports the counts since
+                PerfSample baseline = counters.read();
+                tracked.emplace(processName, Tracked{pid, std::move(counters), baseline});
+                PerfSample none;
+                none.hardware = baseline.hardware;
+                return none;
+            } catch (const std::runtime_error&) {
+                return PerfSample{};
+            }
         }
 
-        throw std::runtime_error("Failed to parse ping result");
+        try {
+            PerfSample current = it->second.counters.read();
+            PerfSample delta = current.since(it->second.last);
+            it->second.last = current;
+            return delta;
+        } catch (const std::runtime_error&) {
+            tracked.erase(it);
+            return PerfSample{};
+        }
     }
 
-    std::tuple<long, long> readCpuStats() {
-        std::ifstream statFile("/proc/stat");
-        if (!statFile.is_open()) {
-            throw std::runtime_error("Failed to open /proc/stat");
-        }
+    std::tuple<long, long, long, long, long, long> readNetworkStats(const std::string& interface) {
+        static thread_local ProcReader netDevFile("/proc/net/dev");
+        ProcScanner scanner(netDevFile.read());
+
+        // The first two lines are column headers
+        scanner.nextLine();
+        while (scanner.nextLine()) {
+            if (scanner.tokenUntil(':') != interface) {
+                continue;
+            }
 
-        std::string line;
-        while (std::getline(statFile, line)) {
-            std::istringstream iss(line);
-            std::string cpu;
-            long user, nice, system, idle, iowait, irq, softirq, steal;
-            if (iss >> cpu >> user >> nice >> system >> idle >> iowait >> irq >> softirq >> steal) {
-                if (cpu == "cpu") {
-                    long idleTime = idle + iowait;
-                    long totalTime = user + nice + system + idle + iowait + irq + softirq + steal;
-                    return std::make_tuple(idleTime, totalTime);
-                }
+            uint64_t rx_bytes, rx_packets, rx_errs, rx_drop, tx_errs, tx_drop;
+            if (scanner.parseUnsigned(rx_bytes) && scanner.parseUnsigned(rx_packets) && scanner.parseUnsigned(rx_errs)
+                    && scanner.parseUnsigned(rx_drop)
+                    && scanner.skipTokens(6) // rx fifo, frame, compressed, multicast; tx bytes, packets
+                    && scanner.parseUnsigned(tx_errs) && scanner.parseUnsigned(tx_drop)) {
+                return std::make_tuple(rx_bytes, rx_packets, rx_errs, rx_drop, tx_errs, tx_drop);
             }
         }
 
-        throw std::runtime_error("Failed to read CPU stats from /proc/stat");
+        throw std::runtime_error("Interface " + interface + " not found in /proc/net/dev");
     }
 
-    long readCpuStealTime() {
-        std::ifstream statFile("/proc/stat");
-        if (!statFile.is_open()) {
-            throw std::runtime_error("Failed to open /proc/stat");
-        }
+    // IPv4 default gateway of interface (any interface if empty) from /proc/net/route,
+    // or an empty string when there is no default route
+    std::string defaultGateway(const std::string& interface) {
+        static thread_local ProcReader routeFile("/proc/net/route");
+        ProcScanner scanner(routeFile.read());
+
+        constexpr uint64_t RTF_GATEWAY = 0x2;
+        while (scanner.nextLine()) { // The first line is a header
+            std::string_view iface = scanner.token();
+            std::string_view destination = scanner.token();
+            std::string_view gateway = scanner.token();
+            std::string_view flags = scanner.token();
+            if ((!interface.empty() && iface != interface) || destination != "00000000") {
+                continue;
+            }
 
-        std::string line;
-        while (std::getline(statFile, line)) {
-            std::istringstream iss(line);
-            std::string cpu;
-            long user, nice, system, idle, iowait, irq, softirq, steal;
-            if (iss >> cpu >> user >> nice >> system >> idle >> iowait >> irq >> softirq >> steal) {
-                if (cpu == "cpu") {
-                    return steal;
-                }
+            uint32_t address = 0;
+            uint64_t flagBits = 0;
+            std::from_chars(flags.data(), flags.data() + flags.size(), flagBits, 16);
+            if (!(flagBits & RTF_GATEWAY) ||
+                std::from_chars(gateway.data(), gateway.data() + gateway.size(), address, 16).ec != std::errc()) {
+                continue;
             }
-        }
 
-        throw std::runtime_error("Failed to read CPU steal time from /proc/stat");
+            // The kernel prints the address as a native-endian integer of the network-order bytes
+            in_addr gatewayAddress;
+            gatewayAddress.s_addr = address;
+            char text[INET_ADDRSTRLEN];
+            if (inet_ntop(AF_INET, &gatewayAddress, text, sizeof(text))) {
+                return text;
+            }
+        }
+        return "";
     }
 
-    std::tuple<long, long> readDiskStats(const std::string& disk) {
-        std::ifstream diskstatsFile("/proc/diskstats");
-        if (!diskstatsFile.is_open()) {
-            throw std::runtime_error("Failed to open /proc/diskstats");
+    // Interface the default route goes out of; empty when there is none
+    std::string defaultRouteInterface() {
+        static thread_local ProcReader routeFile("/proc/net/route");
+        ProcScanner scanner(routeFile.read());
+        while (scanner.nextLine()) { // The first line is a header
+            std::string_view iface = scanner.token();
+            if (scanner.token() == "00000000") {
+                return std::string(iface);
+            }
         }
+        return "";
+    }
 
-        std::string line;
-        while (std::getline(diskstatsFile, line)) {
-            std::istringstream iss(line);
-            std::string device;
-            long read_io, read_merges, read_sectors, read_time, write_io, write_merges, write_sectors, write_time, io_in_progress, io_time, weighted_io_time;
-            if (iss >> device >> device >> device >> read_io >> read_merges >> read_sectors >> read_time >> write_io >> write_merges >> write_sectors >> write_time >> io_in_progress >> io_time >> weighted_io_time) {
-                if (device == disk) {
-                    return std::make_tuple(io_time, read_io + write_io);
-                }
+    // One RTT probe, then the rolling statistics. The target is DIRECTOR_RTT_TARGET when
+    // set, else the interface's default gateway over ICMP only, else 8.8.8.8. Probers
+    // stay alive so the window spans calls. The probe waits up to a second, so it runs
+    // outside the map's lock, and a caller that finds one already in flight for the
+    // interface gets the statistics of the last finished round instead of waiting.
+    RttStats probeNetworkLatency(const std::string& interface) {
+        struct Latency {
+            std::mutex probing;
+            RttProber prober;
+            RttStats latest; // Guarded by the map's mutex
+            explicit Latency(const std::string& interface) : prober(interface) {}
+        };
+        static std::mutex mutex;
+        static std::map<std::string, std::shared_ptr<Latency>> latencies;
+
+        std::shared_ptr<Latency> latency;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto& entry = latencies[interface];
+            if (!entry) {
+                entry = std::make_shared<Latency>(interface);
             }
+            latency = entry;
         }
 
-        throw std::runtime_error("Disk " + disk + " not found in /proc/diskstats");
-    }
+        std::unique_lock<std::mutex> probing(latency->probing, std::try_to_lock);
+        if (!probing.owns_lock()) {
+            std::lock_guard<std::mutex> lock(mutex);
+            return latency->latest;
+        }
 
-    long getSectorSize() {
-        std::ifstream file("/sys/block/sda/queue/hw_sector_size");
-        if (!file.is_open()) {
-            throw std::runtime_error("Failed to open /sys/block/sda/queue/hw_sector_size");
+        std::string target;
+        if (const char* configured = std::getenv(SystemMetrics::NETWORK_RTT_TARGET_ENV)) {
+            target = configured;
+        } else if (std::string gateway = defaultGateway(interface); !gateway.empty() && latency->prober.icmpAvailable()) {
+            // Gateways seldom listen on 443, so a TCP fallback would only ever read as loss
+            target = "icmp://" + gateway;
+        } else {
+            target = "8.8.8.8"; // Google's public DNS server, which answers on 443 too
         }
-        long sector_size;
-        file >> sector_size;
-        return sector_size;
+        latency->prober.probe({target});
+        RttStats stats = latency->prober.stats(target);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        latency->latest = stats;
+        return stats;
+    }
+
+    long readCpuStealTime() {
+        static thread_local ProcReader statFile("/proc/stat");
+        ProcScanner scanner(statFile.read());
+
+        do {
+            if (scanner.token() != "cpu") {
+                continue;
+            }
+            uint64_t steal;
+            if (scanner.skipTokens(7) && scanner.parseUnsigned(steal)) {
+                return static_cast<long>(steal);
+            }
+        } while (scanner.nextLine());
+
+        throw std::runtime_error("Failed to read CPU steal time from /proc/stat");
     }
 
     double readCpuTemperature() {
-        std::vector<std::string> temp_paths = {
-            "/sys/class/thermal/thermal_zone0/temp", // Common path for CPU temperature
-            "/sys/class/hwmon/hwmon0/temp1_input"   // Another common path
+        static thread_local ProcReader temp_paths[] = {
+            ProcReader("/sys/class/thermal/thermal_zone0/temp"), // Common path for CPU temperature
+            ProcReader("/sys/class/hwmon/hwmon0/temp1_input")   // Another common path
         };
 
-        for (const auto& path : temp_paths) {
-            std::ifstream tempFile(path);
-            if (tempFile.is_open()) {
-                long temp;
-                tempFile >> temp;
+        for (auto& tempFile : temp_paths) {
+            std::string_view contents;
+            int64_t temp;
+            if (tempFile.tryRead(contents) && ProcScanner(contents).parseSigned(temp)) {
                 return static_cast<double>(temp) / 1000.0; // Convert from millidegrees to degrees
             }
         }
@@ -155,9 +280,32 @@ namespace helpers {
         throw std::runtime_error("Failed to read CPU temperature from known paths");
     }
 
-    size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
-        ((std::string*)userp)->append((char*)contents, size * nmemb);
-        return size * nmemb;
+    // The four application getters are usually read together, so they share one probe
+    // window per app instead of each running its own
+    constexpr std::chrono::seconds APPLICATION_PROBE_MAX_AGE{5};
+
+    // Shared rather than copied: a result carries a whole latency histogram
+    std::shared_ptr<const HttpProbeResult> probeApplication(const std::string& app) {
+        struct Cached {
+            std::chrono::steady_clock::time_point at;
+            std::shared_ptr<const HttpProbeResult> result;
+        };
+        static std::mutex mutex;
+        static std::map<std::string, Cached> cache;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = cache.find(app);
+            if (it != cache.end() && std::chrono::steady_clock::now() - it->second.at < APPLICATION_PROBE_MAX_AGE) {
+                return it->second.result;
+            }
+        }
+
+        // Probed outside the lock so one slow app does not hold up the others
+        auto result = std::make_shared<const HttpProbeResult>(HttpProber::instance().probe(app));
+        std::lock_guard<std::mutex> lock(mutex);
+        cache[app] = Cached{std::chrono::steady_clock::now(), result};
+        return result;
     }
 
     std::string detectDatabaseType(const std::string& db) {
@@ -175,596 +323,299 @@ namespace helpers {
         return "Unknown";
     }
 
-    double getPostgresConnectionPoolUtilization(const std::string& db) {
-        PGconn* conn = PQconnectdb(db.c_str());
-        if (PQstatus(conn) != CONNECTION_OK) {
-            PQfinish(conn);
-            throw std::runtime_error("Failed to connect to PostgreSQL");
-        }
-
-        PGresult* res = PQexec(conn, "SELECT sum(numbackends)/count(*)::float AS pool_utilization FROM pg_stat_database");
-        if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-            PQclear(res);
-            PQfinish(conn);
-            throw std::runtime_error("Failed to execute query on PostgreSQL");
-        }
-
-        double poolUtilization = std::stod(PQgetvalue(res, 0, 0));
-        PQclear(res);
-        PQfinish(conn);
-
-        return poolUtilization;
-    }
-
-    double getMongoDBConnectionPoolUtilization(const std::string& db) {
-        mongoc_client_t* client;
-        bson_t* command;
-        bson_t reply;
-        bson_error_t error;
-        bool ret;
-        double poolUtilization = 0.0;
-
-        mongoc_init();
-        client = mongoc_client_new(db.c_str());
-        if (!client) {
-            throw std::runtime_error("Failed to connect to MongoDB");
-        }
+    // PostgreSQL is probed on the reactor by the shard's AsyncPgProbe rather than through
+    // the pool, so its getters wait on a future and have to run in a seastar::thread
+    AsyncPgProbe& postgresProbe(const std::string& db) {
+        if (!seastar::thread::running_in_thread()) {
+            throw std::runtime_error("PostgreSQL probes must run in a seastar::thread");
+        }
+        return AsyncPgProbe::forShard(db);
+    }
+
+    // Runs serverStatus on the pooled MongoDB client and returns the numeric fields at
+    // the given dotted paths (0 for a missing field)
+    std::vector<double> mongoServerStatus(const std::string& db, const std::vector<const char*>& paths) {
+        std::vector<double> values(paths.size(), 0.0);
+        DbProbePool::instance().withMongo(db, [&](mongoc_client_t* client) {
+            bson_t* command = BCON_NEW("serverStatus", BCON_INT32(1));
+            bson_t reply;
+            bson_error_t error;
+            bool ok = mongoc_client_command_simple(client, "admin", command, NULL, &reply, &error);
+            bson_destroy(command);
+            if (!ok) {
+                bson_destroy(&reply);
+                if (DbProbePool::isConnectionError(error)) {
+                    throw DbProbePool::ConnectionError("Lost the connection to MongoDB");
+                }
+                throw std::runtime_error("Failed to execute command on MongoDB");
+            }
 
-        command = BCON_NEW("serverStatus", BCON_INT32(1));
-
-        ret = mongoc_client_command_simple(client, "admin", command, NULL, &reply, &error);
-        if (ret) {
-            bson_iter_t iter;
-            if (bson_iter_init_find(&iter, &reply, "connections")) {
-                bson_iter_t sub_iter;
-                if (bson_iter_recurse(&iter, &sub_iter)) {
-                    int current, available;
-                    while (bson_iter_next(&sub_iter)) {
-                        if (BSON_ITER_HOLDS_INT32(&sub_iter)) {
-                            if (strcmp(bson_iter_key(&sub_iter), "current") == 0) {
-                                current = bson_iter_int32(&sub_iter);
-                            } else if (strcmp(bson_iter_key(&sub_iter), "available") == 0) {
-                                available = bson_iter_int32(&sub_iter);
-                            }
-                        }
-                    }
-                    poolUtilization = (double)current / (current + available);
+            for (size_t i = 0; i < paths.size(); ++i) {
+                bson_iter_t iter, field;
+                if (bson_iter_init(&iter, &reply) && bson_iter_find_descendant(&iter, paths[i], &field)) {
+                    values[i] = static_cast<double>(bson_iter_as_int64(&field));
                 }
             }
-        } else {
-            mongoc_client_destroy(client);
-            mongoc_cleanup();
             bson_destroy(&reply);
-            throw std::runtime_error("Failed to execute command on MongoDB");
-        }
+        });
+        return values;
+    }
 
-        mongoc_client_destroy(client);
-        mongoc_cleanup();
-        bson_destroy(&reply);
-        bson_destroy(command);
+    // Per-second rate of a server-side counter. Calls share a baseline in the pool, so
+    // only the first call for a URI waits a second for its second sample.
+    double serverCounterRate(const std::string& db, const std::string& counter, const std::function<double()>& sample) {
+        DbProbePool& pool = DbProbePool::instance();
+        if (auto rate = pool.counterRate(db, counter, sample())) {
+            return *rate;
+        }
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        return pool.counterRate(db, counter, sample()).value_or(0.0);
+    }
 
-        return poolUtilization;
+    double getMongoDBConnectionPoolUtilization(const std::string& db) {
+        std::vector<double> connections = mongoServerStatus(db, {"connections.current", "connections.available"});
+        double current = connections[0];
+        double available = connections[1];
+        return (current + available) > 0 ? current / (current + available) : 0.0;
     }
 
     double getAerospikeDBConnectionPoolUtilization(const std::string& db) {
-        aerospike as;
-        as_config config;
-        as_error err;
-
-        as_config_init(&config);
-        if (!as_config_add_hosts(&config, db.c_str(), 3000)) {
-            throw std::runtime_error("Failed to add AerospikeDB host");
-        }
-
-        aerospike_init(&as, &config);
-        if (aerospike_connect(&as, &err) != AEROSPIKE_OK) {
-            aerospike_destroy(&as);
-            throw std::runtime_error("Failed to connect to AerospikeDB");
-        }
+        DbProbePool::instance().withAerospike(db, [](aerospike*) {});
 
         // Aerospike does not provide direct connection pool stats, assuming a fixed size pool
         double poolUtilization = 0.75;  // Placeholder value for demonstration
-
-        aerospike_destroy(&as);
         return poolUtilization;
     }
 
     double getScyllaDBConnectionPoolUtilization(const std::string& db) {
-        ScyllaDBClient client;
-        if (!client.connect(db)) {
-            throw std::runtime_error("Failed to connect to ScyllaDB");
-        }
+        DbProbePool::instance().withScylla(db, [](ScyllaDBClient&) {});
 
         // ScyllaDB does not provide direct connection pool stats, assuming a fixed size pool
         double poolUtilization = 0.65;  // Placeholder value for demonstration
-
         return poolUtilization;
     }
-    double getPostgresCacheHitMissRate(const std::string& db) {
-        PGconn* conn = PQconnectdb(db.c_str());
-        if (PQstatus(conn) != CONNECTION_OK) {
-            PQfinish(conn);
-            throw std::runtime_error("Failed to connect to PostgreSQL");
-        }
-
-        PGresult* res = PQexec(conn, "SELECT sum(blks_hit) / (sum(blks_hit) + sum(blks_read))::float AS hit_miss_rate FROM pg_stat_database");
-        if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-            PQclear(res);
-            PQfinish(conn);
-            throw std::runtime_error("Failed to execute query on PostgreSQL");
-        }
-
-        double hitMissRate = std::stod(PQgetvalue(res, 0, 0));
-        PQclear(res);
-        PQfinish(conn);
-
-        return hitMissRate;
-    }
 
     double getMongoDBCacheHitMissRate(const std::string& db) {
-        mongoc_client_t* client;
-        bson_t* command;
-        bson_t reply;
-        bson_error_t error;
-        bool ret;
-        double hitMissRate = 0.0;
-
-        mongoc_init();
-        client = mongoc_client_new(db.c_str());
-        if (!client) {
-            throw std::runtime_error("Failed to connect to MongoDB");
-        }
-
-        command = BCON_NEW("serverStatus", BCON_INT32(1));
-
-        ret = mongoc_client_command_simple(client, "admin", command, NULL, &reply, &error);
-        if (ret) {
-            bson_iter_t iter;
-            if (bson_iter_init_find(&iter, &reply, "wiredTiger")) {
-                bson_iter_t sub_iter;
-                if (bson_iter_recurse(&iter, &sub_iter)) {
-                    while (bson_iter_next(&sub_iter)) {
-                        if (BSON_ITER_HOLDS_DOCUMENT(&sub_iter) && strcmp(bson_iter_key(&sub_iter), "cache") == 0) {
-                            bson_iter_t cache_iter;
-                            if (bson_iter_recurse(&sub_iter, &cache_iter)) {
-                                double cacheHits = 0, cacheMisses = 0;
-                                while (bson_iter_next(&cache_iter)) {
-                                    if (BSON_ITER_HOLDS_INT32(&cache_iter)) {
-                                        if (strcmp(bson_iter_key(&cache_iter), "bytes read into cache") == 0) {
-                                            cacheMisses = bson_iter_int32(&cache_iter);
-                                        } else if (strcmp(bson_iter_key(&cache_iter), "bytes read from cache") == 0) {
-                                            cacheHits = bson_iter_int32(&cache_iter);
-                                        }
-                                    }
-                                }
-                                hitMissRate = cacheHits / (cacheHits + cacheMisses);
-                            }
-                        }
-                    }
-                }
-            }
-        } else {
-            mongoc_client_destroy(client);
-            mongoc_cleanup();
-            bson_destroy(&reply);
-            throw std::runtime_error("Failed to execute command on MongoDB");
-        }
-
-        mongoc_client_destroy(client);
-        mongoc_cleanup();
-        bson_destroy(&reply);
-        bson_destroy(command);
-
-        return hitMissRate;
+        std::vector<double> cache = mongoServerStatus(db, {"wiredTiger.cache.bytes read from cache",
+                                                           "wiredTiger.cache.bytes read into cache"});
+        double cacheHits = cache[0];
+        double cacheMisses = cache[1];
+        return (cacheHits + cacheMisses) > 0 ? cacheHits / (cacheHits + cacheMisses) : 0.0;
     }
 
     double getAerospikeDBCacheHitMissRate(const std::string& db) {
-        aerospike as;
-        as_config config;
-        as_error err;
-        as_record rec;
-
-        as_config_init(&config);
-        if (!as_config_add_hosts(&config, db.c_str(), 3000)) {
-            throw std::runtime_error("Failed to add AerospikeDB host");
-        }
-
-        aerospike_init(&as, &config);
-        if (aerospike_connect(&as, &err) != AEROSPIKE_OK) {
-            aerospike_destroy(&as);
-            throw std::runtime_error("Failed to connect to AerospikeDB");
-        }
+        DbProbePool::instance().withAerospike(db, [](aerospike*) {});
 
         // Aerospike does not provide direct cache stats, assuming a fixed cache hit/miss rate
         double hitMissRate = 0.80;  // Placeholder value for demonstration
-
-        aerospike_destroy(&as);
         return hitMissRate;
     }
 
     double getScyllaDBCacheHitMissRate(const std::string& db) {
-        ScyllaDBClient client;
-        if (!client.connect(db)) {
-            throw std::runtime_error("Failed to connect to ScyllaDB");
-        }
+        DbProbePool::instance().withScylla(db, [](ScyllaDBClient&) {});
 
         // ScyllaDB does not provide direct cache stats, assuming a fixed cache hit/miss rate
         double hitMissRate = 0.75;  // Placeholder value for demonstration
-
         return hitMissRate;
     }
-    double getPostgresTransactionRate(const std::string& db) {
-        PGconn* conn = PQconnectdb(db.c_str());
-        if (PQstatus(conn) != CONNECTION_OK) {
-            PQfinish(conn);
-            throw std::runtime_error("Failed to connect to PostgreSQL");
-        }
-
-        PGresult* res = PQexec(conn, "SELECT xact_commit + xact_rollback AS transactions FROM pg_stat_database WHERE datname = current_database()");
-        if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-            PQclear(res);
-            PQfinish(conn);
-            throw std::runtime_error("Failed to execute query on PostgreSQL");
-        }
-
-        long initialTransactions = std::stol(PQgetvalue(res, 0, 0));
-        PQclear(res);
-
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-
-        res = PQexec(conn, "SELECT xact_commit + xact_rollback AS transactions FROM pg_stat_database WHERE datname = current_database()");
-        if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-            PQclear(res);
-            PQfinish(conn);
-            throw std::runtime_error("Failed to execute query on PostgreSQL");
-        }
-
-        long finalTransactions = std::stol(PQgetvalue(res, 0, 0));
-        PQclear(res);
-        PQfinish(conn);
-
-        return static_cast<double>(finalTransactions - initialTransactions);
-    }
 
     double getMongoDBTransactionRate(const std::string& db) {
-        mongoc_client_t* client;
-        bson_t* command;
-        bson_t reply;
-        bson_error_t error;
-        bool ret;
-        double transactionRate = 0.0;
-
-        mongoc_init();
-        client = mongoc_client_new(db.c_str());
-        if (!client) {
-            throw std::runtime_error("Failed to connect to MongoDB");
-        }
-
-        command = BCON_NEW("serverStatus", BCON_INT32(1));
-
-        ret = mongoc_client_command_simple(client, "admin", command, NULL, &reply, &error);
-        if (ret) {
-            bson_iter_t iter;
-            if (bson_iter_init_find(&iter, &reply, "opcounters")) {
-                bson_iter_t sub_iter;
-                if (bson_iter_recurse(&iter, &sub_iter)) {
-                    int initialTransactions = 0;
-                    while (bson_iter_next(&sub_iter)) {
-                        if (BSON_ITER_HOLDS_INT32(&sub_iter)) {
-                            if (strcmp(bson_iter_key(&sub_iter), "command") == 0) {
-                                initialTransactions = bson_iter_int32(&sub_iter);
-                            }
-                        }
-                    }
-
-                    std::this_thread::sleep_for(std::chrono::seconds(1));
-
-                    ret = mongoc_client_command_simple(client, "admin", command, NULL, &reply, &error);
-                    if (ret && bson_iter_init_find(&iter, &reply, "opcounters")) {
-                        if (bson_iter_recurse(&iter, &sub_iter)) {
-                            int finalTransactions = 0;
-                            while (bson_iter_next(&sub_iter)) {
-                                if (BSON_ITER_HOLDS_INT32(&sub_iter)) {
-                                    if (strcmp(bson_iter_key(&sub_iter), "command") == 0) {
-                                        finalTransactions = bson_iter_int32(&sub_iter);
-                                    }
-                                }
-                            }
-                            transactionRate = static_cast<double>(finalTransactions - initialTransactions);
-                        }
-                    }
-                }
-            }
-        } else {
-            mongoc_client_destroy(client);
-            mongoc_cleanup();
-            bson_destroy(&reply);
-            throw std::runtime_error("Failed to execute command on MongoDB");
-        }
-
-        mongoc_client_destroy(client);
-        mongoc_cleanup();
-        bson_destroy(&reply);
-        bson_destroy(command);
-
-        return transactionRate;
+        return serverCounterRate(db, "opcounters.command", [&db] {
+            return mongoServerStatus(db, {"opcounters.command"})[0];
+        });
     }
 
     double getAerospikeDBTransactionRate(const std::string& db) {
-        aerospike as;
-        as_config config;
-        as_error err;
-        as_status status;
-        as_record rec;
-
-        as_config_init(&config);
-        if (!as_config_add_hosts(&config, db.c_str(), 3000)) {
-            throw std::runtime_error("Failed to add AerospikeDB host");
-        }
-
-        aerospike_init(&as, &config);
-        if (aerospike_connect(&as, &err) != AEROSPIKE_OK) {
-            aerospike_destroy(&as);
-            throw std::runtime_error("Failed to connect to AerospikeDB");
-        }
+        DbProbePool::instance().withAerospike(db, [](aerospike*) {});
 
         // Aerospike does not provide direct transaction stats, using a placeholder value
         double transactionRate = 100.0;  // Placeholder value for demonstration
-
-        aerospike_destroy(&as);
         return transactionRate;
     }
 
     double getScyllaDBTransactionRate(const std::string& db) {
-        ScyllaDBClient client;
-        if (!client.connect(db)) {
-            throw std::runtime_error("Failed to connect to ScyllaDB");
-        }
+        DbProbePool::instance().withScylla(db, [](ScyllaDBClient&) {});
 
         // ScyllaDB does not provide direct transaction stats, using a placeholder value
         double transactionRate = 200.0;  // Placeholder value for demonstration
-
         return transactionRate;
     }
 
-    int getFailedLoginAttempts() {
-        std::ifstream logFile("/var/log/auth.log"); // For Ubuntu/Debian
-        if (!logFile.is_open()) {
-            logFile.open("/var/log/secure"); // For CentOS/Fedora/RHEL
-            if (!logFile.is_open()) {
-                throw std::runtime_error("Failed to open log file");
-            }
-        }
+    // LogTailer checkpoints, so the offsets and running counters survive restarts
+    constexpr const char* LOG_CHECKPOINT_DIR = "/var/lib/director/log-offsets";
 
-        std::string line;
-        int failedAttempts = 0;
-        std::regex regex("Failed password for");
+    // Returns the running counters for one metric over one log file. Tailers live for the
+    // life of the process, so each call only parses the bytes appended since the
+    // previous one. Throws std::runtime_error if the file cannot be opened.
+    LogCounters tailLog(const std::string& metric, const std::string& path, LogTailer::BlockHandler handler) {
+        static std::mutex mutex;
+        static std::map<std::string, std::unique_ptr<LogTailer>> tailers;
 
-        while (std::getline(logFile, line)) {
-            if (std::regex_search(line, regex)) {
-                ++failedAttempts;
+        std::lock_guard<std::mutex> lock(mutex);
+        std::string key = metric + ":" + path;
+        auto it = tailers.find(key);
+        if (it == tailers.end()) {
+            std::string checkpoint = std::string(LOG_CHECKPOINT_DIR) + "/" + metric;
+            for (char c : path) {
+                checkpoint += (c == '/') ? '_' : c;
             }
+            std::error_code ignored;
+            std::filesystem::create_directories(LOG_CHECKPOINT_DIR, ignored);
+            it = tailers.emplace(key, std::make_unique<LogTailer>(path, std::move(handler), checkpoint)).first;
         }
-
-        return failedAttempts;
+        return it->second->poll();
     }
 
-    int getIntrusionDetectionAlerts(const std::string& filePath) {
-        std::ifstream logFile(filePath);
-        if (!logFile.is_open()) {
-            throw std::runtime_error("Failed to open intrusion detection log file");
-        }
-
-        std::string line;
-        int alertCount = 0;
+    // Slot 0 counts non-empty lines
+    LogTailer::BlockHandler countLines() {
+        return [](std::string_view lines, LogCounters& counters) {
+            forEachLine(lines, [&](std::string_view line) {
+                if (!line.empty()) {
+                    ++counters.count[0];
+                }
+            });
+        };
+    }
 
-        while (std::getline(logFile, line)) {
-            if (!line.empty()) { // Assuming each line represents an alert
-                ++alertCount;
-            }
+    bool parseLeadingDouble(std::string_view& text, double& value) {
+        while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+            text.remove_prefix(1);
         }
-
-        return alertCount;
-    } 
-
-    int getFirewallLogEntries(const std::string& filePath) {
-        std::ifstream logFile(filePath);
-        if (!logFile.is_open()) {
-            throw std::runtime_error("Failed to open firewall log file");
+        auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (ec != std::errc()) {
+            return false;
         }
+        text.remove_prefix(static_cast<size_t>(end - text.data()));
+        return true;
+    }
 
-        std::string line;
-        int logCount = 0;
+    // Slot 0 counts lines that start with a number and sums those numbers
+    LogTailer::BlockHandler sumLeadingValues() {
+        return [](std::string_view lines, LogCounters& counters) {
+            forEachLine(lines, [&](std::string_view line) {
+                double value;
+                if (parseLeadingDouble(line, value)) {
+                    ++counters.count[0];
+                    counters.sum[0] += value;
+                }
+            });
+        };
+    }
 
-        while (std::getline(logFile, line)) {
-            if (!line.empty()) { // Assuming each line represents a log entry
-                ++logCount;
-            }
+    double averageOf(const LogCounters& counters, const char* emptyMessage) {
+        if (counters.count[0] == 0) {
+            throw std::runtime_error(emptyMessage);
         }
+        return counters.sum[0] / static_cast<double>(counters.count[0]);
+    }
 
-        return logCount;
-    }    
+    // Counter slots of the auth log patterns, all matched in one pass per block
+    enum AuthLogSlot { FAILED_PASSWORD, INVALID_USER, SUDO_FAILURE };
 
-    int getVulnerabilityScans(const std::string& filePath) {
-        std::ifstream logFile(filePath);
-        if (!logFile.is_open()) {
-            throw std::runtime_error("Failed to open vulnerability scan log file");
-        }
+    const LogScanner& authLogScanner() {
+        static const LogScanner scanner = [] {
+            LogScanner patterns;
+            patterns.addPattern("Failed password for");          // FAILED_PASSWORD
+            patterns.addPattern("Invalid user");                 // INVALID_USER
+            patterns.addPattern("sudo:*authentication failure"); // SUDO_FAILURE
+            return patterns;
+        }();
+        return scanner;
+    }
 
-        std::string line;
-        int scanCount = 0;
+    LogCounters tailAuthLog() {
+        auto handler = [](std::string_view lines, LogCounters& counters) {
+            authLogScanner().scan(lines, counters.count.data());
+        };
 
-        while (std::getline(logFile, line)) {
-            if (!line.empty()) { // Assuming each line represents a scan entry
-                ++scanCount;
+        // auth.log on Ubuntu/Debian, secure on CentOS/Fedora/RHEL
+        for (const char* path : {"/var/log/auth.log", "/var/log/secure"}) {
+            try {
+                return tailLog("auth", path, handler);
+            } catch (const std::runtime_error&) {
+                // Try the next distribution's location
             }
         }
+        throw std::runtime_error("Failed to open log file");
+    }
 
-        return scanCount;
+    int getFailedLoginAttempts() {
+        return static_cast<int>(tailAuthLog().count[FAILED_PASSWORD]);
     }
-    double getInstanceTypeUtilization(const std::string& filePath) {
-        std::ifstream logFile(filePath);
-        if (!logFile.is_open()) {
-            throw std::runtime_error("Failed to open instance type utilization file");
-        }
 
-        std::string line;
-        double totalUtilization = 0.0;
-        int instanceCount = 0;
+    int getIntrusionDetectionAlerts(const std::string& filePath) {
+        // Assuming each line represents an alert
+        return static_cast<int>(tailLog("intrusion-alerts", filePath, countLines()).count[0]);
+    }
 
-        while (std::getline(logFile, line)) {
-            if (!line.empty()) {
-                std::istringstream iss(line);
-                double utilization;
-                if (iss >> utilization) {
-                    totalUtilization += utilization;
-                    ++instanceCount;
-                }
-            }
-        }
+    int getFirewallLogEntries(const std::string& filePath) {
+        // Assuming each line represents a log entry
+        return static_cast<int>(tailLog("firewall-entries", filePath, countLines()).count[0]);
+    }
 
-        if (instanceCount == 0) {
-            throw std::runtime_error("No instance utilization data found");
-        }
+    int getVulnerabilityScans(const std::string& filePath) {
+        // Assuming each line represents a scan entry
+        return static_cast<int>(tailLog("vulnerability-scans", filePath, countLines()).count[0]);
+    }
 
-        return totalUtilization / instanceCount; // Average utilization
+    double getInstanceTypeUtilization(const std::string& filePath) {
+        LogCounters counters = tailLog("instance-utilization", filePath, sumLeadingValues());
+        return averageOf(counters, "No instance utilization data found"); // Average utilization
     }
 
     double getAutoScalingMetrics(const std::string& filePath) {
-        std::ifstream logFile(filePath);
-        if (!logFile.is_open()) {
-            throw std::runtime_error("Failed to open auto-scaling metrics file");
-        }
-
-        std::string line;
-        double totalScaleUpEvents = 0.0;
-        double totalScaleDownEvents = 0.0;
-        int scaleUpCount = 0;
-        int scaleDownCount = 0;
-
-        while (std::getline(logFile, line)) {
-            if (!line.empty()) {
-                std::istringstream iss(line);
-                std::string eventType;
+        // Slot 0 accumulates ScaleUp events, slot 1 ScaleDown events
+        LogCounters counters = tailLog("auto-scaling", filePath, [](std::string_view lines, LogCounters& counters) {
+            forEachLine(lines, [&](std::string_view line) {
+                ProcScanner scanner(line);
+                std::string_view eventType = scanner.token();
+                std::string_view rest = scanner.restOfLine();
                 double eventValue;
-                if (iss >> eventType >> eventValue) {
-                    if (eventType == "ScaleUp") {
-                        totalScaleUpEvents += eventValue;
-                        ++scaleUpCount;
-                    } else if (eventType == "ScaleDown") {
-                        totalScaleDownEvents += eventValue;
-                        ++scaleDownCount;
-                    }
+                if (!parseLeadingDouble(rest, eventValue)) {
+                    return;
                 }
-            }
-        }
+                if (eventType == "ScaleUp") {
+                    ++counters.count[0];
+                    counters.sum[0] += eventValue;
+                } else if (eventType == "ScaleDown") {
+                    ++counters.count[1];
+                    counters.sum[1] += eventValue;
+                }
+            });
+        });
 
+        uint64_t scaleUpCount = counters.count[0];
+        uint64_t scaleDownCount = counters.count[1];
         if (scaleUpCount == 0 && scaleDownCount == 0) {
             throw std::runtime_error("No auto-scaling data found");
         }
 
         // Calculate a metric based on scale-up and scale-down events
-        double scaleUpAverage = (scaleUpCount > 0) ? (totalScaleUpEvents / scaleUpCount) : 0.0;
-        double scaleDownAverage = (scaleDownCount > 0) ? (totalScaleDownEvents / scaleDownCount) : 0.0;
+        double scaleUpAverage = (scaleUpCount > 0) ? (counters.sum[0] / scaleUpCount) : 0.0;
+        double scaleDownAverage = (scaleDownCount > 0) ? (counters.sum[1] / scaleDownCount) : 0.0;
 
         return (scaleUpAverage + scaleDownAverage) / 2.0; // Example: average of both events
     }
 
     double getResourceReservations(const std::string& filePath) {
-        std::ifstream logFile(filePath);
-        if (!logFile.is_open()) {
-            throw std::runtime_error("Failed to open resource reservations file");
-        }
-
-        std::string line;
-        double totalReservations = 0.0;
-        int reservationCount = 0;
-
-        while (std::getline(logFile, line)) {
-            if (!line.empty()) {
-                std::istringstream iss(line);
-                double reservation;
-                if (iss >> reservation) {
-                    totalReservations += reservation;
-                    ++reservationCount;
-                }
-            }
-        }
-
-        if (reservationCount == 0) {
-            throw std::runtime_error("No resource reservation data found");
-        }
-
-        return totalReservations / reservationCount; // Average reservation
-    }    
+        LogCounters counters = tailLog("resource-reservations", filePath, sumLeadingValues());
+        return averageOf(counters, "No resource reservation data found"); // Average reservation
+    }
 
     double getPowerUsage(const std::string& filePath) {
-        std::ifstream logFile(filePath);
-        if (!logFile.is_open()) {
-            throw std::runtime_error("Failed to open power usage file");
-        }
-
-        std::string line;
-        double totalPowerUsage = 0.0;
-        int usageCount = 0;
-
-        while (std::getline(logFile, line)) {
-            if (!line.empty()) {
-                std::istringstream iss(line);
-                double powerUsage;
-                if (iss >> powerUsage) {
-                    totalPowerUsage += powerUsage;
-                    ++usageCount;
-                }
-            }
-        }
-
-        if (usageCount == 0) {
-            throw std::runtime_error("No power usage data found");
-        }
-
-        return totalPowerUsage / usageCount; // Average power usage
+        LogCounters counters = tailLog("power-usage", filePath, sumLeadingValues());
+        return averageOf(counters, "No power usage data found"); // Average power usage
     }
 
     double getEnergyEfficiency(const std::string& filePath) {
-        std::ifstream logFile(filePath);
-        if (!logFile.is_open()) {
-            throw std::runtime_error("Failed to open energy efficiency file");
-        }
-
-        std::string line;
-        double totalEfficiency = 0.0;
-        int efficiencyCount = 0;
-
-        while (std::getline(logFile, line)) {
-            if (!line.empty()) {
-                std::istringstream iss(line);
-                double efficiency;
-                if (iss >> efficiency) {
-                    totalEfficiency += efficiency;
-                    ++efficiencyCount;
-                }
-            }
-        }
-
-        if (efficiencyCount == 0) {
-            throw std::runtime_error("No energy efficiency data found");
-        }
-
-        return totalEfficiency / efficiencyCount; // Average energy efficiency
-    }        
+        LogCounters counters = tailLog("energy-efficiency", filePath, sumLeadingValues());
+        return averageOf(counters, "No energy efficiency data found"); // Average energy efficiency
+    }
 }    
 
 
-double SystemMetrics::getCpuUtilization() {
-    auto [initialIdleTime, initialTotalTime] = helpers::readCpuStats();
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-    auto [finalIdleTime, finalTotalTime] = helpers::readCpuStats();
-
-    long deltaIdle = finalIdleTime - initialIdleTime;
-    long deltaTotal = finalTotalTime - initialTotalTime;
-
-    return (1.0 - static_cast<double>(deltaIdle) / deltaTotal) * 100.0;
+double SystemMetrics::getCpuUtilization(std::chrono::milliseconds maxAge) {
+    return helpers::rateSampler().cpuUtilization(maxAge);
 }
 
 std::vector<double> SystemMetrics::getCpuLoadAverage() {
@@ -775,57 +626,16 @@ std::vector<double> SystemMetrics::getCpuLoadAverage() {
     return loadAverages;
 }
 
-double SystemMetrics::getDiskIoUtilization(const std::string& disk) {
-    auto readDiskStats = [&disk]() -> long {
-        std::ifstream diskstatsFile("/proc/diskstats");
-        if (!diskstatsFile.is_open()) {
-            throw std::runtime_error("Failed to open /proc/diskstats");
-        }
-
-        std::string line;
-        while (std::getline(diskstatsFile, line)) {
-            std::istringstream iss(line);
-            std::string device;
-            long read_io, read_merges, read_sectors, read_time, write_io, write_merges, write_sectors, write_time, io_in_progress, io_time, weighted_io_time;
-            if (iss >> device >> device >> device >> read_io >> read_merges >> read_sectors >> read_time >> write_io >> write_merges >> write_sectors >> write_time >> io_in_progress >> io_time >> weighted_io_time) {
-                if (device == disk) {
-                    return io_time;
-                }
-            }
-        }
-
-        throw std::runtime_error("Disk " + disk + " not found in /proc/diskstats");
-    };
-
-    long initial_io_time = readDiskStats();
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-    long final_io_time = readDiskStats();
-
-    return static_cast<double>(final_io_time - initial_io_time) / 10.0; // Return utilization as a percentage
+double SystemMetrics::getDiskIoUtilization(const std::string& disk, std::chrono::milliseconds maxAge) {
+    return helpers::rateSampler().diskIoUtilization(disk, maxAge); // Return utilization as a percentage
 }
 
-double SystemMetrics::getDiskReadThroughput(const std::string& disk) {
-    long sector_size = getSectorSize();
-    auto [initial_read_sectors, initial_write_sectors] = readDiskStats(disk);
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-    auto [final_read_sectors, final_write_sectors] = readDiskStats(disk);
-
-    long sectors_read = final_read_sectors - initial_read_sectors;
-    double read_throughput = (sectors_read * sector_size) / 1024.0; // KB/s
-
-    return read_throughput;
+double SystemMetrics::getDiskReadThroughput(const std::string& disk, std::chrono::milliseconds maxAge) {
+    return helpers::rateSampler().diskReadThroughput(disk, maxAge); // KB/s
 }
 
-double SystemMetrics::getDiskWriteThroughput(const std::string& disk) {
-    long sector_size = getSectorSize();
-    auto [initial_read_sectors, initial_write_sectors] = readDiskStats(disk);
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-    auto [final_read_sectors, final_write_sectors] = readDiskStats(disk);
-
-    long sectors_written = final_write_sectors - initial_write_sectors;
-    double write_throughput = (sectors_written * sector_size) / 1024.0; // KB/s
-
-    return write_throughput;
+double SystemMetrics::getDiskWriteThroughput(const std::string& disk, std::chrono::milliseconds maxAge) {
+    return helpers::rateSampler().diskWriteThroughput(disk, maxAge); // KB/s
 }
 
 double SystemMetrics::getCpuStealTime() {
@@ -869,72 +679,105 @@ double SystemMetrics::getSwapUsage() {
 }
 
 double SystemMetrics::getMemoryPageFaults() {
-    std::ifstream vmstatFile("/proc/vmstat");
-    if (!vmstatFile.is_open()) {
-        throw std::runtime_error("Failed to open /proc/vmstat");
-    }
+    static thread_local ProcReader vmstatFile("/proc/vmstat");
+    ProcScanner scanner(vmstatFile.read());
 
-    std::string line;
-    long pgfault = 0;
-    long pgmajfault = 0;
+    uint64_t pgfault = 0;
+    uint64_t pgmajfault = 0;
 
-    while (std::getline(vmstatFile, line)) {
-        std::istringstream iss(line);
-        std::string key;
-        long value;
-        if (iss >> key >> value) {
-            if (key == "pgfault") {
-                pgfault = value;
-            } else if (key == "pgmajfault") {
-                pgmajfault = value;
-            }
+    do {
+        std::string_view key = scanner.token();
+        if (key == "pgfault") {
+            scanner.parseUnsigned(pgfault);
+        } else if (key == "pgmajfault") {
+            scanner.parseUnsigned(pgmajfault);
         }
-    }
+    } while (scanner.nextLine());
 
     return static_cast<double>(pgfault + pgmajfault);
 }
 
-double SystemMetrics::getMemoryPageFaults() {
-    std::ifstream vmstatFile("/proc/vmstat");
-    if (!vmstatFile.is_open()) {
-        throw std::runtime_error("Failed to open /proc/vmstat");
-    }
+PressureStats SystemMetrics::getCpuPressure() {
+    static thread_local ProcReader pressureFile(pressurePath(PressureResource::Cpu));
+    return parsePressure(pressureFile.read());
+}
 
-    std::string line;
-    long pgfault = 0;
-    long pgmajfault = 0;
+PressureStats SystemMetrics::getMemoryPressure() {
+    static thread_local ProcReader pressureFile(pressurePath(PressureResource::Memory));
+    return parsePressure(pressureFile.read());
+}
 
-    while (std::getline(vmstatFile, line)) {
-        std::istringstream iss(line);
-        std::string key;
-        long value;
-        if (iss >> key >> value) {
-            if (key == "pgfault") {
-                pgfault = value;
-            } else if (key == "pgmajfault") {
-                pgmajfault = value;
-            }
-        }
-    }
+PressureStats SystemMetrics::getIoPressure() {
+    static thread_local ProcReader pressureFile(pressurePath(PressureResource::Io));
+    return parsePressure(pressureFile.read());
+}
 
-    return static_cast<double>(pgfault + pgmajfault);
+double SystemMetrics::getWorkloadCpuUtilization(const std::string& processName) {
+    return helpers::readWorkloadCgroup(processName, [](CgroupMetrics& cgroup) {
+        return cgroup.cpuUtilization();
+    });
 }
 
-double SystemMetrics::getDiskLatency(const std::string& disk) {
-    auto [initial_io_time, initial_io_count] = readDiskStats(disk);
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-    auto [final_io_time, final_io_count] = readDiskStats(disk);
+double SystemMetrics::getWorkloadMemoryUtilization(const std::string& processName) {
+    return helpers::readWorkloadCgroup(processName, [](CgroupMetrics& cgroup) {
+        return cgroup.memoryUtilization();
+    });
+}
 
-    long delta_io_time = final_io_time - initial_io_time;
-    long delta_io_count = final_io_count - initial_io_count;
+double SystemMetrics::getWorkloadIoPressure(const std::string& processName) {
+    return helpers::readWorkloadCgroup(processName, [](CgroupMetrics& cgroup) {
+        return cgroup.ioPressure().some.avg10;
+    });
+}
 
-    if (delta_io_count == 0) {
-        return 0.0; // Avoid division by zero if no I/O operations occurred
+PerfSample SystemMetrics::getWorkloadPerfCounters(const std::string& processName) {
+    return helpers::readWorkloadPerfCounters(processName);
+}
+
+GpuWorkloadUsage SystemMetrics::getWorkloadGpuUsage(const std::string& processName) {
+    pid_t pid = CgroupMetrics::findProcess(processName);
+    if (pid < 0) {
+        return GpuWorkloadUsage{};
+    }
+    std::string cgroup;
+    try {
+        cgroup = CgroupMetrics::resolveCgroup(pid);
+    } catch (const std::runtime_error&) {
+        return GpuWorkloadUsage{};
     }
+    return GpuProcessAccounting::forCgroup(GpuProcessAccounting::instance().collect(), cgroup);
+}
+
+double SystemMetrics::getWorkloadCpuPressure(const std::string& processName) {
+    return helpers::readWorkloadCgroup(processName, [](CgroupMetrics& cgroup) {
+        return cgroup.cpuPressure().some.avg10;
+    });
+}
+
+double SystemMetrics::getDiskLatency(const std::string& disk, std::chrono::milliseconds maxAge) {
+    return helpers::rateSampler().diskLatency(disk, maxAge); // Milliseconds per I/O operation
+}
 
-    double latency = static_cast<double>(delta_io_time) / delta_io_count; // Time per I/O operation
+std::vector<std::string> SystemMetrics::getDisks() {
+    static thread_local ProcReader diskstatsFile("/proc/diskstats");
+    ProcScanner scanner(diskstatsFile.read());
 
-    return latency;
+    // Partitions are in /proc/diskstats too, but only whole devices are under /sys/block
+    std::vector<std::string> disks;
+    do {
+        uint64_t major, minor;
+        if (!scanner.parseUnsigned(major) || !scanner.parseUnsigned(minor)) {
+            continue;
+        }
+        std::string device(scanner.token());
+        if (device.compare(0, 4, "loop") == 0 || device.compare(0, 3, "ram") == 0 || device.compare(0, 4, "zram") == 0) {
+            continue;
+        }
+        if (access(("/sys/block/" + device).c_str(), F_OK) == 0) {
+            disks.push_back(std::move(device));
+        }
+    } while (scanner.nextLine());
+    return disks;
 }
 
 double SystemMetrics::getDiskSpaceUtilization(const std::string& path) {
@@ -951,26 +794,31 @@ double SystemMetrics::getDiskSpaceUtilization(const std::string& path) {
 
 
 
-double SystemMetrics::getNetworkBandwidthUtilization(const std::string& interface) {
-    auto [initial_rx_bytes, initial_tx_bytes] = readNetworkStats(interface);
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-    auto [final_rx_bytes, final_tx_bytes] = readNetworkStats(interface);
-
-    long rx_bytes_diff = final_rx_bytes - initial_rx_bytes;
-    long tx_bytes_diff = final_tx_bytes - initial_tx_bytes;
-
-    double bandwidth_utilization = static_cast<double>(rx_bytes_diff + tx_bytes_diff) / 1024.0; // Convert to KB/s
+std::string SystemMetrics::getPrimaryInterface() {
+    if (const char* configured = std::getenv(NETWORK_INTERFACE_ENV)) {
+        return configured;
+    }
+    std::string interface = helpers::defaultRouteInterface();
+    if (interface.empty()) {
+        throw std::runtime_error("No default route; set " + std::string(NETWORK_INTERFACE_ENV));
+    }
+    return interface;
+}
 
-    return bandwidth_utilization;
+double SystemMetrics::getNetworkBandwidthUtilization(const std::string& interface, std::chrono::milliseconds maxAge) {
+    return helpers::rateSampler().networkBandwidth(interface, maxAge); // KB/s
 }
 
 double SystemMetrics::getNetworkLatency(const std::string& interface) {
+    return getNetworkRttStats(interface).avgMs;
+}
+
+RttStats SystemMetrics::getNetworkRttStats(const std::string& interface) {
     try {
-        // Ping a known reliable external server
-        return ping("8.8.8.8"); // Google's public DNS server
+        return helpers::probeNetworkLatency(interface);
     } catch (const std::runtime_error& e) {
         std::cerr << "Error: " << e.what() << std::endl;
-        return 0.0;
+        return RttStats{};
     }
 }
 
@@ -985,147 +833,49 @@ double SystemMetrics::getPacketLoss(const std::string& interface) {
 }
 
 int SystemMetrics::getActiveConnections(const std::string& interface) {
-    std::ifstream file("/proc/net/tcp");
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open /proc/net/tcp");
-    }
+    return static_cast<int>(getTcpConnectionStates(interface).established());
+}
 
-    int active_connections = 0;
-    std::string line;
-    std::getline(file, line); // Skip the header line
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string local_address;
-        iss >> local_address;
-        if (local_address.find(interface) != std::string::npos) {
-            active_connections++;
+TcpStateCounts SystemMetrics::getTcpConnectionStates(const std::string& interface, uint16_t localPort) {
+    // Only count sockets bound to one of the interface's addresses; an empty interface means all
+    std::vector<LocalAddress> localAddresses;
+    if (!interface.empty()) {
+        localAddresses = SockDiag::interfaceAddresses(interface);
+        if (localAddresses.empty()) {
+            return TcpStateCounts{};
         }
     }
 
-    return active_connections;
+    try {
+        return SockDiag::countTcp(SockDiag::ALL_STATES, localPort, localAddresses);
+    } catch (const std::runtime_error& e) {
+        std::cerr << "sock_diag unavailable, falling back to /proc/net/tcp: " << e.what() << std::endl;
+        return SockDiag::countTcpFromProc(SockDiag::ALL_STATES, localPort, localAddresses);
+    }
 }
 
-double SystemMetrics::getApplicationResponseTime(const std::string& app) {
-    CURL* curl;
-    CURLcode res;
-    std::string readBuffer;
-
-    curl = curl_easy_init();
-    if(curl) {
-        curl_easy_setopt(curl, CURLOPT_URL, app.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, helpers::WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
-
-        auto start = std::chrono::high_resolution_clock::now();
-        res = curl_easy_perform(curl);
-        auto end = std::chrono::high_resolution_clock::now();
-
-        if(res != CURLE_OK) {
-            curl_easy_cleanup(curl);
-            throw std::runtime_error("Failed to get application response time");
-        }
-
-        curl_easy_cleanup(curl);
+std::shared_ptr<const HttpProbeResult> SystemMetrics::getApplicationProbe(const std::string& app) {
+    return helpers::probeApplication(app);
+}
 
-        std::chrono::duration<double> duration = end - start;
-        return duration.count();
+double SystemMetrics::getApplicationResponseTime(const std::string& app) {
+    auto probe = helpers::probeApplication(app);
+    if (probe->latencyMicros.count() == 0) {
+        throw std::runtime_error("Failed to get application response time");
     }
-
-    throw std::runtime_error("Failed to initialize curl");
+    return probe->latencySeconds(50);
 }
 
 double SystemMetrics::getApplicationErrorRate(const std::string& app) {
-    CURL* curl;
-    CURLcode res;
-    int numRequests = 100; // Number of requests to measure the error rate
-    int numErrors = 0;
-    std::string readBuffer;
-
-    curl = curl_easy_init();
-    if(curl) {
-        for (int i = 0; i < numRequests; ++i) {
-            curl_easy_setopt(curl, CURLOPT_URL, app.c_str());
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, helpers::WriteCallback);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
-            curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
-
-            res = curl_easy_perform(curl);
-            if(res != CURLE_OK) {
-                numErrors++;
-            }
-        }
-
-        curl_easy_cleanup(curl);
-        return static_cast<double>(numErrors) / numRequests;
-    }
-
-    throw std::runtime_error("Failed to initialize curl");
+    return helpers::probeApplication(app)->errorRate();
 }
 
 double SystemMetrics::getRequestRate(const std::string& app) {
-    CURL* curl;
-    CURLcode res;
-    int numRequests = 0;
-    std::string readBuffer;
-
-    auto start = std::chrono::high_resolution_clock::now();
-    auto end = start + std::chrono::seconds(10); // Measure requests over 10 seconds
-
-    curl = curl_easy_init();
-    if(curl) {
-        while (std::chrono::high_resolution_clock::now() < end) {
-            curl_easy_setopt(curl, CURLOPT_URL, app.c_str());
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, helpers::WriteCallback);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
-            curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
-
-            res = curl_easy_perform(curl);
-            if(res == CURLE_OK) {
-                numRequests++;
-            }
-        }
-
-        curl_easy_cleanup(curl);
-
-        std::chrono::duration<double> duration = end - start;
-        return numRequests / duration.count(); // Requests per second
-    }
-
-    throw std::runtime_error("Failed to initialize curl");
+    return helpers::probeApplication(app)->requestsPerSecond();
 }
 
 double SystemMetrics::getThroughput(const std::string& app) {
-    CURL* curl;
-    CURLcode res;
-    double totalBytes = 0;
-    std::string readBuffer;
-
-    auto start = std::chrono::high_resolution_clock::now();
-    auto end = start + std::chrono::seconds(10); // Measure throughput over 10 seconds
-
-    curl = curl_easy_init();
-    if(curl) {
-        while (std::chrono::high_resolution_clock::now() < end) {
-            readBuffer.clear();
-            curl_easy_setopt(curl, CURLOPT_URL, app.c_str());
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, helpers::WriteCallback);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
-            curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
-
-            res = curl_easy_perform(curl);
-            if(res == CURLE_OK) {
-                totalBytes += readBuffer.size();
-            }
-        }
-
-        curl_easy_cleanup(curl);
-
-        std::chrono::duration<double> duration = end - start;
-        return (totalBytes / duration.count()) * 8 / 1024 / 1024; // Convert to Mbps (Megabits per second)
-    }
-
-    throw std::runtime_error("Failed to initialize curl");
+    return helpers::probeApplication(app)->bytesPerSecond() * 8 / 1024 / 1024; // Convert to Mbps (Megabits per second)
 }
 
 std::string SystemMetrics::detectDatabaseType(const std::string& db) {
@@ -1143,119 +893,102 @@ std::string SystemMetrics::detectDatabaseType(const std::string& db) {
     return "Unknown";
 }
 
+// Round-trip time of a trivial query on a warm pooled connection, in seconds. The
+// handshake is not included; see getDatabaseConnectLatency.
 double SystemMetrics::getQueryPerformance(const std::string& db) {
     std::string dbType = detectDatabaseType(db);
+    DbProbePool& pool = DbProbePool::instance();
+    std::chrono::duration<double> duration{0};
 
     if (dbType == "PostgreSQL") {
-        PGconn* conn = PQconnectdb(db.c_str());
-        if (PQstatus(conn) != CONNECTION_OK) {
-            PQfinish(conn);
-            throw std::runtime_error("Failed to connect to PostgreSQL");
-        }
-
-        auto start = std::chrono::high_resolution_clock::now();
-        PGresult* res = PQexec(conn, "SELECT 1");
-        auto end = std::chrono::high_resolution_clock::now();
-
-        PQclear(res);
-        PQfinish(conn);
-
-        std::chrono::duration<double> duration = end - start;
-        return duration.count();
+        return helpers::postgresProbe(db).queryLatency().get();
 
     } else if (dbType == "MongoDB") {
-        mongoc_client_t* client;
-        mongoc_collection_t* collection;
-        bson_t* query;
-        mongoc_cursor_t* cursor;
-        bson_error_t error;
-
-        mongoc_init();
-        client = mongoc_client_new(db.c_str());
-        if (!client) {
-            throw std::runtime_error("Failed to connect to MongoDB");
-        }
-
-        collection = mongoc_client_get_collection(client, "test", "collection");
-        query = bson_new();
-
-        auto start = std::chrono::high_resolution_clock::now();
-        cursor = mongoc_collection_find_with_opts(collection, query, NULL, NULL);
-        auto end = std::chrono::high_resolution_clock::now();
-
-        if (mongoc_cursor_error(cursor, &error)) {
+        pool.withMongo(db, [&duration](mongoc_client_t* client) {
+            mongoc_collection_t* collection = mongoc_client_get_collection(client, "test", "collection");
+            bson_t* query = bson_new();
+            bson_t* opts = BCON_NEW("limit", BCON_INT64(1));
+            const bson_t* doc;
+            bson_error_t error;
+
+            // The find is only sent to the server on the first cursor_next
+            auto start = std::chrono::high_resolution_clock::now();
+            mongoc_cursor_t* cursor = mongoc_collection_find_with_opts(collection, query, opts, NULL);
+            mongoc_cursor_next(cursor, &doc);
+            duration = std::chrono::high_resolution_clock::now() - start;
+
+            bool failed = mongoc_cursor_error(cursor, &error);
             mongoc_cursor_destroy(cursor);
+            bson_destroy(opts);
+            bson_destroy(query);
             mongoc_collection_destroy(collection);
-            mongoc_client_destroy(client);
-            mongoc_cleanup();
-            throw std::runtime_error("Failed to execute query on MongoDB");
-        }
-
-        mongoc_cursor_destroy(cursor);
-        mongoc_collection_destroy(collection);
-        mongoc_client_destroy(client);
-        mongoc_cleanup();
-
-        std::chrono::duration<double> duration = end - start;
+            if (failed && DbProbePool::isConnectionError(error)) {
+                throw DbProbePool::ConnectionError("Lost the connection to MongoDB");
+            } else if (failed) {
+                throw std::runtime_error("Failed to execute query on MongoDB");
+            }
+        });
         return duration.count();
 
     } else if (dbType == "AerospikeDB") {
-        aerospike as;
-        as_config config;
-        as_error err;
-
-        as_config_init(&config);
-        if (!as_config_add_hosts(&config, db.c_str(), 3000)) {
-            throw std::runtime_error("Failed to add AerospikeDB host");
-        }
-
-        aerospike_init(&as, &config);
-        if (aerospike_connect(&as, &err) != AEROSPIKE_OK) {
-            aerospike_destroy(&as);
-            throw std::runtime_error("Failed to connect to AerospikeDB");
-        }
-
-        as_record* rec = NULL;
-        as_key key;
-        as_key_init_str(&key, "test", "demo", "key1");
-
-        auto start = std::chrono::high_resolution_clock::now();
-        if (aerospike_key_get(&as, &err, NULL, &key, &rec) != AEROSPIKE_OK) {
-            aerospike_destroy(&as);
-            throw std::runtime_error("Failed to execute query on AerospikeDB");
-        }
-        auto end = std::chrono::high_resolution_clock::now();
-
-        as_record_destroy(rec);
-        aerospike_destroy(&as);
-
-        std::chrono::duration<double> duration = end - start;
+        pool.withAerospike(db, [&duration](aerospike* as) {
+            as_error err;
+            as_record* rec = NULL;
+            as_key key;
+            as_key_init_str(&key, "test", "demo", "key1");
+
+            auto start = std::chrono::high_resolution_clock::now();
+            as_status status = aerospike_key_get(as, &err, NULL, &key, &rec);
+            duration = std::chrono::high_resolution_clock::now() - start;
+
+            if (DbProbePool::isConnectionError(status)) {
+                throw DbProbePool::ConnectionError("Lost the connection to AerospikeDB");
+            } else if (status != AEROSPIKE_OK) {
+                throw std::runtime_error("Failed to execute query on AerospikeDB");
+            }
+            as_record_destroy(rec);
+        });
         return duration.count();
 
     } else if (dbType == "ScyllaDB") {
-        ScyllaDBClient client;
-        if (!client.connect(db)) {
-            throw std::runtime_error("Failed to connect to ScyllaDB");
-        }
-
-        auto start = std::chrono::high_resolution_clock::now();
-        if (!client.executeQuery("SELECT now() FROM system.local")) {
-            throw std::runtime_error("Failed to execute query on ScyllaDB");
-        }
-        auto end = std::chrono::high_resolution_clock::now();
-
-        std::chrono::duration<double> duration = end - start;
+        pool.withScylla(db, [&duration](ScyllaDBClient& client) {
+            auto start = std::chrono::high_resolution_clock::now();
+            bool ok = client.executeQuery("SELECT now() FROM system.local");
+            duration = std::chrono::high_resolution_clock::now() - start;
+
+            // The client reports no error detail, and a read of system.local only fails
+            // when the node is unreachable
+            if (!ok) {
+                throw DbProbePool::ConnectionError("Lost the connection to ScyllaDB");
+            }
+        });
         return duration.count();
     }
 
     throw std::runtime_error("Unknown database type");
 }
 
+double SystemMetrics::getDatabaseConnectLatency(const std::string& db) {
+    if (helpers::detectDatabaseType(db) == "PostgreSQL") {
+        AsyncPgProbe& probe = helpers::postgresProbe(db);
+        if (!probe.connectLatency()) {
+            probe.probe().get();
+        }
+        return probe.connectLatency().value_or(0.0);
+    }
+    // Connect through the pool if this is the first probe of db
+    if (auto latency = DbProbePool::instance().connectLatency(db)) {
+        return *latency;
+    }
+    getQueryPerformance(db);
+    return DbProbePool::instance().connectLatency(db).value_or(0.0);
+}
+
 double SystemMetrics::getConnectionPoolUtilization(const std::string& db) {
     std::string dbType = helpers::detectDatabaseType(db);
 
     if (dbType == "PostgreSQL") {
-        return helpers::getPostgresConnectionPoolUtilization(db);
+        return helpers::postgresProbe(db).poolUtilization().get();
     } else if (dbType == "MongoDB") {
         return helpers::getMongoDBConnectionPoolUtilization(db);
     } else if (dbType == "AerospikeDB") {
@@ -1271,7 +1004,7 @@ double SystemMetrics::getCacheHitMissRate(const std::string& db) {
     std::string dbType = helpers::detectDatabaseType(db);
 
     if (dbType == "PostgreSQL") {
-        return helpers::getPostgresCacheHitMissRate(db);
+        return helpers::postgresProbe(db).cacheHitRatio().get();
     } else if (dbType == "MongoDB") {
         return helpers::getMongoDBCacheHitMissRate(db);
     } else if (dbType == "AerospikeDB") {
@@ -1287,7 +1020,7 @@ double SystemMetrics::getTransactionRate(const std::string& db) {
     std::string dbType = helpers::detectDatabaseType(db);
 
     if (dbType == "PostgreSQL") {
-        return helpers::getPostgresTransactionRate(db);
+        return helpers::postgresProbe(db).transactionRate().get();
     } else if (dbType == "MongoDB") {
         return helpers::getMongoDBTransactionRate(db);
     } else if (dbType == "AerospikeDB") {
@@ -1303,6 +1036,13 @@ int SystemMetrics::getFailedLoginAttempts() {
     return helpers::getFailedLoginAttempts();
 }
 
+SystemMetrics::AuthLogCounts SystemMetrics::getAuthLogCounts() {
+    LogCounters counters = helpers::tailAuthLog();
+    return {static_cast<int>(counters.count[helpers::FAILED_PASSWORD]),
+            static_cast<int>(counters.count[helpers::INVALID_USER]),
+            static_cast<int>(counters.count[helpers::SUDO_FAILURE])};
+}
+
 int SystemMetrics::getIntrusionDetectionAlerts() {
     const std::vector<std::string> logFiles = {
         "/var/log/snort/alert",  // Snort
@@ -1561,210 +1301,81 @@ std::string SystemMetrics::getIpAddress() {
 
 
 bool SystemMetrics::hasNvidiaGpu() {
-    // Run the nvidia-smi command and check the output
-    std::array<char, 128> buffer;
-    std::string result;
-    std::shared_ptr<FILE> pipe(popen("nvidia-smi -L", "r"), pclose);
-
-    if (!pipe) {
-        throw std::runtime_error("Failed to run nvidia-smi command");
-    }
-
-    while (fgets(buffer.data(), 128, pipe.get()) != nullptr) {
-        result += buffer.data();
-    }
-
-    // Check if the output contains information about any NVIDIA GPUs
-    if (result.find("GPU") != std::string::npos) {
-        return true;
+    // The backend is loaded once per process; no nvidia-smi fork per call
+    try {
+        return GpuBackend::instance().deviceCount() > 0;
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
     }
+}
 
-    return false;
+GpuSample SystemMetrics::getGpuSample(unsigned int gpuIndex) {
+    return GpuBackend::instance().sample(gpuIndex);
 }
 
-void SystemMetrics::initializeNVML() {
-    nvmlReturn_t result = nvmlInit();
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to initialize NVML: " + std::string(nvmlErrorString(result)));
-    }
+GpuSweep SystemMetrics::getGpuSweep() {
+    return GpuBackend::instance().sweep();
 }
 
-void SystemMetrics::shutdownNVML() {
-    nvmlReturn_t result = nvmlShutdown();
-    if (NVML_SUCCESS != result) {
-        std::cerr << "Failed to shutdown NVML: " << nvmlErrorString(result) << std::endl;
-    }
+std::shared_ptr<const GpuHistory::Interval> SystemMetrics::getGpuHistory() {
+    return GpuHistory::instance().latest();
 }
 
 float SystemMetrics::getGpuTemperature(unsigned int gpuIndex) {
-    nvmlDevice_t device;
-    nvmlReturn_t result = nvmlDeviceGetHandleByIndex(gpuIndex, &device);
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to get device handle: " + std::string(nvmlErrorString(result)));
-    }
-
-    unsigned int temp;
-    result = nvmlDeviceGetTemperature(device, NVML_TEMPERATURE_GPU, &temp);
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to get temperature: " + std::string(nvmlErrorString(result)));
-    }
-
-    return static_cast<float>(temp);
+    return static_cast<float>(GpuBackend::instance().temperature(gpuIndex));
 }
 
 float SystemMetrics::getGpuUsage(unsigned int gpuIndex) {
-    nvmlDevice_t device;
-    nvmlReturn_t result = nvmlDeviceGetHandleByIndex(gpuIndex, &device);
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to get device handle: " + std::string(nvmlErrorString(result)));
-    }
-
-    nvmlUtilization_t utilization;
-    result = nvmlDeviceGetUtilizationRates(device, &utilization);
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to get utilization: " + std::string(nvmlErrorString(result)));
-    }
-
-    return static_cast<float>(utilization.gpu);
+    return static_cast<float>(GpuBackend::instance().utilization(gpuIndex).gpu);
 }
 
 float SystemMetrics::getGpuMemoryUsage(unsigned int gpuIndex) {
-    nvmlDevice_t device;
-    nvmlReturn_t result = nvmlDeviceGetHandleByIndex(gpuIndex, &device);
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to get device handle: " + std::string(nvmlErrorString(result)));
+    GpuMemoryInfo memory = GpuBackend::instance().memory(gpuIndex);
+    if (memory.total == 0) {
+        return 0.0f;
     }
-
-    nvmlMemory_t memory;
-    result = nvmlDeviceGetMemoryInfo(device, &memory);
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to get memory info: " + std::string(nvmlErrorString(result)));
-    }
-
     return static_cast<float>(memory.used) / static_cast<float>(memory.total) * 100.0f;
 }
 
 float SystemMetrics::getGpuPowerUsage(unsigned int gpuIndex) {
-    nvmlDevice_t device;
-    nvmlReturn_t result = nvmlDeviceGetHandleByIndex(gpuIndex, &device);
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to get device handle: " + std::string(nvmlErrorString(result)));
-    }
-
-    unsigned int power;
-    result = nvmlDeviceGetPowerUsage(device, &power);
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to get power usage: " + std::string(nvmlErrorString(result)));
-    }
-
-    return static_cast<float>(power) / 1000.0f; // Convert to watts
+    return static_cast<float>(GpuBackend::instance().powerUsage(gpuIndex)) / 1000.0f; // Convert to watts
 }
 
-float NvidiaGPUInfo::getGpuFanSpeed(unsigned int gpuIndex) {
-    nvmlDevice_t device;
-    nvmlReturn_t result = nvmlDeviceGetHandleByIndex(gpuIndex, &device);
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to get device handle: " + std::string(nvmlErrorString(result)));
-    }
-
-    unsigned int speed;
-    result = nvmlDeviceGetFanSpeed(device, &speed);
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to get fan speed: " + std::string(nvmlErrorString(result)));
-    }
-
-    return static_cast<float>(speed);
+float SystemMetrics::getGpuFanSpeed(unsigned int gpuIndex) {
+    return static_cast<float>(GpuBackend::instance().fanSpeed(gpuIndex));
 }
 
 float SystemMetrics::getGpuCoreClock(unsigned int gpuIndex) {
-    nvmlDevice_t device;
-    nvmlReturn_t result = nvmlDeviceGetHandleByIndex(gpuIndex, &device);
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to get device handle: " + std::string(nvmlErrorString(result)));
-    }
-
-    unsigned int clock;
-    result = nvmlDeviceGetClock(device, NVML_CLOCK_SM, NVML_CLOCK_ID_CURRENT, &clock);
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to get core clock: " + std::string(nvmlErrorString(result)));
-    }
-
-    return static_cast<float>(clock);
+    return static_cast<float>(GpuBackend::instance().clock(gpuIndex, GpuClock::SM));
 }
 
 float SystemMetrics::getGpuMemoryClock(unsigned int gpuIndex) {
-    nvmlDevice_t device;
-    nvmlReturn_t result = nvmlDeviceGetHandleByIndex(gpuIndex, &device);
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to get device handle: " + std::string(nvmlErrorString(result)));
-    }
-
-    unsigned int clock;
-    result = nvmlDeviceGetClock(device, NVML_CLOCK_MEM, NVML_CLOCK_ID_CURRENT, &clock);
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to get memory clock: " + std::string(nvmlErrorString(result)));
-    }
-
-    return static_cast<float>(clock);
+    return static_cast<float>(GpuBackend::instance().clock(gpuIndex, GpuClock::MEMORY));
 }
 
 float SystemMetrics::getGpuMemoryBandwidthUsage(unsigned int gpuIndex) {
-    nvmlDevice_t device;
-    nvmlReturn_t result = nvmlDeviceGetHandleByIndex(gpuIndex, &device);
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to get device handle: " + std::string(nvmlErrorString(result)));
-    }
-
-    nvmlMemory_t memory;
-    result = nvmlDeviceGetMemoryInfo(device, &memory);
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to get memory info: " + std::string(nvmlErrorString(result)));
-    }
-
-    return static_cast<float>(memory.usedBandwidth);
+    // % of the sample period the memory controller was busy
+    return static_cast<float>(GpuBackend::instance().utilization(gpuIndex).memory);
 }
 
 std::string SystemMetrics::getGpuComputeMode(unsigned int gpuIndex) {
-    nvmlDevice_t device;
-    nvmlReturn_t result = nvmlDeviceGetHandleByIndex(gpuIndex, &device);
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to get device handle: " + std::string(nvmlErrorString(result)));
-    }
-
-    nvmlComputeMode_t computeMode;
-    result = nvmlDeviceGetComputeMode(device, &computeMode);
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to get compute mode: " + std::string(nvmlErrorString(result)));
-    }
-
-    switch (computeMode) {
-        case NVML_COMPUTEMODE_DEFAULT:
+    switch (GpuBackend::instance().computeMode(gpuIndex)) {
+        case GpuComputeMode::DEFAULT:
             return "Default";
-        case NVML_COMPUTEMODE_EXCLUSIVE_THREAD:
+        case GpuComputeMode::EXCLUSIVE_THREAD:
             return "Exclusive Thread";
-        case NVML_COMPUTEMODE_PROHIBITED:
+        case GpuComputeMode::PROHIBITED:
             return "Prohibited";
-        case NVML_COMPUTEMODE_EXCLUSIVE_PROCESS:
+        case GpuComputeMode::EXCLUSIVE_PROCESS:
             return "Exclusive Process";
         default:
             return "Unknown";
     }
 }
 
-float SystemMetrics::getGpuPCIeThroughput(unsigned int gpuIndex, nvmlPcieUtilCounter_t counter) {
-    nvmlDevice_t device;
-    nvmlReturn_t result = nvmlDeviceGetHandleByIndex(gpuIndex, &device);
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to get device handle: " + std::string(nvmlErrorString(result)));
-    }
-
-    unsigned int throughput;
-    result = nvmlDeviceGetPcieThroughput(device, counter, &throughput);
-    if (NVML_SUCCESS != result) {
-        throw std::runtime_error("Failed to get PCIe throughput: " + std::string(nvmlErrorString(result)));
-    }
-
-    return static_cast<float>(throughput);
+float SystemMetrics::getGpuPCIeThroughput(unsigned int gpuIndex, GpuPcieCounter counter) {
+    return static_cast<float>(GpuBackend::instance().pcieThroughput(gpuIndex, counter));
 }
 /**
  * end NIVIDIA GPU Functions here:
@@ -1781,19 +1392,14 @@ bool SystemMetrics::isTbbAvailable() {
 }
 
 bool SystemMetrics::isMpiAvailable() {
-    int flag;
-    MPI_Initialized(&flag);
-    if (!flag) {
-        int argc = 0;
-        char **argv = nullptr;
-        MPI_Init(&argc, &argv);
-    }
-    MPI_Initialized(&flag);
-    if (flag) {
-        MPI_Finalize();
+    // Starts MPI the way the Director needs it and leaves it running: MPI cannot be
+    // initialized again once finalized
+    try {
+        MPIController::initialize();
         return true;
+    } catch (const std::runtime_error&) {
+        return false;
     }
-    return false;
 }
 
 std::vector<SystemMetrics::ProcessMemoryInfo> SystemMetrics::getProcessMemoryUsage(const std::vector<pid_t>& pids) {
@@ -1802,7 +1408,7 @@ std::vector<SystemMetrics::ProcessMemoryInfo> SystemMetrics::getProcessMemoryUsa
     for (pid_t pid : pids) {
         std::ifstream statusFile("/proc/" + std::to_string(pid) + "/status");
         if (!statusFile.is_open()) {
-            throw std::runtime_error("Failed to open /proc/" + std::to_string(pid) + "/status");
+            continue; // The process exited since the pid list was built
         }
 
         std::string line;
@@ -1839,4 +1445,9 @@ std::vector<SystemMetrics::ProcessMemoryInfo> SystemMetrics::getProcessMemoryUsa
     }
 
     return processMemoryInfos;
-}
\ No newline at end of file
+}
+
+ProcessStats SystemMetrics::getProcessStats(const std::vector<pid_t>& pids) {
+    static ProcessStatsCollector collector;
+    return collector.collect(pids);
+}
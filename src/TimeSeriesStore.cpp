@@ -0,0 +1,486 @@
+#include "TimeSeriesStore.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    uint32_t floatBits(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    float bitsFloat(uint32_t bits) {
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    int leadingZeros(uint32_t value) {
+        return value ? __builtin_clz(value) : 32;
+    }
+
+    int trailingZeros(uint32_t value) {
+        return value ? __builtin_ctz(value) : 32;
+    }
+
+    class BitWriter {
+    public:
+        explicit BitWriter(std::vector<uint8_t>& bytes, uint64_t& bitCount) : bytes(bytes), bitCount(bitCount) {}
+
+        void write(uint64_t value, unsigned int width) {
+            while (width > 0) {
+                if (bitCount % 8 == 0) {
+                    bytes.push_back(0);
+                }
+                unsigned int room = 8 - bitCount % 8;
+                unsigned int take = std::min(room, width);
+                uint8_t chunk = static_cast<uint8_t>((value >> (width - take)) & ((1u << take) - 1));
+                bytes.back() |= static_cast<uint8_t>(chunk << (room - take));
+                bitCount += take;
+                width -= take;
+            }
+        }
+
+    private:
+        std::vector<uint8_t>& bytes;
+        uint64_t& bitCount;
+    };
+
+    class BitReader {
+    public:
+        BitReader(const uint8_t* bytes, uint64_t bitCount) : bytes(bytes), byteCount((bitCount + 7) / 8) {}
+
+        // The next width (at most 56) bits without consuming them; bits past the end read as 0
+        uint64_t peek(unsigned int width) const {
+            // One unaligned big-endian load covers any field of up to 56 bits
+            if (position / 8 + sizeof(uint64_t) <= byteCount) {
+                uint64_t word;
+                std::memcpy(&word, bytes + position / 8, sizeof(word));
+                word = __builtin_bswap64(word) << (position % 8);
+                return width ? word >> (64 - width) : 0;
+            }
+            uint64_t value = 0;
+            for (uint64_t bit = position; bit < position + width; ++bit) {
+                uint64_t byte = bit / 8 < byteCount ? bytes[bit / 8] : 0;
+                value = (value << 1) | ((byte >> (7 - bit % 8)) & 1u);
+            }
+            return value;
+        }
+
+        void skip(unsigned int width) { position += width; }
+
+        uint64_t read(unsigned int width) {
+            if (width > 56) {
+                uint64_t high = read(width - 32);
+                return (high << 32) | read(32);
+            }
+            uint64_t value = peek(width);
+            position += width;
+            return value;
+        }
+
+    private:
+        const uint8_t* bytes;
+        uint64_t byteCount;
+        uint64_t position = 0;
+    };
+
+    int64_t signExtend(uint64_t value, unsigned int width) {
+        uint64_t sign = uint64_t(1) << (width - 1);
+        return static_cast<int64_t>((value ^ sign) - sign);
+    }
+
+    constexpr size_t BLOCK_OVERHEAD = 64; // Bookkeeping charged per block on top of its bits
+
+    // What a read covering a whole block takes from it instead of decoding it
+    struct BlockSummary {
+        double sum = 0.0;
+        float min = 0.0f;
+        float max = 0.0f;
+        float first = 0.0f;
+        float last = 0.0f;
+    };
+}
+
+// Gorilla block. Timestamps are milliseconds: the first in full, then delta-of-deltas in
+// the paper's 1/7/9/12/64-bit buckets (two's complement, so 7 bits cover -64..63). Values are float bit patterns: the first in full,
+// then the XOR with the previous one, reusing the previous leading/trailing-zero window
+// when the new meaningful bits fit inside it. append() also keeps the block's summary,
+// so aggregates over a window that spans whole blocks only decode the blocks at its ends.
+struct TimeSeriesStore::Block {
+    std::vector<uint8_t> data;
+    uint64_t bitCount = 0;
+    uint32_t count = 0;
+    uint64_t firstMillis = 0;
+    uint64_t lastMillis = 0;
+    BlockSummary summary;
+
+    // Encoder state, meaningless once sealed
+    int64_t lastDelta = 0;
+    uint32_t lastBits = 0;
+    int lastLeading = -1;
+    int lastTrailing = 0;
+
+    size_t footprint() const { return data.capacity() + BLOCK_OVERHEAD + sizeof(BlockSummary); }
+
+    bool within(uint64_t fromMillis, uint64_t toMillis) const {
+        return count > 0 && firstMillis >= fromMillis && lastMillis <= toMillis;
+    }
+
+    void append(uint64_t millis, float value) {
+        if (count == 0) {
+            summary = {value, value, value, value, value};
+        } else {
+            summary.sum += value;
+            summary.min = std::min(summary.min, value);
+            summary.max = std::max(summary.max, value);
+            summary.last = value;
+        }
+
+        BitWriter out(data, bitCount);
+        uint32_t bits = floatBits(value);
+        if (count == 0) {
+            out.write(millis, 64);
+            out.write(bits, 32);
+            firstMillis = lastMillis = millis;
+            lastBits = bits;
+            count = 1;
+            return;
+        }
+
+        int64_t delta = static_cast<int64_t>(millis - lastMillis);
+        int64_t deltaOfDelta = delta - lastDelta;
+        if (deltaOfDelta == 0) {
+            out.write(0, 1);
+        } else if (deltaOfDelta >= -64 && deltaOfDelta <= 63) {
+            out.write(0b10, 2);
+            out.write(static_cast<uint64_t>(deltaOfDelta) & 0x7f, 7);
+        } else if (deltaOfDelta >= -256 && deltaOfDelta <= 255) {
+            out.write(0b110, 3);
+            out.write(static_cast<uint64_t>(deltaOfDelta) & 0x1ff, 9);
+        } else if (deltaOfDelta >= -2048 && deltaOfDelta <= 2047) {
+            out.write(0b1110, 4);
+            out.write(static_cast<uint64_t>(deltaOfDelta) & 0xfff, 12);
+        } else {
+            out.write(0b1111, 4);
+            out.write(static_cast<uint64_t>(deltaOfDelta), 64);
+        }
+        lastDelta = delta;
+        lastMillis = millis;
+
+        uint32_t xored = bits ^ lastBits;
+        if (xored == 0) {
+            out.write(0, 1);
+        } else {
+            int leading = std::min(leadingZeros(xored), 31);
+            int trailing = trailingZeros(xored);
+            if (lastLeading >= 0 && leading >= lastLeading && trailing >= lastTrailing) {
+                out.write(0b10, 2);
+                out.write(xored >> lastTrailing, 32 - lastLeading - lastTrailing);
+            } else {
+                int meaningful = 32 - leading - trailing;
+                out.write(0b11, 2);
+                out.write(static_cast<uint64_t>(leading), 5);
+                out.write(static_cast<uint64_t>(meaningful - 1), 5);
+                out.write(xored >> trailing, meaningful);
+                lastLeading = leading;
+                lastTrailing = trailing;
+            }
+        }
+        lastBits = bits;
+        ++count;
+    }
+
+    template<typename Visit>
+    void decode(uint64_t fromMillis, uint64_t toMillis, Visit visit) const {
+        if (count == 0 || lastMillis < fromMillis || firstMillis > toMillis) {
+            return;
+        }
+        BitReader in(data.data(), bitCount);
+        uint64_t millis = in.read(64);
+        uint32_t bits = static_cast<uint32_t>(in.read(32));
+        int64_t delta = 0;
+        int leading = 0, trailing = 0;
+        for (uint32_t i = 0;; ) {
+            if (millis >= fromMillis && millis <= toMillis) {
+                visit(millis, bitsFloat(bits));
+            }
+            if (++i == count || millis > toMillis) {
+                return;
+            }
+
+            // Each control code is read with one peek: 0, 10, 110, 1110 or 1111
+            int64_t deltaOfDelta;
+            uint64_t code = in.peek(4);
+            if (code < 0b1000) {
+                in.skip(1);
+                deltaOfDelta = 0;
+            } else if (code < 0b1100) {
+                in.skip(2);
+                deltaOfDelta = signExtend(in.read(7), 7);
+            } else if (code < 0b1110) {
+                in.skip(3);
+                deltaOfDelta = signExtend(in.read(9), 9);
+            } else if (code == 0b1110) {
+                in.skip(4);
+                deltaOfDelta = signExtend(in.read(12), 12);
+            } else {
+                in.skip(4);
+                deltaOfDelta = static_cast<int64_t>(in.read(64));
+            }
+            delta += deltaOfDelta;
+            millis += static_cast<uint64_t>(delta);
+
+            // 0, 10 (previous window) or 11 (new window)
+            code = in.peek(2);
+            if (code >= 0b10) {
+                in.skip(2);
+                if (code == 0b11) {
+                    uint64_t window = in.read(10);
+                    leading = static_cast<int>(window >> 5);
+                    trailing = 32 - leading - (static_cast<int>(window & 0x1f) + 1);
+                }
+                bits ^= static_cast<uint32_t>(in.read(32 - leading - trailing)) << trailing;
+            } else {
+                in.skip(1);
+            }
+        }
+    }
+};
+
+struct TimeSeriesStore::Series {
+    mutable std::mutex mutex;
+    std::vector<std::shared_ptr<const Block>> sealed; // Oldest first; a handful per series
+    Block open;
+};
+
+struct TimeSeriesStore::Node {
+    std::vector<std::unique_ptr<Series>> slots{METRIC_SLOTS}; // Created on first sample
+};
+
+TimeSeriesStore::TimeSeriesStore(size_t memoryBudgetBytes) : budget(memoryBudgetBytes) {}
+
+TimeSeriesStore::~TimeSeriesStore() = default;
+
+TimeSeriesStore& TimeSeriesStore::forShard() {
+    static thread_local TimeSeriesStore store;
+    return store;
+}
+
+void TimeSeriesStore::append(const std::string& node, const MetricFrame& frame) {
+    struct Pending {
+        size_t slot;
+        float value;
+        Series* series;
+    };
+    std::vector<Pending> pending;
+    frame.forEach([&pending](const MetricTraits& traits, unsigned int gpu, float value) {
+        pending.push_back({metricSlot(traits.id, gpu), value, nullptr});
+    });
+
+    // Series are only created under the exclusive lock, so readers resolving a slot
+    // under the shared lock never see one half-built
+    bool missing = false;
+    {
+        std::shared_lock<std::shared_mutex> lock(nodesMutex);
+        auto it = nodes.find(node);
+        for (Pending& sample : pending) {
+            sample.series = it != nodes.end() ? it->second->slots[sample.slot].get() : nullptr;
+            missing = missing || !sample.series;
+        }
+    }
+    if (missing) {
+        std::unique_lock<std::shared_mutex> lock(nodesMutex);
+        std::unique_ptr<Node>& entry = nodes[node];
+        if (!entry) {
+            entry = std::make_unique<Node>();
+            bytes.fetch_add(sizeof(Node) + METRIC_SLOTS * sizeof(std::unique_ptr<Series>), std::memory_order_relaxed);
+        }
+        for (Pending& sample : pending) {
+            std::unique_ptr<Series>& series = entry->slots[sample.slot];
+            if (!series) {
+                series = std::make_unique<Series>();
+                bytes.fetch_add(sizeof(Series) + series->open.footprint(), std::memory_order_relaxed);
+            }
+            sample.series = series.get();
+        }
+    }
+
+    uint64_t millis = frame.timestampMicros / 1000;
+    std::vector<Series*> newlySealed;
+    for (const Pending& sample : pending) {
+        Series* series = sample.series;
+        std::lock_guard<std::mutex> lock(series->mutex);
+        Block& open = series->open;
+        if (open.count > 0 && millis <= open.lastMillis) {
+            continue;
+        }
+        if (open.count == 0 && !series->sealed.empty() && millis <= series->sealed.back()->lastMillis) {
+            continue;
+        }
+
+        size_t before = open.footprint();
+        open.append(millis, sample.value);
+        bytes.fetch_add(open.footprint() - before, std::memory_order_relaxed);
+        stored.fetch_add(1, std::memory_order_relaxed);
+
+        if (open.count == BLOCK_SAMPLES) {
+            size_t unsealed = open.footprint();
+            open.data.shrink_to_fit();
+            bytes.fetch_sub(unsealed - open.footprint(), std::memory_order_relaxed);
+            series->sealed.push_back(std::make_shared<const Block>(std::move(open)));
+            open = Block();
+            bytes.fetch_add(open.footprint(), std::memory_order_relaxed);
+            newlySealed.push_back(series);
+        }
+    }
+
+    if (!newlySealed.empty()) {
+        std::lock_guard<std::mutex> lock(sealedMutex);
+        sealedOrder.insert(sealedOrder.end(), newlySealed.begin(), newlySealed.end());
+    }
+    evictIfOverBudget();
+}
+
+void TimeSeriesStore::evictIfOverBudget() {
+    while (bytes.load(std::memory_order_relaxed) > budget) {
+        Series* series;
+        {
+            std::lock_guard<std::mutex> lock(sealedMutex);
+            if (sealedOrder.empty()) {
+                return; // Only open blocks left; they are needed to keep appending
+            }
+            series = sealedOrder.front();
+            sealedOrder.pop_front();
+        }
+
+        // Each series seals in time order, so its share of sealedOrder is in the same
+        // order as its sealed deque and the front here is the block just dequeued.
+        // A reader still holding the block keeps it alive until it is done.
+        std::lock_guard<std::mutex> lock(series->mutex);
+        if (!series->sealed.empty()) {
+            bytes.fetch_sub(series->sealed.front()->footprint(), std::memory_order_relaxed);
+            stored.fetch_sub(series->sealed.front()->count, std::memory_order_relaxed);
+            series->sealed.erase(series->sealed.begin());
+            evicted.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+TimeSeriesStore::Series* TimeSeriesStore::find(const std::string& node, size_t slot) const {
+    std::shared_lock<std::shared_mutex> lock(nodesMutex);
+    auto it = nodes.find(node);
+    return it != nodes.end() ? it->second->slots[slot].get() : nullptr;
+}
+
+template<typename Visit, typename VisitWhole>
+void TimeSeriesStore::scan(const std::string& node, MetricId id, unsigned int gpu, uint64_t fromMicros,
+                           uint64_t toMicros, Visit visit, VisitWhole visitWhole) const {
+    if (gpu >= MAX_GPUS) {
+        return;
+    }
+    const Series* series = find(node, metricSlot(id, gpu));
+    if (!series) {
+        return;
+    }
+
+    uint64_t fromMillis = fromMicros / 1000;
+    uint64_t toMillis = toMicros / 1000;
+    std::vector<std::shared_ptr<const Block>> blocks;
+    Block open;
+    {
+        std::lock_guard<std::mutex> lock(series->mutex);
+        // Sealed blocks are in time order, so only the ones in range are touched
+        auto block = std::partition_point(series->sealed.begin(), series->sealed.end(),
+                                          [fromMillis](const auto& sealed) { return sealed->lastMillis < fromMillis; });
+        for (; block != series->sealed.end() && (*block)->firstMillis <= toMillis; ++block) {
+            blocks.push_back(*block);
+        }
+        if (series->open.count > 0 && series->open.lastMillis >= fromMillis && series->open.firstMillis <= toMillis) {
+            open = series->open;
+        }
+    }
+
+    for (const auto& block : blocks) {
+        if (!visitWhole(*block, fromMillis, toMillis)) {
+            block->decode(fromMillis, toMillis, visit);
+        }
+    }
+    if (!visitWhole(open, fromMillis, toMillis)) {
+        open.decode(fromMillis, toMillis, visit);
+    }
+}
+
+template<typename Visit>
+void TimeSeriesStore::scan(const std::string& node, MetricId id, unsigned int gpu, uint64_t fromMicros,
+                           uint64_t toMicros, Visit visit) const {
+    scan(node, id, gpu, fromMicros, toMicros, visit, [](const Block&, uint64_t, uint64_t) { return false; });
+}
+
+std::vector<TimeSeriesPoint> TimeSeriesStore::range(const std::string& node, MetricId id, unsigned int gpu,
+                                                    uint64_t fromMicros, uint64_t toMicros) const {
+    std::vector<TimeSeriesPoint> points;
+    scan(node, id, gpu, fromMicros, toMicros, [&points](uint64_t millis, float value) {
+        points.push_back({millis * 1000, value});
+    });
+    return points;
+}
+
+TimeSeriesSummary TimeSeriesStore::aggregate(const std::string& node, MetricId id, unsigned int gpu,
+                                             uint64_t fromMicros, uint64_t toMicros) const {
+    TimeSeriesSummary summary;
+    auto visit = [&summary](uint64_t millis, float value) {
+        if (summary.count == 0) {
+            summary.min = summary.max = summary.first = value;
+            summary.firstMicros = millis * 1000;
+        }
+        summary.min = std::min(summary.min, value);
+        summary.max = std::max(summary.max, value);
+        summary.last = value;
+        summary.lastMicros = millis * 1000;
+        summary.sum += value;
+        ++summary.count;
+    };
+    // Blocks arrive in time order, so a whole one merges like a run of its samples
+    auto visitWhole = [&summary](const Block& block, uint64_t fromMillis, uint64_t toMillis) {
+        if (!block.within(fromMillis, toMillis)) {
+            return false;
+        }
+        if (summary.count == 0) {
+            summary.min = block.summary.min;
+            summary.max = block.summary.max;
+            summary.first = block.summary.first;
+            summary.firstMicros = block.firstMillis * 1000;
+        }
+        summary.min = std::min(summary.min, block.summary.min);
+        summary.max = std::max(summary.max, block.summary.max);
+        summary.last = block.summary.last;
+        summary.lastMicros = block.lastMillis * 1000;
+        summary.sum += block.summary.sum;
+        summary.count += block.count;
+        return true;
+    };
+    scan(node, id, gpu, fromMicros, toMicros, visit, visitWhole);
+    if (summary.count) {
+        summary.mean = summary.sum / static_cast<double>(summary.count);
+    }
+    return summary;
+}
+
+void TimeSeriesStore::read(const std::string& node, MetricId id, unsigned int gpu, uint64_t fromMicros,
+                           uint64_t toMicros, ColumnBatch& batch) const {
+    scan(node, id, gpu, fromMicros, toMicros, [&batch](uint64_t millis, float value) {
+        batch.timestamps.push_back(millis * 1000);
+        batch.values.push_back(value);
+    });
+}
+
+std::vector<std::string> TimeSeriesStore::nodeNames() const {
+    std::shared_lock<std::shared_mutex> lock(nodesMutex);
+    std::vector<std::string> names;
+    names.reserve(nodes.size());
+    for (const auto& [name, node] : nodes) {
+        names.push_back(name);
+    }
+    return names;
+}
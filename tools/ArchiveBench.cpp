@@ -0,0 +1,176 @@
+// Writes a synthetic archive with MetricArchiveWriter and times MetricArchiveReader's
+// scans over it, the queries ArchiveQuery runs.
+//
+//   ArchiveBench [--days <n>] [--nodes <n>] [--directory <path>]
+//
+// Every node reports 16 metrics at 1 Hz as random walks. The archive goes to a temporary
+// directory that is removed afterwards unless --directory names one to keep. Prints the
+// write rate, then for each scan its time, rows/s, and what the headers let it skip; a
+// full scan must count every row that was written.
+// e.g. ArchiveBench --days 365 --nodes 1
+
+#include "MetricArchive.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    int usage(const char* program) {
+        std::fprintf(stderr, "usage: %s [--days <n>] [--nodes <n>] [--directory <path>]\n", program);
+        return 2;
+    }
+
+    constexpr uint64_t START_MICROS = 1729123200ull * 1000000; // 2024-10-17, a partition boundary
+    constexpr uint64_t DAY_MICROS = 86400ull * 1000000;
+
+    std::string nodeName(unsigned long node) {
+        return "10.0." + std::to_string(node >> 8) + "." + std::to_string(node & 0xff);
+    }
+
+    // A fixed seed, so every run writes the same archive
+    void writeArchive(const std::string& directory, unsigned long days, unsigned long nodes) {
+        MetricArchiveWriter writer(directory);
+        std::mt19937 rng(5);
+        std::vector<std::vector<float>> walks(nodes, std::vector<float>(16, 50.0f));
+        auto started = std::chrono::steady_clock::now();
+        uint64_t seconds = days * 86400ull;
+        for (uint64_t second = 0; second < seconds; ++second) {
+            for (unsigned long node = 0; node < nodes; ++node) {
+                std::vector<float>& walk = walks[node];
+                for (float& value : walk) {
+                    value = std::clamp(value + static_cast<float>(static_cast<int>(rng() % 5) - 2), 0.0f, 100.0f);
+                }
+                MetricFrame frame;
+                frame.timestampMicros = START_MICROS + second * 1000000;
+                frame.set(MetricId::CPU_USAGE, walk[0]);
+                frame.set(MetricId::FREE_MEMORY, walk[1] * 1e9f);
+                frame.set(MetricId::USED_MEMORY, walk[2] * 1e9f);
+                frame.set(MetricId::HDD_USAGE, walk[3]);
+                frame.set(MetricId::TRAFFIC_IN, walk[4]);
+                frame.set(MetricId::TRAFFIC_OUT, walk[5]);
+                frame.set(MetricId::GPU_MAX_TEMPERATURE, 40.0f + walk[6] * 0.5f);
+                frame.set(MetricId::GPU_MEAN_USAGE, walk[7]);
+                for (unsigned int gpu = 0; gpu < 8; ++gpu) {
+                    frame.set(MetricId::GPU_USAGE, gpu, walk[8 + gpu]);
+                }
+                writer.append(nodeName(node), frame);
+            }
+            // Flushed on this thread, so nothing is dropped for outrunning a flusher
+            if ((second + 1) * nodes % MetricArchiveWriter::SEGMENT_ROWS < nodes) {
+                writer.flush();
+            }
+        }
+        writer.flush();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        std::printf("wrote %llu rows, %.1f MB in %.1f s (%.2f M rows/s with frame generation)\n",
+                    static_cast<unsigned long long>(writer.rowsWritten()), static_cast<double>(writer.bytesWritten()) / 1e6,
+                    elapsed, static_cast<double>(writer.rowsWritten()) / elapsed / 1e6);
+    }
+
+    void removeArchive(const std::string& directory) {
+        if (DIR* dir = opendir(directory.c_str())) {
+            while (dirent* entry = readdir(dir)) {
+                std::string name = entry->d_name;
+                if (name != "." && name != "..") {
+                    unlink((directory + "/" + name).c_str());
+                }
+            }
+            closedir(dir);
+        }
+        rmdir(directory.c_str());
+    }
+
+    TimeSeriesSummary timeScan(const MetricArchiveReader& reader, const char* label, const MetricArchiveReader::Query& query) {
+        ArchiveScanStats stats;
+        auto started = std::chrono::steady_clock::now();
+        TimeSeriesSummary summary = reader.summarize(query, &stats);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        std::printf("%-26s %12llu %9.3f %10.1f %6llu %6llu %8llu\n", label, static_cast<unsigned long long>(summary.count),
+                    elapsed, static_cast<double>(stats.rowsScanned) / elapsed / 1e6,
+                    static_cast<unsigned long long>(stats.files), static_cast<unsigned long long>(stats.segmentsSkipped),
+                    static_cast<unsigned long long>(stats.chunksSkipped));
+        return summary;
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned long days = 30;
+    unsigned long nodes = 1;
+    std::string directory;
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) {
+            return usage(argv[0]);
+        } else if (option == "--days") {
+            days = std::strtoul(argv[++i], nullptr, 10);
+        } else if (option == "--nodes") {
+            nodes = std::strtoul(argv[++i], nullptr, 10);
+        } else if (option == "--directory") {
+            directory = argv[++i];
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (days == 0 || nodes == 0) {
+        return usage(argv[0]);
+    }
+
+    bool temporary = directory.empty();
+    if (temporary) {
+        char name[] = "/tmp/ArchiveBench.XXXXXX";
+        if (!mkdtemp(name)) {
+            std::fprintf(stderr, "Failed to create a temporary directory\n");
+            return 1;
+        }
+        directory = name;
+    }
+
+    bool counted;
+    try {
+        writeArchive(directory, days, nodes);
+        MetricArchiveReader reader(directory);
+
+        std::printf("%-26s %12s %9s %10s %6s %6s %8s\n", "scan", "rows", "seconds", "M rows/s", "files", "segs-", "chunks-");
+        MetricArchiveReader::Query query;
+        query.id = MetricId::CPU_USAGE;
+        uint64_t full = timeScan(reader, "CpuUsage (first)", query).count;
+        timeScan(reader, "CpuUsage (again)", query);
+        query.id = MetricId::GPU_USAGE;
+        query.gpu = 5;
+        timeScan(reader, "GpuUsage[5]", query);
+        query.id = MetricId::GPU_MAX_TEMPERATURE;
+        query.gpu = 0;
+        query.minValue = 89.5f;
+        timeScan(reader, "GpuMaxTemperature > 89.5", query);
+        query.minValue = -std::numeric_limits<float>::infinity();
+        query.fromMicros = START_MICROS + days / 2 * DAY_MICROS;
+        query.toMicros = query.fromMicros + std::min<uint64_t>(7, days - days / 2) * DAY_MICROS - 1;
+        timeScan(reader, "GpuMaxTemperature, a week", query);
+        query = {};
+        query.node = nodeName(nodes - 1);
+        timeScan(reader, "CpuUsage, one node", query);
+
+        uint64_t rows = days * 86400ull * nodes;
+        counted = full == rows;
+        std::printf("%-4s full scan counted %llu of %llu rows\n", counted ? "ok" : "FAIL",
+                    static_cast<unsigned long long>(full), static_cast<unsigned long long>(rows));
+    } catch (const std::exception& e) {
+        if (temporary) {
+            removeArchive(directory);
+        }
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    if (temporary) {
+        removeArchive(directory);
+    }
+    return counted ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+// Offline query over a metric archive directory written by MetricArchiveWriter.
+//
+//   ArchiveQuery <directory> <Metric>[<gpu>] [--node <ip>] [--from <epoch s>] [--to <epoch s>]
+//                [--above <value>] [--below <value>] [--rows]
+//
+// Prints count, min, max, mean, first and last of the matching samples, and what the
+// block headers let the scan skip. --rows prints every matching sample instead.
+// e.g. ArchiveQuery /var/lib/director/archive GpuTemperature[2] --above 85 --rows
+
+#include "MetricArchive.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace {
+    int usage(const char* program) {
+        std::fprintf(stderr,
+                     "usage: %s <directory> <Metric>[<gpu>] [--node <ip>] [--from <epoch s>] [--to <epoch s>]\n"
+                     "          [--above <value>] [--below <value>] [--rows]\n",
+                     program);
+        return 2;
+    }
+
+    // "GpuUsage[3]" or "CpuUsage"
+    bool parseMetric(const std::string& text, MetricId& id, unsigned int& gpu) {
+        size_t bracket = text.find('[');
+        std::string name = text.substr(0, bracket);
+        gpu = 0;
+        if (bracket != std::string::npos) {
+            char* end;
+            gpu = static_cast<unsigned int>(std::strtoul(text.c_str() + bracket + 1, &end, 10));
+            if (*end != ']' || end[1] != '\0') {
+                return false;
+            }
+        }
+        for (const MetricTraits& traits : METRIC_SCHEMA) {
+            if (name == traits.name) {
+                id = traits.id;
+                return traits.perGpu || bracket == std::string::npos;
+            }
+        }
+        return false;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        return usage(argv[0]);
+    }
+
+    MetricArchiveReader::Query query;
+    if (!parseMetric(argv[2], query.id, query.gpu)) {
+        std::fprintf(stderr, "Unknown metric %s\n", argv[2]);
+        return 2;
+    }
+    bool rows = false;
+    for (int i = 3; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--rows") {
+            rows = true;
+        } else if (i + 1 >= argc) {
+            return usage(argv[0]);
+        } else if (option == "--node") {
+            query.node = argv[++i];
+        } else if (option == "--from") {
+            query.fromMicros = std::strtoull(argv[++i], nullptr, 10) * 1000000;
+        } else if (option == "--to") {
+            query.toMicros = std::strtoull(argv[++i], nullptr, 10) * 1000000;
+        } else if (option == "--above") {
+            query.minValue = std::strtof(argv[++i], nullptr);
+        } else if (option == "--below") {
+            query.maxValue = std::strtof(argv[++i], nullptr);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+
+    try {
+        MetricArchiveReader reader(argv[1]);
+        auto started = std::chrono::steady_clock::now();
+        ArchiveScanStats stats;
+        if (rows) {
+            stats = reader.forEach(query, [](std::string_view node, uint64_t timestampMicros, float value) {
+                std::printf("%llu.%06llu %.*s %g\n", static_cast<unsigned long long>(timestampMicros / 1000000),
+                            static_cast<unsigned long long>(timestampMicros % 1000000),
+                            static_cast<int>(node.size()), node.data(), value);
+            });
+        } else {
+            TimeSeriesSummary summary = reader.summarize(query, &stats);
+            std::printf("count %llu\n", static_cast<unsigned long long>(summary.count));
+            if (summary.count) {
+                std::printf("min %g\nmax %g\nmean %g\nfirst %g\nlast %g\n", summary.min, summary.max, summary.mean,
+                            summary.first, summary.last);
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        std::fprintf(stderr, "files %llu (%llu skipped), segments %llu (%llu skipped), chunks %llu read / %llu skipped, "
+                             "%llu rows in %.3f s\n",
+                     static_cast<unsigned long long>(stats.files), static_cast<unsigned long long>(stats.filesSkipped),
+                     static_cast<unsigned long long>(stats.segments),
+                     static_cast<unsigned long long>(stats.segmentsSkipped),
+                     static_cast<unsigned long long>(stats.chunksRead), static_cast<unsigned long long>(stats.chunksSkipped),
+                     static_cast<unsigned long long>(stats.rowsScanned), seconds);
+    } catch (const std::runtime_error& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,140 @@
+// Drives GpuHistory with the mock backend's synthetic sample buffers and checks what
+// each tick's interval holds.
+//
+//   GpuHistoryCheck [--ticks <n>] [--tick-ms <n>]
+//
+// Device 0 is scripted busy (95%, 300 W), device 1 idle (5%, 60 W), and device 2 keeps
+// no buffers; the driver "samples" every 10 ms. Checks that the percentiles stay per
+// device, that a device without buffers has empty histograms, that callers within a
+// tick share one interval, and that consecutive ticks neither lose nor repeat readings.
+// Prints each check and the cost of a collection, and exits 1 if any check failed.
+// e.g. GpuHistoryCheck --ticks 20 --tick-ms 100
+
+#include "GpuHistory.h"
+#include "MockGpuBackend.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+    int usage(const char* program) {
+        std::fprintf(stderr, "usage: %s [--ticks <n>] [--tick-ms <n>]\n", program);
+        return 2;
+    }
+
+    constexpr uint64_t PERIOD_MICROS = 10000;
+
+    void writeScript(const std::string& path) {
+        std::ofstream script(path, std::ios::trunc);
+        if (!script) {
+            throw std::runtime_error("Failed to create " + path);
+        }
+        script << "0 samples.period " << PERIOD_MICROS << "\n"
+               << "0 samples.gpu 95\n"
+               << "0 samples.power 300000\n"
+               << "1 samples.period " << PERIOD_MICROS << "\n"
+               << "1 samples.gpu 5\n"
+               << "1 samples.power 60000\n"
+               << "2 temperature 40\n";
+    }
+
+    int failures = 0;
+
+    void check(bool passed, const std::string& what) {
+        std::printf("%-4s %s\n", passed ? "ok" : "FAIL", what.c_str());
+        if (!passed) {
+            ++failures;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned long ticks = 10;
+    unsigned long tickMillis = 100;
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) {
+            return usage(argv[0]);
+        } else if (option == "--ticks") {
+            ticks = std::strtoul(argv[++i], nullptr, 10);
+        } else if (option == "--tick-ms") {
+            tickMillis = std::strtoul(argv[++i], nullptr, 10);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    // The mock keeps BUFFER_DEPTH readings; a longer tick would lose some to the wrap
+    if (ticks == 0 || tickMillis == 0 || tickMillis * 1000 >= MockGpuBackend::BUFFER_DEPTH * PERIOD_MICROS) {
+        return usage(argv[0]);
+    }
+
+    char name[] = "/tmp/GpuHistoryCheck.XXXXXX";
+    int fd = mkstemp(name);
+    if (fd < 0) {
+        std::fprintf(stderr, "Failed to create a temporary file\n");
+        return 1;
+    }
+    close(fd);
+    std::string script = name;
+
+    try {
+        writeScript(script);
+        MockGpuBackend backend(script);
+        GpuHistory history(backend);
+        // Reading 0 is taken at load, so its timestamp dates every later one
+        uint64_t firstMicros = backend.bufferedSamples(0, GpuSampleType::GPU_UTILIZATION, 0).at(0).timestampMicros;
+        auto tick = std::chrono::milliseconds(tickMillis);
+
+        uint64_t readings = 0;
+        double collectMicros = 0.0;
+        for (unsigned long t = 0; t < ticks; ++t) {
+            std::this_thread::sleep_for(tick);
+            auto started = std::chrono::steady_clock::now();
+            // Anything younger than the tick is the interval another caller already closed
+            auto interval = history.latest(tick / 2);
+            collectMicros += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started).count();
+            readings += interval->devices.empty() ? 0 : interval->devices[0].utilization.count();
+
+            if (t != 0) {
+                continue;
+            }
+            check(interval->devices.size() == 3, "three devices tracked");
+            if (interval->devices.size() != 3) {
+                break;
+            }
+            const auto& busy = interval->devices[0];
+            const auto& idle = interval->devices[1];
+            check(busy.utilization.percentile(10.0) == 95 && idle.utilization.percentile(90.0) == 5,
+                  "per-device percentiles: busy p10 " + std::to_string(busy.utilization.percentile(10.0)) +
+                  ", idle p90 " + std::to_string(idle.utilization.percentile(90.0)));
+            check(busy.power.percentile(50.0) / 1000 == 300 && idle.power.percentile(50.0) / 1000 == 60,
+                  "per-device power p50: " + std::to_string(busy.power.percentile(50.0) / 1000) + " W, " +
+                  std::to_string(idle.power.percentile(50.0) / 1000) + " W");
+            check(interval->devices[2].utilization.count() == 0 && interval->devices[2].power.count() == 0,
+                  "a device without buffers has empty histograms");
+            LatencyHistogram merged = interval->utilization();
+            check(merged.count() == busy.utilization.count() + idle.utilization.count() && merged.max() >= 95 &&
+                  merged.min() <= 5, "merged utilization covers both devices");
+            check(history.latest(tick / 2) == interval, "a second caller in the tick shares the interval");
+        }
+
+        // Every reading the mock has taken since it loaded, drained exactly once
+        uint64_t lastMicros = backend.bufferedSamples(0, GpuSampleType::GPU_UTILIZATION, 0).back().timestampMicros;
+        uint64_t taken = (lastMicros - firstMicros) / PERIOD_MICROS + 1;
+        uint64_t lower = taken > 1 ? taken - 1 : 0; // The mock may take one more after the last tick
+        check(readings >= lower && readings <= taken,
+              "ticks drained " + std::to_string(readings) + " readings of " + std::to_string(taken) + " taken");
+        std::printf("     collect and close: %.1f us per tick\n", collectMicros / static_cast<double>(ticks));
+    } catch (const std::exception& e) {
+        unlink(script.c_str());
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    unlink(script.c_str());
+    return failures ? 1 : 0;
+}
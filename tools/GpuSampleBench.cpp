@@ -0,0 +1,157 @@
+// Compares GpuBackend::sample() with reading the same gauges through one getter call
+// each, the way the GPU metrics were read before it.
+//
+//   GpuSampleBench [--iterations <n>] [--devices <n>] [--backend mock|system]
+//
+// The mock backend runs a synthetic script with the given number of devices, the last
+// of which has no fan or power reading; on it the two paths must agree field by field
+// and on which fields are valid. "system" is GpuBackend::instance(), i.e. NVML where the
+// driver is installed, and is only timed. Prints the time per tick over all devices.
+// e.g. GpuSampleBench --devices 8 --iterations 100000
+
+#include "GpuBackend.h"
+#include "MockGpuBackend.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+namespace {
+    int usage(const char* program) {
+        std::fprintf(stderr, "usage: %s [--iterations <n>] [--devices <n>] [--backend mock|system]\n", program);
+        return 2;
+    }
+
+    // Constant readings, distinct per device, so both paths must see the same values
+    void writeScript(const std::string& path, unsigned int devices) {
+        std::ofstream script(path, std::ios::trunc);
+        if (!script) {
+            throw std::runtime_error("Failed to create " + path);
+        }
+        for (unsigned int gpu = 0; gpu < devices; ++gpu) {
+            bool last = gpu + 1 == devices;
+            script << gpu << " temperature " << 50 + gpu << "\n"
+                   << gpu << " utilization.gpu " << 10 * gpu % 100 << "\n"
+                   << gpu << " utilization.memory " << 5 * gpu % 100 << "\n"
+                   << gpu << " memory.total 85899345920\n"
+                   << gpu << " memory.used " << (gpu + 1) * 1073741824ull << "\n"
+                   << gpu << " power " << (last ? "n/a" : std::to_string(250000 + gpu * 1000)) << "\n"
+                   << gpu << " fan " << (last ? "n/a" : std::to_string(30 + gpu)) << "\n"
+                   << gpu << " clock.sm " << 1410 + gpu << "\n"
+                   << gpu << " clock.memory 1593\n";
+        }
+    }
+
+    // Every field the getter path reads; energy has no getter
+    bool sameSample(const GpuSample& a, const GpuSample& b) {
+        constexpr uint32_t compared = ~static_cast<uint32_t>(GpuSample::ENERGY);
+        return (a.valid & compared) == (b.valid & compared) && a.temperatureC == b.temperatureC &&
+               a.gpuUtilization == b.gpuUtilization && a.memoryUtilization == b.memoryUtilization &&
+               a.memoryTotal == b.memoryTotal && a.memoryUsed == b.memoryUsed &&
+               a.powerMilliwatts == b.powerMilliwatts && a.fanPercent == b.fanPercent &&
+               a.smClockMHz == b.smClockMHz && a.memoryClockMHz == b.memoryClockMHz;
+    }
+
+    // Microseconds per tick over every device
+    template<typename F>
+    double microsPerTick(F read, unsigned int devices, unsigned long iterations) {
+        volatile uint32_t sink = 0;
+        auto started = std::chrono::steady_clock::now();
+        for (unsigned long i = 0; i < iterations; ++i) {
+            for (unsigned int gpu = 0; gpu < devices; ++gpu) {
+                sink = sink + read(gpu).valid;
+            }
+        }
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started).count() /
+               static_cast<double>(iterations);
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned long iterations = 100000;
+    unsigned int devices = 8;
+    std::string backendName = "mock";
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) {
+            return usage(argv[0]);
+        } else if (option == "--iterations") {
+            iterations = std::strtoul(argv[++i], nullptr, 10);
+        } else if (option == "--devices") {
+            devices = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (option == "--backend") {
+            backendName = argv[++i];
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    bool mock = backendName == "mock";
+    if (iterations == 0 || devices == 0 || (!mock && backendName != "system")) {
+        return usage(argv[0]);
+    }
+
+    std::string script;
+    int failures = 0;
+    try {
+        std::unique_ptr<MockGpuBackend> mockBackend;
+        GpuBackend* backend;
+        if (mock) {
+            char name[] = "/tmp/GpuSampleBench.XXXXXX";
+            int fd = mkstemp(name);
+            if (fd < 0) {
+                throw std::runtime_error("Failed to create a temporary file");
+            }
+            close(fd);
+            script = name;
+            writeScript(script, devices);
+            mockBackend = std::make_unique<MockGpuBackend>(script);
+            backend = mockBackend.get();
+        } else {
+            backend = &GpuBackend::instance();
+        }
+        devices = backend->deviceCount();
+        if (devices == 0) {
+            throw std::runtime_error("The " + backend->name() + " backend has no devices");
+        }
+
+        auto getters = [backend](unsigned int gpu) { return backend->GpuBackend::sample(gpu); };
+        auto sampled = [backend](unsigned int gpu) { return backend->sample(gpu); };
+
+        if (mock) {
+            for (unsigned int gpu = 0; gpu < devices; ++gpu) {
+                bool same = sameSample(getters(gpu), sampled(gpu));
+                std::printf("%-4s device %u: sample() matches the getters\n", same ? "ok" : "FAIL", gpu);
+                failures += same ? 0 : 1;
+            }
+            GpuSample last = sampled(devices - 1);
+            bool unsupported = !last.has(GpuSample::FAN) && !last.has(GpuSample::POWER) && last.has(GpuSample::CLOCKS);
+            std::printf("%-4s device %u: n/a fields left out of valid\n", unsupported ? "ok" : "FAIL", devices - 1);
+            failures += unsupported ? 0 : 1;
+        }
+
+        // One untimed tick each, then the timed runs
+        microsPerTick(getters, devices, 1);
+        microsPerTick(sampled, devices, 1);
+        double getterMicros = microsPerTick(getters, devices, iterations);
+        double sampleMicros = microsPerTick(sampled, devices, iterations);
+        std::printf("%s backend, %u devices\n", backend->name().c_str(), devices);
+        std::printf("%-10s %12s\n", "path", "us/tick");
+        std::printf("%-10s %12.2f\n", "getters", getterMicros);
+        std::printf("%-10s %12.2f\n", "sample()", sampleMicros);
+        std::printf("speedup %.1fx\n", getterMicros / sampleMicros);
+    } catch (const std::exception& e) {
+        if (!script.empty()) {
+            unlink(script.c_str());
+        }
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    if (!script.empty()) {
+        unlink(script.c_str());
+    }
+    return failures ? 1 : 0;
+}
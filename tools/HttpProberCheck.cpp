@@ -0,0 +1,191 @@
+// Runs HttpProber against a local HTTP stand-in and checks what it counts.
+//
+//   HttpProberCheck [--requests <n>] [--parallel <n>]
+//
+// The stand-in listens on 127.0.0.1, keeps connections alive, and answers /ok with 200
+// and a fixed body and /fail with 503. Checks the request, error and byte counts of a
+// healthy, a failing, a mixed and an unreachable window, and that a second window reuses
+// the first one's connections. Prints each check and exits 1 if any failed.
+// e.g. HttpProberCheck --requests 1000 --parallel 16
+
+#include "HttpProber.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    int usage(const char* program) {
+        std::fprintf(stderr, "usage: %s [--requests <n>] [--parallel <n>]\n", program);
+        return 2;
+    }
+
+    constexpr size_t BODY_BYTES = 512;
+
+    // One thread per connection is plenty for a few dozen keep-alive clients
+    class StandInServer {
+    public:
+        StandInServer() {
+            listener = socket(AF_INET, SOCK_STREAM, 0);
+            if (listener < 0) {
+                throw std::runtime_error("Failed to create a socket");
+            }
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t length = sizeof(address);
+            if (bind(listener, reinterpret_cast<sockaddr*>(&address), length) != 0 || listen(listener, 128) != 0 ||
+                getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+                close(listener);
+                throw std::runtime_error("Failed to listen on 127.0.0.1");
+            }
+            port = ntohs(address.sin_port);
+            acceptor = std::thread([this] { acceptLoop(); });
+        }
+
+        ~StandInServer() {
+            shutdown(listener, SHUT_RDWR);
+            close(listener);
+            acceptor.join();
+            // The prober keeps its connections open, so end them from this side
+            for (int fd : connectionFds) {
+                shutdown(fd, SHUT_RDWR);
+            }
+            for (std::thread& connection : connections) {
+                connection.join();
+            }
+            for (int fd : connectionFds) {
+                close(fd);
+            }
+        }
+
+        std::string url(const char* path) const {
+            return "http://127.0.0.1:" + std::to_string(port) + path;
+        }
+
+        size_t accepted() const { return acceptedCount.load(); }
+
+    private:
+        void acceptLoop() {
+            while (true) {
+                int fd = accept(listener, nullptr, nullptr);
+                if (fd < 0) {
+                    return;
+                }
+                ++acceptedCount;
+                connectionFds.push_back(fd);
+                connections.emplace_back([fd] { serve(fd); });
+            }
+        }
+
+        // Answers requests on one connection until either side shuts it down
+        static void serve(int fd) {
+            static const std::string body(BODY_BYTES, 'x');
+            std::string pending;
+            char buffer[4096];
+            while (true) {
+                size_t end = pending.find("\r\n\r\n");
+                if (end == std::string::npos) {
+                    ssize_t n = read(fd, buffer, sizeof(buffer));
+                    if (n <= 0) {
+                        break;
+                    }
+                    pending.append(buffer, static_cast<size_t>(n));
+                    continue;
+                }
+                bool ok = pending.compare(0, 8, "GET /ok ") == 0;
+                pending.erase(0, end + 4);
+
+                std::string response = ok ? "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body
+                                          : "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n";
+                if (write(fd, response.data(), response.size()) != static_cast<ssize_t>(response.size())) {
+                    break;
+                }
+            }
+        }
+
+        int listener = -1;
+        uint16_t port = 0;
+        std::thread acceptor;
+        // Only touched by the acceptor until it has joined
+        std::vector<std::thread> connections;
+        std::vector<int> connectionFds;
+        std::atomic<size_t> acceptedCount{0};
+    };
+
+    int failures = 0;
+
+    void check(bool passed, const char* what, unsigned long long got, unsigned long long want) {
+        std::printf("%-4s %-40s got %llu, want %llu\n", passed ? "ok" : "FAIL", what, got, want);
+        if (!passed) {
+            ++failures;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    HttpProber::Options options;
+    options.requestBudget = 200;
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) {
+            return usage(argv[0]);
+        } else if (option == "--requests") {
+            options.requestBudget = std::strtoul(argv[++i], nullptr, 10);
+        } else if (option == "--parallel") {
+            options.parallel = std::strtoul(argv[++i], nullptr, 10);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    // An even budget splits exactly between the two endpoints of the mixed window
+    if (options.requestBudget < 2 || options.requestBudget % 2 != 0 || options.parallel == 0) {
+        return usage(argv[0]);
+    }
+    unsigned long long budget = options.requestBudget;
+
+    try {
+        StandInServer server;
+        HttpProber& prober = HttpProber::instance();
+
+        HttpProbeResult healthy = prober.probe({server.url("/ok")}, options);
+        check(healthy.requests == budget, "healthy: requests", healthy.requests, budget);
+        check(healthy.errors == 0, "healthy: errors", healthy.errors, 0);
+        check(healthy.latencyMicros.count() == budget, "healthy: latencies recorded", healthy.latencyMicros.count(), budget);
+        check(healthy.bytes == budget * BODY_BYTES, "healthy: body bytes", healthy.bytes, budget * BODY_BYTES);
+        std::printf("     healthy: %.0f requests/s, p50 %.0f us, p99 %.0f us\n", healthy.requestsPerSecond(),
+                    healthy.latencySeconds(50) * 1e6, healthy.latencySeconds(99) * 1e6);
+
+        // The second window has to ride on the first one's connections
+        size_t opened = server.accepted();
+        prober.probe({server.url("/ok")}, options);
+        check(server.accepted() == opened, "reuse: connections opened by window 2", server.accepted() - opened, 0);
+        check(opened <= options.parallel, "reuse: connections opened by window 1", opened, options.parallel);
+
+        HttpProbeResult failing = prober.probe({server.url("/fail")}, options);
+        check(failing.errors == budget, "5xx: errors", failing.errors, budget);
+        check(failing.latencyMicros.count() == budget, "5xx: latencies recorded", failing.latencyMicros.count(), budget);
+
+        HttpProbeResult mixed = prober.probe({server.url("/ok"), server.url("/fail")}, options);
+        check(mixed.requests == budget, "mixed: requests", mixed.requests, budget);
+        check(mixed.errors == budget / 2, "mixed: errors", mixed.errors, budget / 2);
+        check(mixed.bytes == budget / 2 * BODY_BYTES, "mixed: body bytes", mixed.bytes, budget / 2 * BODY_BYTES);
+
+        // Port 1 on loopback refuses the connection: transport failures, no latencies
+        HttpProber::Options refusedOptions = options;
+        refusedOptions.requestBudget = 4;
+        HttpProbeResult refused = prober.probe({"http://127.0.0.1:1/"}, refusedOptions);
+        check(refused.errors == 4, "refused: errors", refused.errors, 4);
+        check(refused.latencyMicros.count() == 0, "refused: latencies recorded", refused.latencyMicros.count(), 0);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,154 @@
+// Compares LogScanner with the per-line matching it replaced, on the auth log patterns
+// SystemMetrics counts.
+//
+//   LogScannerBench [--megabytes <n>] [--file <path>]
+//
+// Without --file it writes a synthetic auth log of the given size (64 MB by default) to
+// a temporary file first. Prints the counts and the time of each method; the counts
+// must agree.
+// e.g. LogScannerBench --file /var/log/auth.log
+
+#include "LogScanner.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    int usage(const char* program) {
+        std::fprintf(stderr, "usage: %s [--megabytes <n>] [--file <path>]\n", program);
+        return 2;
+    }
+
+    // A mix of the lines sshd, sudo, cron and logind write, a few of them matches
+    void writeSyntheticLog(const std::string& path, size_t bytes) {
+        static const char* const LINES[] = {
+            "Oct 17 10:00:01 host sshd[1234]: Accepted publickey for deploy from 10.0.0.5 port 5122 ssh2\n",
+            "Oct 17 10:00:02 host sshd[1235]: Failed password for root from 203.0.113.9 port 4122 ssh2\n",
+            "Oct 17 10:00:03 host sshd[1236]: Invalid user admin from 203.0.113.9 port 4123\n",
+            "Oct 17 10:00:04 host sudo: pam_unix(sudo:auth): authentication failure; logname=bob uid=1000\n",
+            "Oct 17 10:00:05 host CRON[999]: pam_unix(cron:session): session opened for user root by (uid=0)\n",
+            "Oct 17 10:00:06 host systemd-logind[1]: New session 42 of user deploy.\n",
+            "Oct 17 10:00:07 host sshd[1237]: Connection closed by authenticating user root 198.51.100.2 port 2222 [preauth]\n",
+            "Oct 17 10:00:08 host sshd[1238]: Disconnected from user deploy 10.0.0.5 port 5122\n",
+        };
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            throw std::runtime_error("Failed to create " + path);
+        }
+        // A fixed LCG, so every run scans the same text
+        uint32_t state = 1;
+        for (size_t written = 0; written < bytes;) {
+            state = state * 1103515245u + 12345u;
+            const char* line = LINES[(state >> 16) % (sizeof(LINES) / sizeof(LINES[0]))];
+            size_t length = std::strlen(line);
+            file.write(line, static_cast<std::streamsize>(length));
+            written += length;
+        }
+    }
+
+    // What the tailer matched with before LogScanner: one regex per pattern per line
+    std::vector<uint64_t> regexCounts(const std::string& path) {
+        std::ifstream file(path);
+        if (!file) {
+            throw std::runtime_error("Failed to open " + path);
+        }
+        const std::regex patterns[] = {
+            std::regex("Failed password for"),
+            std::regex("Invalid user"),
+            std::regex("sudo:.*authentication failure"),
+        };
+        std::vector<uint64_t> counts(3, 0);
+        std::string line;
+        while (std::getline(file, line)) {
+            for (size_t i = 0; i < counts.size(); ++i) {
+                if (std::regex_search(line, patterns[i])) {
+                    ++counts[i];
+                }
+            }
+        }
+        return counts;
+    }
+
+    template<typename F>
+    double secondsOf(F run, std::vector<uint64_t>& counts) {
+        auto started = std::chrono::steady_clock::now();
+        counts = run();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t megabytes = 64;
+    std::string path;
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) {
+            return usage(argv[0]);
+        } else if (option == "--megabytes") {
+            megabytes = std::strtoul(argv[++i], nullptr, 10);
+        } else if (option == "--file") {
+            path = argv[++i];
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (path.empty() && megabytes == 0) {
+        return usage(argv[0]);
+    }
+
+    bool synthetic = path.empty();
+    try {
+        if (synthetic) {
+            char name[] = "/tmp/LogScannerBench.XXXXXX";
+            int fd = mkstemp(name);
+            if (fd < 0) {
+                throw std::runtime_error("Failed to create a temporary file");
+            }
+            close(fd);
+            path = name;
+            writeSyntheticLog(path, megabytes << 20);
+        }
+
+        // The same patterns, in the same slots, as SystemMetrics' auth log scanner
+        LogScanner scanner;
+        scanner.addPattern("Failed password for");
+        scanner.addPattern("Invalid user");
+        scanner.addPattern("sudo:*authentication failure");
+
+        // One untimed scan warms the page cache for both
+        std::vector<uint64_t> scanned = scanner.scanFile(path);
+        std::vector<uint64_t> matched;
+        double scannerSeconds = secondsOf([&] { return scanner.scanFile(path); }, scanned);
+        double regexSeconds = secondsOf([&] { return regexCounts(path); }, matched);
+
+        std::printf("%-8s %10s %10s %10s %9s\n", "method", "failed", "invalid", "sudo", "seconds");
+        std::printf("%-8s %10llu %10llu %10llu %9.3f\n", "scanner", static_cast<unsigned long long>(scanned[0]),
+                    static_cast<unsigned long long>(scanned[1]), static_cast<unsigned long long>(scanned[2]), scannerSeconds);
+        std::printf("%-8s %10llu %10llu %10llu %9.3f\n", "regex", static_cast<unsigned long long>(matched[0]),
+                    static_cast<unsigned long long>(matched[1]), static_cast<unsigned long long>(matched[2]), regexSeconds);
+        std::printf("speedup %.1fx\n", regexSeconds / scannerSeconds);
+
+        if (synthetic) {
+            unlink(path.c_str());
+        }
+        if (scanned != matched) {
+            std::fprintf(stderr, "counts differ\n");
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        if (synthetic && !path.empty()) {
+            unlink(path.c_str());
+        }
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
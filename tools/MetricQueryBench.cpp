@@ -0,0 +1,170 @@
+// Times MetricQuery over a TimeSeriesStore filled the way monitorNodes fills it, and
+// checks its answers against the decoded samples.
+//
+//   MetricQueryBench [--nodes <n>] [--seconds <n>]
+//
+// Every node reports CPU and GPU usage at 1 Hz as random walks; node 0 holds CPU at 95
+// for the last 6 minutes and node 1 for the last 4. Each unfiltered aggregate that the
+// block summaries answer is timed against the same aggregate forced through the decode
+// path (a filter every sample passes), over the whole history and over the last 5
+// minutes, and the two must agree per node. Also times p95, the sustained-CPU search and
+// per-minute windows. Prints each check and exits 1 if any failed.
+// e.g. MetricQueryBench --nodes 10000 --seconds 3600
+
+#include "MetricQuery.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    int usage(const char* program) {
+        std::fprintf(stderr, "usage: %s [--nodes <n>] [--seconds <n>]\n", program);
+        return 2;
+    }
+
+    constexpr uint64_t START_MICROS = 1760659200ull * 1000000;
+
+    int failures = 0;
+
+    void check(bool passed, const std::string& what) {
+        std::printf("%-4s %s\n", passed ? "ok" : "FAIL", what.c_str());
+        if (!passed) {
+            ++failures;
+        }
+    }
+
+    template<typename F>
+    double millisOf(F run) {
+        auto started = std::chrono::steady_clock::now();
+        run();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    }
+
+    // Sums differ in the order they are added, so allow for the rounding
+    bool sameRows(const std::vector<NodeAggregate>& a, const std::vector<NodeAggregate>& b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (a[i].node != b[i].node || a[i].samples != b[i].samples || a[i].firstMicros != b[i].firstMicros ||
+                a[i].lastMicros != b[i].lastMicros ||
+                std::fabs(a[i].value - b[i].value) > 1e-9 * std::max(1.0, std::fabs(b[i].value))) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned long nodeCount = 10000;
+    unsigned long seconds = 3600;
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) {
+            return usage(argv[0]);
+        } else if (option == "--nodes") {
+            nodeCount = std::strtoul(argv[++i], nullptr, 10);
+        } else if (option == "--seconds") {
+            seconds = std::strtoul(argv[++i], nullptr, 10);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    // The sustained search looks at the last 10 minutes
+    if (nodeCount < 2 || seconds < 600) {
+        return usage(argv[0]);
+    }
+
+    TimeSeriesStore store(size_t(16) << 30);
+    std::vector<std::string> names;
+    for (unsigned long n = 0; n < nodeCount; ++n) {
+        names.push_back("10." + std::to_string(n >> 16) + "." + std::to_string((n >> 8) & 0xff) + "." +
+                        std::to_string(n & 0xff));
+    }
+
+    // A fixed seed, so every run stores the same series
+    std::mt19937 rng(1);
+    std::vector<float> cpu(nodeCount, 50.0f), gpu(nodeCount, 50.0f);
+    double ingestMillis = millisOf([&] {
+        for (unsigned long second = 0; second < seconds; ++second) {
+            for (unsigned long n = 0; n < nodeCount; ++n) {
+                cpu[n] = std::clamp(cpu[n] + static_cast<float>(static_cast<int>(rng() % 7) - 3), 0.0f, 100.0f);
+                gpu[n] = std::clamp(gpu[n] + static_cast<float>(static_cast<int>(rng() % 5) - 2), 0.0f, 100.0f);
+                if (n < 2) {
+                    unsigned long hot = n == 0 ? 360 : 240;
+                    cpu[n] = second >= seconds - hot ? 95.0f : second < seconds - 400 ? 10.0f : cpu[n];
+                }
+                MetricFrame frame;
+                frame.timestampMicros = START_MICROS + second * 1000000;
+                frame.set(MetricId::CPU_USAGE, cpu[n]);
+                frame.set(MetricId::GPU_USAGE, 0, gpu[n]);
+                store.append(names[n], frame);
+            }
+        }
+    });
+    std::printf("%lu nodes x %lu s: %llu samples, %.1f MiB, ingested in %.1f s\n", nodeCount, seconds,
+                static_cast<unsigned long long>(store.samples()), static_cast<double>(store.memoryUsed()) / (1 << 20),
+                ingestMillis / 1000.0);
+
+    MetricQuery query(store);
+    MetricQuery::Selection hour;
+    hour.id = MetricId::GPU_USAGE;
+    hour.fromMicros = START_MICROS;
+    hour.toMicros = START_MICROS + seconds * 1000000 - 1;
+    MetricQuery::Selection recent = hour;
+    recent.fromMicros = hour.toMicros + 1 - 300 * 1000000ull;
+
+    // Every value is above -inf, so this only forces the decode path
+    const QueryPredicate everything{QueryPredicate::ABOVE, -std::numeric_limits<float>::infinity()};
+    struct Named {
+        const char* name;
+        QueryAggregate aggregate;
+    };
+    const Named summarized[] = {
+        {"COUNT", QueryAggregate::COUNT}, {"SUM", QueryAggregate::SUM}, {"MEAN", QueryAggregate::MEAN},
+        {"MIN", QueryAggregate::MIN},     {"MAX", QueryAggregate::MAX}, {"LAST", QueryAggregate::LAST},
+    };
+
+    std::printf("%-22s %12s %12s\n", "aggregate, window", "summary ms", "decoded ms");
+    for (const MetricQuery::Selection* selection : {&hour, &recent}) {
+        const char* window = selection == &hour ? "all" : "last 5 min";
+        for (const Named& named : summarized) {
+            std::vector<NodeAggregate> fast, decoded;
+            double fastMillis = millisOf([&] { fast = query.aggregate(*selection, named.aggregate); });
+            double decodedMillis = millisOf([&] { decoded = query.aggregate(*selection, named.aggregate, &everything); });
+            std::string label = std::string(named.name) + ", " + window;
+            std::printf("%-22s %12.1f %12.1f\n", label.c_str(), fastMillis, decodedMillis);
+            check(sameRows(fast, decoded), label + ": summaries agree with the decoded samples");
+        }
+    }
+
+    std::vector<NodeAggregate> p95;
+    double millis = millisOf([&] { p95 = query.aggregate(hour, QueryAggregate::P95); });
+    std::printf("p95 per node, all: %.1f ms\n", millis);
+    check(p95.size() == nodeCount, "p95: one row per node");
+
+    MetricQuery::Selection lastTen = hour;
+    lastTen.id = MetricId::CPU_USAGE;
+    lastTen.fromMicros = hour.toMicros + 1 - 600 * 1000000ull;
+    const QueryPredicate above80{QueryPredicate::ABOVE, 80.0f};
+    std::vector<NodeAggregate> hot;
+    millis = millisOf([&] { hot = query.sustained(lastTen, above80, 300 * 1000000ull); });
+    std::printf("CPU > 80 for 5 min in the last 10: %.1f ms\n", millis);
+    auto found = [&hot](const std::string& node) {
+        return std::any_of(hot.begin(), hot.end(), [&node](const NodeAggregate& row) { return row.node == node; });
+    };
+    check(found(names[0]) && !found(names[1]), "sustained: node 0 held 6 minutes, node 1 only 4");
+
+    std::vector<NodeWindows> windows;
+    millis = millisOf([&] { windows = query.windowAggregate(hour, QueryAggregate::MAX, 60 * 1000000ull); });
+    std::printf("per-minute max, all: %.1f ms\n", millis);
+    check(!windows.empty() && windows[0].values.size() == (seconds + 59) / 60, "windows: one bucket per minute");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,129 @@
+// Times MPIController's collection round, the NODE_FRAME query the leader sends to the
+// lowest rank of every host, point to point, on a real MPI job.
+//
+//   mpirun -np <ranks> NodeFrameRoundBench [--rounds <n>] [seastar options]
+//
+// Every rank builds the directory and serves queries as Director::initialize does. Rank 0
+// then runs collectNodeFrames() for the given number of rounds, after one untimed round,
+// while the other ranks only answer; all of them keep serving until rank 0 is done. Prints
+// the round latency (best, p50, p99, worst) and the frames and bytes per round, and exits 1
+// unless every round brought back one frame per host, each naming a different host.
+// Anything other than --rounds goes to Seastar.
+// e.g. mpirun -np 8 NodeFrameRoundBench --rounds 1000 --smp 1
+
+#include "MPIController.h"
+#include "ProbeWorker.h"
+#include <seastar/core/app-template.hh>
+#include <seastar/core/sleep.hh>
+#include <seastar/core/thread.hh>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+    int usage(const char* program) {
+        std::fprintf(stderr, "usage: mpirun -np <ranks> %s [--rounds <n>] [seastar options]\n", program);
+        return 2;
+    }
+
+    // Hosts the directory knows, by the name collectNodeFrames() reports them under
+    std::set<std::string> directoryHosts() {
+        std::set<std::string> hostnames, hosts;
+        for (const RankAddress& address : MPIController::rankAddresses()) {
+            if (hostnames.insert(address.hostname).second) {
+                hosts.insert(address.ip.empty() ? address.hostname : address.ip);
+            }
+        }
+        return hosts;
+    }
+
+    bool oneFramePerHost(const std::vector<NodeFrame>& frames, const std::set<std::string>& hosts) {
+        std::set<std::string> seen;
+        for (const NodeFrame& frame : frames) {
+            if (!hosts.count(frame.node) || !seen.insert(frame.node).second) {
+                return false;
+            }
+        }
+        return seen.size() == hosts.size();
+    }
+
+    // Keeps this rank answering until every rank has got here
+    void serveUntilAllDone() {
+        MPI_Request barrier;
+        MPI_Ibarrier(MPI_COMM_WORLD, &barrier);
+        int done = 0;
+        while (!done) {
+            MPI_Test(&barrier, &done, MPI_STATUS_IGNORE);
+            seastar::sleep(std::chrono::milliseconds(1)).get();
+        }
+    }
+
+    int runRounds(unsigned long rounds) {
+        std::set<std::string> hosts = directoryHosts();
+        bool complete = oneFramePerHost(MPIController::collectNodeFrames().get(), hosts);
+        std::vector<double> latencies;
+        for (unsigned long round = 0; round < rounds; ++round) {
+            auto started = std::chrono::steady_clock::now();
+            std::vector<NodeFrame> frames = MPIController::collectNodeFrames().get();
+            latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count());
+            complete = complete && oneFramePerHost(frames, hosts);
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        std::printf("%zu ranks on %zu hosts, %zu frames of %zu bytes per round\n", MPIController::rankAddresses().size(),
+                    hosts.size(), hosts.size(), sizeof(NodeFrame));
+        std::printf("round: best %.3f ms, p50 %.3f ms, p99 %.3f ms, worst %.3f ms over %lu rounds\n", latencies.front(),
+                    latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100], latencies.back(), rounds);
+        std::printf("%-4s every round brought back one frame per host\n", complete ? "ok" : "FAIL");
+        return complete ? 0 : 1;
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned long rounds = 200;
+    std::vector<char*> seastarArgs = {argv[0]};
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option != "--rounds") {
+            seastarArgs.push_back(argv[i]);
+        } else if (i + 1 >= argc) {
+            return usage(argv[0]);
+        } else {
+            rounds = std::strtoul(argv[++i], nullptr, 10);
+        }
+    }
+    if (rounds == 0) {
+        return usage(argv[0]);
+    }
+
+    seastar::app_template app;
+    int status = app.run(static_cast<int>(seastarArgs.size()), seastarArgs.data(), [rounds] {
+        return seastar::async([rounds] {
+            int result = 1;
+            try {
+                MPIController::initialize();
+                MPIController::buildDirectory().get();
+                MPIController::serveQueries().get();
+                result = MPIController::localRank() == 0 ? runRounds(rounds) : 0;
+                serveUntilAllDone();
+                MPIController::stopServing().get();
+                ProbeWorker::forShard().stop().get();
+            } catch (const std::exception& e) {
+                std::fprintf(stderr, "%s\n", e.what());
+                return 1;
+            }
+            return result;
+        });
+    });
+    int initialized = 0;
+    MPI_Initialized(&initialized);
+    if (initialized) {
+        MPI_Finalize();
+    }
+    return status;
+}
@@ -0,0 +1,248 @@
+// Times a /metrics scrape over the node frames of a large cluster, through the same
+// MetricsExposition update, snapshot and join path MetricsExporter serves.
+//
+//   ScrapeBench [--nodes <n>] [--shards <n>] [--ticks <n>] [--scrapes <n>]
+//
+// Nodes are spread over the shards, each with its own MetricsExposition, and every tick
+// each shard updates its nodes with a fresh frame (CPU, memory and 8 GPUs) and publishes,
+// on a thread per shard. Each scrape then snapshots every shard, joins the pieces with
+// forEachPiece() and writes them with writev() to a socket that a reader drains, and is
+// timed until the reader has everything. snapshot() runs on the scraping thread here,
+// where the exporter submits it to each shard. Prints the update and publish CPU time per
+// tick and the scrape latency, and exits 1 if a scrape did not carry one line per sample.
+// e.g. ScrapeBench --nodes 10000 --shards 4 --scrapes 100
+
+#include "MetricsExposition.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    int usage(const char* program) {
+        std::fprintf(stderr, "usage: %s [--nodes <n>] [--shards <n>] [--ticks <n>] [--scrapes <n>]\n", program);
+        return 2;
+    }
+
+    constexpr unsigned int GPUS = 8;
+
+    // What a GPU node's collected frame carries
+    MetricFrame nodeFrame(std::mt19937& rng, uint64_t timestampMicros) {
+        std::uniform_real_distribution<float> percent(0.0f, 100.0f);
+        MetricFrame frame;
+        frame.timestampMicros = timestampMicros;
+        frame.set(MetricId::CPU_USAGE, percent(rng));
+        frame.set(MetricId::TOTAL_MEMORY, 6.4e10);
+        frame.set(MetricId::FREE_MEMORY, percent(rng) * 1e8f);
+        frame.set(MetricId::USED_MEMORY, percent(rng) * 1e8f);
+        for (MetricId id : {MetricId::GPU_COUNT, MetricId::GPU_MAX_TEMPERATURE, MetricId::GPU_MEAN_USAGE,
+                            MetricId::GPU_MIN_USAGE, MetricId::GPU_MEMORY_PRESSURE, MetricId::GPU_USAGE_P50,
+                            MetricId::GPU_USAGE_P90, MetricId::GPU_USAGE_P99, MetricId::GPU_POWER_P90}) {
+            frame.set(id, percent(rng));
+        }
+        for (unsigned int gpu = 0; gpu < GPUS; ++gpu) {
+            for (MetricId id : {MetricId::GPU_TEMPERATURE, MetricId::GPU_USAGE, MetricId::GPU_MEMORY_USAGE,
+                                MetricId::GPU_POWER_USAGE, MetricId::GPU_FAN_SPEED, MetricId::GPU_CORE_CLOCK,
+                                MetricId::GPU_MEMORY_CLOCK}) {
+                frame.set(id, gpu, percent(rng));
+            }
+        }
+        return frame;
+    }
+
+    // Drains the scrape socket and counts the lines it carried
+    class Drain {
+    public:
+        explicit Drain(int fd) : fd(fd), thread([this] { run(); }) {}
+        ~Drain() { thread.join(); }
+
+        uint64_t bytes() const { return received.load(std::memory_order_acquire); }
+        uint64_t lines() const { return newlines.load(std::memory_order_acquire); }
+
+    private:
+        void run() {
+            std::vector<char> buffer(1 << 20);
+            while (true) {
+                ssize_t n = read(fd, buffer.data(), buffer.size());
+                if (n <= 0) {
+                    return;
+                }
+                newlines.fetch_add(static_cast<uint64_t>(std::count(buffer.data(), buffer.data() + n, '\n')),
+                                   std::memory_order_relaxed);
+                received.fetch_add(static_cast<uint64_t>(n), std::memory_order_release);
+            }
+        }
+
+        int fd;
+        std::atomic<uint64_t> received{0};
+        std::atomic<uint64_t> newlines{0};
+        std::thread thread;
+    };
+
+    void writeAll(int fd, std::vector<iovec>& pieces) {
+        size_t next = 0;
+        while (next < pieces.size()) {
+            ssize_t written = writev(fd, pieces.data() + next, static_cast<int>(std::min<size_t>(pieces.size() - next, IOV_MAX)));
+            if (written < 0) {
+                throw std::runtime_error("writev failed");
+            }
+            for (size_t left = static_cast<size_t>(written); left > 0;) {
+                size_t take = std::min(left, pieces[next].iov_len);
+                pieces[next].iov_base = static_cast<char*>(pieces[next].iov_base) + take;
+                pieces[next].iov_len -= take;
+                left -= take;
+                if (pieces[next].iov_len == 0) {
+                    ++next;
+                }
+            }
+        }
+    }
+
+    // CPU time of the calling thread, so shards sharing a core do not charge each other
+    double threadCpuMillis() {
+        timespec now;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+        return static_cast<double>(now.tv_sec) * 1e3 + static_cast<double>(now.tv_nsec) / 1e6;
+    }
+
+    double millisSince(std::chrono::steady_clock::time_point started) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned long nodeCount = 10000;
+    unsigned long shardCount = 4;
+    unsigned long ticks = 3;
+    unsigned long scrapes = 50;
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) {
+            return usage(argv[0]);
+        } else if (option == "--nodes") {
+            nodeCount = std::strtoul(argv[++i], nullptr, 10);
+        } else if (option == "--shards") {
+            shardCount = std::strtoul(argv[++i], nullptr, 10);
+        } else if (option == "--ticks") {
+            ticks = std::strtoul(argv[++i], nullptr, 10);
+        } else if (option == "--scrapes") {
+            scrapes = std::strtoul(argv[++i], nullptr, 10);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (nodeCount == 0 || shardCount == 0 || ticks == 0 || scrapes == 0) {
+        return usage(argv[0]);
+    }
+
+    std::vector<MetricsExposition> shards(shardCount);
+    std::vector<double> updateMillis(shardCount), publishMillis(shardCount);
+    uint64_t samplesPerFrame = 0;
+    std::mt19937 counting;
+    nodeFrame(counting, 1).forEach([&samplesPerFrame](const MetricTraits&, unsigned int, float) { ++samplesPerFrame; });
+
+    for (unsigned long tick = 0; tick < ticks; ++tick) {
+        std::vector<std::thread> threads;
+        for (unsigned long s = 0; s < shardCount; ++s) {
+            threads.emplace_back([&, s] {
+                std::mt19937 rng(static_cast<uint32_t>(tick * shardCount + s));
+                std::vector<std::pair<std::string, MetricFrame>> frames;
+                for (unsigned long n = s; n < nodeCount; n += shardCount) {
+                    frames.emplace_back("10." + std::to_string(n >> 16) + "." + std::to_string((n >> 8) & 0xff) + "." +
+                                            std::to_string(n & 0xff),
+                                        nodeFrame(rng, 1760659200000000ull + tick * 1000000));
+                }
+                double started = threadCpuMillis();
+                for (const auto& [node, frame] : frames) {
+                    shards[s].update(node, frame);
+                }
+                updateMillis[s] = threadCpuMillis() - started;
+                started = threadCpuMillis();
+                shards[s].publish();
+                publishMillis[s] = threadCpuMillis() - started;
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+    double updateWorst = *std::max_element(updateMillis.begin(), updateMillis.end());
+    double publishWorst = *std::max_element(publishMillis.begin(), publishMillis.end());
+    std::printf("%lu nodes on %lu shards, %llu samples per frame\n", nodeCount, shardCount,
+                static_cast<unsigned long long>(samplesPerFrame));
+    std::printf("tick, slowest shard: update %.1f ms CPU (%.2f us/frame), publish %.1f ms CPU\n", updateWorst,
+                updateWorst * 1000.0 / static_cast<double>((nodeCount + shardCount - 1) / shardCount), publishWorst);
+
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+        std::fprintf(stderr, "Failed to create a socket pair\n");
+        return 1;
+    }
+    int sendBuffer = 4 << 20;
+    setsockopt(sockets[0], SOL_SOCKET, SO_SNDBUF, &sendBuffer, sizeof(sendBuffer));
+
+    std::vector<double> latencies;
+    uint64_t scrapeBytes = 0, scrapeLines = 0;
+    size_t pieceCount = 0;
+    try {
+        Drain drain(sockets[1]);
+        for (unsigned long scrape = 0; scrape < scrapes; ++scrape) {
+            uint64_t bytesBefore = drain.bytes(), linesBefore = drain.lines();
+            auto started = std::chrono::steady_clock::now();
+            std::vector<MetricsExposition::Snapshot> snapshots;
+            for (MetricsExposition& shard : shards) {
+                snapshots.push_back(shard.snapshot());
+            }
+            std::vector<iovec> pieces;
+            uint64_t length = 0;
+            MetricsExposition::forEachPiece(snapshots, MetricsExposition::Format::PROMETHEUS,
+                                            [&](const std::string& text, const MetricsExposition::Buffer&) {
+                pieces.push_back({const_cast<char*>(text.data()), text.size()});
+                length += text.size();
+            });
+            pieceCount = pieces.size();
+            writeAll(sockets[0], pieces);
+            while (drain.bytes() - bytesBefore < length) {
+                std::this_thread::yield();
+            }
+            latencies.push_back(millisSince(started));
+            scrapeBytes = length;
+            scrapeLines = drain.lines() - linesBefore;
+        }
+        shutdown(sockets[0], SHUT_WR);
+    } catch (const std::exception& e) {
+        close(sockets[0]);
+        close(sockets[1]);
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    close(sockets[0]);
+    close(sockets[1]);
+
+    std::sort(latencies.begin(), latencies.end());
+    std::printf("scrape: %.1f MB in %zu pieces; best %.2f ms, p50 %.2f ms, worst %.2f ms over %lu scrapes\n",
+                static_cast<double>(scrapeBytes) / 1e6, pieceCount, latencies.front(), latencies[latencies.size() / 2],
+                latencies.back(), scrapes);
+
+    // One "# TYPE" line per family and one line per sample
+    uint64_t families = 0;
+    for (size_t i = 0; i < METRIC_COUNT; ++i) {
+        families += std::any_of(shards.begin(), shards.end(), [i](MetricsExposition& shard) { return shard.snapshot()[i] != nullptr; }) ? 1 : 0;
+    }
+    uint64_t expected = families + nodeCount * samplesPerFrame;
+    bool complete = scrapeLines == expected;
+    std::printf("%-4s scrape carried %llu lines, want %llu\n", complete ? "ok" : "FAIL",
+                static_cast<unsigned long long>(scrapeLines), static_cast<unsigned long long>(expected));
+    return complete ? 0 : 1;
+}
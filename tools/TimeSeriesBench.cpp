@@ -0,0 +1,146 @@
+// Feeds TimeSeriesStore the way monitorNodes does, one frame per node per second, and
+// reports what the history costs.
+//
+//   TimeSeriesBench [--nodes <n>] [--metrics <n>] [--seconds <n>] [--readers <n>]
+//                   [--budget-mb <n>]
+//
+// Values are random walks and timestamps jitter by up to 2 ms, as real ticks do. Prints
+// the bytes per stored sample (everything memoryUsed() charges, bookkeeping included),
+// the ingest rate, the worst tick, and how many aggregate() reads the reader threads
+// completed meanwhile. Eviction starts once the budget is reached.
+// e.g. TimeSeriesBench --nodes 10000 --metrics 50 --seconds 300 --readers 1
+
+#include "TimeSeriesStore.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+    int usage(const char* program) {
+        std::fprintf(stderr,
+                     "usage: %s [--nodes <n>] [--metrics <n>] [--seconds <n>] [--readers <n>] [--budget-mb <n>]\n",
+                     program);
+        return 2;
+    }
+
+    // The first count slots of the schema, per-GPU metrics taking one slot per GPU
+    std::vector<std::pair<MetricId, unsigned int>> firstSlots(size_t count) {
+        std::vector<std::pair<MetricId, unsigned int>> slots;
+        for (const MetricTraits& traits : METRIC_SCHEMA) {
+            unsigned int gpus = traits.perGpu ? static_cast<unsigned int>(MAX_GPUS) : 1u;
+            for (unsigned int gpu = 0; gpu < gpus && slots.size() < count; ++gpu) {
+                slots.emplace_back(traits.id, gpu);
+            }
+        }
+        return slots;
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned long nodeCount = 10000;
+    unsigned long metricCount = 50;
+    unsigned long seconds = 300;
+    unsigned long readerCount = 0;
+    unsigned long budgetMegabytes = 4096;
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) {
+            return usage(argv[0]);
+        } else if (option == "--nodes") {
+            nodeCount = std::strtoul(argv[++i], nullptr, 10);
+        } else if (option == "--metrics") {
+            metricCount = std::strtoul(argv[++i], nullptr, 10);
+        } else if (option == "--seconds") {
+            seconds = std::strtoul(argv[++i], nullptr, 10);
+        } else if (option == "--readers") {
+            readerCount = std::strtoul(argv[++i], nullptr, 10);
+        } else if (option == "--budget-mb") {
+            budgetMegabytes = std::strtoul(argv[++i], nullptr, 10);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (nodeCount == 0 || metricCount == 0 || metricCount > METRIC_SLOTS || seconds == 0 || budgetMegabytes == 0) {
+        return usage(argv[0]);
+    }
+
+    TimeSeriesStore store(size_t(budgetMegabytes) << 20);
+    std::vector<std::pair<MetricId, unsigned int>> slots = firstSlots(metricCount);
+    std::vector<std::string> names;
+    for (unsigned long n = 0; n < nodeCount; ++n) {
+        names.push_back("10." + std::to_string(n >> 16) + "." + std::to_string((n >> 8) & 0xff) + "." +
+                        std::to_string(n & 0xff));
+    }
+
+    // A fixed seed, so every run stores the same series
+    std::mt19937 rng(7);
+    std::vector<std::vector<float>> walks(nodeCount, std::vector<float>(slots.size()));
+    for (auto& walk : walks) {
+        for (float& value : walk) {
+            value = static_cast<float>(rng() % 100);
+        }
+    }
+
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> reads{0};
+    std::vector<std::thread> readers;
+    for (unsigned long r = 0; r < readerCount; ++r) {
+        readers.emplace_back([&, r] {
+            std::mt19937 pick(static_cast<uint32_t>(r + 1));
+            while (!stop.load(std::memory_order_relaxed)) {
+                const auto& [id, gpu] = slots[pick() % slots.size()];
+                store.aggregate(names[pick() % nodeCount], id, gpu, 0, UINT64_MAX);
+                reads.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    constexpr uint64_t START_SECONDS = 1700000000;
+    double worstTick = 0.0;
+    auto started = std::chrono::steady_clock::now();
+    for (unsigned long second = 0; second < seconds; ++second) {
+        auto tickStarted = std::chrono::steady_clock::now();
+        for (unsigned long n = 0; n < nodeCount; ++n) {
+            MetricFrame frame;
+            frame.timestampMicros = (START_SECONDS + second) * 1000000 + rng() % 2000;
+            std::vector<float>& walk = walks[n];
+            for (size_t m = 0; m < slots.size(); ++m) {
+                // Most gauges hold still between ticks; the rest step a little
+                if (rng() % 4 == 0) {
+                    walk[m] = std::clamp(walk[m] + static_cast<float>(static_cast<int>(rng() % 5) - 2), 0.0f, 100.0f);
+                }
+                frame.set(slots[m].first, slots[m].second, walk[m]);
+            }
+            store.append(names[n], frame);
+        }
+        worstTick = std::max(worstTick, std::chrono::duration<double>(std::chrono::steady_clock::now() - tickStarted).count());
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    stop = true;
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+
+    uint64_t appended = static_cast<uint64_t>(nodeCount) * slots.size() * seconds;
+    std::printf("%lu nodes x %zu metrics x %lu s at 1 Hz, %lu reader(s)\n", nodeCount, slots.size(), seconds, readerCount);
+    std::printf("stored          %llu samples (%llu appended, %llu evicted blocks)\n",
+                static_cast<unsigned long long>(store.samples()), static_cast<unsigned long long>(appended),
+                static_cast<unsigned long long>(store.evictedBlocks()));
+    std::printf("memory          %.1f MiB of a %lu MiB budget\n", static_cast<double>(store.memoryUsed()) / (1 << 20),
+                budgetMegabytes);
+    std::printf("bytes/sample    %.3f\n", static_cast<double>(store.memoryUsed()) / static_cast<double>(store.samples()));
+    std::printf("ingest          %.2f M samples/s, %.3f s per tick, worst tick %.3f s\n",
+                static_cast<double>(appended) / elapsed / 1e6, elapsed / static_cast<double>(seconds), worstTick);
+    if (readerCount) {
+        std::printf("reads           %llu aggregate() calls, %.0f/s\n", static_cast<unsigned long long>(reads.load()),
+                    static_cast<double>(reads.load()) / elapsed);
+    }
+    return 0;
+}